@@ -0,0 +1,200 @@
+/**
+ * @file cmlds_shm.c
+ * @brief Publishes the CMLDS link delay in shared memory.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * Every CMLDS link port owns one record, indexed by its port number.
+ * The records are protected by a sequence lock. The writer makes the
+ * sequence odd while it updates the fields, and readers retry whenever
+ * they observe an odd or changed sequence. Half the sequence counts the
+ * publications and serves as the generation of the record.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cmlds_shm.h"
+#include "print.h"
+
+#define CMLDS_SHM_MAGIC		0x434d4c44 /* CMLD */
+#define CMLDS_SHM_VERSION	1
+#define CMLDS_SHM_RETRIES	16
+
+struct cmlds_shm_record {
+	uint32_t seq;
+	int32_t scaled_nrr;
+	int64_t mean_link_delay;
+	uint32_t as_capable;
+} __attribute__((aligned(64)));
+
+struct cmlds_shm_segment {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t n_records;
+	struct cmlds_shm_record record[CMLDS_SHM_MAX_PORT + 1];
+} __attribute__((aligned(64)));
+
+struct cmlds_shm {
+	struct cmlds_shm_segment *seg;
+	struct cmlds_shm_record *record;
+	uint32_t last_seq;
+	bool publisher;
+};
+
+static int cmlds_shm_map(struct cmlds_shm *shm, const char *path)
+{
+	int fd, flags = shm->publisher ? O_RDWR | O_CREAT : O_RDONLY;
+	int prot = shm->publisher ? PROT_READ | PROT_WRITE : PROT_READ;
+	struct stat st;
+	void *addr;
+
+	fd = open(path, flags, 0644);
+	if (fd < 0) {
+		pr_err("cmlds_shm: failed to open %s: %m", path);
+		return -1;
+	}
+	if (fstat(fd, &st)) {
+		pr_err("cmlds_shm: fstat failed: %m");
+		goto fail;
+	}
+	if (st.st_size < (off_t) sizeof(*shm->seg)) {
+		if (!shm->publisher) {
+			pr_err("cmlds_shm: %s is too small", path);
+			goto fail;
+		}
+		if (ftruncate(fd, sizeof(*shm->seg))) {
+			pr_err("cmlds_shm: ftruncate failed: %m");
+			goto fail;
+		}
+	}
+	addr = mmap(NULL, sizeof(*shm->seg), prot, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		pr_err("cmlds_shm: mmap failed: %m");
+		goto fail;
+	}
+	close(fd);
+	shm->seg = addr;
+	return 0;
+fail:
+	close(fd);
+	return -1;
+}
+
+struct cmlds_shm *cmlds_shm_open(const char *path, int port, bool publisher)
+{
+	struct cmlds_shm_segment *seg;
+	struct cmlds_info_np info;
+	struct cmlds_shm *shm;
+
+	if (port < 0 || port > CMLDS_SHM_MAX_PORT) {
+		pr_err("cmlds_shm: port %d out of range", port);
+		return NULL;
+	}
+	shm = calloc(1, sizeof(*shm));
+	if (!shm) {
+		return NULL;
+	}
+	shm->publisher = publisher;
+	if (cmlds_shm_map(shm, path)) {
+		free(shm);
+		return NULL;
+	}
+	seg = shm->seg;
+
+	if (publisher && seg->magic != CMLDS_SHM_MAGIC) {
+		seg->version = CMLDS_SHM_VERSION;
+		seg->n_records = CMLDS_SHM_MAX_PORT + 1;
+		__atomic_store_n(&seg->magic, CMLDS_SHM_MAGIC, __ATOMIC_RELEASE);
+	}
+	if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != CMLDS_SHM_MAGIC ||
+	    seg->version != CMLDS_SHM_VERSION ||
+	    seg->n_records <= (uint32_t) port) {
+		pr_err("cmlds_shm: %s has an unknown layout", path);
+		cmlds_shm_close(shm);
+		return NULL;
+	}
+	shm->record = &seg->record[port];
+
+	if (publisher) {
+		/* Discard whatever a previous server left behind. */
+		memset(&info, 0, sizeof(info));
+		cmlds_shm_publish(shm, &info);
+	} else {
+		shm->last_seq = __atomic_load_n(&shm->record->seq,
+						__ATOMIC_ACQUIRE);
+	}
+	return shm;
+}
+
+void cmlds_shm_close(struct cmlds_shm *shm)
+{
+	struct cmlds_info_np info;
+
+	if (shm->publisher && shm->record) {
+		memset(&info, 0, sizeof(info));
+		cmlds_shm_publish(shm, &info);
+	}
+	munmap(shm->seg, sizeof(*shm->seg));
+	free(shm);
+}
+
+void cmlds_shm_publish(struct cmlds_shm *shm, struct cmlds_info_np *info)
+{
+	struct cmlds_shm_record *r = shm->record;
+	uint32_t seq;
+
+	if (!shm->publisher) {
+		return;
+	}
+	seq = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+	if (seq & 1) {
+		/* A previous writer died in the middle of an update. */
+		seq++;
+	}
+	__atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&r->mean_link_delay, info->meanLinkDelay,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&r->scaled_nrr, info->scaledNeighborRateRatio,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&r->as_capable, info->as_capable, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&r->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int cmlds_shm_read(struct cmlds_shm *shm, struct cmlds_info_np *info)
+{
+	struct cmlds_shm_record *r = shm->record;
+	uint32_t seq, check;
+	int i;
+
+	for (i = 0; i < CMLDS_SHM_RETRIES; i++) {
+		seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
+		}
+		info->meanLinkDelay =
+			__atomic_load_n(&r->mean_link_delay, __ATOMIC_RELAXED);
+		info->scaledNeighborRateRatio =
+			__atomic_load_n(&r->scaled_nrr, __ATOMIC_RELAXED);
+		info->as_capable =
+			__atomic_load_n(&r->as_capable, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		check = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+		if (check != seq) {
+			continue;
+		}
+		if (seq == shm->last_seq) {
+			return 0;
+		}
+		shm->last_seq = seq;
+		return 1;
+	}
+	return -1;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file cmlds_shm.h
+ * @brief Publishes the CMLDS link delay in shared memory.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_CMLDS_SHM_H
+#define HAVE_CMLDS_SHM_H
+
+#include <stdbool.h>
+
+#include "tlv.h"
+
+/** Largest port number that has a record in the shared memory. */
+#define CMLDS_SHM_MAX_PORT 255
+
+struct cmlds_shm;
+
+/**
+ * Opens the shared memory record of a CMLDS link port.
+ *
+ * The CMLDS server opens the record for writing, creating the file if
+ * needed, while the domain instances open it read only.
+ *
+ * @param path       Path of the shared memory file.
+ * @param port       Port number of the CMLDS link port.
+ * @param publisher  True to open the record for writing.
+ * @return           Pointer to the record on success, NULL otherwise.
+ */
+struct cmlds_shm *cmlds_shm_open(const char *path, int port, bool publisher);
+
+/**
+ * Closes a shared memory record. A publisher marks its record as not
+ * capable before going away.
+ * @param shm  A pointer obtained via @ref cmlds_shm_open().
+ */
+void cmlds_shm_close(struct cmlds_shm *shm);
+
+/**
+ * Publishes the current link delay. This is a no-op for readers.
+ * @param shm   A pointer obtained via @ref cmlds_shm_open().
+ * @param info  The link delay information in host byte order.
+ */
+void cmlds_shm_publish(struct cmlds_shm *shm, struct cmlds_info_np *info);
+
+/**
+ * Reads the link delay without making any system calls.
+ * @param shm   A pointer obtained via @ref cmlds_shm_open().
+ * @param info  Returns the link delay information in host byte order.
+ * @return      1 if the record changed since the previous call, 0 if it
+ *              did not, or -1 if no consistent record could be read.
+ */
+int cmlds_shm_read(struct cmlds_shm *shm, struct cmlds_info_np *info);
+
+#endif
@@ -253,6 +253,11 @@ static struct config_enum bmca_enu[] = {
 
 struct config_item config_tab[] = {
 	PORT_ITEM_UIN("active_key_id", 0, 0, UINT32_MAX),
+	PORT_ITEM_INT("adaptive_rate", 0, 0, 1),
+	PORT_ITEM_INT("adaptive_rate_maxLogPdelayReqInterval", 0, INT8_MIN, INT8_MAX),
+	PORT_ITEM_INT("adaptive_rate_maxLogSyncInterval", 0, INT8_MIN, INT8_MAX),
+	PORT_ITEM_INT("adaptive_rate_threshold", 100, 1, INT_MAX),
+	PORT_ITEM_INT("adaptive_rate_window", 16, 2, 1024),
 	PORT_ITEM_INT("allow_unauth", 0, 0, 2),
 	PORT_ITEM_INT("allowedLostResponses", 3, 1, 255),
 	PORT_ITEM_INT("announceReceiptTimeout", 3, 2, UINT8_MAX),
@@ -260,6 +265,7 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("assume_two_step", 0, 0, 1),
 	PORT_ITEM_INT("boundary_clock_jbod", 0, 0, 1),
 	PORT_ITEM_ENU("BMCA", BMCA_PTP, bmca_enu),
+	PORT_ITEM_INT("busy_poll", 0, 0, INT_MAX),
 	GLOB_ITEM_INT("check_fup_sync", 0, 0, 1),
 	GLOB_ITEM_INT("clientOnly", 0, 0, 1),
 	GLOB_ITEM_INT("clockAccuracy", 0xfe, 0, UINT8_MAX),
@@ -273,6 +279,7 @@ struct config_item config_tab[] = {
 	PORT_ITEM_INT("cmlds.majorSdoId", 2, 0, 0x0F),
 	PORT_ITEM_INT("cmlds.port", 0, 0, UINT16_MAX),
 	PORT_ITEM_STR("cmlds.server_address", "/var/run/cmlds_server"),
+	PORT_ITEM_STR("cmlds.shm_path", ""),
 	GLOB_ITEM_ENU("dataset_comparison", DS_CMP_IEEE1588, dataset_comp_enu),
 	PORT_ITEM_INT("delayAsymmetry", 0, INT_MIN, INT_MAX),
 	PORT_ITEM_ENU("delay_filter", FILTER_MOVING_MEDIAN, delay_filter_enu),
@@ -328,7 +335,15 @@ struct config_item config_tab[] = {
 	PORT_ITEM_STR("p2p_dst_ipv6", "FF02:0:0:0:0:0:0:6B"),
 	PORT_ITEM_STR("p2p_dst_mac", "01:80:C2:00:00:0E"),
 	PORT_ITEM_INT("path_trace_enabled", 0, 0, 1),
+	GLOB_ITEM_INT("phc2sys.sample_burst", 1, 1, 64),
+	GLOB_ITEM_INT("phc2sys.sample_burst_gap", 100000, 0, 999999999),
+	GLOB_ITEM_INT("phc2sys.sample_phase", -1, -1, 999999999),
+	GLOB_ITEM_INT("phc2sys.sysoff_robust", 0, 0, PTP_MAX_SAMPLES),
 	PORT_ITEM_INT("phc_index", -1, -1, INT_MAX),
+	GLOB_ITEM_INT("pi_adaptive", 0, 0, 1),
+	GLOB_ITEM_DBL("pi_adaptive_max_factor", 2.0, 1.0, DBL_MAX),
+	GLOB_ITEM_DBL("pi_adaptive_min_factor", 0.0625, DBL_MIN, 1.0),
+	GLOB_ITEM_DBL("pi_adaptive_noise_ref", 100.0, DBL_MIN, DBL_MAX),
 	GLOB_ITEM_DBL("pi_integral_const", 0.0, 0.0, DBL_MAX),
 	GLOB_ITEM_DBL("pi_integral_exponent", 0.4, -DBL_MAX, DBL_MAX),
 	GLOB_ITEM_DBL("pi_integral_norm_max", 0.3, DBL_MIN, 2.0),
@@ -351,13 +366,22 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("ptp_minor_version", 1, 0, 1),
 	GLOB_ITEM_STR("refclock_sock_address", "/var/run/refclock.ptp.sock"),
 	GLOB_ITEM_STR("revisionData", ";;"),
+	PORT_ITEM_INT("rx_path_stats", 0, 0, 1),
 	GLOB_ITEM_STR("sa_file", NULL),
 	GLOB_ITEM_INT("sanity_freq_limit", 200000000, 0, INT_MAX),
 	PORT_ITEM_INT("serverOnly", 0, 0, 1),
 	GLOB_ITEM_INT("servo_num_offset_values", 10, 0, INT_MAX),
 	GLOB_ITEM_INT("servo_offset_threshold", 0, 0, INT_MAX),
+	GLOB_ITEM_STR("servo_state_file", ""),
+	GLOB_ITEM_INT("servo_state_interval", 16, 1, INT_MAX),
+	GLOB_ITEM_INT("servo_state_max_age", 3600, 0, INT_MAX),
+	GLOB_ITEM_DBL("servo_state_max_freq_diff", 100.0, 0.0, DBL_MAX),
 	GLOB_ITEM_STR("slave_event_monitor", ""),
+	GLOB_ITEM_INT("slave_event_monitor_max_latency", 0, 0, INT_MAX),
+	GLOB_ITEM_INT("slave_event_monitor_records", 1, 1, INT_MAX),
+	PORT_ITEM_INT("slave_fast_path", 0, 0, 1),
 	GLOB_ITEM_INT("slaveOnly", 0, 0, 1), /*deprecated*/
+	PORT_ITEM_INT("socket_domain_filter", 0, 0, 1),
 	GLOB_ITEM_INT("socket_priority", 0, 0, 15),
 	PORT_ITEM_INT("spp", -1, -1, UINT8_MAX),
 	GLOB_ITEM_DBL("step_threshold", 0.0, 0.0, DBL_MAX),
@@ -365,6 +389,8 @@ struct config_item config_tab[] = {
 	GLOB_ITEM_INT("summary_interval", 0, INT_MIN, INT_MAX),
 	PORT_ITEM_INT("syncReceiptTimeout", 0, 0, UINT8_MAX),
 	GLOB_ITEM_INT("tc_spanning_tree", 0, 0, 1),
+	GLOB_ITEM_STR("telemetry_shm", ""),
+	PORT_ITEM_INT("timer_slack", 0, 0, 100000000),
 	GLOB_ITEM_INT("timeSource", INTERNAL_OSCILLATOR, 0x10, 0xfe),
 	GLOB_ITEM_ENU("time_stamping", TS_HARDWARE, timestamping_enu),
 	PORT_ITEM_INT("transportSpecific", 0, 0, 0x0F),
@@ -382,6 +408,7 @@ struct config_item config_tab[] = {
 	PORT_ITEM_INT("ts2phc.pin_index", 0, 0, INT_MAX),
 	GLOB_ITEM_INT("ts2phc.pulsewidth", 500000000, 1000000, 999000000),
 	GLOB_ITEM_STR("ts2phc.tod_source", "generic"),
+	GLOB_ITEM_INT("ts2phc.workers", 0, 0, 1),
 	PORT_ITEM_ENU("tsproc_mode", TSPROC_FILTER, tsproc_enu),
 	GLOB_ITEM_INT("twoStepFlag", 1, 0, 1),
 	GLOB_ITEM_INT("tx_timestamp_timeout", 10, 1, INT_MAX),
@@ -403,6 +430,10 @@ struct config_item config_tab[] = {
 
 static struct unicast_master_table *current_uc_mtab;
 
+/* The defaults of config_tab, which a reload starts from. */
+static any_t config_tab_default[N_CONFIG_ITEMS];
+static int config_tab_default_saved;
+
 static enum parser_result
 parse_fault_interval(struct config *cfg, const char *section,
 		     const char *option, const char *value);
@@ -975,6 +1006,13 @@ struct config *config_create(void)
 		return NULL;
 	}
 
+	if (!config_tab_default_saved) {
+		for (i = 0; i < N_CONFIG_ITEMS; i++) {
+			config_tab_default[i] = config_tab[i].val;
+		}
+		config_tab_default_saved = 1;
+	}
+
 	/* Populate the hash table with global defaults. */
 	for (i = 0; i < N_CONFIG_ITEMS; i++) {
 		ci = &config_tab[i];
@@ -1008,7 +1046,7 @@ fail:
 	return NULL;
 }
 
-void config_destroy(struct config *cfg)
+static void config_free(struct config *cfg, void (*item_free)(void *))
 {
 	struct unicast_master_address *address;
 	struct unicast_master_table *table;
@@ -1029,11 +1067,313 @@ void config_destroy(struct config *cfg)
 		STAILQ_REMOVE_HEAD(&cfg->unicast_master_tables, list);
 		free(table);
 	}
-	hash_destroy(cfg->htab, config_item_free);
+	hash_destroy(cfg->htab, item_free);
 	free(cfg->opts);
 	free(cfg);
 }
 
+void config_destroy(struct config *cfg)
+{
+	config_free(cfg, config_item_free);
+}
+
+/*
+ * The global items in config_tab are shared by every configuration, so
+ * reading a second file overwrites them. The helpers below save and
+ * restore their values around the parsing of the new file.
+ */
+
+static int config_item_copy(struct config_item *dst, struct config_item *src)
+{
+	char *s;
+
+	if (dst->type != CFG_TYPE_STRING) {
+		dst->val = src->val;
+		return 0;
+	}
+	s = NULL;
+	if (src->val.s) {
+		s = strdup(src->val.s);
+		if (!s) {
+			pr_err("low memory");
+			return -1;
+		}
+	}
+	if (dst->flags & CFG_ITEM_DYNSTR) {
+		free(dst->val.s);
+	}
+	dst->val.s = s;
+	dst->flags |= CFG_ITEM_DYNSTR;
+	return 0;
+}
+
+static int config_item_equal(struct config_item *a, struct config_item *b)
+{
+	switch (a->type) {
+	case CFG_TYPE_INT:
+	case CFG_TYPE_ENUM:
+		return a->val.i == b->val.i;
+	case CFG_TYPE_DOUBLE:
+		return a->val.d == b->val.d;
+	case CFG_TYPE_STRING:
+		if (!a->val.s || !b->val.s)
+			return a->val.s == b->val.s;
+		return !strcmp(a->val.s, b->val.s);
+	case CFG_TYPE_UINT:
+		return a->val.u == b->val.u;
+	}
+	return 0;
+}
+
+static void config_tab_free(struct config_item *tab)
+{
+	int i;
+
+	if (!tab) {
+		return;
+	}
+	for (i = 0; i < N_CONFIG_ITEMS; i++) {
+		if (tab[i].type == CFG_TYPE_STRING &&
+		    tab[i].flags & CFG_ITEM_DYNSTR) {
+			free(tab[i].val.s);
+		}
+	}
+	free(tab);
+}
+
+static struct config_item *config_tab_save(void)
+{
+	struct config_item *tab;
+	int i;
+
+	tab = calloc(N_CONFIG_ITEMS, sizeof(*tab));
+	if (!tab) {
+		pr_err("low memory");
+		return NULL;
+	}
+	for (i = 0; i < N_CONFIG_ITEMS; i++) {
+		tab[i] = config_tab[i];
+		tab[i].flags &= ~CFG_ITEM_DYNSTR;
+		if (config_item_copy(&tab[i], &config_tab[i])) {
+			config_tab_free(tab);
+			return NULL;
+		}
+	}
+	return tab;
+}
+
+static void config_tab_restore(struct config_item *tab)
+{
+	int i;
+
+	for (i = 0; i < N_CONFIG_ITEMS; i++) {
+		if (config_tab[i].type == CFG_TYPE_STRING &&
+		    config_tab[i].flags & CFG_ITEM_DYNSTR) {
+			free(config_tab[i].val.s);
+		}
+		config_tab[i].val = tab[i].val;
+		config_tab[i].flags = tab[i].flags;
+	}
+	free(tab);
+}
+
+/* Returns the items to their defaults, except for the command line values. */
+static void config_tab_reset(void)
+{
+	int i;
+
+	for (i = 0; i < N_CONFIG_ITEMS; i++) {
+		if (config_tab[i].flags & CFG_ITEM_LOCKED) {
+			continue;
+		}
+		if (config_tab[i].type == CFG_TYPE_STRING &&
+		    config_tab[i].flags & CFG_ITEM_DYNSTR) {
+			free(config_tab[i].val.s);
+		}
+		config_tab[i].val = config_tab_default[i];
+		config_tab[i].flags &= ~CFG_ITEM_DYNSTR;
+	}
+}
+
+/* Frees the port items of a configuration read by config_reload(). */
+static void config_section_item_free(void *ptr)
+{
+	struct config_item *ci = ptr;
+
+	if (ci->flags & CFG_ITEM_STATIC)
+		return;
+	config_item_free(ci);
+}
+
+static int config_has_interface(struct config *cfg, const char *name)
+{
+	struct interface *iface;
+
+	STAILQ_FOREACH(iface, &cfg->interfaces, list) {
+		if (!strncmp(name, interface_name(iface), MAX_IFNAME_SIZE))
+			return 1;
+	}
+	return 0;
+}
+
+static struct unicast_master_table *config_find_mtab(struct config *cfg,
+						     int idx)
+{
+	struct unicast_master_table *table;
+
+	STAILQ_FOREACH(table, &cfg->unicast_master_tables, list) {
+		if (table->table_index == idx)
+			return table;
+	}
+	return NULL;
+}
+
+static int config_mtab_equal(struct unicast_master_table *a,
+			     struct unicast_master_table *b)
+{
+	struct unicast_master_address *x, *y;
+
+	if (!a || !b) {
+		return a == b;
+	}
+	if (a->logQueryInterval != b->logQueryInterval ||
+	    a->count != b->count) {
+		return 0;
+	}
+	if (a->peer_name || b->peer_name) {
+		if (!a->peer_name || !b->peer_name ||
+		    strcmp(a->peer_name, b->peer_name)) {
+			return 0;
+		}
+	}
+	y = STAILQ_FIRST(&b->addrs);
+	STAILQ_FOREACH(x, &a->addrs, list) {
+		if (!y || x->type != y->type ||
+		    x->address.len != y->address.len ||
+		    memcmp(&x->address.ss, &y->address.ss, x->address.len)) {
+			return 0;
+		}
+		y = STAILQ_NEXT(y, list);
+	}
+	return y == NULL;
+}
+
+int config_reload(struct config *cfg, const char *name,
+		  config_reload_t *check, void *ctx)
+{
+	struct config_item *ci, *dst, *fresh = NULL, *item, *save;
+	struct ucmtab_head tables;
+	struct interface *iface;
+	int changed = 0, err = -1, i, idx, keep, mtab;
+	struct config *new;
+	const char *port;
+
+	save = config_tab_save();
+	if (!save) {
+		return -1;
+	}
+	new = config_create();
+	if (!new) {
+		config_tab_free(save);
+		return -1;
+	}
+	config_tab_reset();
+	if (!config_read(name, new)) {
+		fresh = config_tab_save();
+	}
+	config_tab_restore(save);
+	if (!fresh) {
+		pr_err("failed to reload %s, keeping the old configuration",
+		       name);
+		goto out;
+	}
+
+	STAILQ_FOREACH(iface, &new->interfaces, list) {
+		if (!config_has_interface(cfg, interface_name(iface))) {
+			pr_warning("ignoring new port %s, a restart is needed",
+				   interface_name(iface));
+		}
+	}
+
+	for (i = 0; i < N_CONFIG_ITEMS; i++) {
+		ci = &config_tab[i];
+		if (!(ci->flags & CFG_ITEM_PORT)) {
+			if (config_item_equal(ci, &fresh[i]) ||
+			    check(ctx, NULL, ci->label)) {
+				continue;
+			}
+			if (config_item_copy(ci, &fresh[i])) {
+				goto out;
+			}
+			changed++;
+			continue;
+		}
+		/*
+		 * Port items are compared by their effective value in
+		 * each port, and a port section item holds the new value
+		 * when only some of the ports accept it.
+		 */
+		keep = 0;
+		STAILQ_FOREACH(iface, &cfg->interfaces, list) {
+			port = interface_name(iface);
+			item = config_section_item(new, port, ci->label);
+			if (!item) {
+				item = &fresh[i];
+			}
+			if (config_item_equal(config_find_item(cfg, port, ci->label),
+					      item)) {
+				continue;
+			}
+			if (check(ctx, port, ci->label)) {
+				keep = 1;
+				continue;
+			}
+			dst = config_section_item(cfg, port, ci->label);
+			if (!dst) {
+				dst = config_item_alloc(cfg, port, ci->label,
+							ci->type);
+			}
+			if (!dst || config_item_copy(dst, item)) {
+				goto out;
+			}
+			changed++;
+		}
+		if (!keep && !config_item_equal(ci, &fresh[i]) &&
+		    config_item_copy(ci, &fresh[i])) {
+			goto out;
+		}
+	}
+
+	/* The ports use copies of the tables, made when they open. */
+	keep = 0;
+	mtab = 0;
+	STAILQ_FOREACH(iface, &cfg->interfaces, list) {
+		port = interface_name(iface);
+		idx = config_get_int(cfg, port, "unicast_master_table");
+		if (!idx || config_mtab_equal(config_find_mtab(cfg, idx),
+					      config_find_mtab(new, idx))) {
+			continue;
+		}
+		mtab = 1;
+		if (check(ctx, port, NULL)) {
+			keep = 1;
+		}
+	}
+	if (mtab && !keep) {
+		STAILQ_INIT(&tables);
+		STAILQ_CONCAT(&tables, &cfg->unicast_master_tables);
+		STAILQ_CONCAT(&cfg->unicast_master_tables,
+			      &new->unicast_master_tables);
+		STAILQ_CONCAT(&new->unicast_master_tables, &tables);
+		changed++;
+	}
+	err = changed;
+out:
+	config_tab_free(fresh);
+	config_free(new, config_section_item_free);
+	return err;
+}
+
 double config_get_double(struct config *cfg, const char *section,
 			 const char *option)
 {
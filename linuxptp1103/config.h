@@ -79,6 +79,22 @@ static inline struct option *config_long_options(struct config *cfg)
 
 int config_parse_option(struct config *cfg, const char *opt, const char *val);
 
+/*
+ * Decides whether config_reload() applies a changed value. The section
+ * is the port whose value changed, or NULL for a global option, and the
+ * option is NULL when the unicast master table of the port changed.
+ * Returns zero to apply the new value, non-zero to keep the old one.
+ */
+typedef int config_reload_t(void *ctx, const char *section, const char *option);
+
+/*
+ * Reads the file again and applies the values that changed since, as far
+ * as check() allows. The command line values and the set of ports stay
+ * as they are. Returns the number of changes applied, or -1 on error.
+ */
+int config_reload(struct config *cfg, const char *name,
+		  config_reload_t *check, void *ctx);
+
 int config_set_double(struct config *cfg, const char *option, double val);
 
 int config_set_section_int(struct config *cfg, const char *section,
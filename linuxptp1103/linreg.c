@@ -316,6 +316,26 @@ static double linreg_rate_ratio(struct servo *servo)
 	return s->frequency_ratio;
 }
 
+static double linreg_drift(struct servo *servo)
+{
+	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
+
+	return -s->clock_freq;
+}
+
+static void linreg_warm_start(struct servo *servo, double drift,
+			      double rate_ratio)
+{
+	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
+
+	/*
+	 * The regression still needs its points, but the clock runs at the
+	 * saved frequency while they are being collected.
+	 */
+	s->clock_freq = -drift;
+	s->frequency_ratio = rate_ratio;
+}
+
 static void linreg_leap(struct servo *servo, int leap)
 {
 	struct linreg_servo *s = container_of(servo, struct linreg_servo, servo);
@@ -344,6 +364,8 @@ struct servo *linreg_servo_create(double fadj)
 	s->servo.reset = linreg_reset;
 	s->servo.rate_ratio = linreg_rate_ratio;
 	s->servo.leap = linreg_leap;
+	s->servo.drift = linreg_drift;
+	s->servo.warm_start = linreg_warm_start;
 
 	s->clock_freq = -fadj;
 	s->frequency_ratio = 1.0;
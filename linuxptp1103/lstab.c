@@ -6,6 +6,7 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/stat.h>
 
 #include "lstab.h"
@@ -39,6 +40,7 @@
 #define N_HISTORICAL_LEAPS	28
 #define N_LEAPS			(N_HISTORICAL_LEAPS + 200)
 #define NTP_UTC_OFFSET		2208988800ULL
+#define RELOAD_INTERVAL		1 /* seconds */
 
 struct epoch_marker {
 	int offset;	/* TAI - UTC offset of epoch */
@@ -52,7 +54,17 @@ struct lstab {
 	uint64_t expiration_utc;
 	const char *leapfile;
 	time_t lsfile_mtime;
+	time_t next_check;
 	int length;
+	/*
+	 * Remembers the UTC interval [cache_start, cache_end) in which
+	 * lookups return LSTAB_OK with the offset cache_offset, that is
+	 * the current epoch up to its ambiguous last second or up to the
+	 * expiration date. An empty interval means nothing is cached.
+	 */
+	uint64_t cache_start;
+	uint64_t cache_end;
+	int cache_offset;
 };
 
 static const uint64_t expiration_date_ntp = 3944332800ULL; /* 24 Dec 2024 */
@@ -211,6 +223,7 @@ int update_leapsecond_table(struct lstab *lstab)
 		return 0;
 	}
 	printf("updating leap seconds file\n");
+	lstab->cache_end = 0;
 
 	if (lstab_read(lstab, lstab->leapfile)) {
 		lstab->length = 0;
@@ -227,23 +240,71 @@ void lstab_destroy(struct lstab *lstab)
 	free(lstab);
 }
 
+/* Checks the leap seconds file for changes at most once per interval. */
+static int lstab_reload(struct lstab *lstab)
+{
+	struct timespec now;
+
+	if (!lstab->leapfile) {
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec < lstab->next_check) {
+		return 0;
+	}
+	if (update_leapsecond_table(lstab)) {
+		return -1;
+	}
+	lstab->next_check = now.tv_sec + RELOAD_INTERVAL;
+	return 0;
+}
+
+/* Returns the last epoch that started at or before the given time. */
+static int lstab_find(struct lstab *lstab, uint64_t utctime)
+{
+	int lo = 0, hi = lstab->length - 1, mid, epoch = -1;
+
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+		if (utctime >= lstab->lstab[mid].utc) {
+			epoch = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return epoch;
+}
+
+static void lstab_cache(struct lstab *lstab, int epoch)
+{
+	uint64_t end = lstab->expiration_utc + 1;
+	int next = epoch + 1;
+
+	if (next < lstab->length && lstab->lstab[next].utc - 1 < end) {
+		end = lstab->lstab[next].utc - 1;
+	}
+	lstab->cache_start = lstab->lstab[epoch].utc;
+	lstab->cache_end = end;
+	lstab->cache_offset = lstab->lstab[epoch].offset;
+}
+
 enum lstab_result lstab_utc2tai(struct lstab *lstab, uint64_t utctime,
 				int *tai_offset)
 {
-	int epoch = -1, index, next;
+	int epoch, next;
 
-	if (update_leapsecond_table(lstab)) {
+	if (lstab_reload(lstab)) {
 		fprintf(stderr, "Failed to update leap seconds table");
 		return LSTAB_UNKNOWN;
 	}
 
-	for (index = lstab->length - 1; index > -1; index--) {
-		if (utctime >= lstab->lstab[index].utc) {
-			epoch = index;
-			break;
-		}
+	if (utctime >= lstab->cache_start && utctime < lstab->cache_end) {
+		*tai_offset = lstab->cache_offset;
+		return LSTAB_OK;
 	}
 
+	epoch = lstab_find(lstab, utctime);
 	if (epoch == -1) {
 		return LSTAB_UNKNOWN;
 	}
@@ -259,5 +320,6 @@ enum lstab_result lstab_utc2tai(struct lstab *lstab, uint64_t utctime,
 		return LSTAB_EXPIRED;
 	}
 
+	lstab_cache(lstab, epoch);
 	return LSTAB_OK;
 }
@@ -314,6 +314,10 @@ struct ptp_pin_desc {
 #define SO_SELECT_ERR_QUEUE 45
 #endif
 
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
 #ifndef HAVE_CLOCK_ADJTIME
 static inline int clock_adjtime(clockid_t id, struct timex *tx)
 {
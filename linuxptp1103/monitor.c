@@ -3,27 +3,33 @@
  * @note Copyright (C) 2020 Richard Cochran <richardcochran@gmail.com>
  * @note SPDX-License-Identifier: GPL-2.0+
  */
+#include <errno.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include "address.h"
 #include "monitor.h"
 #include "print.h"
 
-#define RECORDS_PER_MESSAGE 1
+#define NS_PER_MS 1000000LL
 
-struct monitor_message {
-	struct ptp_message *msg;
+struct monitor_stream {
+	struct PortIdentity source_pid;
 	int records_per_msg;
 	int count;
+	int64_t oldest;
 };
 
 struct monitor {
 	struct port *dst_port;
-	struct slave_rx_sync_timing_data_tlv *sync_tlv;
-	struct slave_delay_timing_data_tlv *delay_tlv;
-	struct monitor_message delay;
-	struct monitor_message sync;
+	struct address address;
+	int64_t max_latency;
+	unsigned int dropped;
+	struct monitor_stream delay;
+	struct monitor_stream sync;
+	struct slave_delay_timing_record delay_record[SLAVE_DELAY_TIMING_MAX];
+	struct slave_rx_sync_timing_record sync_record[SLAVE_RX_SYNC_TIMING_MAX];
 };
 
 static bool monitor_active(struct monitor *monitor)
@@ -31,94 +37,193 @@ static bool monitor_active(struct monitor *monitor)
 	return monitor->dst_port ? true : false;
 }
 
-static int monitor_forward(struct port *port, struct ptp_message *msg)
+static int64_t monitor_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static int monitor_forward(struct monitor *monitor, struct ptp_message *msg)
 {
-	int err, pdulen = msg->header.messageLength;
+	int err;
 
 	if (msg_pre_send(msg)) {
 		return -1;
 	}
-	err = port_forward_to(port, msg);
-	if (err) {
+	err = port_forward_to(monitor->dst_port, msg);
+	switch (err) {
+	case 0:
+		if (monitor->dropped) {
+			pr_warning("slave event monitor: receiver busy, "
+				   "dropped %u messages", monitor->dropped);
+			monitor->dropped = 0;
+		}
+		break;
+	case -EAGAIN:
+		/* Never block the event loop on a slow receiver. */
+		monitor->dropped++;
+		break;
+	default:
 		pr_debug("failed to send signaling message to slave event monitor: %s",
 			 strerror(-err));
+		break;
 	}
-	if (msg_post_recv(msg, pdulen)) {
-		return -1;
-	}
-	msg->header.sequenceId++;
-
 	return 0;
 }
 
-static struct tlv_extra *monitor_init_message(struct monitor_message *mm,
-					      struct port *destination,
-					      uint16_t tlv_type,
-					      size_t tlv_size,
-					      struct address address)
+static bool monitor_fits(struct ptp_message *msg, size_t tlv_size)
 {
-	struct ptp_message *msg;
+	return msg->header.messageLength + tlv_size <= sizeof(struct message_data);
+}
+
+static int monitor_append_delay(struct monitor *monitor,
+				struct ptp_message *msg)
+{
+	struct slave_delay_timing_data_tlv *tlv;
+	size_t size = sizeof(struct slave_delay_timing_record) *
+		monitor->delay.count;
 	struct tlv_extra *extra;
 
-	msg = port_signaling_construct(destination, &wildcard_pid);
-	if (!msg) {
-		return NULL;
+	if (!monitor_fits(msg, sizeof(*tlv) + size)) {
+		return -1;
 	}
-	extra = msg_tlv_append(msg, tlv_size);
+	extra = msg_tlv_append(msg, sizeof(*tlv) + size);
 	if (!extra) {
-		msg_put(msg);
-		return NULL;
+		monitor->delay.count = 0;
+		return -1;
 	}
-	extra->tlv->type = tlv_type;
-	extra->tlv->length = tlv_size - sizeof(extra->tlv->type) -
-		sizeof(extra->tlv->length);
-
-	mm->msg = msg;
-	mm->msg->address = address;
-	mm->records_per_msg = RECORDS_PER_MESSAGE;
-	mm->count = 0;
-
-	return extra;
+	tlv = (struct slave_delay_timing_data_tlv *) extra->tlv;
+	tlv->type = TLV_SLAVE_DELAY_TIMING_DATA_NP;
+	tlv->length = sizeof(*tlv) + size - sizeof(tlv->type) -
+		sizeof(tlv->length);
+	tlv->sourcePortIdentity = monitor->delay.source_pid;
+	memcpy(tlv->record, monitor->delay_record, size);
+
+	monitor->delay.count = 0;
+	return 0;
 }
 
-static int monitor_init_delay(struct monitor *monitor, struct address address)
+static int monitor_append_sync(struct monitor *monitor,
+			       struct ptp_message *msg)
 {
-	const size_t tlv_size = sizeof(struct slave_delay_timing_data_tlv) +
-		sizeof(struct slave_delay_timing_record) * RECORDS_PER_MESSAGE;
+	struct slave_rx_sync_timing_data_tlv *tlv;
+	size_t size = sizeof(struct slave_rx_sync_timing_record) *
+		monitor->sync.count;
 	struct tlv_extra *extra;
 
-	extra = monitor_init_message(&monitor->delay, monitor->dst_port,
-				     TLV_SLAVE_DELAY_TIMING_DATA_NP, tlv_size,
-				     address);
+	if (!monitor_fits(msg, sizeof(*tlv) + size)) {
+		return -1;
+	}
+	extra = msg_tlv_append(msg, sizeof(*tlv) + size);
 	if (!extra) {
+		monitor->sync.count = 0;
 		return -1;
 	}
-	monitor->delay_tlv = (struct slave_delay_timing_data_tlv *) extra->tlv;
-
+	tlv = (struct slave_rx_sync_timing_data_tlv *) extra->tlv;
+	tlv->type = TLV_SLAVE_RX_SYNC_TIMING_DATA;
+	tlv->length = sizeof(*tlv) + size - sizeof(tlv->type) -
+		sizeof(tlv->length);
+	tlv->sourcePortIdentity = monitor->sync.source_pid;
+	memcpy(tlv->record, monitor->sync_record, size);
+
+	monitor->sync.count = 0;
 	return 0;
 }
 
-static int monitor_init_sync(struct monitor *monitor, struct address address)
+/*
+ * Sends out the pending records of both streams. The stream that
+ * triggered the flush goes first, and the records of the other stream
+ * are carried in a second TLV of the same signaling message whenever
+ * they fit.
+ */
+static int monitor_flush(struct monitor *monitor, bool sync_first)
 {
-	const size_t tlv_size = sizeof(struct slave_rx_sync_timing_data_tlv) +
-		sizeof(struct slave_rx_sync_timing_record) * RECORDS_PER_MESSAGE;
-	struct tlv_extra *extra;
+	struct ptp_message *msg;
+	int err;
 
-	extra = monitor_init_message(&monitor->sync, monitor->dst_port,
-				     TLV_SLAVE_RX_SYNC_TIMING_DATA, tlv_size,
-				     address);
-	if (!extra) {
+	msg = port_signaling_construct(monitor->dst_port, &wildcard_pid);
+	if (!msg) {
+		monitor->delay.count = 0;
+		monitor->sync.count = 0;
 		return -1;
 	}
-	monitor->sync_tlv = (struct slave_rx_sync_timing_data_tlv *) extra->tlv;
+	msg->address = monitor->address;
+
+	if (sync_first) {
+		err = monitor_append_sync(monitor, msg);
+		if (err) {
+			monitor->sync.count = 0;
+		} else if (monitor->delay.count) {
+			monitor_append_delay(monitor, msg);
+		}
+	} else {
+		err = monitor_append_delay(monitor, msg);
+		if (err) {
+			monitor->delay.count = 0;
+		} else if (monitor->sync.count) {
+			monitor_append_sync(monitor, msg);
+		}
+	}
+	if (!err) {
+		err = monitor_forward(monitor, msg);
+	}
+	msg_put(msg);
+	return err;
+}
 
-	return 0;
+static int64_t monitor_deadline(struct monitor *monitor,
+				struct monitor_stream *ms)
+{
+	return ms->count ? ms->oldest + monitor->max_latency : INT64_MAX;
+}
+
+static bool monitor_due(struct monitor *monitor, struct monitor_stream *ms,
+			int64_t now)
+{
+	if (ms->count >= ms->records_per_msg) {
+		return true;
+	}
+	if (monitor->max_latency && now - ms->oldest >= monitor->max_latency) {
+		return true;
+	}
+	return false;
+}
+
+/* Returns the index of the next free record slot in the stream. */
+static int monitor_stream_add(struct monitor_stream *ms,
+			      struct PortIdentity *source_pid, int64_t now)
+{
+	if (!pid_eq(&ms->source_pid, source_pid)) {
+		/* There was a change in remote master. Drop stale records. */
+		ms->source_pid = *source_pid;
+		ms->count = 0;
+	}
+	if (ms->count >= ms->records_per_msg) {
+		/* The last flush failed. Never run past the record array. */
+		ms->count = 0;
+	}
+	if (!ms->count) {
+		ms->oldest = now;
+	}
+	return ms->count++;
+}
+
+static int monitor_records(struct config *config, int max)
+{
+	int n = config_get_int(config, NULL, "slave_event_monitor_records");
+
+	if (n > max) {
+		pr_warning("slave_event_monitor_records limited to %d", max);
+		n = max;
+	}
+	return n;
 }
 
 struct monitor *monitor_create(struct config *config, struct port *dst)
 {
 	struct monitor *monitor;
-	struct address address;
 	struct sockaddr_un sa;
 	const char *path;
 
@@ -134,20 +239,16 @@ struct monitor *monitor_create(struct config *config, struct port *dst)
 	memset(&sa, 0, sizeof(sa));
 	sa.sun_family = AF_LOCAL;
 	snprintf(sa.sun_path, sizeof(sa.sun_path) - 1, "%s", path);
-	address.sun = sa;
-	address.len = sizeof(sa);
+	monitor->address.sun = sa;
+	monitor->address.len = sizeof(sa);
 
 	monitor->dst_port = dst;
-
-	if (monitor_init_delay(monitor, address)) {
-		free(monitor);
-		return NULL;
-	}
-	if (monitor_init_sync(monitor, address)) {
-		msg_put(monitor->delay.msg);
-		free(monitor);
-		return NULL;
-	}
+	monitor->max_latency = NS_PER_MS *
+		config_get_int(config, NULL, "slave_event_monitor_max_latency");
+	monitor->delay.records_per_msg =
+		monitor_records(config, SLAVE_DELAY_TIMING_MAX);
+	monitor->sync.records_per_msg =
+		monitor_records(config, SLAVE_RX_SYNC_TIMING_MAX);
 
 	return monitor;
 }
@@ -156,76 +257,94 @@ int monitor_delay(struct monitor *monitor, struct PortIdentity source_pid,
 		  uint16_t seqid, tmv_t t3, tmv_t corr, tmv_t t4)
 {
 	struct slave_delay_timing_record *record;
-	struct ptp_message *msg;
+	int64_t now;
 
 	if (!monitor_active(monitor)) {
 		return 0;
 	}
 
-	msg = monitor->delay.msg;
-
-	if (!pid_eq(&monitor->delay_tlv->sourcePortIdentity, &source_pid)) {
-		/* There was a change in remote master. Drop stale records. */
-		memcpy(&monitor->delay_tlv->sourcePortIdentity, &source_pid,
-		       sizeof(monitor->delay_tlv->sourcePortIdentity));
-		monitor->delay.count = 0;
-	}
-
-	record = monitor->delay_tlv->record + monitor->delay.count;
+	now = monitor_now();
+	record = monitor->delay_record +
+		monitor_stream_add(&monitor->delay, &source_pid, now);
 	record->sequenceId                  = seqid;
 	record->delayOriginTimestamp        = tmv_to_Timestamp(t3);
 	record->totalCorrectionField        = tmv_to_TimeInterval(corr);
 	record->delayResponseTimestamp      = tmv_to_Timestamp(t4);
 
-	monitor->delay.count++;
-	if (monitor->delay.count == monitor->delay.records_per_msg) {
-		monitor->delay.count = 0;
-		return monitor_forward(monitor->dst_port, msg);
+	if (monitor_due(monitor, &monitor->delay, now)) {
+		return monitor_flush(monitor, false);
 	}
 	return 0;
 }
 
 void monitor_destroy(struct monitor *monitor)
 {
-	if (monitor->delay.msg) {
-		msg_put(monitor->delay.msg);
-	}
-	if (monitor->sync.msg) {
-		msg_put(monitor->sync.msg);
+	if (monitor->dropped) {
+		pr_warning("slave event monitor: dropped %u messages",
+			   monitor->dropped);
 	}
 	free(monitor);
 }
 
-int monitor_sync(struct monitor *monitor, struct PortIdentity source_pid,
-		 uint16_t seqid, tmv_t t1, tmv_t corr, tmv_t t2)
+uint64_t monitor_flush_tmo(struct monitor *monitor)
 {
-	struct slave_rx_sync_timing_record *record;
-	struct ptp_message *msg;
+	int64_t deadline, now;
 
-	if (!monitor_active(monitor)) {
+	if (!monitor_active(monitor) || !monitor->max_latency) {
+		return 0;
+	}
+	deadline = monitor_deadline(monitor, &monitor->sync);
+	if (deadline > monitor_deadline(monitor, &monitor->delay)) {
+		deadline = monitor_deadline(monitor, &monitor->delay);
+	}
+	if (deadline == INT64_MAX) {
 		return 0;
 	}
+	now = monitor_now();
+	/* A zero timeout disarms the timer, so round up to one. */
+	return deadline > now ? deadline - now : 1;
+}
 
-	msg = monitor->sync.msg;
+int monitor_sync(struct monitor *monitor, struct PortIdentity source_pid,
+		 uint16_t seqid, tmv_t t1, tmv_t corr, tmv_t t2,
+		 double rate_ratio)
+{
+	struct slave_rx_sync_timing_record *record;
+	int64_t now;
 
-	if (!pid_eq(&monitor->sync_tlv->sourcePortIdentity, &source_pid)) {
-		/* There was a change in remote master. Drop stale records. */
-		memcpy(&monitor->sync_tlv->sourcePortIdentity, &source_pid,
-		       sizeof(monitor->sync_tlv->sourcePortIdentity));
-		monitor->sync.count = 0;
+	if (!monitor_active(monitor)) {
+		return 0;
 	}
 
-	record = monitor->sync_tlv->record + monitor->sync.count;
+	now = monitor_now();
+	record = monitor->sync_record +
+		monitor_stream_add(&monitor->sync, &source_pid, now);
 	record->sequenceId                 = seqid;
 	record->syncOriginTimestamp        = tmv_to_Timestamp(t1);
 	record->totalCorrectionField       = tmv_to_TimeInterval(corr);
-	record->scaledCumulativeRateOffset = 0;
+	record->scaledCumulativeRateOffset =
+		(Integer32) ((rate_ratio - 1.0) * POW2_41);
 	record->syncEventIngressTimestamp  = tmv_to_Timestamp(t2);
 
-	monitor->sync.count++;
-	if (monitor->sync.count == monitor->sync.records_per_msg) {
-		monitor->sync.count = 0;
-		return monitor_forward(monitor->dst_port, msg);
+	if (monitor_due(monitor, &monitor->sync, now)) {
+		return monitor_flush(monitor, true);
+	}
+	return 0;
+}
+
+int monitor_timeout(struct monitor *monitor)
+{
+	int64_t now;
+
+	if (!monitor_active(monitor) || !monitor->max_latency) {
+		return 0;
+	}
+	now = monitor_now();
+	if (monitor->sync.count && monitor_due(monitor, &monitor->sync, now)) {
+		return monitor_flush(monitor, true);
+	}
+	if (monitor->delay.count && monitor_due(monitor, &monitor->delay, now)) {
+		return monitor_flush(monitor, false);
 	}
 	return 0;
 }
@@ -19,7 +19,17 @@ int monitor_delay(struct monitor *monitor, struct PortIdentity source_pid,
 
 void monitor_destroy(struct monitor *monitor);
 
+/*
+ * Returns the time in nanoseconds until the oldest pending record must be
+ * sent, or zero when no record is pending or no latency limit is set.
+ */
+uint64_t monitor_flush_tmo(struct monitor *monitor);
+
 int monitor_sync(struct monitor *monitor, struct PortIdentity source_pid,
-		 uint16_t seqid, tmv_t t1, tmv_t corr, tmv_t t2);
+		 uint16_t seqid, tmv_t t1, tmv_t corr, tmv_t t2,
+		 double rate_ratio);
+
+/* Sends the pending records that have reached the latency limit. */
+int monitor_timeout(struct monitor *monitor);
 
 #endif
@@ -225,6 +225,60 @@ static int suffix_post_recv(struct ptp_message *msg, int len)
 	return suffix_len;
 }
 
+/*
+ * Checks the lengths of the appended TLVs without touching the message
+ * or the TLV descriptor pool.
+ */
+static int suffix_validate(struct ptp_message *msg, int len)
+{
+	uint8_t *ptr = msg_suffix(msg);
+	int suffix_len = 0;
+	struct TLV *tlv;
+	uint16_t length;
+
+	if (!ptr)
+		return 0;
+
+	while (len >= sizeof(struct TLV)) {
+		tlv = (struct TLV *) ptr;
+		length = ntohs(tlv->length);
+		if (length % 2) {
+			return -EBADMSG;
+		}
+		suffix_len += sizeof(struct TLV);
+		len -= sizeof(struct TLV);
+		ptr += sizeof(struct TLV);
+		if (length > len) {
+			return -EBADMSG;
+		}
+		suffix_len += length;
+		len -= length;
+		ptr += length;
+	}
+	return suffix_len;
+}
+
+/* Looks for a TLV type among the TLVs that are still in network order. */
+static int suffix_contains(struct ptp_message *msg, int type)
+{
+	uint8_t *ptr = msg_suffix(msg);
+	int len = msg->tlv_pending;
+	struct TLV *tlv;
+
+	if (!ptr)
+		return 0;
+
+	while (len >= sizeof(struct TLV)) {
+		tlv = (struct TLV *) ptr;
+		if (ntohs(tlv->type) == type) {
+			return 1;
+		}
+		len -= sizeof(struct TLV) + ntohs(tlv->length);
+		ptr += sizeof(struct TLV) + ntohs(tlv->length);
+	}
+	return 0;
+}
+
 static void suffix_pre_send(struct ptp_message *msg)
 {
 	struct tlv_extra *extra;
@@ -341,7 +395,7 @@ void msg_get(struct ptp_message *m)
 	m->refcnt++;
 }
 
-int msg_post_recv(struct ptp_message *m, int cnt)
+static int msg_post_recv_common(struct ptp_message *m, int cnt, int lazy)
 {
 	int err, pdulen, suffix_len, type;
 
@@ -428,17 +482,36 @@ int msg_post_recv(struct ptp_message *m, int cnt)
 		break;
 	}
 
-	suffix_len = suffix_post_recv(m, cnt - pdulen);
+	m->tlv_pending = 0;
+	if (lazy) {
+		msg_tlv_recycle(m);
+		suffix_len = suffix_validate(m, cnt - pdulen);
+	} else {
+		suffix_len = suffix_post_recv(m, cnt - pdulen);
+	}
 	if (suffix_len < 0) {
 		return suffix_len;
 	}
 	if (pdulen + suffix_len != m->header.messageLength) {
 		return -EBADMSG;
 	}
+	if (lazy) {
+		m->tlv_pending = suffix_len;
+	}
 
 	return 0;
 }
 
+int msg_post_recv(struct ptp_message *m, int cnt)
+{
+	return msg_post_recv_common(m, cnt, 0);
+}
+
+int msg_post_recv_lazy(struct ptp_message *m, int cnt)
+{
+	return msg_post_recv_common(m, cnt, 1);
+}
+
 int msg_pre_send(struct ptp_message *m)
 {
 	int type;
@@ -488,6 +561,17 @@ int msg_pre_send(struct ptp_message *m)
 	return 0;
 }
 
+void msg_pre_resend(struct ptp_message *m, UInteger16 seqid, tmv_t origin)
+{
+	m->header.sequenceId = htons(seqid);
+	if (msg_type(m) == FOLLOW_UP) {
+		m->follow_up.preciseOriginTimestamp = tmv_to_Timestamp(origin);
+		timestamp_pre_send(&m->follow_up.preciseOriginTimestamp);
+	}
+	m->hwts.ts = tmv_zero();
+	m->hwts.sw = tmv_zero();
+}
+
 struct tlv_extra *msg_tlv_append(struct ptp_message *msg, int length)
 {
 	struct tlv_extra *extra;
@@ -510,6 +594,10 @@ int msg_tlv_count(struct ptp_message *msg)
 	int count = 0;
 	struct tlv_extra *extra;
 
+	if (msg_tlv_parse(msg) < 0) {
+		return 0;
+	}
+
 	for (extra = TAILQ_FIRST(&msg->tlv_list);
 			extra != NULL;
 			extra = TAILQ_NEXT(extra, list))
@@ -518,6 +606,38 @@ int msg_tlv_count(struct ptp_message *msg)
 	return count;
 }
 
+struct tlv_extra *msg_tlv_find(struct ptp_message *msg, int type)
+{
+	struct tlv_extra *extra;
+
+	if (msg->tlv_pending) {
+		if (!suffix_contains(msg, type)) {
+			return NULL;
+		}
+		if (msg_tlv_parse(msg) < 0) {
+			return NULL;
+		}
+	}
+	TAILQ_FOREACH(extra, &msg->tlv_list, list) {
+		if (extra->tlv->type == type) {
+			return extra;
+		}
+	}
+	return NULL;
+}
+
+int msg_tlv_parse(struct ptp_message *msg)
+{
+	int len = msg->tlv_pending, suffix_len;
+
+	if (!len) {
+		return 0;
+	}
+	msg->tlv_pending = 0;
+	suffix_len = suffix_post_recv(msg, len);
+	return suffix_len < 0 ? suffix_len : 0;
+}
+
 int msg_tlv_copy(struct ptp_message *msg, struct ptp_message *dup) {
 	struct tlv_extra *extra, *dup_extra;
 	struct TLV *tlv;
@@ -238,6 +238,11 @@ struct ptp_message {
 	 * pointers to the appended TLVs.
 	 */
 	TAILQ_HEAD(tlv_list, tlv_extra) tlv_list;
+	/**
+	 * Length of the received suffix whose TLVs have been validated
+	 * but not yet decoded into the list of TLV descriptors.
+	 */
+	int tlv_pending;
 };
 
 /**
@@ -329,6 +334,39 @@ int msg_tlv_copy(struct ptp_message *msg, struct ptp_message *dup);
  */
 int msg_tlv_count(struct ptp_message *msg);
 
+/**
+ * Find the first TLV of a given type appended to a message.
+ *
+ * If the TLVs of a message were deferred by @ref msg_post_recv_lazy(),
+ * they are decoded once the type is known to be present. A message
+ * without such a TLV is left untouched.
+ *
+ * @param msg   A message obtained using @ref msg_allocate().
+ * @param type  The TLV type to look for.
+ * @return      A pointer to the TLV descriptor, or NULL if the message
+ *              has no such TLV or it could not be decoded.
+ */
+struct tlv_extra *msg_tlv_find(struct ptp_message *msg, int type);
+
+/**
+ * Decode all TLVs deferred by @ref msg_post_recv_lazy().
+ *
+ * @param msg  A message obtained using @ref msg_allocate().
+ * @return     Zero on success, or a negative error code if the TLVs
+ *             are invalid.
+ */
+int msg_tlv_parse(struct ptp_message *msg);
+
+/**
+ * Test whether a message has TLVs that still await decoding.
+ * @param m  Message to test.
+ * @return   One if TLVs are pending, zero otherwise.
+ */
+static inline int msg_tlv_pending(struct ptp_message *m)
+{
+	return m->tlv_pending ? 1 : 0;
+}
+
 /**
  * Obtain the transportSpecific field from a message.
  * @param m  Message to test.
@@ -401,6 +439,19 @@ void msg_get(struct ptp_message *m);
  */
 int msg_post_recv(struct ptp_message *m, int cnt);
 
+/**
+ * Process messages after reception, deferring the TLVs.
+ *
+ * Like @ref msg_post_recv(), but the appended TLVs are only checked
+ * for consistent lengths. They remain in network byte order and are
+ * decoded on demand by @ref msg_tlv_find() or @ref msg_tlv_parse().
+ *
+ * @param m    A message obtained using @ref msg_allocate().
+ * @param cnt  The size of 'm' in bytes.
+ * @return   Zero on success, non-zero if the message is invalid.
+ */
+int msg_post_recv_lazy(struct ptp_message *m, int cnt);
+
 /**
  * Prepare messages for transmission.
  * @param m  A message obtained using @ref msg_allocate().
@@ -408,6 +459,16 @@ int msg_post_recv(struct ptp_message *m, int cnt);
  */
 int msg_pre_send(struct ptp_message *m);
 
+/**
+ * Prepare a message which has already been sent for another transmission.
+ * The message stays in network byte order, and only the sequenceId and,
+ * for a follow up message, the preciseOriginTimestamp are changed.
+ * @param m       A message previously passed to @ref msg_pre_send().
+ * @param seqid   The new sequenceId in host byte order.
+ * @param origin  The new preciseOriginTimestamp of a follow up message.
+ */
+void msg_pre_resend(struct ptp_message *m, UInteger16 seqid, tmv_t origin);
+
 /**
  * Print messages for debugging purposes.
  * @param type  Value of the messageType field as returned by @ref msg_type().
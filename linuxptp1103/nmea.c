@@ -14,190 +14,290 @@
 #define NMEA_CHAR_MIN	' '
 #define NMEA_CHAR_MAX	'~'
 #define NMEA_MAX_LENGTH	256
+#define NMEA_MAX_FIELDS	24
+#define SEC_PER_DAY	86400
 
-enum nmea_state {
-	NMEA_IDLE,
-	NMEA_HAVE_DOLLAR,
-	NMEA_HAVE_STARTG,
-	NMEA_HAVE_STARTX,
-	NMEA_HAVE_BODY,
-	NMEA_HAVE_CSUMA,
-	NMEA_HAVE_CSUM_MSB,
-	NMEA_HAVE_CSUM_LSB,
-	NMEA_HAVE_PENULTIMATE,
+enum nmea_fix {
+	NMEA_FIX_UNKNOWN,
+	NMEA_FIX_INVALID,
+	NMEA_FIX_VALID,
 };
 
 struct nmea_parser {
 	char sentence[NMEA_MAX_LENGTH + 1];
-	char payload_checksum[3];
-	enum nmea_state state;
-	uint8_t checksum;
 	int offset;
+	/* Fix status from the last RMC or GGA sentence. */
+	enum nmea_fix fix;
+	/* Midnight UTC and time of day of the last dated sentence. */
+	time_t date;
+	int tod;
+	bool have_date;
 };
 
-static void nmea_reset(struct nmea_parser *np);
+static void nmea_reset(struct nmea_parser *np)
+{
+	np->offset = 0;
+}
 
-static void nmea_accumulate(struct nmea_parser *np, char c)
+static int nmea_hex(char c)
 {
-	if (c < NMEA_CHAR_MIN || c > NMEA_CHAR_MAX) {
-		nmea_reset(np);
-		return;
-	}
-	if (np->offset == NMEA_MAX_LENGTH) {
-		nmea_reset(np);
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+/* Parses exactly 'len' decimal digits. */
+static int nmea_digits(const char *s, int len)
+{
+	int i, val = 0;
+
+	for (i = 0; i < len; i++) {
+		if (s[i] < '0' || s[i] > '9')
+			return -1;
+		val = val * 10 + s[i] - '0';
 	}
-	np->sentence[np->offset++] = c;
-	np->checksum ^= c;
+	return val;
 }
 
-static int nmea_parse_symbol(struct nmea_parser *np, char c)
+/* Parses a time of day in the form hhmmss[.fraction]. */
+static int nmea_time(const char *s, int *tod, long *nsec)
 {
-	switch (np->state) {
-	case NMEA_IDLE:
-		if (c == '$') {
-			np->state = NMEA_HAVE_DOLLAR;
-		}
-		break;
-	case NMEA_HAVE_DOLLAR:
-		if (c == 'G') {
-			np->state = NMEA_HAVE_STARTG;
-			nmea_accumulate(np, c);
-		} else {
-			nmea_reset(np);
-		}
-		break;
-	case NMEA_HAVE_STARTG:
-		np->state = NMEA_HAVE_STARTX;
-		nmea_accumulate(np, c);
-		break;
-	case NMEA_HAVE_STARTX:
-		np->state = NMEA_HAVE_BODY;
-		nmea_accumulate(np, c);
-		break;
-	case NMEA_HAVE_BODY:
-		if (c == '*') {
-			np->state = NMEA_HAVE_CSUMA;
-		} else {
-			nmea_accumulate(np, c);
-		}
-		break;
-	case NMEA_HAVE_CSUMA:
-		np->state = NMEA_HAVE_CSUM_MSB;
-		np->payload_checksum[0] = c;
-		break;
-	case NMEA_HAVE_CSUM_MSB:
-		np->state = NMEA_HAVE_CSUM_LSB;
-		np->payload_checksum[1] = c;
-		break;
-	case NMEA_HAVE_CSUM_LSB:
-		if (c == '\n') {
-			/*skip the CR*/
-			return 0;
-		}
-		if (c == '\r') {
-			np->state = NMEA_HAVE_PENULTIMATE;
-		} else {
-			nmea_reset(np);
-		}
-		break;
-	case NMEA_HAVE_PENULTIMATE:
-		if (c == '\n') {
-			return 0;
-		}
-		nmea_reset(np);
-		break;
+	int hh, mm, ss;
+	long scale;
+
+	if (strnlen(s, 6) != 6)
+		return -1;
+	hh = nmea_digits(s, 2);
+	mm = nmea_digits(s + 2, 2);
+	ss = nmea_digits(s + 4, 2);
+	if (hh < 0 || hh > 23 || mm < 0 || mm > 59 || ss < 0 || ss > 60)
+		return -1;
+	/* Convert an inserted leap second to ambiguous 23:59:59 */
+	if (ss == 60)
+		ss = 59;
+	*tod = hh * 3600 + mm * 60 + ss;
+
+	*nsec = 0;
+	s += 6;
+	if (*s != '.')
+		return *s ? -1 : 0;
+	for (s++, scale = 100000000; *s; s++, scale /= 10) {
+		if (*s < '0' || *s > '9')
+			return -1;
+		*nsec += (*s - '0') * scale;
 	}
-	return -1;
+	return 0;
 }
 
-static void nmea_reset(struct nmea_parser *np)
+/* Returns midnight UTC of a date in the proleptic Gregorian calendar. */
+static time_t nmea_date(int year, int mon, int mday)
+{
+	int era, yoe, doy, doe;
+
+	year -= mon <= 2;
+	era = year / 400;
+	yoe = year - era * 400;
+	doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + mday - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return ((time_t) era * 146097 + doe - 719468) * SEC_PER_DAY;
+}
+
+static void nmea_set_date(struct nmea_parser *np, time_t date, int tod)
 {
-	memset(np, 0, sizeof(*np));
+	np->date = date;
+	np->tod = tod;
+	np->have_date = true;
 }
 
-static int nmea_scan_rmc(struct nmea_parser *np, struct nmea_rmc *result)
+static void nmea_result(struct nmea_parser *np, int tod, long nsec,
+			bool fix_valid, struct nmea_rmc *result)
 {
-	int cnt, i, msec = 0;
-	char *ptr, status;
-	uint8_t checksum;
-	struct tm tm = {0};
+	result->ts.tv_sec = np->date + tod;
+	result->ts.tv_nsec = nsec;
+	result->fix_valid = fix_valid;
+}
 
-	pr_debug("nmea sentence: %s", np->sentence);
-	cnt = sscanf(np->payload_checksum, "%02hhx", &checksum);
-	if (cnt != 1) {
+static int nmea_scan_rmc(struct nmea_parser *np, char **field, int n,
+			 struct nmea_rmc *result)
+{
+	int tod, mday, mon, year;
+	long nsec;
+
+	if (n < 10 || nmea_time(field[1], &tod, &nsec))
 		return -1;
-	}
-	if (checksum != np->checksum) {
-		pr_err("checksum mismatch 0x%02hhx != 0x%02hhx on %s",
-		       checksum, np->checksum, np->sentence);
+	if (strlen(field[9]) != 6)
 		return -1;
+	mday = nmea_digits(field[9], 2);
+	mon = nmea_digits(field[9] + 2, 2);
+	year = nmea_digits(field[9] + 4, 2);
+	if (mday < 1 || mon < 1 || mon > 12 || year < 0)
+		return -1;
+
+	np->fix = field[2][0] == 'A' ? NMEA_FIX_VALID : NMEA_FIX_INVALID;
+	nmea_set_date(np, nmea_date(2000 + year, mon, mday), tod);
+	nmea_result(np, tod, nsec, np->fix == NMEA_FIX_VALID, result);
+	return 0;
+}
+
+static int nmea_scan_zda(struct nmea_parser *np, char **field, int n,
+			 struct nmea_rmc *result)
+{
+	int tod, mday, mon, year;
+	long nsec;
+
+	if (n < 5 || nmea_time(field[1], &tod, &nsec))
+		return -1;
+	if (strlen(field[2]) != 2 || strlen(field[3]) != 2 ||
+	    strlen(field[4]) != 4)
+		return -1;
+	mday = nmea_digits(field[2], 2);
+	mon = nmea_digits(field[3], 2);
+	year = nmea_digits(field[4], 4);
+	if (mday < 1 || mon < 1 || mon > 12 || year < 0)
+		return -1;
+
+	nmea_set_date(np, nmea_date(year, mon, mday), tod);
+	/*
+	 * ZDA carries no fix status, so it is only trusted after an RMC or
+	 * GGA sentence reported a valid fix.
+	 */
+	nmea_result(np, tod, nsec, np->fix == NMEA_FIX_VALID, result);
+	return 0;
+}
+
+static int nmea_scan_gga(struct nmea_parser *np, char **field, int n,
+			 struct nmea_rmc *result)
+{
+	int tod, quality;
+	long nsec;
+
+	if (n < 7 || nmea_time(field[1], &tod, &nsec))
+		return -1;
+	quality = nmea_digits(field[6], 1);
+	if (quality < 0)
+		return -1;
+	np->fix = quality ? NMEA_FIX_VALID : NMEA_FIX_INVALID;
+
+	/* GGA has no date, so it needs an earlier RMC or ZDA sentence. */
+	if (!np->have_date)
+		return -1;
+	if (tod + SEC_PER_DAY / 2 < np->tod) {
+		/* Midnight passed since the last dated sentence. */
+		np->date += SEC_PER_DAY;
 	}
-	cnt = sscanf(np->sentence,
-		     "G%*cRMC,%2d%2d%2d.%d,%c",
-		     &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &msec, &status);
-	if (cnt != 5) {
-		cnt = sscanf(np->sentence,
-			     "G%*cRMC,%2d%2d%2d,%c",
-			     &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &status);
-		if (cnt != 4) {
-			return -1;
-		}
-	}
-	ptr = np->sentence;
-	for (i = 0; i < 9; i++) {
-		ptr = strchr(ptr, ',');
-		if (!ptr) {
+	np->tod = tod;
+	nmea_result(np, tod, nsec, np->fix == NMEA_FIX_VALID, result);
+	return 0;
+}
+
+/*
+ * Checks a complete sentence, from the last '$' up to the line end, and
+ * splits it into fields in place.
+ */
+static int nmea_scan(struct nmea_parser *np, struct nmea_rmc *result)
+{
+	char *field[NMEA_MAX_FIELDS], *ptr, *star, *type;
+	uint8_t checksum = 0;
+	int hi, lo, n = 0;
+
+	if (np->offset && np->sentence[np->offset - 1] == '\r')
+		np->offset--;
+	np->sentence[np->offset] = '\0';
+
+	/* Too short for the '$' and the checksum. */
+	if (np->offset < 4)
+		return -1;
+	ptr = strrchr(np->sentence, '$') + 1;
+	star = np->sentence + np->offset - 3;
+	if (star < ptr || *star != '*')
+		return -1;
+	for (; ptr < star; ptr++) {
+		if (*ptr < NMEA_CHAR_MIN || *ptr > NMEA_CHAR_MAX)
 			return -1;
-		}
-		ptr++;
+		checksum ^= *ptr;
 	}
-	cnt = sscanf(ptr, "%2d%2d%2d", &tm.tm_mday, &tm.tm_mon, &tm.tm_year);
-	if (cnt != 3) {
+	hi = nmea_hex(star[1]);
+	lo = nmea_hex(star[2]);
+	if (hi < 0 || lo < 0)
+		return -1;
+	ptr = strrchr(np->sentence, '$') + 1;
+	pr_debug("nmea sentence: %s", ptr);
+	if (checksum != (hi << 4 | lo)) {
+		pr_err("checksum mismatch 0x%02x != 0x%02hhx on %s",
+		       hi << 4 | lo, checksum, ptr);
 		return -1;
 	}
-	/* Convert an inserted leap second to ambiguous 23:59:59 */
-	if (tm.tm_sec == 60)
-		tm.tm_sec = 59;
-	tm.tm_year += 100;
-	tm.tm_mon--;
-	tm.tm_isdst = 0;
-	result->ts.tv_sec = mktime(&tm);
-	result->ts.tv_nsec = msec * 1000000UL;
-	result->fix_valid = status == 'A' ? true : false;
-	return 0;
+	*star = '\0';
+
+	field[n++] = ptr;
+	while (n < NMEA_MAX_FIELDS && (ptr = strchr(ptr, ','))) {
+		*ptr++ = '\0';
+		field[n++] = ptr;
+	}
+
+	/* Accept any talker of a satellite system, like GP, GN or GL. */
+	if (field[0][0] != 'G' || strlen(field[0]) != 5)
+		return -1;
+	type = field[0] + 2;
+	if (!strcmp(type, "RMC"))
+		return nmea_scan_rmc(np, field, n, result);
+	if (!strcmp(type, "ZDA"))
+		return nmea_scan_zda(np, field, n, result);
+	if (!strcmp(type, "GGA"))
+		return nmea_scan_gga(np, field, n, result);
+	return -1;
 }
 
-int nmea_parse(struct nmea_parser *np, const char *ptr, int buflen,
+int nmea_parse(struct nmea_parser *np, const char *buf, int buflen,
 	       struct nmea_rmc *result, int *parsed)
 {
-	int count = 0;
-	while (buflen) {
-		if (!nmea_parse_symbol(np, *ptr)) {
-			if (!nmea_scan_rmc(np, result)) {
-				nmea_reset(np);
-				*parsed = count + 1;
-				return 0;
-			}
+	const char *end = buf + buflen, *nl, *ptr = buf;
+	int err, len;
+
+	while (ptr < end) {
+		if (!np->offset) {
+			ptr = memchr(ptr, '$', end - ptr);
+			if (!ptr)
+				break;
+		}
+		nl = memchr(ptr, '\n', end - ptr);
+		len = (nl ? nl : end) - ptr;
+		if (np->offset + len > NMEA_MAX_LENGTH) {
 			nmea_reset(np);
+			if (!nl)
+				break;
+			ptr = nl + 1;
+			continue;
+		}
+		memcpy(np->sentence + np->offset, ptr, len);
+		np->offset += len;
+		if (!nl)
+			break;
+		ptr = nl + 1;
+
+		err = nmea_scan(np, result);
+		nmea_reset(np);
+		if (!err) {
+			*parsed = ptr - buf;
+			return 0;
 		}
-		buflen--;
-		count++;
-		ptr++;
 	}
-	*parsed = count;
+	*parsed = buflen;
 	return -1;
 }
 
 struct nmea_parser *nmea_parser_create(void)
 {
 	struct nmea_parser *np;
-	np = malloc(sizeof(*np));
+	np = calloc(1, sizeof(*np));
 	if (!np) {
 		return NULL;
 	}
-	nmea_reset(np);
-	/* Ensure that mktime(3) returns a value in the UTC time scale. */
-	setenv("TZ", "UTC", 1);
 	return np;
 }
 
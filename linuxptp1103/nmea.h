@@ -18,7 +18,10 @@ struct nmea_rmc {
 };
 
 /**
- * Parses NMEA RMC sentences out of a given buffer.
+ * Parses NMEA RMC, ZDA and GGA sentences out of a given buffer. A GGA
+ * sentence yields a result only once an RMC or ZDA sentence provided the
+ * date. A ZDA sentence carries no fix status, so its result has a valid
+ * fix only after an RMC or GGA sentence reported one.
  * @param np		Pointer obtained via nmea_parser_create().
  * @param buf		Pointer to the data to be parsed.
  * @param buflen	Length of 'buf' in bytes.
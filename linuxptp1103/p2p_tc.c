@@ -54,12 +54,12 @@ void p2p_dispatch(struct port *p, enum fsm_event event, int mdiff)
 		return;
 	}
 
-	port_clr_tmo(p->fda.fd[FD_ANNOUNCE_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_RX_TIMER]);
+	port_clr_tmo(p, FD_ANNOUNCE_TIMER);
+	port_clr_tmo(p, FD_SYNC_RX_TIMER);
 	/* Leave FD_DELAY_TIMER running. */
-	port_clr_tmo(p->fda.fd[FD_QUALIFICATION_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_MANNO_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_TX_TIMER]);
+	port_clr_tmo(p, FD_QUALIFICATION_TIMER);
+	port_clr_tmo(p, FD_MANNO_TIMER);
+	port_clr_tmo(p, FD_SYNC_TX_TIMER);
 
 	/*
 	 * Handle the side effects of the state transition.
@@ -126,12 +126,15 @@ enum fsm_event p2p_event(struct port *p, int fd_index)
 	case FD_SYNC_TX_TIMER:
 	case FD_UNICAST_REQ_TIMER:
 	case FD_UNICAST_SRV_TIMER:
+	case FD_MONITOR_TIMER:
 		pr_err("unexpected timer expiration");
 		return EV_NONE;
 
 	case FD_RTNL:
 		pr_debug("%s: received link status notification", p->log_name);
-		rtnl_link_status(fd, p->name, port_link_status, p);
+		if (rtnl_monitor_process(p->rtnl) <= 0) {
+			return EV_NONE;
+		}
 		if (p->link_status == (LINK_UP|LINK_STATE_CHANGED)) {
 			return EV_FAULT_CLEARED;
 		} else if ((p->link_status == (LINK_DOWN|LINK_STATE_CHANGED)) ||
@@ -31,6 +31,7 @@
 #include <sys/ioctl.h>
 #include <sys/queue.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -90,6 +91,20 @@ struct clock {
 	struct stats *freq_stats;
 	struct stats *delay_stats;
 	struct clockcheck *sanity_check;
+	int64_t sysoff_baseline;
+	unsigned int sysoff_readings;
+	unsigned int sysoff_rejected;
+};
+
+/* Schedules the clock updates at absolute times of CLOCK_MONOTONIC. */
+struct sample_sched {
+	int fd;
+	uint64_t interval;
+	int phase;
+	int64_t lead;
+	uint64_t target;
+	struct stats *jitter;
+	unsigned int max_count;
 };
 
 struct port {
@@ -105,6 +120,10 @@ struct domain {
 	enum servo_type servo_type;
 	int phc_readings;
 	double phc_interval;
+	int sample_phase;
+	int sample_burst;
+	int sample_burst_gap;
+	int sysoff_robust;
 	int forced_sync_offset;
 	int kernel_leap;
 	int state_changed;
@@ -152,6 +171,12 @@ static struct servo *servo_add(struct domain *domain,
 		pr_err("Failed to create servo");
 		return NULL;
 	}
+	if (servo_state_attach(servo, phc2sys_config,
+			       clock->device ? clock->device : "CLOCK_REALTIME")) {
+		pr_err("Failed to attach servo state file");
+		servo_destroy(servo);
+		return NULL;
+	}
 
 	servo_sync_interval(servo, domain->phc_interval);
 
@@ -552,29 +577,41 @@ static void update_clock_stats(struct clock *clock, unsigned int max_count,
 
 	if (!stats_get_result(clock->delay_stats, &delay_stats)) {
 		pr_info("%s "
-			"rms %4.0f max %4.0f "
+			"rms %4.0f max %4.0f p99 %4.0f p99.9 %4.0f "
 			"freq %+6.0f +/- %3.0f "
-			"delay %5.0f +/- %3.0f",
+			"delay %5.0f +/- %3.0f p99 %5.0f p99.9 %5.0f",
 			clock->device,
 			offset_stats.rms, offset_stats.max_abs,
+			offset_stats.p99, offset_stats.p999,
 			freq_stats.mean, freq_stats.stddev,
-			delay_stats.mean, delay_stats.stddev);
+			delay_stats.mean, delay_stats.stddev,
+			delay_stats.p99, delay_stats.p999);
 	} else {
 		pr_info("%s "
-			"rms %4.0f max %4.0f "
+			"rms %4.0f max %4.0f p99 %4.0f p99.9 %4.0f "
 			"freq %+6.0f +/- %3.0f",
 			clock->device,
 			offset_stats.rms, offset_stats.max_abs,
+			offset_stats.p99, offset_stats.p999,
 			freq_stats.mean, freq_stats.stddev);
 	}
 
+	if (clock->sysoff_readings) {
+		pr_info("%s sysoff rejected %u of %u readings",
+			clock->device, clock->sysoff_rejected,
+			clock->sysoff_readings);
+		clock->sysoff_readings = 0;
+		clock->sysoff_rejected = 0;
+	}
+
 	stats_reset(clock->offset_stats);
 	stats_reset(clock->freq_stats);
 	stats_reset(clock->delay_stats);
 }
 
 static void update_clock(struct domain *domain, struct clock *clock,
-			 int64_t offset, uint64_t ts, int64_t delay)
+			 int64_t offset, uint64_t ts, int64_t delay,
+			 double weight)
 {
 	enum servo_state state = SERVO_UNLOCKED;
 	double ppb = 0.0;
@@ -596,7 +633,7 @@ static void update_clock(struct domain *domain, struct clock *clock,
 	if (clock->sanity_check && clockcheck_sample(clock->sanity_check, ts))
 		servo_reset(clock->servo);
 
-	ppb = servo_sample(clock->servo, offset, ts, 1.0, &state);
+	ppb = servo_sample(clock->servo, offset, ts, weight, &state);
 	clock->servo_state = state;
 
 	switch (state) {
@@ -678,6 +715,17 @@ static int read_pps(int fd, int64_t *offset, uint64_t *ts)
 	return 1;
 }
 
+/* Writes the servo state files outside of the sample path. */
+static void flush_servo_state(struct domain *domain)
+{
+	struct clock *c;
+
+	LIST_FOREACH(c, &domain->clocks, list) {
+		if (c->servo)
+			servo_state_flush(c->servo);
+	}
+}
+
 static int do_pps_loop(struct domain *domain, struct clock *clock,
 		       int fd)
 {
@@ -728,7 +776,8 @@ static int do_pps_loop(struct domain *domain, struct clock *clock,
 
 		if (pmc_agent_update(domain->agent) < 0)
 			continue;
-		update_clock(domain, clock, pps_offset, pps_ts, -1);
+		update_clock(domain, clock, pps_offset, pps_ts, -1, 1.0);
+		flush_servo_state(domain);
 	}
 	close(fd);
 	return 0;
@@ -754,10 +803,117 @@ static int update_needed(struct clock *c)
 	return 0;
 }
 
+static int measure_sysoff(struct domain *domain, struct clock *clock,
+			 struct clock *phc, int64_t *offset, uint64_t *ts,
+			 int64_t *delay, double *weight)
+{
+	struct sysoff_sample sample;
+	int err;
+
+	if (!domain->sysoff_robust) {
+		return sysoff_measure(CLOCKID_TO_FD(phc->clkid),
+				      phc->sysoff_method, domain->phc_readings,
+				      offset, ts, delay);
+	}
+	err = sysoff_measure_robust(CLOCKID_TO_FD(phc->clkid),
+				    phc->sysoff_method, domain->sysoff_robust,
+				    &clock->sysoff_baseline, &sample);
+	if (err)
+		return err;
+
+	if (clock->offset_stats && phc->sysoff_method != SYSOFF_PRECISE) {
+		clock->sysoff_readings += domain->sysoff_robust;
+		clock->sysoff_rejected += sample.rejected;
+	}
+	*offset = sample.offset;
+	*ts = sample.ts;
+	*delay = sample.delay;
+	*weight = sample.weight;
+	return 0;
+}
+
+static int measure_clock(struct domain *domain, struct clock *clock,
+			 int64_t *offset, uint64_t *ts, int64_t *delay,
+			 double *weight)
+{
+	int err;
+
+	*weight = 1.0;
+
+	if (clock->clkid == CLOCK_REALTIME &&
+	    domain->src_clock->sysoff_method >= 0) {
+		/* use sysoff */
+		err = measure_sysoff(domain, clock, domain->src_clock,
+				     offset, ts, delay, weight);
+	} else if (domain->src_clock->clkid == CLOCK_REALTIME &&
+		   clock->sysoff_method >= 0) {
+		/* use reversed sysoff */
+		err = measure_sysoff(domain, clock, clock,
+				     offset, ts, delay, weight);
+		if (!err) {
+			*offset = -*offset;
+			*ts += *offset;
+		}
+	} else {
+		/* use phc */
+		err = clockadj_compare(domain->src_clock->clkid,
+				       clock->clkid,
+				       domain->phc_readings,
+				       offset, ts, delay);
+	}
+	return err;
+}
+
+/*
+ * Takes a burst of measurements spaced by sample_burst_gap and keeps the
+ * one with the shortest delay.
+ */
+static int measure_clock_burst(struct domain *domain, struct clock *clock,
+			       int64_t *offset, uint64_t *ts, int64_t *delay,
+			       double *weight)
+{
+	int64_t burst_offset, burst_delay;
+	struct timespec start, slot;
+	uint64_t burst_ts, ns;
+	double burst_weight;
+	int i, err, valid = 0;
+
+	if (domain->sample_burst < 2) {
+		return measure_clock(domain, clock, offset, ts, delay, weight);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < domain->sample_burst; i++) {
+		if (i) {
+			ns = start.tv_nsec +
+				(uint64_t) i * domain->sample_burst_gap;
+			slot.tv_sec = start.tv_sec + ns / NS_PER_SEC;
+			slot.tv_nsec = ns % NS_PER_SEC;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&slot, NULL);
+		}
+		err = measure_clock(domain, clock, &burst_offset, &burst_ts,
+				    &burst_delay, &burst_weight);
+		if (err == -EBUSY)
+			continue;
+		if (err)
+			return err;
+		if (!valid || (burst_delay >= 0 && burst_delay < *delay)) {
+			*offset = burst_offset;
+			*ts = burst_ts;
+			*delay = burst_delay;
+			*weight = burst_weight;
+			valid = 1;
+		}
+	}
+	return valid ? 0 : -EBUSY;
+}
+
 static int update_domain_clocks(struct domain *domain)
 {
 	int64_t offset, delay;
 	struct clock *clock;
+	double weight;
 	uint64_t ts;
 	int err;
 
@@ -772,53 +928,209 @@ static int update_domain_clocks(struct domain *domain)
 		    !strcmp(clock->device, domain->src_clock->device))
 			continue;
 
-		if (clock->clkid == CLOCK_REALTIME &&
-		    domain->src_clock->sysoff_method >= 0) {
-			/* use sysoff */
-			err = sysoff_measure(CLOCKID_TO_FD(domain->src_clock->clkid),
-					     domain->src_clock->sysoff_method,
-					     domain->phc_readings,
-					     &offset, &ts, &delay);
-		} else if (domain->src_clock->clkid == CLOCK_REALTIME &&
-			   clock->sysoff_method >= 0) {
-			/* use reversed sysoff */
-			err = sysoff_measure(CLOCKID_TO_FD(clock->clkid),
-					     clock->sysoff_method,
-					     domain->phc_readings,
-					     &offset, &ts, &delay);
-			if (!err) {
-				offset = -offset;
-				ts += offset;
-			}
-		} else {
-			/* use phc */
-			err = clockadj_compare(domain->src_clock->clkid,
-					       clock->clkid,
-					       domain->phc_readings,
-					       &offset, &ts, &delay);
-		}
+		err = measure_clock_burst(domain, clock, &offset, &ts, &delay,
+					  &weight);
 		if (err == -EBUSY)
 			continue;
 		if (err)
 			return -1;
-		update_clock(domain, clock, offset, ts, delay);
+		update_clock(domain, clock, offset, ts, delay, weight);
 	}
 
 	return 0;
 }
 
+static uint64_t monotonic_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static clockid_t sched_source(struct domain *domains, int n_domains)
+{
+	int i;
+
+	for (i = 0; i < n_domains; i++) {
+		if (domains[i].src_clock)
+			return domains[i].src_clock->clkid;
+	}
+	return CLOCK_MONOTONIC;
+}
+
+/*
+ * Returns the CLOCK_MONOTONIC time at which the source clock reaches the
+ * configured phase of its interval, closest to one interval from 'last'.
+ */
+static uint64_t sched_next(struct sample_sched *sched, clockid_t src,
+			   uint64_t last)
+{
+	uint64_t next = last + sched->interval, mono, now, src_next, aligned;
+	struct timespec ts;
+	int64_t offset;
+
+	if (sched->phase < 0 || src == CLOCK_MONOTONIC)
+		return next;
+
+	mono = monotonic_now();
+	if (clock_gettime(src, &ts))
+		return next;
+	now = monotonic_now();
+	offset = ts.tv_sec * NS_PER_SEC + ts.tv_nsec - (mono + now) / 2;
+
+	src_next = next + offset;
+	aligned = src_next - src_next % sched->interval +
+		sched->phase % sched->interval;
+	if (aligned + sched->interval / 2 < src_next)
+		aligned += sched->interval;
+	else if (aligned > src_next + sched->interval / 2)
+		aligned -= sched->interval;
+
+	next = aligned - offset;
+	while (next <= now)
+		next += sched->interval;
+	return next;
+}
+
+static int sched_arm(struct sample_sched *sched)
+{
+	struct itimerspec tmo;
+	uint64_t expiry = sched->target - sched->lead;
+
+	memset(&tmo, 0, sizeof(tmo));
+	tmo.it_value.tv_sec = expiry / NS_PER_SEC;
+	tmo.it_value.tv_nsec = expiry % NS_PER_SEC;
+	if (timerfd_settime(sched->fd, TFD_TIMER_ABSTIME, &tmo, NULL)) {
+		pr_err("failed to set sampling timer: %m");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Learns how long it takes from the timer expiry to the first
+ * measurement, so that the next expiry comes early by that much.
+ */
+static void sched_update(struct sample_sched *sched, uint64_t actual)
+{
+	struct stats_result result;
+	int64_t error = actual - sched->target;
+
+	sched->lead += error / 8;
+	if (sched->lead < 0)
+		sched->lead = 0;
+	if (sched->lead > sched->interval / 2)
+		sched->lead = sched->interval / 2;
+
+	if (!sched->jitter)
+		return;
+	stats_add_value(sched->jitter, error);
+	if (stats_get_num_values(sched->jitter) < sched->max_count)
+		return;
+	stats_get_result(sched->jitter, &result);
+	pr_info("sample jitter rms %4.0f max %4.0f p99 %4.0f lead %6" PRId64,
+		result.rms, result.max_abs, result.p99, sched->lead);
+	stats_reset(sched->jitter);
+}
+
+/*
+ * Handles the messages of the ptp4l instances that arrived while
+ * waiting for the next clock update, so that a port state change
+ * takes effect right away.
+ */
+static void process_agents(struct domain *domains, int n_domains,
+			   struct pollfd *pfd)
+{
+	int i, state_changed = 0;
+	struct domain *domain;
+
+	for (i = 0; i < n_domains; i++) {
+		domain = &domains[i];
+		if (!(pfd[i].revents & (POLLIN | POLLPRI))) {
+			continue;
+		}
+		if (pmc_agent_process(domain->agent) < 0) {
+			continue;
+		}
+		if (domain->state_changed) {
+			state_changed = 1;
+
+			/* refresh the offset, as it may have changed
+			 * after the port state change */
+			if (pmc_agent_request_utc_offset(domain->agent)) {
+				pr_err("failed to request UTC offset");
+			}
+		}
+	}
+
+	if (state_changed) {
+		reconfigure(domains, n_domains);
+	}
+}
+
 static int do_loop(struct domain *domains, int n_domains)
 {
-	int i, state_changed, prev_sub;
-	struct timespec interval;
+	int i, cnt, err = -1, state_changed, prev_sub;
+	struct sample_sched sched;
 	struct domain *domain;
+	struct pollfd *pfd;
+	uint64_t expirations;
 
+	memset(&sched, 0, sizeof(sched));
 	/* All domains have the same interval */
-	interval.tv_sec = domains[0].phc_interval;
-	interval.tv_nsec = (domains[0].phc_interval - interval.tv_sec) * 1e9;
+	sched.interval = domains[0].phc_interval * NS_PER_SEC;
+	sched.phase = domains[0].sample_phase;
+	sched.max_count = domains[0].stats_max_count;
+	if (sched.max_count > 0) {
+		sched.jitter = stats_create();
+		if (!sched.jitter) {
+			pr_err("failed to create stats");
+			return -1;
+		}
+	}
+	sched.fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (sched.fd < 0) {
+		pr_err("failed to create sampling timer: %m");
+		goto out_stats;
+	}
+
+	/* The agents of the domains, followed by the sampling timer. */
+	pfd = calloc(n_domains + 1, sizeof(*pfd));
+	if (!pfd) {
+		goto out_timer;
+	}
+	for (i = 0; i < n_domains; i++) {
+		pfd[i].fd = pmc_agent_get_fd(domains[i].agent);
+		pfd[i].events = POLLIN | POLLPRI;
+	}
+	pfd[n_domains].fd = sched.fd;
+	pfd[n_domains].events = POLLIN;
+
+	sched.target = sched_next(&sched, sched_source(domains, n_domains),
+				  monotonic_now());
+	if (sched_arm(&sched)) {
+		goto out_pfd;
+	}
 
 	while (is_running()) {
-		clock_nanosleep(CLOCK_MONOTONIC, 0, &interval, NULL);
+		cnt = poll(pfd, n_domains + 1, -1);
+		if (cnt < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_err("poll failed: %m");
+			goto out_pfd;
+		}
+		process_agents(domains, n_domains, pfd);
+
+		if (!(pfd[n_domains].revents & POLLIN)) {
+			continue;
+		}
+		if (read(sched.fd, &expirations, sizeof(expirations)) < 0) {
+			pr_err("failed to read sampling timer: %m");
+			goto out_pfd;
+		}
 
 		state_changed = 0;
 		for (i = 0; i < n_domains; i++) {
@@ -843,9 +1155,8 @@ static int do_loop(struct domain *domains, int n_domains)
 
 				/* force getting offset, as it may have
 				 * changed after the port state change */
-				if (pmc_agent_query_utc_offset(domain->agent,
-							       1000)) {
-					pr_err("failed to get UTC offset");
+				if (pmc_agent_request_utc_offset(domain->agent)) {
+					pr_err("failed to request UTC offset");
 					continue;
 				}
 			}
@@ -856,6 +1167,8 @@ static int do_loop(struct domain *domains, int n_domains)
 			state_changed = 0;
 		}
 
+		sched_update(&sched, monotonic_now());
+
 		for (i = 0; i < n_domains; i++) {
 			domain = &domains[i];
 
@@ -863,10 +1176,28 @@ static int do_loop(struct domain *domains, int n_domains)
 				continue;
 
 			if (update_domain_clocks(domain))
-				return -1;
+				goto out_pfd;
 		}
-	}
-	return 0;
+
+		sched.target = sched_next(&sched,
+					  sched_source(domains, n_domains),
+					  sched.target);
+		if (sched_arm(&sched)) {
+			goto out_pfd;
+		}
+
+		for (i = 0; i < n_domains; i++)
+			flush_servo_state(&domains[i]);
+	}
+	err = 0;
+out_pfd:
+	free(pfd);
+out_timer:
+	close(sched.fd);
+out_stats:
+	if (sched.jitter)
+		stats_destroy(sched.jitter);
+	return err;
 }
 
 static int clock_compute_state(struct domain *domain,
@@ -1434,6 +1765,12 @@ int main(int argc, char *argv[])
 	}
 	settings.kernel_leap = config_get_int(cfg, NULL, "kernel_leap");
 	settings.sanity_freq_limit = config_get_int(cfg, NULL, "sanity_freq_limit");
+	settings.sample_phase = config_get_int(cfg, NULL, "phc2sys.sample_phase");
+	settings.sample_burst = config_get_int(cfg, NULL, "phc2sys.sample_burst");
+	settings.sample_burst_gap =
+		config_get_int(cfg, NULL, "phc2sys.sample_burst_gap");
+	settings.sysoff_robust =
+		config_get_int(cfg, NULL, "phc2sys.sysoff_robust");
 
 	if (autocfg) {
 		if (n_domains == 0)
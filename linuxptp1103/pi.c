@@ -35,6 +35,11 @@
 
 #define FREQ_EST_MARGIN 0.001
 
+/* Smoothing factor of the offset noise estimate */
+#define ADAPT_ALPHA (1.0 / 16)
+/* Minimum number of locked samples between gain changes */
+#define ADAPT_HOLDOFF 32
+
 struct pi_servo {
 	struct servo servo;
 	int64_t offset[2];
@@ -44,6 +49,14 @@ struct pi_servo {
 	double ki;
 	double last_freq;
 	int count;
+	int warm;
+	double interval;
+	/* adaptive gain scheduling: */
+	double kp_nominal;
+	double ki_nominal;
+	double factor;
+	double noise_var;
+	int adapt_count;
 	/* configuration: */
 	double configured_pi_kp;
 	double configured_pi_ki;
@@ -53,6 +66,11 @@ struct pi_servo {
 	double configured_pi_ki_scale;
 	double configured_pi_ki_exponent;
 	double configured_pi_ki_norm_max;
+	int configured_adaptive;
+	double configured_noise_ref;
+	double configured_min_factor;
+	double configured_max_factor;
+	int sw_ts;
 };
 
 static void pi_destroy(struct servo *servo)
@@ -61,6 +79,61 @@ static void pi_destroy(struct servo *servo)
 	free(s);
 }
 
+/*
+ * Scaling kp by the factor and ki by its square scales the bandwidth of
+ * the loop while keeping its damping.
+ */
+static void pi_apply_gains(struct pi_servo *s)
+{
+	s->kp = s->kp_nominal * s->factor;
+	if (s->kp > s->configured_pi_kp_norm_max / s->interval)
+		s->kp = s->configured_pi_kp_norm_max / s->interval;
+
+	s->ki = s->ki_nominal * s->factor * s->factor;
+	if (s->ki > s->configured_pi_ki_norm_max / s->interval)
+		s->ki = s->configured_pi_ki_norm_max / s->interval;
+}
+
+/*
+ * Tracks the variance of the offset in the locked state and moves the
+ * gains towards the bandwidth at which the noise would equal the
+ * configured reference. A change is made only when the wanted factor
+ * differs from the current one by at least two, and then by a factor of
+ * two, so the gains do not flap around a boundary.
+ */
+static void pi_adapt(struct pi_servo *s, int64_t offset)
+{
+	double target, factor = s->factor;
+
+	if (!s->adapt_count && !s->noise_var)
+		s->noise_var = (double) offset * offset;
+	else
+		s->noise_var += ADAPT_ALPHA * ((double) offset * offset -
+					       s->noise_var);
+
+	if (++s->adapt_count < ADAPT_HOLDOFF)
+		return;
+
+	target = s->noise_var > 0.0 ?
+		s->configured_noise_ref / sqrt(s->noise_var) :
+		s->configured_max_factor;
+
+	if (target >= 2.0 * factor)
+		factor = fmin(2.0 * factor, s->configured_max_factor);
+	else if (target <= factor / 2.0)
+		factor = fmax(factor / 2.0, s->configured_min_factor);
+
+	if (factor == s->factor)
+		return;
+
+	s->factor = factor;
+	s->adapt_count = 0;
+	pi_apply_gains(s);
+
+	pr_info("PI servo: offset noise %.0f ns, gain factor %.3f kp %.3f ki %.6f",
+		sqrt(s->noise_var), s->factor, s->kp, s->ki);
+}
+
 static double pi_sample(struct servo *servo,
 			int64_t offset,
 			uint64_t local_ts,
@@ -73,6 +146,11 @@ static double pi_sample(struct servo *servo,
 
 	switch (s->count) {
 	case 0:
+		if (s->warm) {
+			/* The drift is already known, skip the estimation. */
+			s->warm = 0;
+			goto locked;
+		}
 		s->offset[0] = offset;
 		s->local[0] = local_ts;
 		*state = SERVO_UNLOCKED;
@@ -109,7 +187,7 @@ static double pi_sample(struct servo *servo,
 			s->drift = -servo->max_frequency;
 		else if (s->drift > servo->max_frequency)
 			s->drift = servo->max_frequency;
-
+	locked:
 		if ((servo->first_update &&
 		     servo->first_step_threshold &&
 		     servo->first_step_threshold < llabs(offset)) ||
@@ -147,6 +225,8 @@ static double pi_sample(struct servo *servo,
 			s->drift += ki_term;
 		}
 		*state = SERVO_LOCKED;
+		if (s->configured_adaptive)
+			pi_adapt(s, offset);
 		break;
 	}
 
@@ -158,13 +238,12 @@ static void pi_sync_interval(struct servo *servo, double interval)
 {
 	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 
-	s->kp = s->configured_pi_kp_scale * pow(interval, s->configured_pi_kp_exponent);
-	if (s->kp > s->configured_pi_kp_norm_max / interval)
-		s->kp = s->configured_pi_kp_norm_max / interval;
-
-	s->ki = s->configured_pi_ki_scale * pow(interval, s->configured_pi_ki_exponent);
-	if (s->ki > s->configured_pi_ki_norm_max / interval)
-		s->ki = s->configured_pi_ki_norm_max / interval;
+	s->interval = interval;
+	s->kp_nominal = s->configured_pi_kp_scale *
+		pow(interval, s->configured_pi_kp_exponent);
+	s->ki_nominal = s->configured_pi_ki_scale *
+		pow(interval, s->configured_pi_ki_exponent);
+	pi_apply_gains(s);
 
 	pr_debug("PI servo: sync interval %.3f kp %.3f ki %.6f",
 		 interval, s->kp, s->ki);
@@ -175,24 +254,37 @@ static void pi_reset(struct servo *servo)
 	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 
 	s->count = 0;
+	s->warm = 0;
 }
 
-struct servo *pi_servo_create(struct config *cfg, double fadj, int sw_ts)
+static int pi_gains(struct servo *servo, double *kp, double *ki, double *noise)
 {
-	struct pi_servo *s;
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
 
-	s = calloc(1, sizeof(*s));
-	if (!s)
-		return NULL;
+	*kp = s->kp;
+	*ki = s->ki;
+	*noise = sqrt(s->noise_var);
+	return s->configured_adaptive ? 1 : 0;
+}
 
-	s->servo.destroy = pi_destroy;
-	s->servo.sample  = pi_sample;
-	s->servo.sync_interval = pi_sync_interval;
-	s->servo.reset   = pi_reset;
-	s->drift         = fadj;
-	s->last_freq     = fadj;
-	s->kp            = 0.0;
-	s->ki            = 0.0;
+static double pi_drift(struct servo *servo)
+{
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
+
+	return s->drift;
+}
+
+static void pi_warm_start(struct servo *servo, double drift, double rate_ratio)
+{
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
+
+	s->drift = drift;
+	s->last_freq = drift;
+	s->warm = 1;
+}
+
+static void pi_configure(struct pi_servo *s, struct config *cfg)
+{
 	s->configured_pi_kp = config_get_double(cfg, NULL, "pi_proportional_const");
 	s->configured_pi_ki = config_get_double(cfg, NULL, "pi_integral_const");
 	s->configured_pi_kp_scale = config_get_double(cfg, NULL, "pi_proportional_scale");
@@ -206,6 +298,13 @@ struct servo *pi_servo_create(struct config *cfg, double fadj, int sw_ts)
 		config_get_double(cfg, NULL, "pi_integral_exponent");
 	s->configured_pi_ki_norm_max =
 		config_get_double(cfg, NULL, "pi_integral_norm_max");
+	s->configured_adaptive = config_get_int(cfg, NULL, "pi_adaptive");
+	s->configured_noise_ref =
+		config_get_double(cfg, NULL, "pi_adaptive_noise_ref");
+	s->configured_min_factor =
+		config_get_double(cfg, NULL, "pi_adaptive_min_factor");
+	s->configured_max_factor =
+		config_get_double(cfg, NULL, "pi_adaptive_max_factor");
 
 	if (s->configured_pi_kp && s->configured_pi_ki) {
 		/* Use the constants as configured by the user without
@@ -218,7 +317,7 @@ struct servo *pi_servo_create(struct config *cfg, double fadj, int sw_ts)
 		s->configured_pi_kp_norm_max = MAX_KP_NORM_MAX;
 		s->configured_pi_ki_norm_max = MAX_KI_NORM_MAX;
 	} else if (!s->configured_pi_kp_scale || !s->configured_pi_ki_scale) {
-		if (sw_ts) {
+		if (s->sw_ts) {
 			s->configured_pi_kp_scale = SWTS_KP_SCALE;
 			s->configured_pi_ki_scale = SWTS_KI_SCALE;
 		} else {
@@ -226,6 +325,55 @@ struct servo *pi_servo_create(struct config *cfg, double fadj, int sw_ts)
 			s->configured_pi_ki_scale = HWTS_KI_SCALE;
 		}
 	}
+}
+
+/*
+ * The integrator keeps its value, so the new gains take over smoothly
+ * from the current frequency.
+ */
+static void pi_reconfigure(struct servo *servo, struct config *cfg)
+{
+	struct pi_servo *s = container_of(servo, struct pi_servo, servo);
+
+	pi_configure(s, cfg);
+
+	if (!s->configured_adaptive) {
+		s->factor = 1.0;
+	} else {
+		s->factor = fmin(fmax(s->factor, s->configured_min_factor),
+				 s->configured_max_factor);
+	}
+	s->adapt_count = 0;
+	pi_sync_interval(servo, s->interval);
+
+	pr_info("PI servo: reconfigured, kp %.3f ki %.6f", s->kp, s->ki);
+}
+
+struct servo *pi_servo_create(struct config *cfg, double fadj, int sw_ts)
+{
+	struct pi_servo *s;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->servo.destroy = pi_destroy;
+	s->servo.sample  = pi_sample;
+	s->servo.sync_interval = pi_sync_interval;
+	s->servo.reset   = pi_reset;
+	s->servo.drift   = pi_drift;
+	s->servo.gains   = pi_gains;
+	s->servo.warm_start = pi_warm_start;
+	s->servo.reconfigure = pi_reconfigure;
+	s->drift         = fadj;
+	s->last_freq     = fadj;
+	s->kp            = 0.0;
+	s->ki            = 0.0;
+	s->factor        = 1.0;
+	s->interval      = 1.0;
+	s->sw_ts         = sw_ts;
+
+	pi_configure(s, cfg);
 
 	return &s->servo;
 }
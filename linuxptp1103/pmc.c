@@ -26,12 +26,15 @@
 #include <inttypes.h>
 #include <arpa/inet.h>
 
+#include "contain.h"
 #include "ds.h"
 #include "fsm.h"
 #include "notification.h"
+#include "pmc_batch.h"
 #include "pmc_common.h"
 #include "print.h"
 #include "sad.h"
+#include "telemetry.h"
 #include "tlv.h"
 #include "uds.h"
 #include "util.h"
@@ -41,6 +44,7 @@ static struct pmc *pmc;
 
 #define IFMT "\n\t\t"
 #define P41 ((double)(1ULL << 41))
+#define P32 ((double)(1ULL << 32))
 
 static char *text2str(struct PTPText *text)
 {
@@ -80,7 +84,7 @@ static void pmc_show_rx_sync_timing(struct slave_rx_sync_timing_record *record,
 		IFMT "sequenceId                 %hu"
 		IFMT "syncOriginTimestamp        %" PRId64 ".%09u"
 		IFMT "totalCorrectionField       %" PRId64
-		IFMT "scaledCumulativeRateOffset %u"
+		IFMT "scaledCumulativeRateOffset %d"
 		IFMT "syncEventIngressTimestamp  %" PRId64 ".%09u",
 		record->sequenceId,
 		SHOW_TIMESTAMP(record->syncOriginTimestamp),
@@ -107,6 +111,55 @@ static void pmc_show_unicast_master_entry(struct unicast_master_entry *entry,
 	);
 }
 
+static const char *pmc_stats_bulk_name(unsigned int i, char *buf, int len)
+{
+	static const char *msg_types[MAX_MESSAGE_TYPES] = {
+		"Sync", "Delay_Req", "Pdelay_Req", "Pdelay_Resp",
+		NULL, NULL, NULL, NULL,
+		"Follow_Up", "Delay_Resp", "Pdelay_Resp_Follow_Up", "Announce",
+		"Signaling", "Management", NULL, NULL,
+	};
+	static const char *service[] = {
+		"announce_timeout", "sync_timeout", "delay_timeout",
+		"unicast_service_timeout", "unicast_request_timeout",
+		"master_announce_timeout", "master_sync_timeout",
+		"qualification_timeout", "sync_mismatch", "followup_mismatch",
+	};
+	unsigned int svc = 2 * MAX_MESSAGE_TYPES;
+
+	if (i < 2 * MAX_MESSAGE_TYPES) {
+		if (msg_types[i % MAX_MESSAGE_TYPES]) {
+			snprintf(buf, len, "%s_%s", i < MAX_MESSAGE_TYPES ?
+				 "rx" : "tx", msg_types[i % MAX_MESSAGE_TYPES]);
+		} else {
+			snprintf(buf, len, "%s_type_%u", i < MAX_MESSAGE_TYPES ?
+				 "rx" : "tx", i % MAX_MESSAGE_TYPES);
+		}
+	} else if (i - svc < ARRAY_SIZE(service)) {
+		snprintf(buf, len, "%s", service[i - svc]);
+	} else {
+		snprintf(buf, len, "counter_%u", i);
+	}
+	return buf;
+}
+
+static void pmc_show_stats_bulk_record(struct port_stats_bulk_record *rec,
+				       FILE *fp)
+{
+	unsigned int i, n = 0;
+	char name[32];
+
+	fprintf(fp, IFMT "portNumber                %hu", rec->portNumber);
+	for (i = 0; i < 64; i++) {
+		if (!(rec->mask & (1ULL << i))) {
+			continue;
+		}
+		fprintf(fp, IFMT "  %-24s%" PRIu64,
+			pmc_stats_bulk_name(i, name, sizeof(name)),
+			rec->value[n++]);
+	}
+}
+
 static void pmc_show_signaling(struct ptp_message *msg, FILE *fp)
 {
 	struct slave_rx_sync_timing_record *sync_record;
@@ -164,7 +217,12 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 	struct unicast_master_table_np *umtn;
 	struct grandmaster_settings_np *gsn;
 	struct port_service_stats_np *pssp;
+	struct port_stats_bulk_record *rec;
 	struct mgmt_clock_description *cd;
+	struct port_rate_stats_np *prsn;
+	struct port_tlv_stats_np *ptsn;
+	struct port_tc_stats_np *ptcn;
+	struct port_stats_bulk_np *psb;
 	struct management_tlv_datum *mtd;
 	struct unicast_master_entry *ume;
 	struct subscribe_events_np *sen;
@@ -174,6 +232,8 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 	struct timePropertiesDS *tp;
 	struct management_tlv *mgt;
 	struct time_status_np *tsn;
+	struct clock_stats_np *csn;
+	struct servo_gains_np *sgn;
 	struct port_stats_np *pcp;
 	struct tlv_extra *extra;
 	struct port_ds_np *pnp;
@@ -223,7 +283,8 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 		goto out;
 	}
 	mgt = (struct management_tlv *) msg->management.suffix;
-	if (mgt->length == 2 && mgt->id != MID_NULL_MANAGEMENT) {
+	if (mgt->length == 2 && mgt->id != MID_NULL_MANAGEMENT &&
+	    mgt->id != MID_RELOAD_CONFIG_NP) {
 		fprintf(fp, "empty-tlv ");
 		goto out;
 	}
@@ -430,6 +491,38 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 			tsn->gmPresent ? "true" : "false",
 			cid2str(&tsn->gmIdentity));
 		break;
+	case MID_CLOCK_STATS_NP:
+		csn = (struct clock_stats_np *) mgt->data;
+		fprintf(fp, "CLOCK_STATS_NP "
+			IFMT "num_values     %" PRIu32
+			IFMT "offset_rms     %" PRId64
+			IFMT "offset_max_abs %" PRId64
+			IFMT "offset_p99     %" PRId64
+			IFMT "offset_p999    %" PRId64
+			IFMT "delay_mean     %" PRId64
+			IFMT "delay_p99      %" PRId64
+			IFMT "delay_p999     %" PRId64,
+			csn->num_values,
+			csn->offset_rms,
+			csn->offset_max_abs,
+			csn->offset_p99,
+			csn->offset_p999,
+			csn->delay_mean,
+			csn->delay_p99,
+			csn->delay_p999);
+		break;
+	case MID_SERVO_GAINS_NP:
+		sgn = (struct servo_gains_np *) mgt->data;
+		fprintf(fp, "SERVO_GAINS_NP "
+			IFMT "kp           %.6f"
+			IFMT "ki           %.9f"
+			IFMT "offset_noise %" PRId64
+			IFMT "adaptive     %hhu",
+			sgn->scaled_kp / P32,
+			sgn->scaled_ki / P32,
+			sgn->offset_noise,
+			sgn->adaptive);
+		break;
 	case MID_GRANDMASTER_SETTINGS_NP:
 		gsn = (struct grandmaster_settings_np *) mgt->data;
 		fprintf(fp, "GRANDMASTER_SETTINGS_NP "
@@ -593,6 +686,64 @@ static void pmc_show(struct ptp_message *msg, FILE *fp)
 		pssp->stats.sync_mismatch,
 		pssp->stats.followup_mismatch);
 		break;
+	case MID_PORT_STATS_BULK_NP:
+		psb = (struct port_stats_bulk_np *) mgt->data;
+		fprintf(fp, "PORT_STATS_BULK_NP "
+			IFMT "generation                %u"
+			IFMT "first_port                %hu"
+			IFMT "num_records               %hu",
+			psb->generation, psb->first_port, psb->num_records);
+		buf = psb->data;
+		for (i = 0; i < psb->num_records; i++) {
+			rec = (struct port_stats_bulk_record *) buf;
+			pmc_show_stats_bulk_record(rec, fp);
+			buf += sizeof(*rec) + __builtin_popcountll(rec->mask) *
+				sizeof(uint64_t);
+		}
+		break;
+	case MID_PORT_RATE_STATS_NP:
+		prsn = (struct port_rate_stats_np *) mgt->data;
+		fprintf(fp, "PORT_RATE_STATS_NP "
+			IFMT "portIdentity              %s"
+			IFMT "enabled                   %hhu"
+			IFMT "logSyncInterval           %hhd"
+			IFMT "logPdelayReqInterval      %hhd"
+			IFMT "allanDeviation            %.3e"
+			IFMT "pathDelayVariation        %.1f"
+			IFMT "rateChanges               %u"
+			IFMT "syncSaved                 %" PRIu64
+			IFMT "pdelaySaved               %" PRIu64,
+			pid2str(&prsn->portIdentity),
+			prsn->enabled,
+			prsn->logSyncInterval,
+			prsn->logPdelayReqInterval,
+			prsn->allanDeviation * 1e-12,
+			prsn->pathDelayVariation / 65536.0,
+			prsn->rateChanges,
+			prsn->syncSaved,
+			prsn->pdelaySaved);
+		break;
+	case MID_PORT_TLV_STATS_NP:
+		ptsn = (struct port_tlv_stats_np *) mgt->data;
+		fprintf(fp, "PORT_TLV_STATS_NP "
+			IFMT "portIdentity              %s"
+			IFMT "rx_TLV_decoded            %" PRIu64
+			IFMT "rx_TLV_skipped            %" PRIu64,
+			pid2str(&ptsn->portIdentity),
+			ptsn->rxTlvDecoded,
+			ptsn->rxTlvSkipped);
+		break;
+	case MID_PORT_TC_STATS_NP:
+		ptcn = (struct port_tc_stats_np *) mgt->data;
+		fprintf(fp, "PORT_TC_STATS_NP "
+			IFMT "portIdentity              %s"
+			IFMT "txts_timeout              %" PRIu64,
+			pid2str(&ptcn->portIdentity),
+			ptcn->txtsTimeout);
+		break;
+	case MID_RELOAD_CONFIG_NP:
+		fprintf(fp, "RELOAD_CONFIG_NP ");
+		break;
 	case MID_UNICAST_MASTER_TABLE_NP:
 		umtn = (struct unicast_master_table_np *) mgt->data;
 		fprintf(fp, "UNICAST_MASTER_TABLE_NP "
@@ -681,6 +832,194 @@ out:
 	fflush(fp);
 }
 
+static void pmc_show_telemetry(struct PortIdentity *pid, int64_t gen, int id,
+			       void *data, int datalen)
+{
+	struct management_tlv *mgt;
+	struct tlv_extra *extra;
+	struct ptp_message *msg;
+
+	msg = msg_allocate();
+	if (!msg) {
+		return;
+	}
+	msg->header.tsmt = MANAGEMENT;
+	msg->header.messageLength = sizeof(struct management_msg);
+	msg->header.sourcePortIdentity = *pid;
+	msg->header.sequenceId = gen;
+	msg->management.flags = RESPONSE;
+
+	extra = msg_tlv_append(msg, sizeof(*mgt) + datalen);
+	if (!extra) {
+		msg_put(msg);
+		return;
+	}
+	mgt = (struct management_tlv *) extra->tlv;
+	mgt->type = TLV_MANAGEMENT;
+	mgt->length = sizeof(mgt->id) + datalen;
+	mgt->id = id;
+	memcpy(mgt->data, data, datalen);
+
+	pmc_show(msg, stdout);
+	msg_put(msg);
+}
+
+static bool pmc_telemetry_alive(struct telemetry *t)
+{
+	if (telemetry_alive(t)) {
+		return true;
+	}
+	fprintf(stderr, "telemetry: ptp4l is not running\n");
+	return false;
+}
+
+/*
+ * Answers a GET command from the telemetry segment of ptp4l, printing
+ * the same output that the management response would produce.
+ */
+static int pmc_telemetry_command(struct telemetry *t, char *str)
+{
+	char action_str[10+1] = {0}, id_str[64+1] = {0};
+	struct port_service_stats_np pssn;
+	struct telemetry_clock clk;
+	struct telemetry_port rec;
+	struct port_stats_np psn;
+	struct PortIdentity pid;
+	int64_t gen;
+	int port;
+
+	if (2 != sscanf(str, " %10s %64s", action_str, id_str) ||
+	    strncasecmp(action_str, "GET", strlen(action_str))) {
+		return -1;
+	}
+
+	if (!strcasecmp(id_str, "CURRENT_DATA_SET") ||
+	    !strcasecmp(id_str, "PARENT_DATA_SET") ||
+	    !strcasecmp(id_str, "TIME_STATUS_NP")) {
+		if (!pmc_telemetry_alive(t)) {
+			return 0;
+		}
+		gen = telemetry_read_clock(t, &clk);
+		if (gen < 0) {
+			fprintf(stderr, "telemetry: clock record is busy\n");
+			return 0;
+		}
+		if (!gen) {
+			return 0;
+		}
+		pid.clockIdentity = clk.identity;
+		pid.portNumber = 0;
+		if (!strcasecmp(id_str, "CURRENT_DATA_SET")) {
+			pmc_show_telemetry(&pid, gen, MID_CURRENT_DATA_SET,
+					   &clk.cds, sizeof(clk.cds));
+		} else if (!strcasecmp(id_str, "PARENT_DATA_SET")) {
+			pmc_show_telemetry(&pid, gen, MID_PARENT_DATA_SET,
+					   &clk.pds, sizeof(clk.pds));
+		} else {
+			pmc_show_telemetry(&pid, gen, MID_TIME_STATUS_NP,
+					   &clk.tsn, sizeof(clk.tsn));
+		}
+		return 0;
+	}
+
+	if (strcasecmp(id_str, "PORT_DATA_SET") &&
+	    strcasecmp(id_str, "PORT_STATS_NP") &&
+	    strcasecmp(id_str, "PORT_SERVICE_STATS_NP")) {
+		return -1;
+	}
+	if (!pmc_telemetry_alive(t)) {
+		return 0;
+	}
+	for (port = 1; port <= TELEMETRY_MAX_PORT; port++) {
+		gen = telemetry_read_port(t, port, &rec);
+		if (gen < 0) {
+			fprintf(stderr, "telemetry: port %d record is busy\n",
+				port);
+			continue;
+		}
+		if (!gen) {
+			continue;
+		}
+		if (!strcasecmp(id_str, "PORT_DATA_SET")) {
+			pmc_show_telemetry(&rec.pds.portIdentity, gen,
+					   MID_PORT_DATA_SET,
+					   &rec.pds, sizeof(rec.pds));
+		} else if (!strcasecmp(id_str, "PORT_STATS_NP")) {
+			psn.portIdentity = rec.pds.portIdentity;
+			psn.stats = rec.stats;
+			pmc_show_telemetry(&rec.pds.portIdentity, gen,
+					   MID_PORT_STATS_NP,
+					   &psn, sizeof(psn));
+		} else {
+			pssn.portIdentity = rec.pds.portIdentity;
+			pssn.stats = rec.service_stats;
+			pmc_show_telemetry(&rec.pds.portIdentity, gen,
+					   MID_PORT_SERVICE_STATS_NP,
+					   &pssn, sizeof(pssn));
+		}
+	}
+	return 0;
+}
+
+static int pmc_telemetry_run(const char *path, int argc, char *argv[])
+{
+	char line[1024], *command;
+	struct telemetry *t;
+	int length;
+
+	t = telemetry_open(path, false);
+	if (!t) {
+		return -1;
+	}
+	if (optind < argc) {
+		while (optind < argc) {
+			command = argv[optind++];
+			if (pmc_telemetry_command(t, command)) {
+				fprintf(stderr, "bad command: %s\n", command);
+			}
+		}
+	} else {
+		while (is_running() && fgets(line, sizeof(line), stdin)) {
+			length = strlen(line);
+			if (length < 2) {
+				continue;
+			}
+			line[length - 1] = 0;
+			if (pmc_telemetry_command(t, line)) {
+				fprintf(stderr, "bad command: %s\n", line);
+			}
+		}
+	}
+	telemetry_close(t);
+	msg_cleanup();
+	return 0;
+}
+
+static int pmc_batch_main(struct pmc_batch *b, char **targets, int n_targets,
+			  int argc, char *argv[])
+{
+	int i;
+
+	for (i = 0; i < n_targets; i++) {
+		if (pmc_batch_add_target(b, targets[i])) {
+			fprintf(stderr, "bad target: %s\n", targets[i]);
+			return -1;
+		}
+	}
+	if (optind == argc) {
+		fprintf(stderr, "no commands given for the targets\n");
+		return -1;
+	}
+	while (optind < argc) {
+		if (pmc_batch_add_command(b, argv[optind])) {
+			fprintf(stderr, "bad command: %s\n", argv[optind]);
+			return -1;
+		}
+		optind++;
+	}
+	return pmc_batch_run(b, stdout);
+}
+
 static void usage(char *progname)
 {
 	fprintf(stderr,
@@ -697,9 +1036,13 @@ static void usage(char *progname)
 		" -h        prints this message and exits\n"
 		" -i [dev]  interface device to use, default 'eth0'\n"
 		"           for network and '/var/run/pmc.$pid' for UDS.\n"
+		" -m [file] read from the telemetry shared memory 'file'\n"
+		" -r [addr] query the UDS path or IP address 'addr' in parallel\n"
+		"           with other targets, printing JSON, may be repeated\n"
 		" -s [path] server address for UDS, default '/var/run/ptp4l'.\n"
 		" -t [hex]  transport specific field, default 0x0\n"
 		" -v        prints the software version and exits\n"
+		" -w [num]  time limit per target in milliseconds, default 1000\n"
 		" -z        send zero length TLV values with the GET actions\n"
 		"\n",
 		progname);
@@ -707,13 +1050,15 @@ static void usage(char *progname)
 
 int main(int argc, char *argv[])
 {
-	const char *iface_name = NULL;
+	const char *iface_name = NULL, *telemetry_path = NULL;
 	char *config = NULL, *progname;
 	int c, cnt, index, length, tmo = -1, batch_mode = 0, zero_datalen = 0;
-	int ret = 0;
+	int ret = 0, n_targets = 0, target_tmo = 1000;
+	char **targets = NULL, **tmp;
 	char line[1024], *command = NULL, uds_local[MAX_IFNAME_SIZE + 1];
 	enum transport_type transport_type = TRANS_UDP_IPV4;
 	UInteger8 boundary_hops = 1, domain_number = 0, transport_specific = 0, allow_unauth = 0;
+	struct pmc_batch *batch;
 	struct ptp_message *msg;
 	struct option *opts;
 	struct config *cfg;
@@ -732,7 +1077,7 @@ int main(int argc, char *argv[])
 	/* Process the command line arguments. */
 	progname = strrchr(argv[0], '/');
 	progname = progname ? 1+progname : argv[0];
-	while (EOF != (c = getopt_long(argc, argv, "246u""b:d:f:hi:s:t:vz",
+	while (EOF != (c = getopt_long(argc, argv, "246u""b:d:f:hi:m:r:s:t:vw:z",
 				       opts, &index))) {
 		switch (c) {
 		case 0:
@@ -780,6 +1125,18 @@ int main(int argc, char *argv[])
 		case 'i':
 			iface_name = optarg;
 			break;
+		case 'm':
+			telemetry_path = optarg;
+			break;
+		case 'r':
+			tmp = realloc(targets, (n_targets + 1) * sizeof(*tmp));
+			if (!tmp) {
+				ret = -1;
+				goto out;
+			}
+			targets = tmp;
+			targets[n_targets++] = optarg;
+			break;
 		case 's':
 			if (strlen(optarg) > MAX_IFNAME_SIZE) {
 				fprintf(stderr, "path %s too long, max is %d\n",
@@ -804,6 +1161,14 @@ int main(int argc, char *argv[])
 			version_show(stdout);
 			config_destroy(cfg);
 			return 0;
+		case 'w':
+			target_tmo = atoi(optarg);
+			if (target_tmo <= 0) {
+				fprintf(stderr, "bad time limit: %s\n", optarg);
+				ret = -1;
+				goto out;
+			}
+			break;
 		case 'z':
 			zero_datalen = 1;
 			break;
@@ -833,6 +1198,25 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	print_set_progname(progname);
+	print_set_syslog(1);
+	print_set_verbose(1);
+
+	if (n_targets) {
+		batch = pmc_batch_create(cfg, iface_name ? iface_name : "eth0",
+					 boundary_hops, domain_number,
+					 transport_specific, allow_unauth,
+					 zero_datalen, target_tmo, pmc_show);
+		if (!batch) {
+			ret = -1;
+			goto out;
+		}
+		ret = pmc_batch_main(batch, targets, n_targets, argc, argv);
+		pmc_batch_destroy(batch);
+		msg_cleanup();
+		goto out;
+	}
+
 	if (!iface_name) {
 		if (transport_type == TRANS_UDS) {
 			snprintf(uds_local, sizeof(uds_local),
@@ -846,9 +1230,10 @@ int main(int argc, char *argv[])
 		batch_mode = 1;
 	}
 
-	print_set_progname(progname);
-	print_set_syslog(1);
-	print_set_verbose(1);
+	if (telemetry_path) {
+		ret = pmc_telemetry_run(telemetry_path, argc, argv);
+		goto out;
+	}
 
 	pmc = pmc_create(cfg, transport_type, iface_name,
 			 config_get_string(cfg, NULL, "uds_address"),
@@ -934,6 +1319,7 @@ int main(int argc, char *argv[])
 	msg_cleanup();
 
 out:
+	free(targets);
 	sad_destroy(cfg);
 	config_destroy(cfg);
 	return ret;
@@ -33,6 +33,17 @@
 #define UPDATES_PER_SUBSCRIPTION 3
 #define MIN_UPDATE_INTERVAL 10
 
+/* Requests that remain unanswered for this long are forgotten. */
+#define REQUEST_TIMEOUT NS_PER_SEC
+#define MAX_REQUESTS 4
+
+struct pmc_request {
+	UInteger16 sequence_id;
+	int id;
+	uint64_t sent;
+	bool active;
+};
+
 struct pmc_agent {
 	struct pmc *pmc;
 	uint64_t pmc_last_update;
@@ -49,16 +60,49 @@ struct pmc_agent {
 	/* Callback on message reception */
 	pmc_node_recv_subscribed_t *recv_subscribed;
 	void *recv_context;
+
+	/* Requests sent without waiting for the response */
+	struct pmc_request request[MAX_REQUESTS];
+
+	/* Port counters, indexed by port number minus one */
+	uint64_t (*port_stats)[PORT_STATS_BULK_COUNTERS];
+	unsigned int num_port_stats;
+	UInteger32 stats_generation;
+	UInteger16 stats_first_port;
 };
 
-static void send_subscription(struct pmc_agent *node)
+static int send_subscription(struct pmc_agent *node)
 {
 	struct subscribe_events_np sen;
 
 	memset(&sen, 0, sizeof(sen));
 	sen.duration = UPDATES_PER_SUBSCRIPTION * node->update_interval;
 	event_bitmask_set(sen.bitmask, NOTIFY_PORT_STATE, TRUE);
-	pmc_send_set_action(node->pmc, MID_SUBSCRIBE_EVENTS_NP, &sen, sizeof(sen));
+	return pmc_send_set_action(node->pmc, MID_SUBSCRIBE_EVENTS_NP,
+				   &sen, sizeof(sen));
+}
+
+static int send_stats_request(struct pmc_agent *node)
+{
+	struct port_stats_bulk_np psb;
+
+	memset(&psb, 0, sizeof(psb));
+	psb.generation = node->stats_generation;
+	psb.first_port = node->stats_first_port;
+	return pmc_send_get_data(node->pmc, MID_PORT_STATS_BULK_NP,
+				 &psb, sizeof(psb));
+}
+
+static int monotonic_ns(uint64_t *ts)
+{
+	struct timespec tp;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &tp)) {
+		pr_err("failed to read clock: %m");
+		return -errno;
+	}
+	*ts = tp.tv_sec * NS_PER_SEC + tp.tv_nsec;
+	return 0;
 }
 
 static int check_clock_identity(struct pmc_agent *node, struct ptp_message *msg)
@@ -162,6 +206,9 @@ static int run_pmc(struct pmc_agent *node, int timeout, int ds_id,
 			case MID_SUBSCRIBE_EVENTS_NP:
 				send_subscription(node);
 				break;
+			case MID_PORT_STATS_BULK_NP:
+				send_stats_request(node);
+				break;
 			default:
 				pmc_send_get_action(node->pmc, ds_id);
 				break;
@@ -213,6 +260,188 @@ static int renew_subscription(struct pmc_agent *node, int timeout)
 	return 0;
 }
 
+static int update_port_stats(struct pmc_agent *node,
+			     struct port_stats_bulk_np *psb)
+{
+	uint64_t (*stats)[PORT_STATS_BULK_COUNTERS];
+	struct port_stats_bulk_record *rec;
+	uint8_t *buf = psb->data;
+	unsigned int i, n;
+	uint64_t *value;
+	int k;
+
+	for (k = 0; k < psb->num_records; k++) {
+		rec = (struct port_stats_bulk_record *) buf;
+		n = __builtin_popcountll(rec->mask);
+		buf += sizeof(*rec) + n * sizeof(uint64_t);
+		if (!rec->portNumber) {
+			continue;
+		}
+		if (rec->portNumber > node->num_port_stats) {
+			stats = realloc(node->port_stats,
+					rec->portNumber * sizeof(*stats));
+			if (!stats) {
+				return -ENOMEM;
+			}
+			memset(stats + node->num_port_stats, 0,
+			       (rec->portNumber - node->num_port_stats) *
+			       sizeof(*stats));
+			node->port_stats = stats;
+			node->num_port_stats = rec->portNumber;
+		}
+		value = node->port_stats[rec->portNumber - 1];
+		for (i = 0, n = 0; i < 64; i++) {
+			if (!(rec->mask & (1ULL << i))) {
+				continue;
+			}
+			if (i < PORT_STATS_BULK_COUNTERS) {
+				value[i] = rec->value[n];
+			}
+			n++;
+		}
+	}
+	return 0;
+}
+
+static void update_utc_offset(struct pmc_agent *node,
+			      struct timePropertiesDS *tds)
+{
+	if (tds->flags & PTP_TIMESCALE) {
+		node->sync_offset = tds->currentUtcOffset;
+		if (tds->flags & LEAP_61)
+			node->leap = 1;
+		else if (tds->flags & LEAP_59)
+			node->leap = -1;
+		else
+			node->leap = 0;
+		node->utc_offset_traceable = tds->flags & UTC_OFF_VALID &&
+					     tds->flags & TIME_TRACEABLE;
+	} else {
+		node->sync_offset = 0;
+		node->leap = 0;
+		node->utc_offset_traceable = 0;
+	}
+}
+
+static struct pmc_request *request_find(struct pmc_agent *node,
+					UInteger16 sequence_id)
+{
+	int i;
+
+	for (i = 0; i < MAX_REQUESTS; i++) {
+		if (node->request[i].active &&
+		    node->request[i].sequence_id == sequence_id) {
+			return &node->request[i];
+		}
+	}
+	return NULL;
+}
+
+static bool request_pending(struct pmc_agent *node, int id)
+{
+	int i;
+
+	for (i = 0; i < MAX_REQUESTS; i++) {
+		if (node->request[i].active && node->request[i].id == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void request_expire(struct pmc_agent *node, uint64_t ts)
+{
+	int i;
+
+	for (i = 0; i < MAX_REQUESTS; i++) {
+		if (node->request[i].active &&
+		    ts - node->request[i].sent >= REQUEST_TIMEOUT) {
+			pr_debug("management request 0x%04x timed out",
+				 node->request[i].id);
+			node->request[i].active = false;
+		}
+	}
+}
+
+/*
+ * Sends a request without waiting for the response, which is matched
+ * by its sequenceId in pmc_agent_process().
+ */
+static int request_send(struct pmc_agent *node, int id)
+{
+	struct pmc_request *req = NULL;
+	uint64_t ts;
+	int i, err;
+
+	if (request_pending(node, id)) {
+		return 0;
+	}
+	for (i = 0; i < MAX_REQUESTS; i++) {
+		if (!node->request[i].active) {
+			req = &node->request[i];
+			break;
+		}
+	}
+	if (!req) {
+		return -EBUSY;
+	}
+	err = monotonic_ns(&ts);
+	if (err) {
+		return err;
+	}
+	switch (id) {
+	case MID_SUBSCRIBE_EVENTS_NP:
+		err = send_subscription(node);
+		break;
+	default:
+		err = pmc_send_get_action(node->pmc, id);
+		break;
+	}
+	if (err < 0) {
+		return err;
+	}
+	req->sequence_id = pmc_last_sequence_id(node->pmc);
+	req->id = id;
+	req->sent = ts;
+	req->active = true;
+	return 0;
+}
+
+static void process_msg(struct pmc_agent *node, struct ptp_message *msg)
+{
+	struct pmc_request *req;
+	int res;
+
+	if (!check_clock_identity(node, msg)) {
+		return;
+	}
+	res = is_msg_mgt(msg);
+	if (!res) {
+		return;
+	}
+	req = request_find(node, msg->header.sequenceId);
+	if (res < 0) {
+		if (req) {
+			pr_debug("management request 0x%04x failed", req->id);
+			req->active = false;
+		}
+		return;
+	}
+	if (!req || management_tlv_id(msg) != req->id) {
+		/* A push notification. */
+		node->recv_subscribed(node->recv_context, msg, -1);
+		return;
+	}
+	req->active = false;
+
+	switch (req->id) {
+	case MID_TIME_PROPERTIES_DATA_SET:
+		update_utc_offset(node, management_tlv_data(msg));
+		node->pmc_last_update = req->sent;
+		break;
+	}
+}
+
 int run_pmc_wait_sync(struct pmc_agent *node, int timeout)
 {
 	struct ptp_message *msg;
@@ -267,6 +496,7 @@ void pmc_agent_destroy(struct pmc_agent *agent)
 	if (agent->pmc) {
 		pmc_destroy(agent->pmc);
 	}
+	free(agent->port_stats);
 	free(agent);
 }
 
@@ -283,11 +513,32 @@ int pmc_agent_get_leap(struct pmc_agent *agent)
 	return agent->leap;
 }
 
+int pmc_agent_get_port_stats(struct pmc_agent *agent, unsigned int port,
+			     struct PortStats *stats,
+			     struct PortServiceStats *service_stats)
+{
+	uint64_t *value;
+
+	if (!port || port > agent->num_port_stats) {
+		return -ENOENT;
+	}
+	value = agent->port_stats[port - 1];
+	memcpy(stats, value, sizeof(*stats));
+	memcpy(service_stats, value + sizeof(*stats) / sizeof(uint64_t),
+	       sizeof(*service_stats));
+	return 0;
+}
+
 int pmc_agent_get_sync_offset(struct pmc_agent *agent)
 {
 	return agent->sync_offset;
 }
 
+int pmc_agent_get_fd(struct pmc_agent *agent)
+{
+	return agent->pmc ? pmc_get_transport_fd(agent->pmc) : -1;
+}
+
 int pmc_agent_get_number_ports(struct pmc_agent *node)
 {
 	if (!node->dds_valid) {
@@ -296,6 +547,39 @@ int pmc_agent_get_number_ports(struct pmc_agent *node)
 	return node->dds.numberPorts;
 }
 
+int pmc_agent_process(struct pmc_agent *node)
+{
+	struct ptp_message *msg;
+	struct pollfd pollfd;
+	int cnt;
+
+	if (!node->pmc) {
+		return 0;
+	}
+	pollfd.fd = pmc_get_transport_fd(node->pmc);
+	pollfd.events = POLLIN | POLLPRI;
+
+	while (1) {
+		cnt = poll(&pollfd, 1, 0);
+		if (cnt < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_err("poll failed");
+			return -errno;
+		}
+		if (!cnt || !(pollfd.revents & (POLLIN | POLLPRI))) {
+			return 0;
+		}
+		msg = pmc_recv(node->pmc);
+		if (!msg) {
+			continue;
+		}
+		process_msg(node, msg);
+		msg_put(msg);
+	}
+}
+
 int pmc_agent_query_dds(struct pmc_agent *node, int timeout)
 {
 	struct ptp_message *msg;
@@ -366,9 +650,43 @@ out:
 	return run_pmc_err2errno(res);
 }
 
+int pmc_agent_query_port_stats(struct pmc_agent *node, int timeout)
+{
+	struct port_stats_bulk_np *psb;
+	UInteger32 generation = 0;
+	struct ptp_message *msg;
+	int err, res;
+
+	node->stats_first_port = 0;
+	do {
+		res = run_pmc(node, timeout, MID_PORT_STATS_BULK_NP, &msg);
+		if (is_run_pmc_error(res)) {
+			node->stats_first_port = 0;
+			return run_pmc_err2errno(res);
+		}
+		psb = management_tlv_data(msg);
+		/*
+		 * Anything that changes while the later parts are being
+		 * fetched has a newer generation than the first part.
+		 */
+		if (!generation) {
+			generation = psb->generation;
+		}
+		err = update_port_stats(node, psb);
+		node->stats_first_port = psb->first_port;
+		msg_put(msg);
+		if (err) {
+			node->stats_first_port = 0;
+			return err;
+		}
+	} while (node->stats_first_port);
+
+	node->stats_generation = generation;
+	return 0;
+}
+
 int pmc_agent_query_utc_offset(struct pmc_agent *node, int timeout)
 {
-	struct timePropertiesDS *tds;
 	struct ptp_message *msg;
 	int res;
 
@@ -376,27 +694,19 @@ int pmc_agent_query_utc_offset(struct pmc_agent *node, int timeout)
 	if (is_run_pmc_error(res)) {
 		return run_pmc_err2errno(res);
 	}
-
-	tds = (struct timePropertiesDS *) management_tlv_data(msg);
-	if (tds->flags & PTP_TIMESCALE) {
-		node->sync_offset = tds->currentUtcOffset;
-		if (tds->flags & LEAP_61)
-			node->leap = 1;
-		else if (tds->flags & LEAP_59)
-			node->leap = -1;
-		else
-			node->leap = 0;
-		node->utc_offset_traceable = tds->flags & UTC_OFF_VALID &&
-					     tds->flags & TIME_TRACEABLE;
-	} else {
-		node->sync_offset = 0;
-		node->leap = 0;
-		node->utc_offset_traceable = 0;
-	}
+	update_utc_offset(node, management_tlv_data(msg));
 	msg_put(msg);
 	return 0;
 }
 
+int pmc_agent_request_utc_offset(struct pmc_agent *node)
+{
+	if (!node->pmc) {
+		return -ENODEV;
+	}
+	return request_send(node, MID_TIME_PROPERTIES_DATA_SET);
+}
+
 void pmc_agent_set_sync_offset(struct pmc_agent *agent, int offset)
 {
 	agent->sync_offset = offset;
@@ -413,31 +723,26 @@ int pmc_agent_subscribe(struct pmc_agent *node, int timeout, int interval)
 
 int pmc_agent_update(struct pmc_agent *node)
 {
-	struct ptp_message *msg;
-	struct timespec tp;
 	uint64_t ts;
+	int err;
 
 	if (!node->pmc) {
 		return 0;
 	}
-	if (clock_gettime(CLOCK_MONOTONIC, &tp)) {
-		pr_err("failed to read clock: %m");
-		return -errno;
+	err = monotonic_ns(&ts);
+	if (err) {
+		return err;
 	}
-	ts = tp.tv_sec * NS_PER_SEC + tp.tv_nsec;
+	request_expire(node, ts);
 
 	if (ts - node->pmc_last_update >= node->update_interval) {
 		if (node->stay_subscribed) {
-			renew_subscription(node, 0);
-		}
-		if (!pmc_agent_query_utc_offset(node, 0)) {
-			node->pmc_last_update = ts;
+			request_send(node, MID_SUBSCRIBE_EVENTS_NP);
 		}
+		request_send(node, MID_TIME_PROPERTIES_DATA_SET);
 	}
 
-	run_pmc(node, 0, -1, &msg);
-
-	return 0;
+	return pmc_agent_process(node);
 }
 
 int pmc_agent_is_subscribed(struct pmc_agent *agent)
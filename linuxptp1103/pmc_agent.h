@@ -54,6 +54,16 @@ void pmc_agent_destroy(struct pmc_agent *agent);
  */
 void pmc_agent_disable(struct pmc_agent *agent);
 
+/**
+ * Gets the file descriptor of the connection to the ptp4l service, so
+ * that the caller can wait for it in its own event loop. Whenever it
+ * becomes readable, the caller should invoke @ref pmc_agent_process().
+ *
+ * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
+ * @return       The file descriptor, or -1 if the agent is not connected.
+ */
+int pmc_agent_get_fd(struct pmc_agent *agent);
+
 /**
  * Gets the current leap adjustment.
  * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
@@ -71,6 +81,21 @@ int pmc_agent_get_leap(struct pmc_agent *agent);
  */
 int pmc_agent_get_number_ports(struct pmc_agent *agent);
 
+/**
+ * Gets the counters of a port as of the last call to
+ * @ref pmc_agent_query_port_stats().
+ *
+ * @param agent          Pointer to a PMC instance obtained via
+ *                       @ref pmc_agent_create().
+ * @param port           The port number of interest.
+ * @param stats          Buffer to hold the message counters.
+ * @param service_stats  Buffer to hold the service counters.
+ * @return               Zero on success, or -ENOENT if the port is unknown.
+ */
+int pmc_agent_get_port_stats(struct pmc_agent *agent, unsigned int port,
+			     struct PortStats *stats,
+			     struct PortServiceStats *service_stats);
+
 /**
  * Gets the TAI-UTC offset.
  * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
@@ -78,6 +103,20 @@ int pmc_agent_get_number_ports(struct pmc_agent *agent);
  */
 int pmc_agent_get_sync_offset(struct pmc_agent *agent);
 
+/**
+ * Processes the messages waiting on the connection to the ptp4l service
+ * without blocking.
+ *
+ * Responses to the requests sent by @ref pmc_agent_update() and
+ * @ref pmc_agent_request_utc_offset() are matched by their sequenceId,
+ * and any other message is passed to the port state notification
+ * callback.
+ *
+ * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
+ * @return       Zero on success, negative error code otherwise.
+ */
+int pmc_agent_process(struct pmc_agent *agent);
+
 /**
  * Queries the local clock's default data set from the ptp4l service.
  * The result of the query will be cached inside of the agent.
@@ -113,6 +152,22 @@ int pmc_agent_query_port_properties(struct pmc_agent *agent, int timeout,
 				    int *tstamping, int *phc_index,
 				    char *iface);
 
+/**
+ * Brings the cached counters of all ports up to date, using the bulk
+ * statistics of the ptp4l service. Only the counters that changed since
+ * the previous call are transferred, which makes it cheap enough to call
+ * every second, even with many ports.
+ *
+ * In addition:
+ *
+ * - The port state notification callback might be invoked.
+ *
+ * @param agent    Pointer to a PMC instance obtained via @ref pmc_agent_create().
+ * @param timeout  Transmit and receive timeout in milliseconds.
+ * @return         Zero on success, negative error code otherwise.
+ */
+int pmc_agent_query_port_stats(struct pmc_agent *agent, int timeout);
+
 /**
  * Queries the TAI-UTC offset and the current leap adjustment from the
  * ptp4l service.
@@ -127,6 +182,16 @@ int pmc_agent_query_port_properties(struct pmc_agent *agent, int timeout,
  */
 int pmc_agent_query_utc_offset(struct pmc_agent *agent, int timeout);
 
+/**
+ * Asks the local ptp4l instance for the TAI-UTC offset and the leap
+ * second flags without waiting for the response, which is handled by
+ * @ref pmc_agent_process().
+ *
+ * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
+ * @return       Zero on success, negative error code otherwise.
+ */
+int pmc_agent_request_utc_offset(struct pmc_agent *agent);
+
 /**
  * Sets the TAI-UTC offset.
  * @param agent  Pointer to a PMC instance obtained via @ref pmc_agent_create().
@@ -155,6 +220,10 @@ int pmc_agent_subscribe(struct pmc_agent *agent, int timeout, int interval);
  * - Any active port state subscription will be renewed.
  * - The port state notification callback might be invoked.
  *
+ * This function never blocks. The queries are sent without waiting,
+ * and their responses are handled by this function or by
+ * @ref pmc_agent_process(), whichever runs first after they arrive.
+ *
  * This function should be called periodically at least once per
  * minute to keep both the port state and the leap second flags up to
  * date.  Note that the PMC agent rate limits the query to once per
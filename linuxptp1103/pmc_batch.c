@@ -0,0 +1,694 @@
+/**
+ * @file pmc_batch.c
+ * @brief Queries many PTP instances at once and prints JSON lines.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * All of the targets are served by a single poll loop over non-blocking
+ * sockets, so that a slow or dead target only costs its own time limit.
+ * Every UDS target has a socket of its own. The UDP targets of one
+ * address family share a socket and are told apart by the source
+ * address of the responses. The responses of a target are matched to
+ * its requests by sequenceId and management ID.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pmc_batch.h"
+#include "pmc_common.h"
+#include "print.h"
+#include "tlv.h"
+#include "util.h"
+
+/* Number of targets that have requests in flight at any one time. */
+#define BATCH_WINDOW	256
+/*
+ * A port level GET is answered once by every port, so a target is
+ * complete once each request has an answer and the socket was quiet
+ * for this long, in milliseconds.
+ */
+#define BATCH_QUIET	10
+
+enum batch_state {
+	BATCH_PENDING,
+	BATCH_ACTIVE,
+	BATCH_DONE,
+};
+
+struct batch_command {
+	int code;
+	const char *name;
+};
+
+struct batch_request {
+	UInteger16 seq;
+	int sent;
+	int answers;
+};
+
+struct batch_target {
+	char *name;
+	enum batch_state state;
+	enum transport_type type;
+	struct address addr;
+	struct pmc *pmc;
+	struct batch_request *req;
+	int next;
+	int64_t deadline;
+	int64_t last_rx;
+	const char *error;
+	char *buf;
+	size_t len;
+	FILE *out;
+	int n_out;
+};
+
+struct pmc_batch {
+	struct config *cfg;
+	char *iface_name;
+	UInteger8 boundary_hops;
+	UInteger8 domain_number;
+	UInteger8 transport_specific;
+	UInteger8 allow_unauth;
+	int zero_datalen;
+	int timeout;
+	pmc_batch_show_t *show;
+	struct pmc *udp4;
+	struct pmc *udp6;
+	struct batch_target *target;
+	int n_targets;
+	struct batch_command *cmd;
+	int n_cmds;
+	FILE *fp;
+};
+
+static int64_t batch_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static const char *batch_error_string(int error)
+{
+	switch (error) {
+	case MID_RESPONSE_TOO_BIG:
+		return "RESPONSE_TOO_BIG";
+	case MID_NO_SUCH_ID:
+		return "NO_SUCH_ID";
+	case MID_WRONG_LENGTH:
+		return "WRONG_LENGTH";
+	case MID_WRONG_VALUE:
+		return "WRONG_VALUE";
+	case MID_NOT_SETABLE:
+		return "NOT_SETABLE";
+	case MID_NOT_SUPPORTED:
+		return "NOT_SUPPORTED";
+	case MID_GENERAL_ERROR:
+		return "GENERAL_ERROR";
+	}
+	return "unknown";
+}
+
+static void json_string(FILE *fp, const char *s, size_t len)
+{
+	unsigned char c;
+	size_t i;
+
+	fputc('"', fp);
+	for (i = 0; i < len; i++) {
+		c = s[i];
+		if (c == '"' || c == '\\') {
+			fprintf(fp, "\\%c", c);
+		} else if (c < 0x20) {
+			fprintf(fp, "\\u%04x", c);
+		} else {
+			fputc(c, fp);
+		}
+	}
+	fputc('"', fp);
+}
+
+static int json_number(const char *s, size_t len)
+{
+	const char *end = s + len;
+
+	if (s < end && *s == '-') {
+		s++;
+	}
+	if (s == end || *s < '0' || *s > '9') {
+		return 0;
+	}
+	if (*s == '0' && s + 1 < end && s[1] >= '0' && s[1] <= '9') {
+		return 0;
+	}
+	while (s < end && *s >= '0' && *s <= '9') {
+		s++;
+	}
+	if (s < end && *s == '.') {
+		if (++s == end || *s < '0' || *s > '9') {
+			return 0;
+		}
+		while (s < end && *s >= '0' && *s <= '9') {
+			s++;
+		}
+	}
+	if (s < end && (*s == 'e' || *s == 'E')) {
+		s++;
+		if (s < end && (*s == '+' || *s == '-')) {
+			s++;
+		}
+		if (s == end || *s < '0' || *s > '9') {
+			return 0;
+		}
+		while (s < end && *s >= '0' && *s <= '9') {
+			s++;
+		}
+	}
+	return s == end;
+}
+
+/*
+ * Turns the text of a response, a header line followed by lines of
+ * "key value", into the members of a JSON object.
+ */
+static void json_data(FILE *fp, const char *text)
+{
+	const char *key, *val, *end;
+	size_t klen, vlen;
+	int n = 0;
+
+	text = strchr(text, '\n');
+	while (text && *text) {
+		text++;
+		end = strchr(text, '\n');
+		if (!end) {
+			end = text + strlen(text);
+		}
+		key = text;
+		while (key < end && (*key == '\t' || *key == ' ')) {
+			key++;
+		}
+		for (klen = 0; key + klen < end && key[klen] != ' '; klen++)
+			;
+		val = key + klen;
+		while (val < end && *val == ' ') {
+			val++;
+		}
+		vlen = end - val;
+		while (vlen && val[vlen - 1] == ' ') {
+			vlen--;
+		}
+		if (klen) {
+			fprintf(fp, "%s", n++ ? "," : "");
+			json_string(fp, key, klen);
+			fputc(':', fp);
+			if (json_number(val, vlen)) {
+				fwrite(val, 1, vlen, fp);
+			} else {
+				json_string(fp, val, vlen);
+			}
+		}
+		text = *end ? end : NULL;
+	}
+}
+
+static int batch_nonblock(struct pmc *pmc)
+{
+	int fd = pmc_get_transport_fd(pmc), flags;
+
+	flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		pr_err("failed to make socket non-blocking: %m");
+		return -1;
+	}
+	return 0;
+}
+
+static struct pmc *batch_pmc_create(struct pmc_batch *b,
+				    enum transport_type type,
+				    const char *iface_name, const char *remote)
+{
+	struct pmc *pmc;
+
+	pmc = pmc_create(b->cfg, type, iface_name, remote, b->boundary_hops,
+			 b->domain_number, b->transport_specific,
+			 b->allow_unauth, b->zero_datalen);
+	if (!pmc) {
+		return NULL;
+	}
+	if (batch_nonblock(pmc)) {
+		pmc_destroy(pmc);
+		return NULL;
+	}
+	return pmc;
+}
+
+static struct pmc **batch_udp(struct pmc_batch *b, enum transport_type type)
+{
+	return type == TRANS_UDP_IPV4 ? &b->udp4 : &b->udp6;
+}
+
+static int batch_same_host(struct address *a, struct address *b)
+{
+	if (a->sa.sa_family != b->sa.sa_family) {
+		return 0;
+	}
+	switch (a->sa.sa_family) {
+	case AF_INET:
+		return !memcmp(&a->sin.sin_addr, &b->sin.sin_addr,
+			       sizeof(a->sin.sin_addr));
+	case AF_INET6:
+		return !memcmp(&a->sin6.sin6_addr, &b->sin6.sin6_addr,
+			       sizeof(a->sin6.sin6_addr));
+	}
+	return 0;
+}
+
+struct pmc_batch *pmc_batch_create(struct config *cfg, const char *iface_name,
+				   UInteger8 boundary_hops,
+				   UInteger8 domain_number,
+				   UInteger8 transport_specific,
+				   UInteger8 allow_unauth, int zero_datalen,
+				   int timeout, pmc_batch_show_t *show)
+{
+	struct pmc_batch *b;
+
+	b = calloc(1, sizeof(*b));
+	if (!b) {
+		return NULL;
+	}
+	b->iface_name = strdup(iface_name);
+	if (!b->iface_name) {
+		free(b);
+		return NULL;
+	}
+	b->cfg = cfg;
+	b->boundary_hops = boundary_hops;
+	b->domain_number = domain_number;
+	b->transport_specific = transport_specific;
+	b->allow_unauth = allow_unauth;
+	b->zero_datalen = zero_datalen;
+	b->timeout = timeout;
+	b->show = show;
+	return b;
+}
+
+static void batch_target_release(struct batch_target *t)
+{
+	if (t->out) {
+		fclose(t->out);
+		t->out = NULL;
+	}
+	free(t->buf);
+	t->buf = NULL;
+	if (t->pmc && t->type == TRANS_UDS) {
+		pmc_destroy(t->pmc);
+	}
+	t->pmc = NULL;
+	free(t->req);
+	t->req = NULL;
+}
+
+void pmc_batch_destroy(struct pmc_batch *b)
+{
+	int i;
+
+	for (i = 0; i < b->n_targets; i++) {
+		batch_target_release(&b->target[i]);
+		free(b->target[i].name);
+	}
+	if (b->udp4) {
+		pmc_destroy(b->udp4);
+	}
+	if (b->udp6) {
+		pmc_destroy(b->udp6);
+	}
+	free(b->target);
+	free(b->cmd);
+	free(b->iface_name);
+	free(b);
+}
+
+int pmc_batch_add_target(struct pmc_batch *b, const char *target)
+{
+	struct batch_target *t;
+
+	t = realloc(b->target, (b->n_targets + 1) * sizeof(*t));
+	if (!t) {
+		return -1;
+	}
+	b->target = t;
+	t = &b->target[b->n_targets];
+	memset(t, 0, sizeof(*t));
+
+	if (target[0] == '/') {
+		if (strlen(target) > MAX_IFNAME_SIZE) {
+			pr_err("path %s too long, max is %d",
+			       target, MAX_IFNAME_SIZE);
+			return -1;
+		}
+		t->type = TRANS_UDS;
+	} else {
+		t->type = strchr(target, ':') ? TRANS_UDP_IPV6 : TRANS_UDP_IPV4;
+		if (str2addr(t->type, target, &t->addr)) {
+			return -1;
+		}
+	}
+	t->name = strdup(target);
+	if (!t->name) {
+		return -1;
+	}
+	b->n_targets++;
+	return 0;
+}
+
+int pmc_batch_add_command(struct pmc_batch *b, const char *command)
+{
+	struct batch_command *cmd;
+
+	cmd = realloc(b->cmd, (b->n_cmds + 1) * sizeof(*cmd));
+	if (!cmd) {
+		return -1;
+	}
+	b->cmd = cmd;
+	cmd = &b->cmd[b->n_cmds];
+	if (pmc_parse_get(command, &cmd->code, &cmd->name)) {
+		return -1;
+	}
+	b->n_cmds++;
+	return 0;
+}
+
+static void batch_finish(struct pmc_batch *b, struct batch_target *t,
+			 const char *status)
+{
+	fclose(t->out);
+	t->out = NULL;
+
+	fprintf(b->fp, "{\"target\":");
+	json_string(b->fp, t->name, strlen(t->name));
+	fprintf(b->fp, ",\"status\":\"%s\"", status);
+	if (t->error) {
+		fprintf(b->fp, ",\"error\":");
+		json_string(b->fp, t->error, strlen(t->error));
+	}
+	fprintf(b->fp, ",\"responses\":[");
+	fwrite(t->buf, 1, t->len, b->fp);
+	fprintf(b->fp, "]}\n");
+	fflush(b->fp);
+
+	batch_target_release(t);
+	t->state = BATCH_DONE;
+}
+
+static int batch_activate(struct pmc_batch *b, struct batch_target *t,
+			  int index, int64_t now)
+{
+	char local[MAX_IFNAME_SIZE + 1];
+	struct pmc **udp;
+
+	t->state = BATCH_ACTIVE;
+	t->deadline = now + b->timeout;
+	t->out = open_memstream(&t->buf, &t->len);
+	t->req = calloc(b->n_cmds, sizeof(*t->req));
+	if (!t->out || !t->req) {
+		t->error = "out of memory";
+		return -1;
+	}
+	if (t->type == TRANS_UDS) {
+		snprintf(local, sizeof(local), "/var/run/pmc.%d.%d",
+			 getpid(), index);
+		t->pmc = batch_pmc_create(b, TRANS_UDS, local, t->name);
+	} else {
+		udp = batch_udp(b, t->type);
+		if (!*udp) {
+			*udp = batch_pmc_create(b, t->type, b->iface_name, NULL);
+		}
+		t->pmc = *udp;
+	}
+	if (!t->pmc) {
+		t->error = "failed to create pmc";
+		return -1;
+	}
+	return 0;
+}
+
+/* Sends the requests of a target until the socket is full. */
+static int batch_send(struct pmc_batch *b, struct batch_target *t)
+{
+	int err;
+
+	while (t->next < b->n_cmds) {
+		err = pmc_send_get_action_to(t->pmc, b->cmd[t->next].code,
+					     t->type == TRANS_UDS ? NULL : &t->addr);
+		if (err == -EAGAIN || err == -EWOULDBLOCK) {
+			return 0;
+		}
+		if (err) {
+			t->error = strerror(-err);
+			return -1;
+		}
+		t->req[t->next].seq = pmc_last_sequence_id(t->pmc);
+		t->req[t->next].sent = 1;
+		t->next++;
+	}
+	return 0;
+}
+
+static struct batch_target *batch_lookup(struct pmc_batch *b,
+					 struct pmc *pmc,
+					 struct ptp_message *msg)
+{
+	struct batch_target *t;
+	int i;
+
+	for (i = 0; i < b->n_targets; i++) {
+		t = &b->target[i];
+		if (t->state != BATCH_ACTIVE || t->pmc != pmc) {
+			continue;
+		}
+		if (t->type == TRANS_UDS ||
+		    batch_same_host(&t->addr, &msg->address)) {
+			return t;
+		}
+	}
+	return NULL;
+}
+
+static void batch_response(struct pmc_batch *b, struct batch_target *t,
+			   int index, struct ptp_message *msg, int error)
+{
+	char *text = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	fprintf(t->out, "%s{\"id\":\"%s\",\"source\":\"%s\",\"seq\":%hu",
+		t->n_out++ ? "," : "", b->cmd[index].name,
+		pid2str(&msg->header.sourcePortIdentity),
+		msg->header.sequenceId);
+	if (error) {
+		fprintf(t->out, ",\"error\":\"%s\"}",
+			batch_error_string(error));
+		return;
+	}
+	fp = open_memstream(&text, &len);
+	if (!fp) {
+		fprintf(t->out, ",\"data\":{}}");
+		return;
+	}
+	b->show(msg, fp);
+	fclose(fp);
+	fprintf(t->out, ",\"data\":{");
+	json_data(t->out, text);
+	fprintf(t->out, "}}");
+	free(text);
+}
+
+static void batch_receive(struct pmc_batch *b, struct pmc *pmc, int64_t now)
+{
+	struct management_error_status *mes;
+	struct management_tlv *mgt;
+	struct batch_target *t;
+	struct ptp_message *msg;
+	int i, id, error = 0;
+	struct TLV *tlv;
+
+	msg = pmc_recv(pmc);
+	if (!msg) {
+		return;
+	}
+	if (msg_type(msg) != MANAGEMENT ||
+	    management_action(msg) != RESPONSE || !msg_tlv_count(msg)) {
+		goto out;
+	}
+	tlv = (struct TLV *) msg->management.suffix;
+	if (tlv->type == TLV_MANAGEMENT) {
+		mgt = (struct management_tlv *) tlv;
+		id = mgt->id;
+	} else if (tlv->type == TLV_MANAGEMENT_ERROR_STATUS) {
+		mes = (struct management_error_status *) tlv;
+		id = mes->id;
+		error = mes->error;
+	} else {
+		goto out;
+	}
+	t = batch_lookup(b, pmc, msg);
+	if (!t) {
+		goto out;
+	}
+	for (i = 0; i < b->n_cmds; i++) {
+		if (t->req[i].sent && t->req[i].seq == msg->header.sequenceId &&
+		    b->cmd[i].code == id) {
+			break;
+		}
+	}
+	if (i == b->n_cmds) {
+		goto out;
+	}
+	t->req[i].answers++;
+	t->last_rx = now;
+	batch_response(b, t, i, msg, error);
+out:
+	msg_put(msg);
+}
+
+static int batch_complete(struct pmc_batch *b, struct batch_target *t)
+{
+	int i;
+
+	if (t->next < b->n_cmds) {
+		return 0;
+	}
+	for (i = 0; i < b->n_cmds; i++) {
+		if (!t->req[i].answers) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Returns the time at which a target needs attention. */
+static int64_t batch_expiry(struct pmc_batch *b, struct batch_target *t)
+{
+	if (batch_complete(b, t) && t->last_rx + BATCH_QUIET < t->deadline) {
+		return t->last_rx + BATCH_QUIET;
+	}
+	return t->deadline;
+}
+
+static void batch_add_pollfd(struct pollfd *pfd, struct pmc **owner, int *n,
+			     struct pmc *pmc, int pollout)
+{
+	int i;
+
+	for (i = 0; i < *n; i++) {
+		if (owner[i] == pmc) {
+			break;
+		}
+	}
+	if (i == *n) {
+		pfd[i].fd = pmc_get_transport_fd(pmc);
+		pfd[i].events = POLLIN | POLLPRI;
+		owner[i] = pmc;
+		(*n)++;
+	}
+	if (pollout) {
+		pfd[i].events |= POLLOUT;
+	}
+}
+
+int pmc_batch_run(struct pmc_batch *b, FILE *fp)
+{
+	int i, j, cnt, n, tmo, active = 0, done = 0, next = 0, err = 0;
+	struct batch_target *t;
+	struct pollfd *pfd;
+	struct pmc **owner;
+	int64_t now, when;
+
+	b->fp = fp;
+	pfd = calloc(BATCH_WINDOW, sizeof(*pfd));
+	owner = calloc(BATCH_WINDOW, sizeof(*owner));
+	if (!pfd || !owner) {
+		free(pfd);
+		free(owner);
+		return -1;
+	}
+
+	while (done < b->n_targets && is_running()) {
+		now = batch_now();
+		while (active < BATCH_WINDOW && next < b->n_targets) {
+			t = &b->target[next];
+			if (batch_activate(b, t, next, now)) {
+				batch_finish(b, t, "error");
+				done++;
+			} else {
+				active++;
+			}
+			next++;
+		}
+
+		n = 0;
+		when = -1;
+		for (i = 0; i < next; i++) {
+			t = &b->target[i];
+			if (t->state != BATCH_ACTIVE) {
+				continue;
+			}
+			batch_add_pollfd(pfd, owner, &n, t->pmc,
+					 t->next < b->n_cmds);
+			if (when < 0 || batch_expiry(b, t) < when) {
+				when = batch_expiry(b, t);
+			}
+		}
+		tmo = when < 0 ? 0 : when > now ? when - now : 0;
+
+		cnt = poll(pfd, n, tmo);
+		if (cnt < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			pr_err("poll failed: %m");
+			err = -1;
+			break;
+		}
+		now = batch_now();
+
+		for (j = 0; cnt > 0 && j < n; j++) {
+			if (pfd[j].revents & POLLOUT) {
+				for (i = 0; i < next; i++) {
+					t = &b->target[i];
+					if (t->state == BATCH_ACTIVE &&
+					    t->pmc == owner[j] &&
+					    batch_send(b, t)) {
+						batch_finish(b, t, "error");
+						active--;
+						done++;
+					}
+				}
+			}
+			if (pfd[j].revents & (POLLIN | POLLPRI)) {
+				batch_receive(b, owner[j], now);
+			}
+		}
+
+		for (i = 0; i < next; i++) {
+			t = &b->target[i];
+			if (t->state != BATCH_ACTIVE || batch_expiry(b, t) > now) {
+				continue;
+			}
+			batch_finish(b, t, batch_complete(b, t) ? "ok" : "timeout");
+			active--;
+			done++;
+		}
+	}
+
+	free(pfd);
+	free(owner);
+	return err;
+}
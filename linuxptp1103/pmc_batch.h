@@ -0,0 +1,75 @@
+/**
+ * @file pmc_batch.h
+ * @brief Queries many PTP instances at once and prints JSON lines.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_PMC_BATCH_H
+#define HAVE_PMC_BATCH_H
+
+#include <stdio.h>
+
+#include "config.h"
+#include "msg.h"
+
+struct pmc_batch;
+
+/**
+ * Formats a management response as text, one "key value" pair per line.
+ * @param msg  The response.
+ * @param fp   Stream receiving the text.
+ */
+typedef void pmc_batch_show_t(struct ptp_message *msg, FILE *fp);
+
+/**
+ * Creates a new batch.
+ *
+ * @param cfg                 Configuration used for the sockets.
+ * @param iface_name          Network interface used for the UDP targets.
+ * @param boundary_hops       The boundaryHops field of the requests.
+ * @param domain_number       The domainNumber field of the requests.
+ * @param transport_specific  The transportSpecific field, upper nibble.
+ * @param allow_unauth        Accept responses without authentication.
+ * @param zero_datalen        Send zero length TLV values with GET.
+ * @param timeout             Time limit of each target, in milliseconds.
+ * @param show                Formats the data of the responses.
+ * @return                    Pointer to a new batch on success, NULL otherwise.
+ */
+struct pmc_batch *pmc_batch_create(struct config *cfg, const char *iface_name,
+				   UInteger8 boundary_hops,
+				   UInteger8 domain_number,
+				   UInteger8 transport_specific,
+				   UInteger8 allow_unauth, int zero_datalen,
+				   int timeout, pmc_batch_show_t *show);
+
+/**
+ * Destroys a batch.
+ * @param b  A pointer obtained via @ref pmc_batch_create().
+ */
+void pmc_batch_destroy(struct pmc_batch *b);
+
+/**
+ * Adds a target to a batch.
+ * @param b       A pointer obtained via @ref pmc_batch_create().
+ * @param target  An absolute UDS path, or an IPv4 or IPv6 address.
+ * @return        Zero on success, non-zero otherwise.
+ */
+int pmc_batch_add_target(struct pmc_batch *b, const char *target);
+
+/**
+ * Adds a command to a batch. Only GET commands are supported.
+ * @param b        A pointer obtained via @ref pmc_batch_create().
+ * @param command  A command like "GET CURRENT_DATA_SET".
+ * @return         Zero on success, non-zero otherwise.
+ */
+int pmc_batch_add_command(struct pmc_batch *b, const char *command);
+
+/**
+ * Sends every command to every target and prints one JSON object per
+ * target as soon as the target has answered or timed out.
+ * @param b   A pointer obtained via @ref pmc_batch_create().
+ * @param fp  Stream receiving the JSON lines.
+ * @return    Zero on success, non-zero otherwise.
+ */
+int pmc_batch_run(struct pmc_batch *b, FILE *fp);
+
+#endif
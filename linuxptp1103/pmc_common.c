@@ -78,8 +78,11 @@
 
 static void do_get_action(struct pmc *pmc, int action, int index, char *str);
 static void do_set_action(struct pmc *pmc, int action, int index, char *str);
+static void do_stats_bulk_action(struct pmc *pmc, int action, int index,
+				 char *str);
 static void not_supported(struct pmc *pmc, int action, int index, char *str);
 static void null_management(struct pmc *pmc, int action, int index, char *str);
+static void do_command_action(struct pmc *pmc, int action, int index, char *str);
 
 static const char *action_string[] = {
 	"GET",
@@ -132,6 +135,8 @@ struct management_id idtab[] = {
 	{ "GRANDMASTER_SETTINGS_NP", MID_GRANDMASTER_SETTINGS_NP, do_set_action },
 	{ "SUBSCRIBE_EVENTS_NP", MID_SUBSCRIBE_EVENTS_NP, do_set_action },
 	{ "SYNCHRONIZATION_UNCERTAIN_NP", MID_SYNCHRONIZATION_UNCERTAIN_NP, do_set_action },
+	{ "CLOCK_STATS_NP", MID_CLOCK_STATS_NP, do_get_action },
+	{ "SERVO_GAINS_NP", MID_SERVO_GAINS_NP, do_get_action },
 /* Port management ID values */
 	{ "NULL_MANAGEMENT", MID_NULL_MANAGEMENT, null_management },
 	{ "CLOCK_DESCRIPTION", MID_CLOCK_DESCRIPTION, do_get_action },
@@ -154,6 +159,11 @@ struct management_id idtab[] = {
 	{ "PORT_PROPERTIES_NP", MID_PORT_PROPERTIES_NP, do_get_action },
 	{ "PORT_STATS_NP", MID_PORT_STATS_NP, do_get_action },
 	{ "PORT_SERVICE_STATS_NP", MID_PORT_SERVICE_STATS_NP, do_get_action },
+	{ "PORT_STATS_BULK_NP", MID_PORT_STATS_BULK_NP, do_stats_bulk_action },
+	{ "PORT_RATE_STATS_NP", MID_PORT_RATE_STATS_NP, do_get_action },
+	{ "PORT_TLV_STATS_NP", MID_PORT_TLV_STATS_NP, do_get_action },
+	{ "PORT_TC_STATS_NP", MID_PORT_TC_STATS_NP, do_get_action },
+	{ "RELOAD_CONFIG_NP", MID_RELOAD_CONFIG_NP, do_command_action },
 	{ "UNICAST_MASTER_TABLE_NP", MID_UNICAST_MASTER_TABLE_NP, do_get_action },
 	{ "PORT_HWCLOCK_NP", MID_PORT_HWCLOCK_NP, do_get_action },
 	{ "POWER_PROFILE_SETTINGS_NP", MID_POWER_PROFILE_SETTINGS_NP, do_set_action },
@@ -403,6 +413,24 @@ static void do_set_action(struct pmc *pmc, int action, int index, char *str)
 	}
 }
 
+static void do_stats_bulk_action(struct pmc *pmc, int action, int index,
+				 char *str)
+{
+	struct port_stats_bulk_np psb;
+
+	if (action != GET) {
+		fprintf(stderr, "%s only allows GET\n", idtab[index].name);
+		return;
+	}
+	memset(&psb, 0, sizeof(psb));
+	sscanf(str, " %*s %*s "
+	       "generation %u "
+	       "first_port %hu ",
+	       &psb.generation,
+	       &psb.first_port);
+	pmc_send_get_data(pmc, idtab[index].code, &psb, sizeof(psb));
+}
+
 static void not_supported(struct pmc *pmc, int action, int index, char *str)
 {
 	fprintf(stdout, "sorry, %s not supported yet\n", idtab[index].name);
@@ -416,6 +444,14 @@ static void null_management(struct pmc *pmc, int action, int index, char *str)
 		puts("non-get actions still todo");
 }
 
+static void do_command_action(struct pmc *pmc, int action, int index, char *str)
+{
+	if (action == COMMAND)
+		pmc_send_command_action(pmc, idtab[index].code);
+	else
+		fprintf(stderr, "%s only allows COMMAND\n", idtab[index].name);
+}
+
 static int parse_action(char *s)
 {
 	int len = strlen(s);
@@ -619,6 +655,10 @@ static int pmc_send(struct pmc *pmc, struct ptp_message *msg)
 		pr_err("msg_pre_send failed");
 		return -1;
 	}
+	if (msg->header.flagField[0] & UNICAST) {
+		return transport_sendto(pmc->transport, &pmc->fdarray,
+					TRANS_GENERAL, msg);
+	}
 	return transport_send(pmc->transport, &pmc->fdarray,
 			      TRANS_GENERAL, msg);
 }
@@ -660,6 +700,12 @@ static int pmc_tlv_datalen(struct pmc *pmc, int id)
 	case MID_TIME_STATUS_NP:
 		len += sizeof(struct time_status_np);
 		break;
+	case MID_CLOCK_STATS_NP:
+		len += sizeof(struct clock_stats_np);
+		break;
+	case MID_SERVO_GAINS_NP:
+		len += sizeof(struct servo_gains_np);
+		break;
 	case MID_ALTERNATE_TIME_OFFSET_ENABLE:
 		len += sizeof(struct management_tlv_datum);
 		break;
@@ -695,6 +741,18 @@ static int pmc_tlv_datalen(struct pmc *pmc, int id)
 	case MID_PORT_SERVICE_STATS_NP:
 		len += sizeof(struct port_service_stats_np);
 		break;
+	case MID_PORT_STATS_BULK_NP:
+		len += sizeof(struct port_stats_bulk_np);
+		break;
+	case MID_PORT_RATE_STATS_NP:
+		len += sizeof(struct port_rate_stats_np);
+		break;
+	case MID_PORT_TLV_STATS_NP:
+		len += sizeof(struct port_tlv_stats_np);
+		break;
+	case MID_PORT_TC_STATS_NP:
+		len += sizeof(struct port_tc_stats_np);
+		break;
 	case MID_UNICAST_MASTER_TABLE_NP:
 		len += EMPTY_UNICAST_MASTER_TABLE_NP;
 		break;
@@ -721,7 +779,12 @@ int pmc_get_transport_fd(struct pmc *pmc)
 	return pmc->fdarray.fd[FD_GENERAL];
 }
 
-int pmc_send_get_action(struct pmc *pmc, int id)
+UInteger16 pmc_last_sequence_id(struct pmc *pmc)
+{
+	return pmc->sequence_id - 1;
+}
+
+static struct ptp_message *pmc_get_message(struct pmc *pmc, int id)
 {
 	int datalen, pdulen;
 	struct ptp_message *msg;
@@ -730,7 +793,7 @@ int pmc_send_get_action(struct pmc *pmc, int id)
 
 	msg = pmc_message(pmc, GET);
 	if (!msg) {
-		return -1;
+		return NULL;
 	}
 	mgt = (struct management_tlv *) msg->management.suffix;
 	mgt->type = TLV_MANAGEMENT;
@@ -744,7 +807,7 @@ int pmc_send_get_action(struct pmc *pmc, int id)
 	if (!extra) {
 		pr_err("failed to allocate TLV descriptor");
 		msg_put(msg);
-		return -ENOMEM;
+		return NULL;
 	}
 	extra->tlv = (struct TLV *) msg->management.suffix;
 	msg_tlv_attach(msg, extra);
@@ -765,19 +828,50 @@ int pmc_send_get_action(struct pmc *pmc, int id)
 		cd->protocolAddress = (struct PortAddress *) buf;
 	}
 
+	return msg;
+}
+
+int pmc_send_get_action(struct pmc *pmc, int id)
+{
+	struct ptp_message *msg;
+
+	msg = pmc_get_message(pmc, id);
+	if (!msg) {
+		return -1;
+	}
 	pmc_send(pmc, msg);
 	msg_put(msg);
 
 	return 0;
 }
 
-int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
+int pmc_send_get_action_to(struct pmc *pmc, int id, struct address *addr)
+{
+	struct ptp_message *msg;
+	int cnt;
+
+	msg = pmc_get_message(pmc, id);
+	if (!msg) {
+		return -ENOMEM;
+	}
+	if (addr) {
+		msg->address = *addr;
+		msg->header.flagField[0] |= UNICAST;
+	}
+	cnt = pmc_send(pmc, msg);
+	msg_put(msg);
+
+	return cnt < 0 ? cnt : 0;
+}
+
+static int pmc_send_data(struct pmc *pmc, int action, int id,
+			 void *data, int datasize)
 {
 	struct management_tlv *mgt;
 	struct ptp_message *msg;
 	struct tlv_extra *extra;
 
-	msg = pmc_message(pmc, SET);
+	msg = pmc_message(pmc, action);
 	if (!msg) {
 		return -1;
 	}
@@ -790,13 +884,30 @@ int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
 	mgt->type = TLV_MANAGEMENT;
 	mgt->length = 2 + datasize;
 	mgt->id = id;
-	memcpy(mgt->data, data, datasize);
+	if (datasize) {
+		memcpy(mgt->data, data, datasize);
+	}
 	pmc_send(pmc, msg);
 	msg_put(msg);
 
 	return 0;
 }
 
+int pmc_send_get_data(struct pmc *pmc, int id, void *data, int datasize)
+{
+	return pmc_send_data(pmc, GET, id, data, datasize);
+}
+
+int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize)
+{
+	return pmc_send_data(pmc, SET, id, data, datasize);
+}
+
+int pmc_send_command_action(struct pmc *pmc, int id)
+{
+	return pmc_send_data(pmc, COMMAND, id, NULL, 0);
+}
+
 int pmc_send_set_aton(struct pmc *pmc, int id, uint8_t key, const char *name)
 {
 	struct alternate_time_offset_name *aton;
@@ -930,6 +1041,23 @@ const char *pmc_action_string(int action)
 	return action_string[action];
 }
 
+int pmc_parse_get(const char *str, int *code, const char **name)
+{
+	char action_str[10+1] = {0}, id_str[64+1] = {0};
+	int id;
+
+	if (2 != sscanf(str, " %10s %64s", action_str, id_str))
+		return -1;
+	if (parse_action(action_str) != GET)
+		return -1;
+	id = parse_id(id_str);
+	if (id < 0)
+		return -1;
+	*code = idtab[id].code;
+	*name = idtab[id].name;
+	return 0;
+}
+
 int pmc_do_command(struct pmc *pmc, char *str)
 {
 	int action, id;
@@ -38,10 +38,18 @@ void pmc_destroy(struct pmc *pmc);
 
 int pmc_get_transport_fd(struct pmc *pmc);
 
+UInteger16 pmc_last_sequence_id(struct pmc *pmc);
+
 int pmc_send_get_action(struct pmc *pmc, int id);
 
+int pmc_send_get_action_to(struct pmc *pmc, int id, struct address *addr);
+
+int pmc_send_get_data(struct pmc *pmc, int id, void *data, int datasize);
+
 int pmc_send_set_action(struct pmc *pmc, int id, void *data, int datasize);
 
+int pmc_send_command_action(struct pmc *pmc, int id);
+
 int pmc_send_set_aton(struct pmc *pmc, int id, uint8_t key, const char *name);
 
 struct ptp_message *pmc_recv(struct pmc *pmc);
@@ -52,5 +60,6 @@ void pmc_target_all(struct pmc *pmc);
 
 const char *pmc_action_string(int action);
 int pmc_do_command(struct pmc *pmc, char *str);
+int pmc_parse_get(const char *str, int *code, const char **name);
 
 #endif
@@ -0,0 +1,242 @@
+/**
+ * @file pollset.c
+ * @brief Waits for events on the descriptors of many fdarrays via epoll.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * Every descriptor is registered with the kernel once, carrying a
+ * pointer to its (owner, index) entry, so a wake up costs time in
+ * proportion to the number of ready descriptors rather than to the
+ * number of ports.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/queue.h>
+
+#include "pollset.h"
+#include "print.h"
+
+#define POLLSET_MAX_EVENTS 64
+
+struct pollset_entry {
+	void *owner;
+	int index;
+	int fd;
+};
+
+struct pollset_source {
+	LIST_ENTRY(pollset_source) list;
+	void *owner;
+	struct pollset_entry entry[N_POLLFD];
+};
+
+struct pollset {
+	int epfd;
+	int spin_usec;
+	LIST_HEAD(source_head, pollset_source) sources;
+	struct epoll_event ev[POLLSET_MAX_EVENTS];
+};
+
+static struct pollset_source *pollset_find(struct pollset *ps, void *owner)
+{
+	struct pollset_source *src;
+
+	LIST_FOREACH(src, &ps->sources, list) {
+		if (src->owner == owner) {
+			return src;
+		}
+	}
+	return NULL;
+}
+
+static void pollset_del(struct pollset *ps, struct pollset_entry *e)
+{
+	/* The kernel already forgot about descriptors that were closed. */
+	epoll_ctl(ps->epfd, EPOLL_CTL_DEL, e->fd, NULL);
+	e->fd = -1;
+}
+
+/*
+ * A descriptor number belongs to one entry at a time. When another entry
+ * still holds the number, the file it registered has been closed, and the
+ * kernel dropped that registration. The stale entry is forgotten without
+ * telling the kernel, so that its owner's next update does not remove the
+ * registration of the new owner.
+ */
+static void pollset_claim(struct pollset *ps, struct pollset_entry *e, int fd)
+{
+	struct pollset_source *src;
+	int i;
+
+	LIST_FOREACH(src, &ps->sources, list) {
+		for (i = 0; i < N_POLLFD; i++) {
+			if (&src->entry[i] != e && src->entry[i].fd == fd) {
+				src->entry[i].fd = -1;
+			}
+		}
+	}
+}
+
+static int pollset_add(struct pollset *ps, struct pollset_entry *e, int fd)
+{
+	struct epoll_event ev;
+
+	pollset_claim(ps, e, fd);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.ptr = e;
+
+	/*
+	 * A descriptor number that did not change may still refer to a
+	 * new file, when the old one was closed and the number reused.
+	 */
+	if (e->fd == fd && !epoll_ctl(ps->epfd, EPOLL_CTL_MOD, fd, &ev)) {
+		return 0;
+	}
+	e->fd = -1;
+	if (epoll_ctl(ps->epfd, EPOLL_CTL_ADD, fd, &ev)) {
+		pr_err("pollset: failed to add descriptor %d: %m", fd);
+		return -1;
+	}
+	e->fd = fd;
+	return 0;
+}
+
+struct pollset *pollset_create(int spin_usec)
+{
+	struct pollset *ps;
+
+	ps = calloc(1, sizeof(*ps));
+	if (!ps) {
+		return NULL;
+	}
+	ps->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (ps->epfd < 0) {
+		pr_err("epoll_create1 failed: %m");
+		free(ps);
+		return NULL;
+	}
+	ps->spin_usec = spin_usec;
+	LIST_INIT(&ps->sources);
+	return ps;
+}
+
+void pollset_destroy(struct pollset *ps)
+{
+	struct pollset_source *src;
+
+	while ((src = LIST_FIRST(&ps->sources)) != NULL) {
+		LIST_REMOVE(src, list);
+		free(src);
+	}
+	close(ps->epfd);
+	free(ps);
+}
+
+int pollset_update(struct pollset *ps, void *owner, struct fdarray *fda)
+{
+	struct pollset_source *src;
+	struct pollset_entry *e;
+	int i, err = 0;
+
+	src = pollset_find(ps, owner);
+	if (!src) {
+		src = calloc(1, sizeof(*src));
+		if (!src) {
+			return -1;
+		}
+		src->owner = owner;
+		for (i = 0; i < N_POLLFD; i++) {
+			src->entry[i].owner = owner;
+			src->entry[i].index = i;
+			src->entry[i].fd = -1;
+		}
+		LIST_INSERT_HEAD(&ps->sources, src, list);
+	}
+	for (i = 0; i < N_POLLFD; i++) {
+		e = &src->entry[i];
+		if (e->fd >= 0 && e->fd != fda->fd[i]) {
+			pollset_del(ps, e);
+		}
+		if (fda->fd[i] >= 0 && pollset_add(ps, e, fda->fd[i])) {
+			err = -1;
+		}
+	}
+	return err;
+}
+
+void pollset_remove(struct pollset *ps, void *owner)
+{
+	struct pollset_source *src;
+	int i;
+
+	src = pollset_find(ps, owner);
+	if (!src) {
+		return;
+	}
+	for (i = 0; i < N_POLLFD; i++) {
+		if (src->entry[i].fd >= 0) {
+			pollset_del(ps, &src->entry[i]);
+		}
+	}
+	LIST_REMOVE(src, list);
+	free(src);
+}
+
+static int64_t pollset_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int pollset_spin(struct pollset *ps, int max, int *timeout)
+{
+	int64_t start = pollset_now_us(), elapsed;
+	int cnt;
+
+	do {
+		cnt = epoll_wait(ps->epfd, ps->ev, max, 0);
+		if (cnt) {
+			return cnt;
+		}
+		elapsed = pollset_now_us() - start;
+	} while (elapsed < ps->spin_usec);
+
+	if (*timeout > 0) {
+		*timeout -= elapsed / 1000;
+		if (*timeout < 0) {
+			*timeout = 0;
+		}
+	}
+	return 0;
+}
+
+int pollset_wait(struct pollset *ps, struct pollset_event *ev, int max,
+		 int timeout)
+{
+	struct pollset_entry *e;
+	int cnt = 0, i;
+
+	if (max > POLLSET_MAX_EVENTS) {
+		max = POLLSET_MAX_EVENTS;
+	}
+	if (ps->spin_usec && timeout) {
+		cnt = pollset_spin(ps, max, &timeout);
+	}
+	if (!cnt) {
+		cnt = epoll_wait(ps->epfd, ps->ev, max, timeout);
+	}
+	for (i = 0; i < cnt; i++) {
+		e = ps->ev[i].data.ptr;
+		ev[i].owner = e->owner;
+		ev[i].index = e->index;
+		ev[i].error = ps->ev[i].events & EPOLLERR ? true : false;
+	}
+	return cnt;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file pollset.h
+ * @brief Waits for events on the descriptors of many fdarrays via epoll.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_POLLSET_H
+#define HAVE_POLLSET_H
+
+#include <stdbool.h>
+
+#include "fd.h"
+
+struct pollset;
+
+/**
+ * A descriptor that became ready.
+ */
+struct pollset_event {
+	/** The owner of the fdarray, as passed to @ref pollset_update(). */
+	void *owner;
+	/** Index of the descriptor within the owner's fdarray. */
+	int index;
+	/** True if an error condition is pending on the descriptor. */
+	bool error;
+};
+
+/**
+ * Creates a new poll set.
+ *
+ * @param spin_usec  How long @ref pollset_wait() keeps checking for
+ *                   events without sleeping, in microseconds. Zero
+ *                   means that it goes to sleep right away.
+ * @return           Pointer to a new poll set on success, NULL otherwise.
+ */
+struct pollset *pollset_create(int spin_usec);
+
+/**
+ * Destroys a poll set.
+ * @param ps  A pointer obtained via @ref pollset_create().
+ */
+void pollset_destroy(struct pollset *ps);
+
+/**
+ * Registers the descriptors of an fdarray, or brings an earlier
+ * registration up to date after descriptors were opened or closed.
+ * Call this whenever the owner's fdarray changes. Negative descriptors
+ * are skipped.
+ *
+ * @param ps     A pointer obtained via @ref pollset_create().
+ * @param owner  Identifies the fdarray, typically a port.
+ * @param fda    The descriptors of the owner.
+ * @return       Zero on success, non-zero otherwise.
+ */
+int pollset_update(struct pollset *ps, void *owner, struct fdarray *fda);
+
+/**
+ * Drops all of the descriptors of an owner from a poll set.
+ * @param ps     A pointer obtained via @ref pollset_create().
+ * @param owner  The owner passed to @ref pollset_update().
+ */
+void pollset_remove(struct pollset *ps, void *owner);
+
+/**
+ * Waits for descriptors to become ready.
+ *
+ * The descriptors are level triggered. A descriptor that remains ready
+ * after its event was handled, like a socket holding more than one
+ * message, will be reported again by the next call.
+ *
+ * @param ps       A pointer obtained via @ref pollset_create().
+ * @param ev       Array that returns the ready descriptors.
+ * @param max      Number of elements in the array.
+ * @param timeout  Time limit in milliseconds, or -1 to wait forever.
+ * @return         The number of ready descriptors, or -1 on error.
+ */
+int pollset_wait(struct pollset *ps, struct pollset_event *ev, int max,
+		 int timeout);
+
+#endif
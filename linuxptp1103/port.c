@@ -28,6 +28,7 @@
 
 #include "bmc.h"
 #include "clock.h"
+#include "cmlds_shm.h"
 #include "designated_fsm.h"
 #include "filter.h"
 #include "missing.h"
@@ -36,10 +37,14 @@
 #include "port.h"
 #include "port_private.h"
 #include "print.h"
+#include "ratectl.h"
 #include "rtnl.h"
 #include "sad.h"
 #include "sk.h"
+#include "stats.h"
 #include "tc.h"
+#include "telemetry.h"
+#include "timerq.h"
 #include "tlv.h"
 #include "tmv.h"
 #include "tsproc.h"
@@ -64,6 +69,10 @@ static int port_is_ieee8021as(struct port *p);
 static int port_is_uds(struct port *p);
 static int port_has_security(struct port *p);
 static void port_nrate_initialize(struct port *p);
+static int port_resend(struct port *p, struct ptp_message *msg,
+		       enum transport_event event);
+static int port_send(struct port *p, struct ptp_message *msg,
+		     enum transport_event event);
 
 static int announce_compare(struct ptp_message *m1, struct ptp_message *m2)
 {
@@ -237,11 +246,8 @@ struct fdarray *port_fda(struct port *port)
 	return &port->fda;
 }
 
-int set_tmo_log(int fd, unsigned int scale, int log_seconds)
+static uint64_t tmo_log_ns(unsigned int scale, int log_seconds)
 {
-	struct itimerspec tmo = {
-		{0, 0}, {0, 0}
-	};
 	uint64_t ns;
 	int i;
 
@@ -252,15 +258,44 @@ int set_tmo_log(int fd, unsigned int scale, int log_seconds)
 			ns >>= 1;
 		}
 
-		tmo.it_value.tv_sec = ns / NS_PER_SEC;
-		tmo.it_value.tv_nsec = ns % NS_PER_SEC;
-
 	} else
-		tmo.it_value.tv_sec = scale * (1 << log_seconds);
+		ns = scale * NS_PER_SEC << log_seconds;
+
+	return ns;
+}
+
+static uint64_t tmo_random_ns(int min, int span, int log_seconds)
+{
+	uint64_t min_ns, span_ns;
+
+	if (log_seconds >= 0) {
+		min_ns = min * NS_PER_SEC << log_seconds;
+		span_ns = span * NS_PER_SEC << log_seconds;
+	} else {
+		min_ns = min * NS_PER_SEC >> -log_seconds;
+		span_ns = span * NS_PER_SEC >> -log_seconds;
+	}
+
+	return min_ns + (span_ns * (random() % (1 << 15) + 1) >> 15);
+}
+
+static int set_tmo_ns(int fd, uint64_t ns)
+{
+	struct itimerspec tmo = {
+		{0, 0}, {0, 0}
+	};
+
+	tmo.it_value.tv_sec = ns / NS_PER_SEC;
+	tmo.it_value.tv_nsec = ns % NS_PER_SEC;
 
 	return timerfd_settime(fd, 0, &tmo, NULL);
 }
 
+int set_tmo_log(int fd, unsigned int scale, int log_seconds)
+{
+	return set_tmo_ns(fd, tmo_log_ns(scale, log_seconds));
+}
+
 int set_tmo_lin(int fd, int seconds)
 {
 	struct itimerspec tmo = {
@@ -273,25 +308,51 @@ int set_tmo_lin(int fd, int seconds)
 
 int set_tmo_random(int fd, int min, int span, int log_seconds)
 {
-	uint64_t value_ns, min_ns, span_ns;
-	struct itimerspec tmo = {
-		{0, 0}, {0, 0}
-	};
+	return set_tmo_ns(fd, tmo_random_ns(min, span, log_seconds));
+}
 
-	if (log_seconds >= 0) {
-		min_ns = min * NS_PER_SEC << log_seconds;
-		span_ns = span * NS_PER_SEC << log_seconds;
-	} else {
-		min_ns = min * NS_PER_SEC >> -log_seconds;
-		span_ns = span * NS_PER_SEC >> -log_seconds;
+/*
+ * The port timers live in a timer queue whose descriptor occupies the
+ * FD_FIRST_TIMER slot. Like with a timerfd, a zero timeout disarms.
+ */
+static int port_set_tmo_ns(struct port *p, int index, uint64_t ns)
+{
+	if (!p->timers) {
+		return -1;
+	}
+	if (!ns) {
+		timerq_disarm(p->timers, index - FD_FIRST_TIMER);
+		return 0;
 	}
+	return timerq_arm(p->timers, index - FD_FIRST_TIMER, ns);
+}
 
-	value_ns = min_ns + (span_ns * (random() % (1 << 15) + 1) >> 15);
+int port_set_tmo_log(struct port *p, int index,
+		     unsigned int scale, int log_seconds)
+{
+	return port_set_tmo_ns(p, index, tmo_log_ns(scale, log_seconds));
+}
+
+static int port_set_tmo_random(struct port *p, int index,
+			       int min, int span, int log_seconds)
+{
+	return port_set_tmo_ns(p, index, tmo_random_ns(min, span, log_seconds));
+}
 
-	tmo.it_value.tv_sec = value_ns / NS_PER_SEC;
-	tmo.it_value.tv_nsec = value_ns % NS_PER_SEC;
+/* Flushes the records held back by the slave event monitor in time. */
+static int port_set_monitor_tmo(struct port *p)
+{
+	return port_set_tmo_ns(p, FD_MONITOR_TIMER,
+			       monitor_flush_tmo(p->slave_event_monitor));
+}
 
-	return timerfd_settime(fd, 0, &tmo, NULL);
+int port_set_tmo_abs(struct port *p, int index, struct timespec *ts)
+{
+	if (!p->timers) {
+		return -1;
+	}
+	return timerq_arm_abs(p->timers, index - FD_FIRST_TIMER,
+			      ts->tv_sec * NS_PER_SEC + ts->tv_nsec);
 }
 
 int port_set_fault_timer_log(struct port *port,
@@ -650,6 +711,9 @@ static int path_trace_ignore(struct port *p, struct ptp_message *m)
 	if (msg_type(m) != ANNOUNCE) {
 		return 0;
 	}
+	if (!msg_tlv_find(m, TLV_PATH_TRACE)) {
+		return 0;
+	}
 	TAILQ_FOREACH(extra, &m->tlv_list, list) {
 		ptt = (struct path_trace_tlv *) extra->tlv;
 		if (ptt->type != TLV_PATH_TRACE) {
@@ -671,6 +735,26 @@ static void port_stats_inc_rx(struct port *p, const struct ptp_message *msg)
 	p->stats.rxMsgType[msg_type(msg)]++;
 }
 
+/*
+ * Decodes the TLVs of a message that passed the filters. Messages that
+ * were dropped before this point never touched the TLV descriptor pool.
+ */
+static int port_tlv_parse(struct port *p, struct ptp_message *msg)
+{
+	if (!msg_tlv_pending(msg)) {
+		return 0;
+	}
+	p->rxTlvDecoded++;
+	return msg_tlv_parse(msg);
+}
+
+static void port_tlv_skip(struct port *p, struct ptp_message *msg)
+{
+	if (msg_tlv_pending(msg)) {
+		p->rxTlvSkipped++;
+	}
+}
+
 static void port_stats_inc_tx(struct port *p, const struct ptp_message *msg)
 {
 	p->stats.txMsgType[msg_type(msg)]++;
@@ -704,6 +788,25 @@ static int peer_prepare_and_send(struct port *p, struct ptp_message *msg,
 	return 0;
 }
 
+/*
+ * Announces a change in the link delay measured by a CMLDS link port, to
+ * the subscribed management clients as well as in shared memory.
+ */
+static void port_cmlds_notify(struct port *p)
+{
+	struct cmlds_info_np info;
+
+	port_notify_event(p, NOTIFY_CMLDS);
+	if (!p->cmlds.shm) {
+		return;
+	}
+	info.meanLinkDelay = p->peerMeanPathDelay;
+	info.scaledNeighborRateRatio =
+		(Integer32) (p->nrate.ratio * POW2_41 - POW2_41);
+	info.as_capable = p->asCapable;
+	cmlds_shm_publish(p->cmlds.shm, &info);
+}
+
 int port_capable(struct port *p)
 {
 	if (!port_is_ieee8021as(p)) {
@@ -766,7 +869,7 @@ capable:
 	if (p->asCapable == NOT_CAPABLE) {
 		pr_debug("%s: setting asCapable", p->log_name);
 		p->asCapable = AS_CAPABLE;
-		port_notify_event(p, NOTIFY_CMLDS);
+		port_cmlds_notify(p);
 		/* Send gPTP-capable signaling message to advertise capability */
 		if (p->gptp_capable_transmit) {
 			port_tx_gptp_capable(p);
@@ -778,7 +881,7 @@ not_capable:
 	if (p->asCapable)
 		port_nrate_initialize(p);
 	p->asCapable = NOT_CAPABLE;
-	port_notify_event(p, NOTIFY_CMLDS);
+	port_cmlds_notify(p);
 	/* Send gPTP-capable signaling to indicate loss of capability */
 	if (p->gptp_capable_transmit) {
 		port_tx_gptp_capable(p);
@@ -786,12 +889,12 @@ not_capable:
 	return 0;
 }
 
-int port_clr_tmo(int fd)
+int port_clr_tmo(struct port *p, int index)
 {
-	struct itimerspec tmo = {
-		{0, 0}, {0, 0}
-	};
-	return timerfd_settime(fd, 0, &tmo, NULL);
+	if (p->timers) {
+		timerq_disarm(p->timers, index - FD_FIRST_TIMER);
+	}
+	return 0;
 }
 
 static int port_ignore(struct port *p, struct ptp_message *m)
@@ -912,6 +1015,118 @@ static const Octet profile_id_p2p[] = {0x00, 0x1B, 0x19, 0x00, 0x02, 0x00};
 static const Octet profile_id_8275_1[] = {0x00, 0x19, 0xA7, 0x01, 0x02, 0x03};
 static const Octet profile_id_8275_2[] = {0x00, 0x19, 0xA7, 0x02, 0x01, 0x02};
 
+static void port_fill_portds(struct port *p, struct portDS *pds)
+{
+	pds->portIdentity            = p->portIdentity;
+	if (p->state == PS_GRAND_MASTER) {
+		pds->portState = PS_MASTER;
+	} else {
+		pds->portState = p->state;
+	}
+	pds->logMinDelayReqInterval  = p->logMinDelayReqInterval;
+	pds->peerMeanPathDelay       = p->peerMeanPathDelay;
+	pds->logAnnounceInterval     = p->logAnnounceInterval;
+	pds->announceReceiptTimeout  = p->announceReceiptTimeout;
+	pds->logSyncInterval         = p->logSyncInterval;
+	if (p->delayMechanism) {
+		pds->delayMechanism = p->delayMechanism;
+	} else {
+		pds->delayMechanism = DM_E2E;
+	}
+	pds->logMinPdelayReqInterval = p->logMinPdelayReqInterval;
+	pds->versionNumber           = p->versionNumber;
+}
+
+static void port_telemetry_publish(struct port *p)
+{
+	struct telemetry_port rec;
+
+	if (!p->telemetry) {
+		return;
+	}
+	memset(&rec, 0, sizeof(rec));
+	port_fill_portds(p, &rec.pds);
+	rec.stats = p->stats;
+	rec.service_stats = p->service_stats;
+	if (!memcmp(&rec, &p->telemetry_last, sizeof(rec))) {
+		return;
+	}
+	telemetry_publish_port(p->telemetry, portnum(p), &rec);
+	p->telemetry_last = rec;
+}
+
+/*
+ * Starts from the published clock record, so that the last servo sample,
+ * which only the port feeding the servo knows, is carried over.
+ */
+static int port_telemetry_clock(struct port *p, struct telemetry_clock *clk,
+				struct telemetry_clock *old)
+{
+	struct currentDS *cds = clock_current_dataset(p->clock);
+	struct parent_ds *dad = clock_parent_ds(p->clock);
+	struct ClockIdentity id = clock_identity(p->clock);
+	struct follow_up_info_tlv fui;
+
+	memset(old, 0, sizeof(*old));
+	if (telemetry_read_clock(p->telemetry, old) <= 0) {
+		memset(old, 0, sizeof(*old));
+	}
+	*clk = *old;
+
+	memset(&fui, 0, sizeof(fui));
+	clock_follow_up_info(p->clock, &fui);
+
+	clk->identity = id;
+	clk->cds = *cds;
+	clk->pds = dad->pds;
+
+	clk->tsn.master_offset = cds->offsetFromMaster >> 16;
+	clk->tsn.cumulativeScaledRateOffset = fui.cumulativeScaledRateOffset;
+	clk->tsn.scaledLastGmPhaseChange = fui.scaledLastGmPhaseChange;
+	clk->tsn.gmTimeBaseIndicator = fui.gmTimeBaseIndicator;
+	clk->tsn.lastGmPhaseChange = fui.lastGmPhaseChange;
+	clk->tsn.gmPresent = cid_eq(&dad->pds.grandmasterIdentity, &id) ? 0 : 1;
+	clk->tsn.gmIdentity = dad->pds.grandmasterIdentity;
+
+	return memcmp(clk, old, sizeof(*clk));
+}
+
+/* Publishes the data sets of the clock after a state or parent change. */
+static void port_telemetry_update_clock(struct port *p)
+{
+	struct telemetry_clock clk, old;
+
+	if (!p->telemetry) {
+		return;
+	}
+	if (port_telemetry_clock(p, &clk, &old)) {
+		telemetry_publish_clock(p->telemetry, &clk);
+	}
+}
+
+static void port_telemetry_publish_clock(struct port *p, tmv_t ingress,
+					 enum servo_state state)
+{
+	struct currentDS *cds = clock_current_dataset(p->clock);
+	struct telemetry_clock clk, old;
+
+	if (!p->telemetry) {
+		return;
+	}
+	port_telemetry_clock(p, &clk, &old);
+
+	clk.tsn.ingress_time = tmv_to_nanoseconds(ingress);
+
+	clk.servo.ingress_time = tmv_to_nanoseconds(ingress);
+	clk.servo.offset = cds->offsetFromMaster >> 16;
+	clk.servo.path_delay = cds->meanPathDelay >> 16;
+	clk.servo.scaled_rate_offset =
+		(int64_t) (clock_rate_ratio(p->clock) * POW2_41 - POW2_41);
+	clk.servo.state = state;
+
+	telemetry_publish_clock(p->telemetry, &clk);
+}
+
 static int port_management_fill_response(struct port *target,
 					 struct ptp_message *rsp, int id)
 {
@@ -922,7 +1137,12 @@ static int port_management_fill_response(struct port *target,
 	struct mgmt_clock_description *cd;
 	struct management_tlv_datum *mtd;
 	struct unicast_master_entry *ume;
+	struct port_rate_stats_np *prsn;
+	struct port_tlv_stats_np *ptsn;
+	struct port_tc_stats_np *ptcn;
 	struct clock_description *desc;
+	struct servo_gains_np *sgn;
+	struct clock_stats_np *csn;
 	struct port_properties_np *ppn;
 	struct port_hwclock_np *phn;
 	struct cmlds_info_np *cmlds;
@@ -933,10 +1153,14 @@ static int port_management_fill_response(struct port *target,
 	struct tlv_extra *extra;
 	struct PortIdentity pid;
 	const char *ts_label;
+	struct ratectl_stats rcs;
+	double kp, ki, noise;
 	struct portDS *pds;
+	uint64_t newest;
+	struct port *q;
 	uint16_t u16;
 	uint8_t *buf;
-	int datalen;
+	int adaptive, datalen;
 
 	extra = tlv_extra_alloc();
 	if (!extra) {
@@ -1026,24 +1250,7 @@ static int port_management_fill_response(struct port *target,
 		break;
 	case MID_PORT_DATA_SET:
 		pds = (struct portDS *) tlv->data;
-		pds->portIdentity            = target->portIdentity;
-		if (target->state == PS_GRAND_MASTER) {
-			pds->portState = PS_MASTER;
-		} else {
-			pds->portState = target->state;
-		}
-		pds->logMinDelayReqInterval  = target->logMinDelayReqInterval;
-		pds->peerMeanPathDelay       = target->peerMeanPathDelay;
-		pds->logAnnounceInterval     = target->logAnnounceInterval;
-		pds->announceReceiptTimeout  = target->announceReceiptTimeout;
-		pds->logSyncInterval         = target->logSyncInterval;
-		if (target->delayMechanism) {
-			pds->delayMechanism = target->delayMechanism;
-		} else {
-			pds->delayMechanism = DM_E2E;
-		}
-		pds->logMinPdelayReqInterval = target->logMinPdelayReqInterval;
-		pds->versionNumber           = target->versionNumber;
+		port_fill_portds(target, pds);
 		datalen = sizeof(*pds);
 		break;
 	case MID_LOG_ANNOUNCE_INTERVAL:
@@ -1177,6 +1384,67 @@ static int port_management_fill_response(struct port *target,
 		cmlds->as_capable = target->asCapable;
 		datalen = sizeof(*cmlds);
 		break;
+	case MID_PORT_TLV_STATS_NP:
+		ptsn = (struct port_tlv_stats_np *)tlv->data;
+		ptsn->portIdentity = target->portIdentity;
+		ptsn->rxTlvDecoded = target->rxTlvDecoded;
+		ptsn->rxTlvSkipped = target->rxTlvSkipped;
+		datalen = sizeof(*ptsn);
+		break;
+	case MID_PORT_TC_STATS_NP:
+		ptcn = (struct port_tc_stats_np *)tlv->data;
+		ptcn->portIdentity = target->portIdentity;
+		ptcn->txtsTimeout = target->txtsTimeout;
+		datalen = sizeof(*ptcn);
+		break;
+	case MID_PORT_RATE_STATS_NP:
+		prsn = (struct port_rate_stats_np *)tlv->data;
+		memset(prsn, 0, sizeof(*prsn));
+		prsn->portIdentity = target->portIdentity;
+		prsn->logSyncInterval = target->logSyncInterval;
+		prsn->logPdelayReqInterval = target->logPdelayReqInterval;
+		if (target->ratectl) {
+			ratectl_get_stats(target->ratectl, &rcs);
+			prsn->enabled = 1;
+			prsn->allanDeviation = rcs.adev * 1e12 < UINT32_MAX ?
+				rcs.adev * 1e12 : UINT32_MAX;
+			prsn->pathDelayVariation = rcs.pdv * 65536.0;
+			prsn->rateChanges = rcs.changes;
+			prsn->syncSaved = rcs.sync_saved;
+			prsn->pdelaySaved = rcs.pdelay_saved;
+		}
+		datalen = sizeof(*prsn);
+		break;
+	case MID_CLOCK_STATS_NP:
+		/* The servo is shared, report the port that fed it last. */
+		csn = (struct clock_stats_np *)tlv->data;
+		memset(csn, 0, sizeof(*csn));
+		newest = 0;
+		for (q = clock_first_port(target->clock); q;
+		     q = LIST_NEXT(q, list)) {
+			if (q->summary_time > newest) {
+				*csn = q->summary;
+				newest = q->summary_time;
+			}
+		}
+		datalen = sizeof(*csn);
+		break;
+	case MID_SERVO_GAINS_NP:
+		adaptive = servo_gains(clock_servo(target->clock),
+				       &kp, &ki, &noise);
+		if (adaptive < 0) {
+			/* Only the PI servo has gains. */
+			tlv_extra_recycle(extra);
+			return 0;
+		}
+		sgn = (struct servo_gains_np *)tlv->data;
+		memset(sgn, 0, sizeof(*sgn));
+		sgn->scaled_kp = kp * POW2_32;
+		sgn->scaled_ki = ki * POW2_32;
+		sgn->offset_noise = noise;
+		sgn->adaptive = adaptive;
+		datalen = sizeof(*sgn);
+		break;
 	default:
 		/* The caller should *not* respond to this message. */
 		tlv_extra_recycle(extra);
@@ -1195,6 +1463,140 @@ static int port_management_fill_response(struct port *target,
 	return 1;
 }
 
+/* Leave room for an authentication TLV. */
+#define PORT_STATS_BULK_RESERVE 64
+
+struct port_stats_track {
+	uint64_t value[PORT_STATS_BULK_COUNTERS];
+	UInteger32 changed[PORT_STATS_BULK_COUNTERS];
+};
+
+static UInteger32 port_stats_generation;
+
+static void port_stats_values(struct port *p, uint64_t *value)
+{
+	memcpy(value, &p->stats, sizeof(p->stats));
+	memcpy(value + sizeof(p->stats) / sizeof(uint64_t),
+	       &p->service_stats, sizeof(p->service_stats));
+}
+
+/*
+ * Stamps every counter that changed since the previous scan with the
+ * given generation. Returns the bit mask of the counters that changed
+ * after generation 'since'.
+ */
+static uint64_t port_stats_track(struct port *p, UInteger32 gen,
+				 UInteger32 since, uint64_t *value)
+{
+	struct port_stats_track *t = p->stats_track;
+	uint64_t mask = 0;
+	unsigned int i;
+
+	if (!t) {
+		t = calloc(1, sizeof(*t));
+		if (!t) {
+			return 0;
+		}
+		p->stats_track = t;
+	}
+	port_stats_values(p, value);
+
+	for (i = 0; i < PORT_STATS_BULK_COUNTERS; i++) {
+		if (!t->changed[i] || t->value[i] != value[i]) {
+			t->value[i] = value[i];
+			t->changed[i] = gen;
+		}
+		if (!since || (int32_t) (t->changed[i] - since) > 0) {
+			mask |= 1ULL << i;
+		}
+	}
+	return mask;
+}
+
+static int port_management_stats_bulk(struct port *target,
+				      struct ptp_message *rsp,
+				      struct ptp_message *req)
+{
+	uint64_t mask, value[PORT_STATS_BULK_COUNTERS];
+	struct port_stats_bulk_record *rec;
+	struct port_stats_bulk_np *psb;
+	struct management_tlv *tlv;
+	struct tlv_extra *extra;
+	UInteger16 first = 0;
+	UInteger32 since = 0;
+	int datalen, space;
+	unsigned int i, n;
+	struct port *p;
+
+	tlv = (struct management_tlv *) req->management.suffix;
+	if (tlv->length >= sizeof(tlv->id) + sizeof(*psb)) {
+		psb = (struct port_stats_bulk_np *) tlv->data;
+		since = psb->generation;
+		first = psb->first_port;
+	}
+
+	extra = tlv_extra_alloc();
+	if (!extra) {
+		pr_err("failed to allocate TLV descriptor");
+		return 0;
+	}
+	extra->tlv = (struct TLV *) rsp->management.suffix;
+
+	tlv = (struct management_tlv *) rsp->management.suffix;
+	tlv->type = TLV_MANAGEMENT;
+	tlv->id = MID_PORT_STATS_BULK_NP;
+
+	if (!++port_stats_generation) {
+		port_stats_generation++;
+	}
+	/* A generation from the future was handed out before a restart. */
+	if ((int32_t) (since - port_stats_generation) >= 0) {
+		since = 0;
+	}
+	psb = (struct port_stats_bulk_np *) tlv->data;
+	psb->generation = port_stats_generation;
+	psb->first_port = 0;
+	psb->num_records = 0;
+	datalen = sizeof(*psb);
+	space = sizeof(struct message_data) - rsp->header.messageLength -
+		sizeof(*tlv) - PORT_STATS_BULK_RESERVE;
+
+	/*
+	 * Every query scans all of the ports, so that no change goes
+	 * unnoticed, even when the ports before 'first' are not reported.
+	 */
+	for (p = clock_first_port(target->clock); p; p = LIST_NEXT(p, list)) {
+		mask = port_stats_track(p, port_stats_generation, since, value);
+		if (portnum(p) < first || psb->first_port) {
+			continue;
+		}
+		if (!mask) {
+			continue;
+		}
+		n = __builtin_popcountll(mask);
+		if (datalen + sizeof(*rec) + n * sizeof(uint64_t) > space) {
+			psb->first_port = portnum(p);
+			continue;
+		}
+		rec = (struct port_stats_bulk_record *) (tlv->data + datalen);
+		rec->portNumber = portnum(p);
+		rec->reserved = 0;
+		rec->mask = mask;
+		for (i = 0, n = 0; i < PORT_STATS_BULK_COUNTERS; i++) {
+			if (mask & (1ULL << i)) {
+				rec->value[n++] = value[i];
+			}
+		}
+		datalen += sizeof(*rec) + n * sizeof(uint64_t);
+		psb->num_records++;
+	}
+
+	tlv->length = sizeof(tlv->id) + datalen;
+	rsp->header.messageLength += sizeof(*tlv) + datalen;
+	msg_tlv_attach(rsp, extra);
+	return 1;
+}
+
 static int port_management_get_response(struct port *target,
 					struct port *ingress, int id,
 					struct ptp_message *req)
@@ -1207,13 +1609,56 @@ static int port_management_get_response(struct port *target,
 	if (!rsp) {
 		return 0;
 	}
-	respond = port_management_fill_response(target, rsp, id);
+	if (id == MID_PORT_STATS_BULK_NP)
+		respond = port_management_stats_bulk(target, rsp, req);
+	else
+		respond = port_management_fill_response(target, rsp, id);
 	if (respond)
 		port_prepare_and_send(ingress, rsp, TRANS_GENERAL);
 	msg_put(rsp);
 	return respond;
 }
 
+static int port_management_command(struct port *target,
+				   struct port *ingress, int id,
+				   struct ptp_message *req)
+{
+	struct management_tlv *tlv;
+	struct ptp_message *rsp;
+	struct tlv_extra *extra;
+
+	switch (id) {
+	case MID_RELOAD_CONFIG_NP:
+		/* Only a local user may change the configuration. */
+		if (!port_is_uds(ingress)) {
+			port_management_send_error(target, ingress, req,
+						   MID_NOT_SUPPORTED);
+			return 1;
+		}
+		request_reload();
+		break;
+	default:
+		return 0;
+	}
+
+	rsp = port_management_reply(port_identity(target), ingress, req);
+	if (!rsp) {
+		return 0;
+	}
+	extra = msg_tlv_append(rsp, sizeof(*tlv));
+	if (!extra) {
+		msg_put(rsp);
+		return 0;
+	}
+	tlv = (struct management_tlv *) extra->tlv;
+	tlv->type = TLV_MANAGEMENT;
+	tlv->length = sizeof(tlv->id);
+	tlv->id = id;
+	port_prepare_and_send(ingress, rsp, TRANS_GENERAL);
+	msg_put(rsp);
+	return 1;
+}
+
 static int port_management_set(struct port *target,
 			       struct port *ingress, int id,
 			       struct ptp_message *req)
@@ -1306,9 +1751,9 @@ static void port_nrate_initialize(struct port *p)
 
 int port_set_announce_tmo(struct port *p)
 {
-	return set_tmo_random(p->fda.fd[FD_ANNOUNCE_TIMER],
-			      p->announceReceiptTimeout,
-			      p->announce_span, p->logAnnounceInterval);
+	return port_set_tmo_random(p, FD_ANNOUNCE_TIMER,
+				   p->announceReceiptTimeout,
+				   p->announce_span, p->logAnnounceInterval);
 }
 
 int port_set_delay_tmo(struct port *p)
@@ -1319,35 +1764,35 @@ int port_set_delay_tmo(struct port *p)
 	switch (p->delayMechanism) {
 	case DM_COMMON_P2P:
 	case DM_P2P:
-		return set_tmo_log(p->fda.fd[FD_DELAY_TIMER], 1,
-				   p->logPdelayReqInterval);
+		return port_set_tmo_log(p, FD_DELAY_TIMER, 1,
+					p->logPdelayReqInterval);
 	default:
 		break;
 	}
-	return set_tmo_random(p->fda.fd[FD_DELAY_TIMER], 0, 2,
-			      p->logMinDelayReqInterval);
+	return port_set_tmo_random(p, FD_DELAY_TIMER, 0, 2,
+				   p->logMinDelayReqInterval);
 }
 
 static int port_set_manno_tmo(struct port *p)
 {
-	return set_tmo_log(p->fda.fd[FD_MANNO_TIMER], 1, p->logAnnounceInterval);
+	return port_set_tmo_log(p, FD_MANNO_TIMER, 1, p->logAnnounceInterval);
 }
 
 int port_set_qualification_tmo(struct port *p)
 {
-	return set_tmo_log(p->fda.fd[FD_QUALIFICATION_TIMER],
+	return port_set_tmo_log(p, FD_QUALIFICATION_TIMER,
 		       1+clock_steps_removed(p->clock), p->logAnnounceInterval);
 }
 
 int port_set_sync_rx_tmo(struct port *p)
 {
-	return set_tmo_log(p->fda.fd[FD_SYNC_RX_TIMER],
-			   p->syncReceiptTimeout, p->logSyncInterval);
+	return port_set_tmo_log(p, FD_SYNC_RX_TIMER,
+				p->syncReceiptTimeout, p->logSyncInterval);
 }
 
 static int port_set_sync_tx_tmo(struct port *p)
 {
-	return set_tmo_log(p->fda.fd[FD_SYNC_TX_TIMER], 1, p->logSyncInterval);
+	return port_set_tmo_log(p, FD_SYNC_TX_TIMER, 1, p->logSyncInterval);
 }
 
 void port_show_transition(struct port *p, enum port_state next,
@@ -1394,6 +1839,121 @@ static void message_interval_request(struct port *p,
 	}
 }
 
+static void port_rate_request(struct port *p)
+{
+	p->logSyncInterval = ratectl_sync_interval(p->ratectl);
+	p->logPdelayReqInterval = ratectl_pdelay_interval(p->ratectl);
+	pr_info("%s: requesting sync interval 2^%d, pdelay interval 2^%d",
+		p->log_name, p->logSyncInterval, p->logPdelayReqInterval);
+	port_tx_interval_request(p, SIGNAL_NO_CHANGE, p->logSyncInterval,
+				 p->delayMechanism == DM_P2P ?
+				 p->logPdelayReqInterval : SIGNAL_NO_CHANGE);
+}
+
+static void port_rate_control(struct port *p, enum servo_state state,
+			      Integer8 sync_interval)
+{
+	struct currentDS *cds;
+	int changed = 0;
+
+	switch (state) {
+	case SERVO_UNLOCKED:
+	case SERVO_JUMP:
+		changed = ratectl_reset(p->ratectl);
+		break;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		cds = clock_current_dataset(p->clock);
+		changed = ratectl_sync_sample(p->ratectl,
+					      cds->offsetFromMaster >> 16,
+					      sync_interval);
+		break;
+	}
+	if (changed) {
+		port_rate_request(p);
+	}
+}
+
+static void port_rate_delay(struct port *p, struct tsproc *tsp)
+{
+	tmv_t delay;
+
+	if (!p->ratectl || tsproc_raw_delay(tsp, &delay)) {
+		return;
+	}
+	if (ratectl_delay_sample(p->ratectl, tmv_to_nanoseconds(delay),
+				 p->delayMechanism == DM_P2P)) {
+		port_rate_request(p);
+	}
+}
+
+/*
+ * Collects the offset and path delay of the locked servo over the
+ * summary_interval, and keeps the result for CLOCK_STATS_NP.
+ */
+static void port_summary(struct port *p, enum servo_state state,
+			 Integer8 sync_interval)
+{
+	struct stats_result offset, delay;
+	struct currentDS *cds;
+	unsigned int max_count;
+	struct timespec now;
+	int shift;
+
+	if (!p->offset_stats) {
+		return;
+	}
+	switch (state) {
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		break;
+	default:
+		return;
+	}
+	cds = clock_current_dataset(p->clock);
+	stats_add_value(p->offset_stats, cds->offsetFromMaster >> 16);
+	stats_add_value(p->delay_stats, cds->meanPathDelay >> 16);
+
+	shift = config_get_int(clock_config(p->clock), NULL,
+			       "summary_interval") - sync_interval;
+	if (shift > 30) {
+		shift = 30;
+	}
+	max_count = shift > 0 ? 1U << shift : 1;
+	if (stats_get_num_values(p->offset_stats) < max_count) {
+		return;
+	}
+	stats_get_result(p->offset_stats, &offset);
+	stats_get_result(p->delay_stats, &delay);
+
+	p->summary.num_values = stats_get_num_values(p->offset_stats);
+	p->summary.offset_rms = offset.rms;
+	p->summary.offset_max_abs = offset.max_abs;
+	p->summary.offset_p99 = offset.p99;
+	p->summary.offset_p999 = offset.p999;
+	p->summary.delay_mean = delay.mean;
+	p->summary.delay_p99 = delay.p99;
+	p->summary.delay_p999 = delay.p999;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	p->summary_time = now.tv_sec * NS_PER_SEC + now.tv_nsec;
+
+	if (max_count > 1) {
+		pr_info("%s: offset p99 %4" PRId64 " p99.9 %4" PRId64
+			" delay p99 %5" PRId64 " p99.9 %5" PRId64,
+			p->log_name,
+			p->summary.offset_p99, p->summary.offset_p999,
+			p->summary.delay_p99, p->summary.delay_p999);
+	}
+	if (max_count > 1 && p->rx_path_stats) {
+		pr_info("%s: rx %4" PRIu64 " ns/msg", p->log_name,
+			p->rx_count ? p->rx_ns / p->rx_count : 0);
+	}
+	stats_reset(p->offset_stats);
+	stats_reset(p->delay_stats);
+	p->rx_ns = 0;
+	p->rx_count = 0;
+}
+
 static void port_synchronize(struct port *p,
 			     uint16_t seqid,
 			     tmv_t ingress_ts,
@@ -1419,7 +1979,9 @@ static void port_synchronize(struct port *p,
 	case PS_SLAVE:
 		monitor_sync(p->slave_event_monitor,
 			     clock_parent_identity(p->clock), seqid,
-			     t1, tmv_add(c1, c2), t2);
+			     t1, tmv_add(c1, c2), t2,
+			     clock_rate_ratio(p->clock));
+		port_set_monitor_tmo(p);
 		break;
 	default:
 		break;
@@ -1429,10 +1991,16 @@ static void port_synchronize(struct port *p,
 
 	last_state = clock_servo_state(p->clock);
 	state = clock_synchronize(p->clock, t2, t1c);
+	port_telemetry_publish_clock(p, t2, state);
+	if (p->ratectl) {
+		port_rate_control(p, state, sync_interval);
+	}
+	port_summary(p, state, sync_interval);
 	switch (state) {
 	case SERVO_UNLOCKED:
 		port_dispatch(p, EV_SYNCHRONIZATION_FAULT, 0);
-		if (servo_offset_threshold(clock_servo(p->clock)) != 0 &&
+		if (!p->ratectl &&
+		    servo_offset_threshold(clock_servo(p->clock)) != 0 &&
 		    sync_interval != p->initialLogSyncInterval) {
 			p->logPdelayReqInterval = p->logMinPdelayReqInterval;
 			p->logSyncInterval = p->initialLogSyncInterval;
@@ -1590,11 +2158,53 @@ static int port_cmlds_renew(struct port *p, time_t now)
 	return 0;
 }
 
+static void port_cmlds_update(struct port *p, struct cmlds_info_np *cmlds)
+{
+	p->peer_delay = nanoseconds_to_tmv(cmlds->meanLinkDelay >> 16);
+	p->peerMeanPathDelay = cmlds->meanLinkDelay;
+	p->nrate.ratio = 1.0 + (double) cmlds->scaledNeighborRateRatio / POW2_41;
+	p->asCapable = cmlds->as_capable;
+	p->cmlds.timer_count = 0;
+	if (p->state == PS_UNCALIBRATED || p->state == PS_SLAVE) {
+		const tmv_t tx = tmv_zero();
+		clock_peer_delay(p->clock, p->peer_delay, tx, tx, p->nrate.ratio);
+	}
+}
+
+/*
+ * Picks up the link delay published in shared memory. The CMLDS server
+ * publishes after every peer delay exchange, so a record which does not
+ * change for too long is treated like missing push notifications.
+ */
+static enum fsm_event port_cmlds_shm_poll(struct port *p)
+{
+	struct cmlds_info_np cmlds;
+
+	switch (cmlds_shm_read(p->cmlds.shm, &cmlds)) {
+	case 1:
+		port_cmlds_update(p, &cmlds);
+		return EV_NONE;
+	case 0:
+		break;
+	default:
+		pr_debug("%s: inconsistent CMLDS record", p->log_name);
+		break;
+	}
+	p->cmlds.timer_count++;
+	if (p->cmlds.timer_count > p->allowedLostResponses) {
+		p->asCapable = NOT_CAPABLE;
+	}
+	return EV_NONE;
+}
+
 static enum fsm_event port_cmlds_timeout(struct port *p)
 {
 	struct timespec now;
 	int err;
 
+	if (p->cmlds.shm) {
+		return port_cmlds_shm_poll(p);
+	}
 	if (!p->cmlds.pmc) {
 		return EV_NONE;
 	}
@@ -1716,25 +2326,82 @@ int port_delay_request(struct port *p)
 		pr_err("%s: send delay request failed", p->log_name);
 		goto out;
 	}
-	if (msg_sots_missing(msg)) {
-		pr_err("missing timestamp on transmitted delay request");
-		goto out;
+	if (msg_sots_missing(msg)) {
+		pr_err("missing timestamp on transmitted delay request");
+		goto out;
+	}
+
+	TAILQ_INSERT_HEAD(&p->delay_req, msg, list);
+
+	return 0;
+out:
+	msg_put(msg);
+	return -1;
+}
+
+/*
+ * Multicast Sync, Follow_Up and Announce messages are kept in wire format
+ * after being sent, and subsequent transmissions only patch the fields
+ * which change from one message to the next. A template is dropped as
+ * soon as the data it was built from changes.
+ */
+static void port_tmpl_flush_announce(struct port *p)
+{
+	if (p->tmpl.announce) {
+		msg_put(p->tmpl.announce);
+		p->tmpl.announce = NULL;
+	}
+}
+
+static void port_tmpl_flush_sync(struct port *p)
+{
+	if (p->tmpl.sync) {
+		msg_put(p->tmpl.sync);
+		p->tmpl.sync = NULL;
+	}
+	if (p->tmpl.fup) {
+		msg_put(p->tmpl.fup);
+		p->tmpl.fup = NULL;
 	}
+}
 
-	TAILQ_INSERT_HEAD(&p->delay_req, msg, list);
+static void port_tmpl_flush(struct port *p)
+{
+	port_tmpl_flush_announce(p);
+	port_tmpl_flush_sync(p);
+}
 
-	return 0;
-out:
-	msg_put(msg);
-	return -1;
+static size_t port_announce_src(struct port *p, struct parent_ds *dad,
+				struct timePropertiesDS *tp,
+				struct port_announce_src *src)
+{
+	size_t len = offsetof(struct port_announce_src, ptl);
+
+	memset(src, 0, len);
+	src->tp = *tp;
+	src->pds = dad->pds;
+	src->steps_removed = clock_steps_removed(p->clock);
+	src->log_interval = p->logAnnounceInterval;
+	src->key_id = p->active_key_id;
+	src->pwr = p->pwr;
+	if (p->path_trace_enabled && dad->path_length <= PATH_TRACE_MAX) {
+		src->path_length = dad->path_length;
+		memcpy(src->ptl, dad->ptl,
+		       dad->path_length * sizeof(struct ClockIdentity));
+		len += dad->path_length * sizeof(struct ClockIdentity);
+	}
+	return len;
 }
 
 int port_tx_announce(struct port *p, struct address *dst, uint16_t sequence_id)
 {
 	struct timePropertiesDS tp = clock_time_properties(p->clock);
 	struct parent_ds *dad = clock_parent_ds(p->clock);
+	struct port_announce_src src;
+	size_t src_len = 0;
 	struct ptp_message *msg;
-	int err;
+	int err, length;
+	bool reusable;
 
 	if (p->inhibit_multicast_service && !dst) {
 		return 0;
@@ -1742,6 +2409,20 @@ int port_tx_announce(struct port *p, struct address *dst, uint16_t sequence_id)
 	if (!port_capable(p)) {
 		return 0;
 	}
+	if (!dst) {
+		src_len = port_announce_src(p, dad, &tp, &src);
+		if (p->tmpl.announce &&
+		    !memcmp(&src, &p->tmpl.announce_src, src_len)) {
+			msg = p->tmpl.announce;
+			msg_pre_resend(msg, sequence_id, tmv_zero());
+			err = port_resend(p, msg, TRANS_GENERAL);
+			if (err) {
+				pr_err("%s: send announce failed", p->log_name);
+				port_tmpl_flush_announce(p);
+			}
+			return err;
+		}
+	}
 	msg = msg_allocate();
 	if (!msg) {
 		return -1;
@@ -1777,21 +2458,40 @@ int port_tx_announce(struct port *p, struct address *dst, uint16_t sequence_id)
 	if (ieee_c37_238_append(p, msg)) {
 		pr_err("%s: append power profile failed", p->log_name);
 	}
+	/*
+	 * The time zone TLVs change without notice, so only messages
+	 * without them are kept for reuse.
+	 */
+	length = msg->header.messageLength;
 	if (clock_append_timezones(p->clock, msg)) {
 		pr_err("%s: append time zones failed", p->log_name);
 	}
+	reusable = !dst && length == msg->header.messageLength;
 
 	err = port_prepare_and_send(p, msg, TRANS_GENERAL);
 	if (err) {
 		pr_err("%s: send announce failed", p->log_name);
+	} else if (reusable) {
+		port_tmpl_flush_announce(p);
+		p->tmpl.announce = msg;
+		memcpy(&p->tmpl.announce_src, &src, src_len);
+		return 0;
 	}
 	msg_put(msg);
 	return err;
 }
 
+static bool port_sync_tmpl_valid(struct port *p)
+{
+	return p->tmpl.sync &&
+		p->tmpl.sync_interval == p->logSyncInterval &&
+		p->tmpl.sync_key_id == p->active_key_id;
+}
+
 int port_tx_sync(struct port *p, struct address *dst, uint16_t sequence_id)
 {
 	struct ptp_message *msg, *fup;
+	bool two_step = false, reuse = false;
 	int err, event;
 
 	switch (p->timestamping) {
@@ -1819,6 +2519,18 @@ int port_tx_sync(struct port *p, struct address *dst, uint16_t sequence_id)
 	if (port_sync_incapable(p)) {
 		return 0;
 	}
+	if (!dst && port_sync_tmpl_valid(p)) {
+		reuse = true;
+		msg = p->tmpl.sync;
+		fup = p->tmpl.fup;
+		msg_get(msg);
+		if (fup) {
+			msg_get(fup);
+		}
+		msg_pre_resend(msg, sequence_id, tmv_zero());
+		err = port_resend(p, msg, event);
+		goto sent;
+	}
 	msg = msg_allocate();
 	if (!msg) {
 		return -1;
@@ -1849,6 +2561,7 @@ int port_tx_sync(struct port *p, struct address *dst, uint16_t sequence_id)
 		msg->header.logMessageInterval = 0x7f;
 	}
 	err = port_prepare_and_send(p, msg, event);
+sent:
 	if (err) {
 		pr_err("%s: send sync failed", p->log_name);
 		goto out;
@@ -1864,6 +2577,12 @@ int port_tx_sync(struct port *p, struct address *dst, uint16_t sequence_id)
 	/*
 	 * Send the follow up message right away.
 	 */
+	two_step = true;
+	if (reuse) {
+		msg_pre_resend(fup, sequence_id, msg->hwts.ts);
+		err = port_resend(p, fup, TRANS_GENERAL);
+		goto fup_sent;
+	}
 	fup->hwts.type = p->timestamping;
 
 	fup->header.tsmt               = FOLLOW_UP | p->transportSpecific;
@@ -1887,12 +2606,29 @@ int port_tx_sync(struct port *p, struct address *dst, uint16_t sequence_id)
 	}
 
 	err = port_prepare_and_send(p, fup, TRANS_GENERAL);
+fup_sent:
 	if (err) {
 		pr_err("%s: send follow up failed", p->log_name);
 	}
 out:
+	if (err && reuse) {
+		port_tmpl_flush_sync(p);
+	} else if (!err && !reuse && !dst) {
+		port_tmpl_flush_sync(p);
+		if (!two_step) {
+			msg_put(fup);
+			fup = NULL;
+		}
+		p->tmpl.sync = msg;
+		p->tmpl.fup = fup;
+		p->tmpl.sync_interval = p->logSyncInterval;
+		p->tmpl.sync_key_id = p->active_key_id;
+		return 0;
+	}
 	msg_put(msg);
-	msg_put(fup);
+	if (fup) {
+		msg_put(fup);
+	}
 	return err;
 }
 
@@ -1959,17 +2695,48 @@ static void port_clear_fda(struct port *p, int count)
 		p->fda.fd[i] = -1;
 }
 
+static void port_set_busy_poll(struct port *p)
+{
+	int i, usec = config_get_int(clock_config(p->clock), p->name, "busy_poll");
+
+	if (!usec || port_is_uds(p)) {
+		return;
+	}
+	for (i = FD_EVENT; i <= FD_GENERAL; i++) {
+		if (p->fda.fd[i] < 0) {
+			continue;
+		}
+		if (sk_set_busy_poll(p->fda.fd[i], usec)) {
+			pr_warning("%s: busy polling not available", p->log_name);
+			return;
+		}
+	}
+}
+
 static int port_cmlds_initialize(struct port *p)
 {
 	struct config *cfg = clock_config(p->clock);
 	const int zero_datalen = 1;
 	const UInteger8 hops = 0;
 	struct timespec now;
+	const char *shm_path;
 
 	p->cmlds.port = config_get_int(cfg, p->name, "cmlds.port");
 	if (!p->cmlds.port) {
 		p->cmlds.port = portnum(p);
 	}
+	p->cmlds.timer_count = 0;
+
+	shm_path = config_get_string(cfg, p->name, "cmlds.shm_path");
+	if (shm_path[0]) {
+		p->cmlds.shm = cmlds_shm_open(shm_path, p->cmlds.port, false);
+		if (p->cmlds.shm) {
+			return 0;
+		}
+		pr_warning("%s: falling back to CMLDS push notifications",
+			   p->log_name);
+	}
+
 	p->cmlds.pmc = pmc_create(cfg, TRANS_UDS,
 				  config_get_string(cfg, p->name, "cmlds.client_address"),
 				  config_get_string(cfg, p->name, "cmlds.server_address"),
@@ -1980,15 +2747,27 @@ static int port_cmlds_initialize(struct port *p)
 	if (!p->cmlds.pmc) {
 		return -1;
 	}
-	p->cmlds.timer_count = 0;
 	p->fda.fd[FD_CMLDS] = pmc_get_transport_fd(p->cmlds.pmc);
 	clock_gettime(CLOCK_MONOTONIC, &now);
 	return port_cmlds_renew(p, now.tv_sec);
 }
 
+static int port_cmlds_publish_initialize(struct port *p)
+{
+	struct config *cfg = clock_config(p->clock);
+	const char *shm_path;
+
+	shm_path = config_get_string(cfg, p->name, "cmlds.shm_path");
+	if (!shm_path[0]) {
+		return 0;
+	}
+	p->cmlds.shm = cmlds_shm_open(shm_path, portnum(p), true);
+	return p->cmlds.shm ? 0 : -1;
+}
+
 void port_disable(struct port *p)
 {
-	int i;
+	uint64_t armed, settime;
 
 	tc_flush(p);
 	flush_last_sync(p);
@@ -1999,8 +2778,12 @@ void port_disable(struct port *p)
 	free_foreign_masters(p);
 	transport_close(p->trp, &p->fda);
 
-	for (i = 0; i < N_TIMER_FDS; i++) {
-		close(p->fda.fd[FD_FIRST_TIMER + i]);
+	if (p->timers) {
+		timerq_stats(p->timers, &armed, &settime);
+		pr_debug("%s: timers armed %" PRIu64 " times, %" PRIu64
+			 " timerfd updates", p->log_name, armed, settime);
+		timerq_destroy(p->timers);
+		p->timers = NULL;
 	}
 
 	if (p->cmlds.pmc) {
@@ -2008,6 +2791,11 @@ void port_disable(struct port *p)
 		p->fda.fd[FD_CMLDS] = -1;
 		p->cmlds.pmc = NULL;
 	}
+	if (p->cmlds.shm) {
+		cmlds_shm_close(p->cmlds.shm);
+		p->cmlds.shm = NULL;
+	}
+	port_tmpl_flush(p);
 
 	/* Reset sync interval monitoring */
 	p->last_sync_recv_time = tmv_zero();
@@ -2021,7 +2809,7 @@ void port_disable(struct port *p)
 int port_initialize(struct port *p)
 {
 	struct config *cfg = clock_config(p->clock);
-	int fd[N_TIMER_FDS], i;
+	int i;
 
 	p->multiple_seq_pdr_count  = 0;
 	p->multiple_pdr_detected   = 0;
@@ -2044,6 +2832,9 @@ int port_initialize(struct port *p)
 	p->logMinPdelayReqInterval = config_get_int(cfg, p->name, "logMinPdelayReqInterval");
 	p->logPdelayReqInterval    = p->logMinPdelayReqInterval;
 	p->operLogPdelayReqInterval = config_get_int(cfg, p->name, "operLogPdelayReqInterval");
+	if (p->ratectl) {
+		ratectl_reset(p->ratectl);
+	}
 	p->neighborPropDelayThresh = config_get_int(cfg, p->name, "neighborPropDelayThresh");
 	p->min_neighbor_prop_delay = config_get_int(cfg, p->name, "min_neighbor_prop_delay");
 	p->delay_response_timeout  = config_get_int(cfg, p->name, "delay_response_timeout");
@@ -2064,22 +2855,20 @@ int port_initialize(struct port *p)
 		p->inhibit_delay_req = 1;
 	}
 
-	for (i = 0; i < N_TIMER_FDS; i++) {
-		fd[i] = -1;
-	}
-	for (i = 0; i < N_TIMER_FDS; i++) {
-		fd[i] = timerfd_create(CLOCK_MONOTONIC, 0);
-		if (fd[i] < 0) {
-			pr_err("timerfd_create: %s", strerror(errno));
-			goto no_timers;
-		}
+	p->timers = timerq_create(N_TIMER_FDS,
+				  config_get_int(cfg, p->name, "timer_slack"));
+	if (!p->timers) {
+		goto no_timers;
 	}
 	if (transport_open(p->trp, p->iface, &p->fda, p->timestamping))
 		goto no_tropen;
+	port_set_busy_poll(p);
 
+	/* All of the timers share the descriptor in the first slot. */
 	for (i = 0; i < N_TIMER_FDS; i++) {
-		p->fda.fd[FD_FIRST_TIMER + i] = fd[i];
+		p->fda.fd[FD_FIRST_TIMER + i] = -1;
 	}
+	p->fda.fd[FD_FIRST_TIMER] = timerq_fd(p->timers);
 
 	if (port_set_announce_tmo(p)) {
 		goto no_tmo;
@@ -2091,8 +2880,11 @@ int port_initialize(struct port *p)
 	if (port_delay_mechanism(p) == DM_COMMON_P2P && port_cmlds_initialize(p)) {
 		goto no_tmo;
 	}
+	if (port_delay_mechanism(p) == DM_P2P && port_cmlds_publish_initialize(p)) {
+		goto no_tmo;
+	}
 
-	/* No need to open rtnl socket on UDS port. */
+	/* No need to monitor the link on UDS port. */
 	if (!port_is_uds(p)) {
 		/*
 		 * The delay timer is usually started when the device
@@ -2102,12 +2894,15 @@ int port_initialize(struct port *p)
 		if (p->bmca == BMCA_NOOP) {
 			port_set_delay_tmo(p);
 		}
-		if (p->fda.fd[FD_RTNL] == -1) {
-			p->fda.fd[FD_RTNL] = rtnl_open();
+		if (!p->rtnl) {
+			p->rtnl = rtnl_monitor_add(interface_name(p->iface),
+						   port_link_status, p);
+			if (p->rtnl) {
+				p->fda.fd[FD_RTNL] = rtnl_listener_fd(p->rtnl);
+			}
 		}
-		if (p->fda.fd[FD_RTNL] >= 0) {
-			const char *ifname = interface_name(p->iface);
-			rtnl_link_query(p->fda.fd[FD_RTNL], ifname);
+		if (p->rtnl) {
+			rtnl_monitor_query(p->rtnl);
 		}
 	}
 
@@ -2123,11 +2918,9 @@ int port_initialize(struct port *p)
 no_tmo:
 	transport_close(p->trp, &p->fda);
 no_tropen:
+	timerq_destroy(p->timers);
+	p->timers = NULL;
 no_timers:
-	for (i = 0; i < N_TIMER_FDS; i++) {
-		if (fd[i] >= 0)
-			close(fd[i]);
-	}
 	return -1;
 }
 
@@ -2147,6 +2940,9 @@ static int port_renew_transport(struct port *p)
 	transport_close(p->trp, &p->fda);
 	port_clear_fda(p, FD_FIRST_TIMER);
 	res = transport_open(p->trp, p->iface, &p->fda, p->timestamping);
+	if (!res) {
+		port_set_busy_poll(p);
+	}
 	/* Need to call clock_fda_changed even if transport_open failed in
 	 * order to update clock to the now closed descriptors. */
 	clock_fda_changed(p->clock);
@@ -2273,15 +3069,7 @@ static int process_cmlds(struct port *p)
 			break;
 		}
 		cmlds = (struct cmlds_info_np *) mgt->data;
-		p->peer_delay = nanoseconds_to_tmv(cmlds->meanLinkDelay >> 16);
-		p->peerMeanPathDelay = cmlds->meanLinkDelay;
-		p->nrate.ratio = 1.0 + (double) cmlds->scaledNeighborRateRatio / POW2_41;
-		p->asCapable = cmlds->as_capable;
-		p->cmlds.timer_count = 0;
-		if (p->state == PS_UNCALIBRATED || p->state == PS_SLAVE) {
-			const tmv_t tx = tmv_zero();
-			clock_peer_delay(p->clock, p->peer_delay, tx, tx, p->nrate.ratio);
-		}
+		port_cmlds_update(p, cmlds);
 		break;
 	case MID_SUBSCRIBE_EVENTS_NP:
 		break;
@@ -2389,8 +3177,10 @@ void process_delay_resp(struct port *p, struct ptp_message *m)
 
 	monitor_delay(p->slave_event_monitor, clock_parent_identity(p->clock),
 		      m->header.sequenceId, t3, c3, t4);
+	port_set_monitor_tmo(p);
 
 	clock_path_delay(p->clock, t3, t4c);
+	port_rate_delay(p, clock_get_tsproc(p->clock));
 
 	TAILQ_REMOVE(&p->delay_req, req, list);
 	msg_put(req);
@@ -2661,12 +3451,13 @@ calc:
 	if (p->state == PS_UNCALIBRATED || p->state == PS_SLAVE) {
 		clock_peer_delay(p->clock, p->peer_delay, t1, t2,
 				 p->nrate.ratio);
+		port_rate_delay(p, p->tsproc);
 	}
 
 	msg_put(p->peer_delay_req);
 	p->peer_delay_req = NULL;
 
-	port_notify_event(p, NOTIFY_CMLDS);
+	port_cmlds_notify(p);
 }
 
 int process_pdelay_resp(struct port *p, struct ptp_message *m)
@@ -2816,17 +3607,34 @@ void process_sync(struct port *p, struct ptp_message *m)
 
 void port_close(struct port *p)
 {
+	struct port *q;
+
 	if (port_is_enabled(p)) {
 		port_cancel_unicast(p);
 		port_disable(p);
 	}
 
-	if (p->fda.fd[FD_RTNL] >= 0) {
-		rtnl_close(p->fda.fd[FD_RTNL]);
+	if (p->rtnl) {
+		/* Another port may take over the link monitor socket. */
+		q = rtnl_monitor_remove(p->rtnl);
+		if (q) {
+			q->fda.fd[FD_RTNL] = rtnl_listener_fd(q->rtnl);
+			clock_fda_changed(q->clock);
+		}
 	}
 
+	if (p->telemetry) {
+		telemetry_clear_port(p->telemetry, portnum(p));
+		telemetry_close(p->telemetry);
+	}
 	unicast_client_cleanup(p);
 	unicast_service_cleanup(p);
+	free(p->stats_track);
+	stats_destroy(p->offset_stats);
+	stats_destroy(p->delay_stats);
+	if (p->ratectl) {
+		ratectl_destroy(p->ratectl);
+	}
 	transport_destroy(p->trp);
 	tsproc_destroy(p->tsproc);
 	if (p->fault_fd >= 0) {
@@ -2873,12 +3681,12 @@ struct foreign_clock *port_compute_best(struct port *p)
 
 static void port_e2e_transition(struct port *p, enum port_state next)
 {
-	port_clr_tmo(p->fda.fd[FD_ANNOUNCE_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_RX_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_DELAY_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_QUALIFICATION_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_MANNO_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_TX_TIMER]);
+	port_clr_tmo(p, FD_ANNOUNCE_TIMER);
+	port_clr_tmo(p, FD_SYNC_RX_TIMER);
+	port_clr_tmo(p, FD_DELAY_TIMER);
+	port_clr_tmo(p, FD_QUALIFICATION_TIMER);
+	port_clr_tmo(p, FD_MANNO_TIMER);
+	port_clr_tmo(p, FD_SYNC_TX_TIMER);
 	/* Leave FD_UNICAST_REQ_TIMER running. */
 
 	switch (next) {
@@ -2898,7 +3706,7 @@ static void port_e2e_transition(struct port *p, enum port_state next)
 	case PS_MASTER:
 	case PS_GRAND_MASTER:
 		if (!p->inhibit_announce) {
-			set_tmo_log(p->fda.fd[FD_MANNO_TIMER], 1, -10); /*~1ms*/
+			port_set_tmo_log(p, FD_MANNO_TIMER, 1, -10); /*~1ms*/
 		}
 		port_set_sync_tx_tmo(p);
 		sad_set_last_seqid(clock_config(p->clock), p->spp, -1);
@@ -2920,12 +3728,12 @@ static void port_e2e_transition(struct port *p, enum port_state next)
 
 static void port_p2p_transition(struct port *p, enum port_state next)
 {
-	port_clr_tmo(p->fda.fd[FD_ANNOUNCE_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_RX_TIMER]);
+	port_clr_tmo(p, FD_ANNOUNCE_TIMER);
+	port_clr_tmo(p, FD_SYNC_RX_TIMER);
 	/* Leave FD_DELAY_TIMER running. */
-	port_clr_tmo(p->fda.fd[FD_QUALIFICATION_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_MANNO_TIMER]);
-	port_clr_tmo(p->fda.fd[FD_SYNC_TX_TIMER]);
+	port_clr_tmo(p, FD_QUALIFICATION_TIMER);
+	port_clr_tmo(p, FD_MANNO_TIMER);
+	port_clr_tmo(p, FD_SYNC_TX_TIMER);
 	/* Leave FD_UNICAST_REQ_TIMER running. */
 
 	switch (next) {
@@ -2950,7 +3758,7 @@ static void port_p2p_transition(struct port *p, enum port_state next)
 	case PS_MASTER:
 	case PS_GRAND_MASTER:
 		if (!p->inhibit_announce) {
-			set_tmo_log(p->fda.fd[FD_MANNO_TIMER], 1, -10); /*~1ms*/
+			port_set_tmo_log(p, FD_MANNO_TIMER, 1, -10); /*~1ms*/
 		}
 		port_set_sync_tx_tmo(p);
 		sad_set_last_seqid(clock_config(p->clock), p->spp, -1);
@@ -2972,6 +3780,9 @@ static void port_p2p_transition(struct port *p, enum port_state next)
 void port_dispatch(struct port *p, enum fsm_event event, int mdiff)
 {
 	p->dispatch(p, event, mdiff);
+	port_telemetry_publish(p);
+	/* The clock dispatches to every port after a BMC decision. */
+	port_telemetry_update_clock(p);
 }
 
 static void bc_dispatch(struct port *p, enum fsm_event event, int mdiff)
@@ -3088,7 +3899,146 @@ void port_link_status(void *ctx, int linkup, int ts_index)
 
 enum fsm_event port_event(struct port *p, int fd_index)
 {
-	return p->event(p, fd_index);
+	enum fsm_event event;
+	int id;
+
+	if (fd_index == FD_FIRST_TIMER && p->timers) {
+		id = timerq_expired(p->timers);
+		if (id < 0) {
+			return EV_NONE;
+		}
+		fd_index = FD_FIRST_TIMER + id;
+	}
+	event = p->event(p, fd_index);
+	port_telemetry_publish(p);
+	return event;
+}
+
+/*
+ * Accounts the time spent on the messages which the slave fast path can
+ * handle, for the comparison printed at the summary interval. Only done
+ * with rx_path_stats enabled, as the clock reads cost time themselves.
+ */
+static void port_rx_cost(struct port *p, struct ptp_message *m,
+			 struct timespec *begin)
+{
+	struct timespec now;
+
+	if (!p->rx_path_stats) {
+		return;
+	}
+	if (p->state != PS_SLAVE && p->state != PS_UNCALIBRATED) {
+		return;
+	}
+	switch (msg_type(m)) {
+	case SYNC:
+	case FOLLOW_UP:
+	case DELAY_RESP:
+		break;
+	default:
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	p->rx_ns += (now.tv_sec - begin->tv_sec) * NS_PER_SEC +
+		now.tv_nsec - begin->tv_nsec;
+	p->rx_count++;
+}
+
+static enum fsm_event port_rx_sync(struct port *p, struct ptp_message *m)
+{
+	process_sync(p, m);
+	if (p->state == PS_SLAVE && dds_domainNumber_get(p->clock) == 1) {
+		sync_state_shm_update(slave_servo_stable_shm_get(p->clock), 1, 1);
+	}
+	return EV_NONE;
+}
+
+static enum fsm_event port_rx_follow_up(struct port *p, struct ptp_message *m)
+{
+	process_follow_up(p, m);
+	return EV_NONE;
+}
+
+static enum fsm_event port_rx_delay_resp(struct port *p, struct ptp_message *m)
+{
+	process_delay_resp(p, m);
+	return EV_NONE;
+}
+
+/*
+ * The subset of port_ignore() that applies to the messages of the fast
+ * path. UDS, gPTP and path trace checks have been ruled out in advance.
+ */
+static int port_fast_ignore(struct port *p, struct ptp_message *m)
+{
+	struct ClockIdentity c1, c2;
+
+	if (p->match_transport_specific &&
+	    msg_transport_specific(m) != p->transportSpecific) {
+		return 1;
+	}
+	if (pid_eq(&m->header.sourcePortIdentity, &p->portIdentity)) {
+		return 1;
+	}
+	if (m->header.domainNumber != clock_domain_number(p->clock)) {
+		return 1;
+	}
+	c1 = clock_identity(p->clock);
+	c2 = m->header.sourcePortIdentity.clockIdentity;
+
+	return cid_eq(&c1, &c2);
+}
+
+/*
+ * Receives a Sync, Follow_Up or Delay_Resp message of the current
+ * master. The port has no security, so there is nothing to
+ * authenticate.
+ */
+static enum fsm_event port_fast_event(struct port *p, struct ptp_message *msg)
+{
+	if (port_fast_ignore(p, msg)) {
+		port_tlv_skip(p, msg);
+		return EV_NONE;
+	}
+	if (msg_sots_missing(msg)) {
+		pr_err("%s: received %s without timestamp",
+		       p->log_name, msg_type_string(msg_type(msg)));
+		port_tlv_skip(p, msg);
+		return EV_NONE;
+	}
+	if (port_tlv_parse(p, msg)) {
+		pr_err("%s: bad message", p->log_name);
+		return EV_NONE;
+	}
+	if (msg_sots_valid(msg)) {
+		ts_add(&msg->hwts.ts, -p->rx_timestamp_offset);
+		if (p->state == PS_SLAVE) {
+			clock_check_ts(p->clock,
+				       tmv_to_nanoseconds(msg->hwts.ts));
+		}
+	}
+	return p->fast_rx[msg_type(msg)](p, msg);
+}
+
+/*
+ * Installs the fast path handlers that the port configuration permits.
+ * Messages without a handler take the generic path of bc_event().
+ */
+static void port_fast_rx_init(struct port *p, struct config *cfg)
+{
+	memset(p->fast_rx, 0, sizeof(p->fast_rx));
+
+	if (!config_get_int(cfg, p->name, "slave_fast_path")) {
+		return;
+	}
+	if (port_is_uds(p) || port_has_security(p) || p->follow_up_info) {
+		return;
+	}
+	p->fast_rx[SYNC] = port_rx_sync;
+	p->fast_rx[FOLLOW_UP] = port_rx_follow_up;
+	if (p->delayMechanism == DM_E2E) {
+		p->fast_rx[DELAY_RESP] = port_rx_delay_resp;
+	}
 }
 
 static enum fsm_event bc_event(struct port *p, int fd_index)
@@ -3096,6 +4046,7 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 	enum fsm_event event = EV_NONE;
 	struct ptp_message *msg, *dup = NULL;
 	int cnt, fd = p->fda.fd[fd_index], err;
+	struct timespec begin;
 	
 	switch (fd_index) {
 	case FD_ANNOUNCE_TIMER:
@@ -3126,11 +4077,11 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		 * state transition. So, it won't be cleared anywhere else.
 		 */
 		if (p->bmca == BMCA_NOOP) {
-			port_clr_tmo(p->fda.fd[FD_SYNC_RX_TIMER]);
+			port_clr_tmo(p, FD_SYNC_RX_TIMER);
 		}
 
 		if (p->inhibit_announce) {
-			port_clr_tmo(p->fda.fd[FD_ANNOUNCE_TIMER]);
+			port_clr_tmo(p, FD_ANNOUNCE_TIMER);
 		} else {
 			port_set_announce_tmo(p);
 		}
@@ -3208,13 +4159,20 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		p->service_stats.unicast_request_timeout++;
 		return unicast_client_timer(p) ? EV_FAULT_DETECTED : EV_NONE;
 
+	case FD_MONITOR_TIMER:
+		pr_debug("%s: slave event monitor timeout", p->log_name);
+		monitor_timeout(p->slave_event_monitor);
+		port_set_monitor_tmo(p);
+		return EV_NONE;
+
 	case FD_CMLDS:
 		pr_debug("%s: CMLDS push notification", p->log_name);
 		return process_cmlds(p) ? EV_FAULT_DETECTED : EV_NONE;
 
 	case FD_RTNL:
 		pr_debug("%s: received link status notification", p->log_name);
-		rtnl_link_status(fd, p->name, port_link_status, p);
+		if (rtnl_monitor_process(p->rtnl) <= 0)
+			return EV_NONE;
 		if (p->link_status == (LINK_UP | LINK_STATE_CHANGED))
 			return EV_FAULT_CLEARED;
 		else if ((p->link_status == (LINK_DOWN | LINK_STATE_CHANGED)) ||
@@ -3236,6 +4194,9 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		msg_put(msg);
 		return EV_FAULT_DETECTED;
 	}
+	if (p->rx_path_stats) {
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+	}
 	if (port_has_security(p)) {
 		dup = msg_duplicate(msg, 0);
 		if (!dup) {
@@ -3243,7 +4204,7 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 			return EV_NONE;
 		}
 	}
-	err = msg_post_recv(msg, cnt);
+	err = msg_post_recv_lazy(msg, cnt);
 	if (err) {
 		switch (err) {
 		case -EBADMSG:
@@ -3260,7 +4221,15 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		return EV_NONE;
 	}
 	port_stats_inc_rx(p, msg);
+	if (p->fast_rx[msg_type(msg)] &&
+	    (p->state == PS_SLAVE || p->state == PS_UNCALIBRATED)) {
+		event = port_fast_event(p, msg);
+		port_rx_cost(p, msg, &begin);
+		msg_put(msg);
+		return event;
+	}
 	if (port_ignore(p, msg)) {
+		port_tlv_skip(p, msg);
 		msg_put(msg);
 		if (dup) {
 			msg_put(dup);
@@ -3271,6 +4240,23 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 	    !(p->timestamping == TS_P2P1STEP && msg_type(msg) == PDELAY_REQ)) {
 		pr_err("%s: received %s without timestamp",
 		       p->log_name, msg_type_string(msg_type(msg)));
+		port_tlv_skip(p, msg);
+		msg_put(msg);
+		if (dup) {
+			msg_put(dup);
+		}
+		return EV_NONE;
+	}
+	err = port_tlv_parse(p, msg);
+	if (err) {
+		switch (err) {
+		case -EBADMSG:
+			pr_err("%s: bad message", p->log_name);
+			break;
+		case -EPROTO:
+			pr_debug("%s: ignoring message", p->log_name);
+			break;
+		}
 		msg_put(msg);
 		if (dup) {
 			msg_put(dup);
@@ -3303,10 +4289,7 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 
 	switch (msg_type(msg)) {
 	case SYNC:
-		process_sync(p, msg);
-		if(p->state==PS_SLAVE && dds_domainNumber_get(p->clock)==1) {
-		  sync_state_shm_update(slave_servo_stable_shm_get(p->clock), 1, 1);
-		}
+		event = port_rx_sync(p, msg);
 		break;
 	case DELAY_REQ:
 		if (process_delay_req(p, msg))
@@ -3344,6 +4327,7 @@ static enum fsm_event bc_event(struct port *p, int fd_index)
 		break;
 	}
 
+	port_rx_cost(p, msg, &begin);
 	msg_put(msg);
 	if (dup) {
 		msg_put(dup);
@@ -3365,7 +4349,7 @@ int port_forward(struct port *p, struct ptp_message *msg)
 int port_forward_to(struct port *p, struct ptp_message *msg)
 {
 	int cnt;
-	cnt = transport_sendto(p->trp, &p->fda, TRANS_GENERAL, msg);
+	cnt = transport_sendto(p->trp, &p->fda, TRANS_GENERAL_NOWAIT, msg);
 	if (cnt < 0) {
 		return cnt;
 	} else if (!cnt) {
@@ -3388,6 +4372,29 @@ int port_prepare_and_send(struct port *p, struct ptp_message *msg,
 	if (cnt) {
 		return -1;
 	}
+	return port_send(p, msg, event);
+}
+
+/*
+ * Sends a pre-encoded message again, after its variable fields have been
+ * updated by msg_pre_resend(). Authentication TLVs already present in
+ * the message get a fresh ICV.
+ */
+static int port_resend(struct port *p, struct ptp_message *msg,
+		       enum transport_event event)
+{
+	if (port_has_security(p) &&
+	    sad_update_auth_tlv(clock_config(p->clock), msg)) {
+		return -1;
+	}
+	return port_send(p, msg, event);
+}
+
+static int port_send(struct port *p, struct ptp_message *msg,
+		     enum transport_event event)
+{
+	int cnt;
+
 	if (msg_unicast(msg)) {
 		cnt = transport_sendto(p->trp, &p->fda, event, msg);
 	} else {
@@ -3408,6 +4415,70 @@ struct PortIdentity port_identity(struct port *p)
 	return p->portIdentity;
 }
 
+static struct ratectl *port_ratectl_create(struct port *p, struct config *cfg)
+{
+	return ratectl_create(
+		config_get_int(cfg, p->name, "logSyncInterval"),
+		config_get_int(cfg, p->name, "adaptive_rate_maxLogSyncInterval"),
+		config_get_int(cfg, p->name, "logMinPdelayReqInterval"),
+		config_get_int(cfg, p->name, "adaptive_rate_maxLogPdelayReqInterval"),
+		config_get_int(cfg, p->name, "adaptive_rate_threshold"),
+		config_get_int(cfg, p->name, "adaptive_rate_window"));
+}
+
+int port_reload(struct port *p)
+{
+	struct config *cfg = clock_config(p->clock);
+	struct ratectl *ratectl = NULL;
+	struct tsproc *tsproc;
+
+	tsproc = tsproc_create(config_get_int(cfg, p->name, "tsproc_mode"),
+			       config_get_int(cfg, p->name, "delay_filter"),
+			       config_get_int(cfg, p->name, "delay_filter_length"));
+	if (!tsproc) {
+		pr_err("%s: failed to create time stamp processor", p->log_name);
+		return -1;
+	}
+	if (!port_is_uds(p) && config_get_int(cfg, p->name, "adaptive_rate")) {
+		ratectl = port_ratectl_create(p, cfg);
+		if (!ratectl) {
+			pr_err("%s: failed to create rate controller", p->log_name);
+			goto err_tsproc;
+		}
+	}
+	if (!port_is_uds(p) && unicast_client_reload(p)) {
+		goto err_ratectl;
+	}
+	tsproc_destroy(p->tsproc);
+	p->tsproc = tsproc;
+	if (p->ratectl) {
+		ratectl_destroy(p->ratectl);
+	}
+	p->ratectl = ratectl;
+
+	/* The rate controller takes over the interval requests. */
+	p->msg_interval_request = config_get_int(cfg, p->name, "msg_interval_request");
+	if (p->ratectl) {
+		p->msg_interval_request = 0;
+	}
+
+	p->asymmetry = config_get_int(cfg, p->name, "delayAsymmetry");
+	p->asymmetry <<= 16;
+	p->rx_timestamp_offset = config_get_int(cfg, p->name, "ingressLatency");
+	p->rx_timestamp_offset <<= 16;
+	p->tx_timestamp_offset = config_get_int(cfg, p->name, "egressLatency");
+	p->tx_timestamp_offset <<= 16;
+	return 0;
+
+err_ratectl:
+	if (ratectl) {
+		ratectl_destroy(ratectl);
+	}
+err_tsproc:
+	tsproc_destroy(tsproc);
+	return -1;
+}
+
 int port_number(struct port *p)
 {
 	return portnum(p);
@@ -3433,6 +4504,19 @@ int port_manage(struct port *p, struct port *ingress, struct ptp_message *msg)
 	}
 	mgt = (struct management_tlv *) msg->management.suffix;
 
+	/*
+	 * The bulk statistics cover every port, the clock statistics and
+	 * the servo gains belong to the clock, and the configuration is
+	 * reloaded for all of them, so one answer is enough.
+	 */
+	if ((mgt->id == MID_PORT_STATS_BULK_NP ||
+	     mgt->id == MID_CLOCK_STATS_NP ||
+	     mgt->id == MID_SERVO_GAINS_NP ||
+	     mgt->id == MID_RELOAD_CONFIG_NP) && target == 0xffff &&
+	    p != clock_first_port(p->clock)) {
+		return 0;
+	}
+
 	switch (management_action(msg)) {
 	case GET:
 		if (port_management_get_response(p, ingress, mgt->id, msg))
@@ -3443,6 +4527,8 @@ int port_manage(struct port *p, struct port *ingress, struct ptp_message *msg)
 			return 1;
 		break;
 	case COMMAND:
+		if (port_management_command(p, ingress, mgt->id, msg))
+			return 1;
 		break;
 	default:
 		return -1;
@@ -3467,6 +4553,9 @@ int port_manage(struct port *p, struct port *ingress, struct ptp_message *msg)
 	case MID_TRANSPARENT_CLOCK_PORT_DATA_SET:
 	case MID_DELAY_MECHANISM:
 	case MID_LOG_MIN_PDELAY_REQ_INTERVAL:
+	case MID_CLOCK_STATS_NP:
+	case MID_SERVO_GAINS_NP:
+	case MID_RELOAD_CONFIG_NP:
 		port_management_send_error(p, ingress, msg, MID_NOT_SUPPORTED);
 		break;
 	default:
@@ -3606,6 +4695,7 @@ struct port *port_open(const char *phc_device,
 	enum clock_type type = clock_type(clock);
 	struct config *cfg = clock_config(clock);
 	struct port *p = malloc(sizeof(*p));
+	const char *shm_path;
 	int i;
 
 	if (!p) {
@@ -3793,6 +4883,30 @@ struct port *port_open(const char *phc_device,
 		goto err_uc_service;
 	}
 	p->nrate.ratio = 1.0;
+	port_fast_rx_init(p, cfg);
+	p->rx_path_stats = config_get_int(cfg, p->name, "rx_path_stats");
+
+	if (!port_is_uds(p) && config_get_int(cfg, p->name, "adaptive_rate")) {
+		p->ratectl = port_ratectl_create(p, cfg);
+		if (!p->ratectl) {
+			pr_err("%s: failed to create rate controller", p->log_name);
+			goto err_tsproc;
+		}
+		if (p->msg_interval_request) {
+			pr_warning("%s: msg_interval_request is ignored with adaptive_rate",
+				   p->log_name);
+			p->msg_interval_request = 0;
+		}
+	}
+
+	if (!port_is_uds(p)) {
+		p->offset_stats = stats_create();
+		p->delay_stats = stats_create();
+		if (!p->offset_stats || !p->delay_stats) {
+			pr_err("failed to create stats");
+			goto err_stats;
+		}
+	}
 
 	port_clear_fda(p, N_POLLFD);
 	p->fault_fd = -1;
@@ -3800,11 +4914,33 @@ struct port *port_open(const char *phc_device,
 		p->fault_fd = timerfd_create(CLOCK_MONOTONIC, 0);
 		if (p->fault_fd < 0) {
 			pr_err("timerfd_create failed: %m");
-			goto err_tsproc;
+			goto err_stats;
+		}
+	}
+	shm_path = config_get_string(cfg, NULL, "telemetry_shm");
+	if (shm_path[0] && !port_is_uds(p)) {
+		if (number > TELEMETRY_MAX_PORT) {
+			pr_err("%s: no telemetry record, port number too large",
+			       p->log_name);
+		} else {
+			p->telemetry = telemetry_open(shm_path, true);
+			if (!p->telemetry) {
+				goto err_fault_fd;
+			}
 		}
 	}
 	return p;
 
+err_fault_fd:
+	if (p->fault_fd >= 0) {
+		close(p->fault_fd);
+	}
+err_stats:
+	stats_destroy(p->offset_stats);
+	stats_destroy(p->delay_stats);
+	if (p->ratectl) {
+		ratectl_destroy(p->ratectl);
+	}
 err_tsproc:
 	tsproc_destroy(p->tsproc);
 err_uc_service:
@@ -26,6 +26,7 @@
 #include "notification.h"
 #include "transport.h"
 
+#define POW2_32 ((double)(1ULL << 32))
 #define POW2_41 ((double)(1ULL << 41))
 
 /* forward declarations */
@@ -97,6 +98,7 @@ int port_forward(struct port *p, struct ptp_message *msg);
 
 /**
  * Forward a message on a given port to the address stored in the message.
+ * The call never blocks, a busy receiver yields -EAGAIN.
  * @param port    A pointer previously obtained via port_open().
  * @param msg     The message to send. Must be in network byte order.
  * @return        Zero on success, negative errno value otherwise.
@@ -359,6 +361,17 @@ enum bmca_select port_bmca(struct port *p);
  */
 void tc_cleanup(void);
 
+/**
+ * Read the settings again which a port only takes when it is opened,
+ * namely the time stamp processor, the rate controller, the latencies,
+ * the delay asymmetry, and the unicast master table. The caller should
+ * re-initialize the port afterwards.
+ *
+ * @param port  A port instance.
+ * @return      Zero on success, non-zero otherwise.
+ */
+int port_reload(struct port *port);
+
 /**
  * Update port's unicast state if port's unicast_state_dirty is true.
  *
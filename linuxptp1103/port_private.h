@@ -23,11 +23,13 @@
 
 #include "as_capable.h"
 #include "clock.h"
+#include "cmlds_shm.h"
 #include "fsm.h"
 #include "monitor.h"
 #include "msg.h"
 #include "pmc_common.h"
 #include "power_profile.h"
+#include "telemetry.h"
 #include "tmv.h"
 #include "util.h"
 
@@ -60,6 +62,18 @@ struct tc_txd {
 	int ingress_port;
 };
 
+/* The data a pre-encoded multicast Announce message was built from. */
+struct port_announce_src {
+	struct timePropertiesDS tp;
+	struct parentDS pds;
+	UInteger16 steps_removed;
+	Integer8 log_interval;
+	UInteger32 key_id;
+	struct ieee_c37_238_settings_np pwr;
+	unsigned int path_length;
+	struct ClockIdentity ptl[PATH_TRACE_MAX];
+} PACKED;
+
 struct port {
 	LIST_ENTRY(port) list;
 	const char *name;
@@ -69,12 +83,18 @@ struct port {
 	struct transport *trp;
 	enum timestamp_type timestamping;
 	struct fdarray fda;
+	struct timerq *timers;
+	struct telemetry *telemetry;
+	struct telemetry_port telemetry_last;
+	struct rtnl_listener *rtnl;
 	int fault_fd;
 	int phc_index;
 	int phc_from_cmdline;
 
 	void (*dispatch)(struct port *p, enum fsm_event event, int mdiff);
 	enum fsm_event (*event)(struct port *p, int fd_index);
+	enum fsm_event (*fast_rx[MAX_MESSAGE_TYPES])(struct port *p,
+						     struct ptp_message *m);
 
 	int jbod;
 	struct foreign_clock *best;
@@ -126,6 +146,7 @@ struct port {
 	Integer8            logMinPdelayReqInterval;
 	Integer8            operLogPdelayReqInterval;
 	Integer8            logPdelayReqInterval;
+	struct ratectl      *ratectl;
 	UInteger32          neighborPropDelayThresh;
 	int                 follow_up_info;
 	int                 freq_est_interval;
@@ -152,6 +173,10 @@ struct port {
 	Integer64	    portAsymmetry;
 	struct PortStats    stats;
 	struct PortServiceStats    service_stats;
+	UInteger64          rxTlvDecoded;
+	UInteger64          rxTlvSkipped;
+	UInteger64          txtsTimeout;
+	struct port_stats_track *stats_track;
 	/* foreignMasterDS */
 	LIST_HEAD(fm, foreign_clock) foreign_masters;
 	/* TC book keeping */
@@ -172,11 +197,30 @@ struct port {
 		unsigned int timer_count;
 		time_t last_renewal;
 		struct pmc *pmc;
+		struct cmlds_shm *shm;
 		int port;
 	} cmlds;
+	/* tail statistics of the summary_interval, see CLOCK_STATS_NP */
+	struct stats *offset_stats;
+	struct stats *delay_stats;
+	struct clock_stats_np summary;
+	uint64_t summary_time;
+	/* receive path cost of Sync, Follow_Up and Delay_Resp */
+	int rx_path_stats;
+	uint64_t rx_ns;
+	uint64_t rx_count;
 	/* sync interval monitoring */
 	tmv_t last_sync_recv_time;
 	int sync_interval_exceed_count;
+	/* pre-encoded multicast messages */
+	struct {
+		struct ptp_message *sync;
+		struct ptp_message *fup;
+		Integer8 sync_interval;
+		UInteger32 sync_key_id;
+		struct ptp_message *announce;
+		struct port_announce_src announce_src;
+	} tmpl;
 };
 
 #define portnum(p) (p->portIdentity.portNumber)
@@ -193,7 +237,7 @@ void fc_clear(struct foreign_clock *fc);
 void flush_delay_req(struct port *p);
 void flush_last_sync(struct port *p);
 int port_capable(struct port *p);
-int port_clr_tmo(int fd);
+int port_clr_tmo(struct port *p, int index);
 int port_delay_request(struct port *p);
 void port_disable(struct port *p);
 int port_initialize(struct port *p);
@@ -203,6 +247,9 @@ int port_set_announce_tmo(struct port *p);
 int port_set_delay_tmo(struct port *p);
 int port_set_qualification_tmo(struct port *p);
 int port_set_sync_rx_tmo(struct port *p);
+int port_set_tmo_abs(struct port *p, int index, struct timespec *ts);
+int port_set_tmo_log(struct port *p, int index,
+		     unsigned int scale, int log_seconds);
 void port_show_transition(struct port *p, enum port_state next,
 			  enum fsm_event event);
 struct ptp_message *port_signaling_uc_construct(struct port *p,
@@ -29,7 +29,9 @@
 #include "pi.h"
 #include "print.h"
 #include "raw.h"
+#include "reload.h"
 #include "sad.h"
+#include "servo.h"
 #include "sk.h"
 #include "transport.h"
 #include "udp6.h"
@@ -254,11 +256,29 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+	if (servo_state_attach(clock_servo(clock), cfg, req_phc ? req_phc :
+			       interface_label(STAILQ_FIRST(&cfg->interfaces)))) {
+		goto out;
+	}
+
+	if (handle_reload_signal()) {
+		goto out;
+	}
+
 	err = 0;
 
 	while (is_running()) {
 		if (clock_poll(clock))
 			break;
+		servo_state_flush(clock_servo(clock));
+		if (!reload_requested()) {
+			continue;
+		}
+		if (!config) {
+			pr_warning("no configuration file to reload");
+			continue;
+		}
+		reload_clock(clock, config);
 	}
 out:
 	if (clock)
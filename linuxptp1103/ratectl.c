@@ -0,0 +1,232 @@
+/**
+ * @file ratectl.c
+ * @brief Adapts the Sync and Pdelay rates of a port to the path stability.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The Sync rate follows the time error that builds up between two Sync
+ * messages. For offsets x sampled at the interval tau, the second
+ * difference x[i] - 2 x[i-1] + x[i-2] has a variance of 2 tau^2 times
+ * the Allan variance at tau, so its RMS value divided by the square
+ * root of two is the expected error over one interval. When that error
+ * exceeds the threshold the controller asks for twice the rate, and
+ * when it stays well below the threshold for a whole window it asks
+ * for half the rate. The peer delay rate follows the standard
+ * deviation of the raw path delay in the same way.
+ */
+#include <math.h>
+#include <stdlib.h>
+
+#include "ratectl.h"
+
+/* Slow down only while the error is this many times below the threshold. */
+#define RATECTL_HYSTERESIS	3
+/* A single error this many times the threshold returns to the fastest rate. */
+#define RATECTL_DISTURBANCE	4
+
+struct ratectl {
+	int min_sync;
+	int max_sync;
+	int min_pdelay;
+	int max_pdelay;
+	double threshold;
+	int window;
+
+	/* The chosen intervals */
+	int sync;
+	int pdelay;
+
+	/* Second differences of the offset at one Sync interval */
+	int tau_log;
+	int64_t x1;
+	int64_t x2;
+	int nx;
+	double sum_d2;
+	int n_d2;
+
+	/* Running variance of the raw path delay */
+	double mean;
+	double m2;
+	int n_delay;
+
+	struct ratectl_stats stats;
+};
+
+static int clamp(int val, int min, int max)
+{
+	if (val < min) {
+		return min;
+	}
+	if (val > max) {
+		return max;
+	}
+	return val;
+}
+
+static uint64_t saved(int log_interval, int min)
+{
+	int shift = log_interval - min;
+
+	if (shift <= 0) {
+		return 0;
+	}
+	if (shift > 62) {
+		shift = 62;
+	}
+	return (1ULL << shift) - 1;
+}
+
+static int ratectl_set(struct ratectl *rc, int sync, int pdelay)
+{
+	if (rc->sync == sync && rc->pdelay == pdelay) {
+		return 0;
+	}
+	rc->sync = sync;
+	rc->pdelay = pdelay;
+	rc->stats.changes++;
+	return 1;
+}
+
+static void ratectl_clear_sync(struct ratectl *rc)
+{
+	rc->nx = 0;
+	rc->sum_d2 = 0.0;
+	rc->n_d2 = 0;
+}
+
+static void ratectl_clear_delay(struct ratectl *rc)
+{
+	rc->mean = 0.0;
+	rc->m2 = 0.0;
+	rc->n_delay = 0;
+}
+
+struct ratectl *ratectl_create(int min_sync, int max_sync,
+			       int min_pdelay, int max_pdelay,
+			       int threshold, int window)
+{
+	struct ratectl *rc;
+
+	if (threshold <= 0 || window < 2) {
+		return NULL;
+	}
+	rc = calloc(1, sizeof(*rc));
+	if (!rc) {
+		return NULL;
+	}
+	rc->min_sync = min_sync;
+	rc->max_sync = max_sync > min_sync ? max_sync : min_sync;
+	rc->min_pdelay = min_pdelay;
+	rc->max_pdelay = max_pdelay > min_pdelay ? max_pdelay : min_pdelay;
+	rc->threshold = threshold;
+	rc->window = window;
+	rc->sync = min_sync;
+	rc->pdelay = min_pdelay;
+	return rc;
+}
+
+void ratectl_destroy(struct ratectl *rc)
+{
+	free(rc);
+}
+
+int ratectl_reset(struct ratectl *rc)
+{
+	ratectl_clear_sync(rc);
+	ratectl_clear_delay(rc);
+	return ratectl_set(rc, rc->min_sync, rc->min_pdelay);
+}
+
+int ratectl_sync_sample(struct ratectl *rc, int64_t offset, int log_interval)
+{
+	double d2, err, tau;
+	int next;
+
+	rc->stats.sync_saved += saved(log_interval, rc->min_sync);
+
+	/* Samples taken at different intervals do not mix. */
+	if (rc->nx && log_interval != rc->tau_log) {
+		ratectl_clear_sync(rc);
+	}
+	rc->tau_log = log_interval;
+
+	if (rc->nx >= 2) {
+		d2 = (double) offset - 2.0 * rc->x1 + rc->x2;
+		if (fabs(d2) > RATECTL_DISTURBANCE * rc->threshold) {
+			return ratectl_reset(rc);
+		}
+		rc->sum_d2 += d2 * d2;
+		rc->n_d2++;
+	}
+	rc->x2 = rc->x1;
+	rc->x1 = offset;
+	rc->nx++;
+
+	if (rc->n_d2 < rc->window) {
+		return 0;
+	}
+	err = sqrt(rc->sum_d2 / (2.0 * rc->n_d2));
+	tau = ldexp(1.0, log_interval);
+	rc->stats.adev = err / tau * 1e-9;
+	rc->sum_d2 = 0.0;
+	rc->n_d2 = 0;
+
+	next = log_interval;
+	if (err > rc->threshold) {
+		next--;
+	} else if (err * RATECTL_HYSTERESIS < rc->threshold) {
+		next++;
+	}
+	next = clamp(next, rc->min_sync, rc->max_sync);
+
+	return ratectl_set(rc, next, rc->pdelay);
+}
+
+int ratectl_delay_sample(struct ratectl *rc, int64_t delay, int pdelay)
+{
+	double delta, pdv;
+	int next;
+
+	if (pdelay) {
+		rc->stats.pdelay_saved += saved(rc->pdelay, rc->min_pdelay);
+	}
+
+	rc->n_delay++;
+	delta = delay - rc->mean;
+	rc->mean += delta / rc->n_delay;
+	rc->m2 += delta * (delay - rc->mean);
+
+	if (rc->n_delay < rc->window) {
+		return 0;
+	}
+	pdv = sqrt(rc->m2 / (rc->n_delay - 1));
+	rc->stats.pdv = pdv;
+	ratectl_clear_delay(rc);
+
+	if (!pdelay) {
+		return 0;
+	}
+	next = rc->pdelay;
+	if (pdv > rc->threshold) {
+		next--;
+	} else if (pdv * RATECTL_HYSTERESIS < rc->threshold) {
+		next++;
+	}
+	next = clamp(next, rc->min_pdelay, rc->max_pdelay);
+
+	return ratectl_set(rc, rc->sync, next);
+}
+
+int ratectl_sync_interval(struct ratectl *rc)
+{
+	return rc->sync;
+}
+
+int ratectl_pdelay_interval(struct ratectl *rc)
+{
+	return rc->pdelay;
+}
+
+void ratectl_get_stats(struct ratectl *rc, struct ratectl_stats *stats)
+{
+	*stats = rc->stats;
+}
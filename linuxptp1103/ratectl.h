@@ -0,0 +1,99 @@
+/**
+ * @file ratectl.h
+ * @brief Adapts the Sync and Pdelay rates of a port to the path stability.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_RATECTL_H
+#define HAVE_RATECTL_H
+
+#include <stdint.h>
+
+struct ratectl;
+
+/**
+ * Counters and estimates reported by a rate controller.
+ */
+struct ratectl_stats {
+	/** Allan deviation at the current Sync interval. */
+	double adev;
+	/** Standard deviation of the raw path delay, in nanoseconds. */
+	double pdv;
+	/** Number of times the rates were changed. */
+	uint32_t changes;
+	/** Sync messages not received compared to the fastest rate. */
+	uint64_t sync_saved;
+	/** Peer delay exchanges not made compared to the fastest rate. */
+	uint64_t pdelay_saved;
+};
+
+/**
+ * Creates a new rate controller.
+ *
+ * The fastest rates are used until a full window of samples shows
+ * that the path is stable enough for a slower rate. A slowest interval
+ * below the fastest one pins the rate to the fastest interval.
+ *
+ * @param min_sync    Fastest logSyncInterval that may be requested.
+ * @param max_sync    Slowest logSyncInterval that may be requested.
+ * @param min_pdelay  Fastest logPdelayReqInterval that may be used.
+ * @param max_pdelay  Slowest logPdelayReqInterval that may be used.
+ * @param threshold   Largest acceptable time error between two Sync
+ *                    messages, in nanoseconds.
+ * @param window      Number of samples in each estimate.
+ * @return            Pointer to a new controller on success, NULL otherwise.
+ */
+struct ratectl *ratectl_create(int min_sync, int max_sync,
+			       int min_pdelay, int max_pdelay,
+			       int threshold, int window);
+
+/**
+ * Destroys a rate controller.
+ * @param rc  A pointer obtained via @ref ratectl_create().
+ */
+void ratectl_destroy(struct ratectl *rc);
+
+/**
+ * Returns to the fastest rates and discards the collected samples.
+ * @param rc  A pointer obtained via @ref ratectl_create().
+ * @return    One if the rates were changed, zero otherwise.
+ */
+int ratectl_reset(struct ratectl *rc);
+
+/**
+ * Feeds the offset from the master measured with a Sync message.
+ * @param rc      A pointer obtained via @ref ratectl_create().
+ * @param offset  Offset from the master, in nanoseconds.
+ * @param log_interval  The logMessageInterval of the Sync message.
+ * @return        One if the rates were changed, zero otherwise.
+ */
+int ratectl_sync_sample(struct ratectl *rc, int64_t offset, int log_interval);
+
+/**
+ * Feeds a raw path delay measurement.
+ * @param rc      A pointer obtained via @ref ratectl_create().
+ * @param delay   The raw path delay, in nanoseconds.
+ * @param pdelay  True if the delay was measured with a peer delay exchange.
+ * @return        One if the rates were changed, zero otherwise.
+ */
+int ratectl_delay_sample(struct ratectl *rc, int64_t delay, int pdelay);
+
+/**
+ * Returns the logSyncInterval chosen by the controller.
+ * @param rc  A pointer obtained via @ref ratectl_create().
+ */
+int ratectl_sync_interval(struct ratectl *rc);
+
+/**
+ * Returns the logPdelayReqInterval chosen by the controller.
+ * @param rc  A pointer obtained via @ref ratectl_create().
+ */
+int ratectl_pdelay_interval(struct ratectl *rc);
+
+/**
+ * Reads the counters and estimates of a controller.
+ * @param rc     A pointer obtained via @ref ratectl_create().
+ * @param stats  Returns the counters and estimates.
+ */
+void ratectl_get_stats(struct ratectl *rc, struct ratectl_stats *stats);
+
+#endif
@@ -151,10 +151,63 @@ static struct sock_filter raw_filter_vlan_norm_event[] = {
 #define FILTER_GENERAL_POS_SRC0 14
 #define FILTER_GENERAL_POS_SRC2 12
 
+#define FILTER_MAX_LEN 32
+
+/*
+ * Replaces the final "accept" of a filter program with a check of the
+ * domainNumber and, optionally, the transportSpecific field of the PTP
+ * header found behind the Ethernet header and an optional VLAN tag.
+ * Jumps to the final "reject" are moved past the inserted check.
+ */
+static int raw_filter_domain(struct sock_filter *dst,
+			     const struct sock_filter *src, int len,
+			     int domain, int ts)
+{
+	struct sock_filter check[] = {
+		BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 12),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_8021Q, 0, 2),
+		BPF_STMT(BPF_LDX | BPF_W   | BPF_IMM, VLAN_HLEN),
+		BPF_STMT(BPF_JMP | BPF_JA, 1),
+		BPF_STMT(BPF_LDX | BPF_W   | BPF_IMM, 0),
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_IND, sizeof(struct eth_hdr) + 4),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, domain, 0, 0),
+		BPF_STMT(BPF_LD  | BPF_B   | BPF_IND, sizeof(struct eth_hdr)),
+		BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xf0),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ts, 0, 0),
+	};
+	int i, n = 0, n_check = ts < 0 ? 7 : ARRAY_SIZE(check);
+	struct sock_filter *insn;
+
+	for (i = 0; i < len - 2; i++) {
+		insn = &dst[n++];
+		*insn = src[i];
+		if (BPF_CLASS(insn->code) != BPF_JMP ||
+		    BPF_OP(insn->code) == BPF_JA) {
+			continue;
+		}
+		if (i + 1 + insn->jt == len - 1) {
+			insn->jt += n_check;
+		}
+		if (i + 1 + insn->jf == len - 1) {
+			insn->jf += n_check;
+		}
+	}
+	/* A failed comparison at check[k] jumps to the final "reject". */
+	check[6].jf = n_check - 6;
+	check[9].jf = n_check - 9;
+	for (i = 0; i < n_check; i++) {
+		dst[n++] = check[i];
+	}
+	dst[n++] = src[len - 2];
+	dst[n++] = src[len - 1];
+	return n;
+}
+
 static int raw_configure(int fd, int event, int index,
 			 unsigned char *local_addr, unsigned char *addr1,
-			 unsigned char *addr2, int enable)
+			 unsigned char *addr2, int enable, int domain, int ts)
 {
+	struct sock_filter insn[FILTER_MAX_LEN];
 	int err1, err2, option;
 	struct packet_mreq mreq;
 	struct sock_fprog prg;
@@ -180,6 +233,11 @@ static int raw_configure(int fd, int event, int index,
 		prg.filter[FILTER_GENERAL_POS_SRC2].k =
 			ntohl(prg.filter[FILTER_GENERAL_POS_SRC2].k);
 	}
+	if (domain >= 0) {
+		prg.len = raw_filter_domain(insn, prg.filter, prg.len,
+					    domain, ts);
+		prg.filter = insn;
+	}
 
 	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prg, sizeof(prg))) {
 		pr_err("setsockopt SO_ATTACH_FILTER failed: %m");
@@ -236,7 +294,7 @@ static int raw_close(struct transport *t, struct fdarray *fda)
 
 static int open_socket(const char *name, int event, unsigned char *local_addr,
 		       unsigned char *ptp_dst_mac, unsigned char *p2p_dst_mac,
-		       int socket_priority)
+		       int socket_priority, int domain, int ts)
 {
 	struct sockaddr_ll addr;
 	int fd, index;
@@ -270,7 +328,7 @@ static int open_socket(const char *name, int event, unsigned char *local_addr,
 		goto no_option;
 	}
 	if (raw_configure(fd, event, index, local_addr, ptp_dst_mac,
-			  p2p_dst_mac, 1))
+			  p2p_dst_mac, 1, domain, ts))
 		goto no_option;
 
 	return fd;
@@ -351,7 +409,7 @@ static int raw_open(struct transport *t, struct interface *iface,
 	struct raw *raw = container_of(t, struct raw, t);
 	unsigned char ptp_dst_mac[MAC_LEN];
 	unsigned char p2p_dst_mac[MAC_LEN];
-	int efd, gfd, socket_priority;
+	int domain, efd, gfd, socket_priority, ts;
 	const char *name;
 	char *str;
 
@@ -373,14 +431,15 @@ static int raw_open(struct transport *t, struct interface *iface,
 		goto no_mac;
 
 	socket_priority = config_get_int(t->cfg, "global", "socket_priority");
+	domain = transport_domain_filter(t, name, &ts);
 
 	efd = open_socket(name, 1, raw->src_addr.sll.sll_addr, ptp_dst_mac,
-			  p2p_dst_mac, socket_priority);
+			  p2p_dst_mac, socket_priority, domain, ts);
 	if (efd < 0)
 		goto no_event;
 
 	gfd = open_socket(name, 0, raw->src_addr.sll.sll_addr, p2p_dst_mac,
-			  p2p_dst_mac, socket_priority);
+			  p2p_dst_mac, socket_priority, domain, ts);
 	if (gfd < 0)
 		goto no_general;
 
@@ -453,9 +512,13 @@ static int raw_send(struct transport *t, struct fdarray *fda,
 	ssize_t cnt;
 	unsigned char pkt[1600], *ptr = buf;
 	struct eth_hdr *hdr;
-	int fd = -1;
+	int fd = -1, flags = 0;
 
 	switch (event) {
+	case TRANS_GENERAL_NOWAIT:
+		flags = MSG_DONTWAIT;
+		event = TRANS_GENERAL;
+		/* fall through */
 	case TRANS_GENERAL:
 		fd = fda->fd[FD_GENERAL];
 		break;
@@ -479,7 +542,7 @@ static int raw_send(struct transport *t, struct fdarray *fda,
 
 	hdr->type = htons(ETH_P_1588);
 
-	cnt = send(fd, ptr, len, 0);
+	cnt = send(fd, ptr, len, flags);
 	if (cnt < 1) {
 		return -errno;
 	}
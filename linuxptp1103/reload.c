@@ -0,0 +1,235 @@
+/**
+ * @file reload.c
+ * @brief Applies a changed configuration file to a running clock.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "msg.h"
+#include "port.h"
+#include "port_private.h"
+#include "print.h"
+#include "reload.h"
+#include "servo.h"
+#include "sk.h"
+
+struct reload {
+	struct config *cfg;
+	int logging;
+	int servo;
+	int sk;
+	struct port *first;
+	/* One flag per port, in the order of the clock's list */
+	int *ports;
+};
+
+/* Options applied with the print_set_*() functions. */
+static const char *logging_options[] = {
+	"logging_level",
+	"message_tag",
+	"use_syslog",
+	"verbose",
+	NULL,
+};
+
+/* Options kept in global variables, read on every message. */
+static const char *sk_options[] = {
+	"assume_two_step",
+	"check_fup_sync",
+	"tx_timestamp_timeout",
+	NULL,
+};
+
+/* Options read by servo_reconfigure(). */
+static const char *servo_options[] = {
+	"first_step_threshold",
+	"max_frequency",
+	"pi_adaptive",
+	"pi_adaptive_max_factor",
+	"pi_adaptive_min_factor",
+	"pi_adaptive_noise_ref",
+	"pi_integral_const",
+	"pi_integral_exponent",
+	"pi_integral_norm_max",
+	"pi_integral_scale",
+	"pi_proportional_const",
+	"pi_proportional_exponent",
+	"pi_proportional_norm_max",
+	"pi_proportional_scale",
+	"servo_num_offset_values",
+	"servo_offset_threshold",
+	"step_threshold",
+	NULL,
+};
+
+/* Options read by port_reload() and port_initialize(). */
+static const char *port_options[] = {
+	"adaptive_rate",
+	"adaptive_rate_maxLogPdelayReqInterval",
+	"adaptive_rate_maxLogSyncInterval",
+	"adaptive_rate_threshold",
+	"adaptive_rate_window",
+	"announceReceiptTimeout",
+	"asCapable",
+	"busy_poll",
+	"delayAsymmetry",
+	"delay_filter",
+	"delay_filter_length",
+	"delay_response_timeout",
+	"egressLatency",
+	"G.8275.portDS.localPriority",
+	"ignore_source_id",
+	"ignore_transport_specific",
+	"ingressLatency",
+	"inhibit_announce",
+	"inhibit_delay_req",
+	"interface_rate_tlv",
+	"logAnnounceInterval",
+	"logMinDelayReqInterval",
+	"logMinPdelayReqInterval",
+	"logSyncInterval",
+	"min_neighbor_prop_delay",
+	"msg_interval_request",
+	"neighborPropDelayThresh",
+	"operLogPdelayReqInterval",
+	"operLogSyncInterval",
+	"syncReceiptTimeout",
+	"timer_slack",
+	"transportSpecific",
+	"tsproc_mode",
+	"unicast_req_duration",
+	NULL,
+};
+
+static int reload_match(const char **options, const char *option)
+{
+	for (; *options; options++) {
+		if (!strcmp(*options, option)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Marks the port with the given name, or every port for a global option. */
+static void reload_mark(struct reload *r, const char *section)
+{
+	struct port *p;
+	int i;
+
+	for (p = r->first, i = 0; p; p = LIST_NEXT(p, list), i++) {
+		if (!section || !strcmp(p->name, section)) {
+			r->ports[i] = 1;
+		}
+	}
+}
+
+static int reload_check(void *ctx, const char *section, const char *option)
+{
+	struct reload *r = ctx;
+
+	if (!option) {
+		reload_mark(r, section);
+		return 0;
+	}
+	if (reload_match(logging_options, option)) {
+		r->logging = 1;
+		return 0;
+	}
+	if (reload_match(sk_options, option)) {
+		r->sk = 1;
+		return 0;
+	}
+	if (reload_match(servo_options, option)) {
+		r->servo = 1;
+		return 0;
+	}
+	if (reload_match(port_options, option)) {
+		reload_mark(r, section);
+		return 0;
+	}
+	/* The unicast client and service force hybrid_e2e on. */
+	if (section && !strcmp(option, "hybrid_e2e") &&
+	    (config_get_int(r->cfg, section, "unicast_master_table") ||
+	     config_get_int(r->cfg, section, "unicast_listen"))) {
+		return -1;
+	}
+	pr_warning("%s%s%s changed, a restart is needed to apply it",
+		   section ? section : "", section ? ": " : "", option);
+	return -1;
+}
+
+int reload_clock(struct clock *c, const char *file)
+{
+	struct config *cfg = clock_config(c);
+	char *tag = NULL;
+	struct reload r;
+	struct port *p;
+	int i, n = 0;
+
+	memset(&r, 0, sizeof(r));
+	r.cfg = cfg;
+	r.first = clock_first_port(c);
+	for (p = r.first; p; p = LIST_NEXT(p, list)) {
+		n++;
+	}
+	r.ports = calloc(n + 1, sizeof(*r.ports));
+	if (!r.ports) {
+		pr_err("low memory");
+		return -1;
+	}
+
+	/* The print code keeps a pointer to the tag, which may be freed. */
+	if (config_get_string(cfg, NULL, "message_tag")) {
+		tag = strdup(config_get_string(cfg, NULL, "message_tag"));
+	}
+	print_set_tag(tag);
+
+	pr_notice("reloading configuration file %s", file);
+	n = config_reload(cfg, file, reload_check, &r);
+
+	print_set_tag(config_get_string(cfg, NULL, "message_tag"));
+	free(tag);
+	if (n < 0) {
+		free(r.ports);
+		return -1;
+	}
+
+	if (r.logging) {
+		print_set_verbose(config_get_int(cfg, NULL, "verbose"));
+		print_set_syslog(config_get_int(cfg, NULL, "use_syslog"));
+		print_set_level(config_get_int(cfg, NULL, "logging_level"));
+	}
+	if (r.sk) {
+		assume_two_step = config_get_int(cfg, NULL, "assume_two_step");
+		sk_check_fupsync = config_get_int(cfg, NULL, "check_fup_sync");
+		sk_tx_timeout = config_get_int(cfg, NULL, "tx_timestamp_timeout");
+	}
+	if (r.servo) {
+		servo_reconfigure(clock_servo(c), cfg);
+	}
+	for (p = r.first, i = 0; p; p = LIST_NEXT(p, list), i++) {
+		if (!r.ports[i]) {
+			continue;
+		}
+		if (port_reload(p)) {
+			pr_err("%s: failed to reload the port settings",
+			       p->log_name);
+		}
+		/* A disabled port takes the new values when it is enabled. */
+		if (port_state(p) == PS_DISABLED) {
+			continue;
+		}
+		pr_notice("%s: re-initializing with the new configuration",
+			  p->log_name);
+		port_dispatch(p, EV_INITIALIZE, 0);
+		clock_set_sde(c, 1);
+	}
+	pr_notice("configuration reloaded, %d change%s applied",
+		  n, n == 1 ? "" : "s");
+
+	free(r.ports);
+	return n;
+}
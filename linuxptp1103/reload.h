@@ -0,0 +1,25 @@
+/**
+ * @file reload.h
+ * @brief Applies a changed configuration file to a running clock.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_RELOAD_H
+#define HAVE_RELOAD_H
+
+#include "clock.h"
+
+/**
+ * Reads the configuration file again and applies the changes that are
+ * safe while running: the logging, the time stamp timeouts, the servo
+ * gains and thresholds, the port intervals, filters and latencies, and
+ * the unicast master tables. Only the ports whose settings changed are
+ * re-initialized. Any other change is reported and keeps its old value
+ * until the next restart.
+ *
+ * @param c     The clock.
+ * @param file  Path of the configuration file given at start up.
+ * @return      The number of changes applied, or -1 on error.
+ */
+int reload_clock(struct clock *c, const char *file);
+
+#endif
@@ -27,17 +27,25 @@
 #ifdef HAVE_IF_TEAM
 #include <linux/if_team.h>
 #endif
+#include <errno.h>
+#include <inttypes.h>
 #include <net/if.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/queue.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "hash.h"
 #include "missing.h"
 #include "print.h"
 #include "rtnl.h"
 
 #define BUF_SIZE 4096
+#define MONITOR_BUF_SIZE 65536
+#define NS_PER_SEC 1000000000LL
 #define GENLMSG_DATA(glh) ((void *)(NLMSG_DATA(glh) + GENL_HDRLEN))
 
 static int rtnl_len;
@@ -203,7 +211,43 @@ static inline int rtnl_nested_rtattr_parse(struct rtattr *tb[], int max, struct
 	return rtnl_rtattr_parse(tb, max, RTA_DATA(rta), RTA_PAYLOAD(rta));
 }
 
-static int rtnl_linkinfo_parse(int master_index, struct rtattr *rta)
+/* Link state of an interface watched by the monitor. */
+struct rtnl_link {
+	LIST_HEAD(listener_head, rtnl_listener) listeners;
+	int index;
+	int link_up;
+	/* Cached active port of a team, valid unless negative. */
+	int team_index;
+};
+
+struct rtnl_listener {
+	LIST_ENTRY(rtnl_listener) list;
+	LIST_ENTRY(rtnl_listener) all;
+	struct rtnl_monitor *monitor;
+	struct rtnl_link *link;
+	rtnl_callback cb;
+	void *ctx;
+	char device[IF_NAMESIZE];
+	/* Event file descriptor, or -1 for the listener reading the socket. */
+	int efd;
+	int pending;
+	int link_up;
+	int ts_index;
+	int64_t rx;
+};
+
+struct rtnl_monitor {
+	int fd;
+	struct hash *links;
+	struct rtnl_listener *reader;
+	LIST_HEAD(all_head, rtnl_listener) listeners;
+	char *buf;
+};
+
+static struct rtnl_monitor *rtnl_monitor;
+
+static int rtnl_linkinfo_parse(int master_index, struct rtattr *rta,
+			       struct rtnl_link *link)
 {
 	struct rtattr *linkinfo[IFLA_INFO_MAX+1];
 	struct rtattr *bond[IFLA_BOND_MAX+1];
@@ -226,7 +270,13 @@ static int rtnl_linkinfo_parse(int master_index, struct rtattr *rta)
 				index = rta_getattr_u32(bond[IFLA_BOND_ACTIVE_SLAVE]);
 			}
 		} else if (kind && !strncmp(kind, "team", 4)) {
-			index = get_team_active_iface(master_index);
+			if (link && link->team_index >= 0) {
+				index = link->team_index;
+			} else {
+				index = get_team_active_iface(master_index);
+				if (link)
+					link->team_index = index;
+			}
 		}
 	}
 	return index;
@@ -301,7 +351,8 @@ int rtnl_link_status(int fd, const char *device, rtnl_callback cb, void *ctx)
 				  IFLA_PAYLOAD(nh));
 
 		if (tb[IFLA_LINKINFO])
-			slave_index = rtnl_linkinfo_parse(index, tb[IFLA_LINKINFO]);
+			slave_index = rtnl_linkinfo_parse(index, tb[IFLA_LINKINFO],
+							  NULL);
 
 		if (cb)
 			cb(ctx, link_up, slave_index);
@@ -310,6 +361,296 @@ int rtnl_link_status(int fd, const char *device, rtnl_callback cb, void *ctx)
 	return 0;
 }
 
+static int64_t rtnl_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+static struct rtnl_link *rtnl_monitor_link(struct rtnl_monitor *m, int index,
+					   int create)
+{
+	struct rtnl_link *link;
+	char key[16];
+
+	snprintf(key, sizeof(key), "%d", index);
+	link = hash_lookup(m->links, key);
+	if (link || !create)
+		return link;
+
+	link = calloc(1, sizeof(*link));
+	if (!link)
+		return NULL;
+	LIST_INIT(&link->listeners);
+	link->index = index;
+	link->link_up = -1;
+	link->team_index = -1;
+	if (hash_insert(m->links, key, link)) {
+		free(link);
+		return NULL;
+	}
+	return link;
+}
+
+/* Parses one link message and passes it to the listeners of the link. */
+static void rtnl_monitor_newlink(struct rtnl_monitor *m, struct nlmsghdr *nh,
+				 int64_t rx)
+{
+	struct ifinfomsg *info = NLMSG_DATA(nh);
+	struct rtattr *tb[IFLA_MAX+1];
+	struct rtnl_listener *l;
+	struct rtnl_link *link;
+	int link_up, slave_index = -1;
+
+	rtnl_rtattr_parse(tb, IFLA_MAX, IFLA_RTA(info), IFLA_PAYLOAD(nh));
+
+	if (tb[IFLA_MASTER]) {
+		/* A change of a port may switch the active port of a team. */
+		link = rtnl_monitor_link(m, rta_getattr_u32(tb[IFLA_MASTER]), 0);
+		if (link)
+			link->team_index = -1;
+	}
+
+	link = rtnl_monitor_link(m, info->ifi_index, 0);
+	if (!link || LIST_EMPTY(&link->listeners))
+		return;
+
+	link_up = info->ifi_flags & IFF_RUNNING ? 1 : 0;
+	if (link->link_up != link_up) {
+		link->link_up = link_up;
+		link->team_index = -1;
+	}
+	pr_debug("interface index %d is %s", link->index,
+		 link_up ? "up" : "down");
+
+	if (tb[IFLA_LINKINFO])
+		slave_index = rtnl_linkinfo_parse(link->index,
+						  tb[IFLA_LINKINFO], link);
+
+	LIST_FOREACH(l, &link->listeners, list) {
+		l->link_up = link_up;
+		l->ts_index = slave_index;
+		if (!l->pending)
+			l->rx = rx;
+		l->pending = 1;
+		if (l->efd >= 0 && eventfd_write(l->efd, 1))
+			pr_err("rtnl: eventfd_write: %m");
+	}
+}
+
+static void rtnl_monitor_requery(struct rtnl_monitor *m)
+{
+	struct rtnl_listener *l;
+
+	LIST_FOREACH(l, &m->listeners, all)
+		rtnl_link_query(m->fd, l->device);
+}
+
+/* Reads all pending messages from the socket. */
+static int rtnl_monitor_read(struct rtnl_monitor *m)
+{
+	struct nlmsghdr *nh;
+	int64_t rx;
+	int len;
+
+	while (1) {
+		len = recv(m->fd, m->buf, MONITOR_BUF_SIZE,
+			   MSG_DONTWAIT | MSG_TRUNC);
+		if (len < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			if (errno == ENOBUFS) {
+				/* Events were lost, ask for the current state. */
+				pr_warning("rtnl: socket overrun");
+				rtnl_monitor_requery(m);
+				continue;
+			}
+			pr_err("rtnl: recv: %m");
+			return -1;
+		}
+		if (len > MONITOR_BUF_SIZE) {
+			pr_err("rtnl: dropped message of %d bytes", len);
+			rtnl_monitor_requery(m);
+			continue;
+		}
+		rx = rtnl_now();
+		nh = (struct nlmsghdr *) m->buf;
+		for ( ; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+			if (nh->nlmsg_type == RTM_NEWLINK)
+				rtnl_monitor_newlink(m, nh, rx);
+		}
+	}
+}
+
+static void rtnl_monitor_destroy(struct rtnl_monitor *m)
+{
+	hash_destroy(m->links, free);
+	nl_close(m->fd);
+	free(m->buf);
+	free(m);
+}
+
+static struct rtnl_monitor *rtnl_monitor_create(void)
+{
+	struct rtnl_monitor *m;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+	LIST_INIT(&m->listeners);
+	m->buf = malloc(MONITOR_BUF_SIZE);
+	m->links = hash_create();
+	m->fd = nl_open(NETLINK_ROUTE);
+	if (!m->buf || !m->links || m->fd < 0) {
+		if (m->fd >= 0)
+			nl_close(m->fd);
+		if (m->links)
+			hash_destroy(m->links, NULL);
+		free(m->buf);
+		free(m);
+		return NULL;
+	}
+	return m;
+}
+
+static int rtnl_listener_attach(struct rtnl_listener *l)
+{
+	struct rtnl_link *link;
+	int index;
+
+	index = if_nametoindex(l->device);
+	if (l->link && l->link->index == index)
+		return 0;
+	if (l->link)
+		LIST_REMOVE(l, list);
+	l->link = NULL;
+
+	link = rtnl_monitor_link(l->monitor, index, 1);
+	if (!link) {
+		pr_err("rtnl: low memory");
+		return -1;
+	}
+	LIST_INSERT_HEAD(&link->listeners, l, list);
+	l->link = link;
+	return 0;
+}
+
+struct rtnl_listener *rtnl_monitor_add(const char *device, rtnl_callback cb,
+				       void *ctx)
+{
+	struct rtnl_listener *l;
+
+	if (!rtnl_monitor) {
+		rtnl_monitor = rtnl_monitor_create();
+		if (!rtnl_monitor)
+			return NULL;
+	}
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		goto no_listener;
+	l->monitor = rtnl_monitor;
+	l->cb = cb;
+	l->ctx = ctx;
+	snprintf(l->device, sizeof(l->device), "%s", device);
+
+	if (rtnl_monitor->reader) {
+		l->efd = eventfd(0, EFD_NONBLOCK);
+		if (l->efd < 0) {
+			pr_err("rtnl: eventfd: %m");
+			goto no_efd;
+		}
+	} else {
+		l->efd = -1;
+		rtnl_monitor->reader = l;
+	}
+	if (rtnl_listener_attach(l))
+		goto no_link;
+
+	LIST_INSERT_HEAD(&rtnl_monitor->listeners, l, all);
+	return l;
+
+no_link:
+	if (l->efd >= 0)
+		close(l->efd);
+	else
+		rtnl_monitor->reader = NULL;
+no_efd:
+	free(l);
+no_listener:
+	if (LIST_EMPTY(&rtnl_monitor->listeners)) {
+		rtnl_monitor_destroy(rtnl_monitor);
+		rtnl_monitor = NULL;
+	}
+	return NULL;
+}
+
+int rtnl_listener_fd(struct rtnl_listener *l)
+{
+	return l->efd >= 0 ? l->efd : l->monitor->fd;
+}
+
+void *rtnl_monitor_remove(struct rtnl_listener *l)
+{
+	struct rtnl_monitor *m = l->monitor;
+	struct rtnl_listener *next;
+	void *ctx = NULL;
+
+	LIST_REMOVE(l, list);
+	LIST_REMOVE(l, all);
+	if (l->efd >= 0) {
+		close(l->efd);
+	} else {
+		/* Hand the socket over to another listener. */
+		next = LIST_FIRST(&m->listeners);
+		m->reader = next;
+		if (next) {
+			close(next->efd);
+			next->efd = -1;
+			ctx = next->ctx;
+		}
+	}
+	free(l);
+
+	if (LIST_EMPTY(&m->listeners)) {
+		rtnl_monitor_destroy(m);
+		rtnl_monitor = NULL;
+	}
+	return ctx;
+}
+
+int rtnl_monitor_query(struct rtnl_listener *l)
+{
+	if (rtnl_listener_attach(l))
+		return -1;
+	return rtnl_link_query(l->monitor->fd, l->device);
+}
+
+int rtnl_monitor_process(struct rtnl_listener *l)
+{
+	eventfd_t cnt;
+
+	if (l->efd >= 0) {
+		if (eventfd_read(l->efd, &cnt) && errno != EAGAIN) {
+			pr_err("rtnl: eventfd_read: %m");
+			return -1;
+		}
+	} else if (rtnl_monitor_read(l->monitor)) {
+		return -1;
+	}
+	if (!l->pending)
+		return 0;
+
+	l->pending = 0;
+	if (l->cb)
+		l->cb(l->ctx, l->link_up, l->ts_index);
+
+	pr_debug("%s: link event handled after %" PRId64 " ns",
+		 l->device, rtnl_now() - l->rx);
+	return 1;
+}
+
 static int genl_send_msg(int fd, int family_id, int genl_cmd, int genl_version,
 		  int rta_type, void *rta_data, int rta_len)
 {
@@ -24,6 +24,9 @@
 
 typedef void (*rtnl_callback)(void *ctx, int linkup, int ts_index);
 
+/** Opaque type. */
+struct rtnl_listener;
+
 /**
  * Close a RT netlink socket.
  * @param fd  A socket obtained via rtnl_open().
@@ -68,6 +71,49 @@ int rtnl_link_status(int fd, const char *device, rtnl_callback cb, void *ctx);
  */
 int rtnl_iface_has_vclock(const char *device, int phc_index);
 
+/**
+ * Register for the link events of an interface. All listeners share a
+ * single RT netlink socket, which parses each event once and passes it to
+ * the listeners of the interface only.
+ * @param device Interface name.
+ * @param cb     Callback function to be invoked on each event.
+ * @param ctx    Private context passed to the callback.
+ * @return       A new listener on success, NULL otherwise.
+ */
+struct rtnl_listener *rtnl_monitor_add(const char *device, rtnl_callback cb,
+				       void *ctx);
+
+/**
+ * Unregister a listener. When the listener was the one reading the shared
+ * socket, another listener takes the socket over, and the file descriptor
+ * it has to poll changes.
+ * @param l  A listener obtained via rtnl_monitor_add().
+ * @return   The context of the listener which took over the socket, or NULL.
+ */
+void *rtnl_monitor_remove(struct rtnl_listener *l);
+
+/**
+ * Obtain the file descriptor which signals the events of a listener.
+ * @param l  A listener obtained via rtnl_monitor_add().
+ * @return   A file descriptor to poll for reading.
+ */
+int rtnl_listener_fd(struct rtnl_listener *l);
+
+/**
+ * Request the link status of the interface of a listener from the kernel.
+ * @param l  A listener obtained via rtnl_monitor_add().
+ * @return   Zero on success, non-zero otherwise.
+ */
+int rtnl_monitor_query(struct rtnl_listener *l);
+
+/**
+ * Handle a readable file descriptor of a listener, invoking its callback
+ * if there was an event for its interface.
+ * @param l  A listener obtained via rtnl_monitor_add().
+ * @return   One if the callback was invoked, zero if not, or -1 on error.
+ */
+int rtnl_monitor_process(struct rtnl_listener *l);
+
 /**
  * Open a RT netlink socket for monitoring link state.
  * @return    A valid socket, or -1 on error.
@@ -22,6 +22,11 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
 
 #include "config.h"
 #include "linreg.h"
@@ -35,12 +40,207 @@
 #include "print.h"
 #include "servo.h"
 
-struct servo *servo_create(struct config *cfg, enum servo_type type,
-			   double fadj, int max_ppb, int sw_ts)
+#define BOOT_ID_PATH "/proc/sys/kernel/random/boot_id"
+#define BOOT_ID_LEN 37
+
+struct servo_saved_state {
+	char boot_id[BOOT_ID_LEN];
+	int64_t boottime;
+	double drift;
+	double rate_ratio;
+};
+
+/*
+ * The age of the saved state is measured with CLOCK_BOOTTIME, which is
+ * neither stepped nor slewed by the servos, and the boot ID rules out
+ * comparing time stamps from different boots.
+ */
+static int64_t servo_boottime(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_BOOTTIME, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int servo_boot_id(char *buf)
+{
+	FILE *fp;
+	int err;
+
+	fp = fopen(BOOT_ID_PATH, "r");
+	if (!fp) {
+		return -1;
+	}
+	err = fscanf(fp, "%36s", buf) == 1 ? 0 : -1;
+	fclose(fp);
+	return err;
+}
+
+/*
+ * The saved state is only trusted within the same boot, so the file is
+ * not synced. The rename still replaces it atomically.
+ */
+static void servo_state_save(struct servo *servo)
+{
+	char tmp[PATH_MAX], boot_id[BOOT_ID_LEN];
+	FILE *fp;
+	int err;
+
+	if (servo_boot_id(boot_id)) {
+		return;
+	}
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", servo->state_file) >=
+	    sizeof(tmp)) {
+		return;
+	}
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		pr_err("failed to open %s: %m", tmp);
+		return;
+	}
+	fprintf(fp, "boot_id %s\n", boot_id);
+	fprintf(fp, "boottime %" PRId64 "\n", servo->saved.boottime);
+	fprintf(fp, "drift %.3f\n", servo->saved.drift);
+	fprintf(fp, "rate_ratio %.12f\n", servo->saved.rate_ratio);
+
+	err = fflush(fp);
+	if (fclose(fp) || err) {
+		pr_err("failed to write %s", tmp);
+		unlink(tmp);
+		return;
+	}
+	/* Replace the old state atomically. */
+	if (rename(tmp, servo->state_file)) {
+		pr_err("failed to rename %s: %m", tmp);
+		unlink(tmp);
+	}
+	servo->saved.dirty = 0;
+}
+
+static int servo_state_load(const char *path, struct servo_saved_state *st)
+{
+	FILE *fp;
+	int cnt;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		return -1;
+	}
+	cnt = fscanf(fp, "boot_id %36s boottime %" SCNd64 " drift %lf "
+		     "rate_ratio %lf", st->boot_id, &st->boottime, &st->drift,
+		     &st->rate_ratio);
+	fclose(fp);
+
+	return cnt == 4 ? 0 : -1;
+}
+
+int servo_state_attach(struct servo *servo, struct config *cfg,
+		       const char *key)
+{
+	struct servo_saved_state st;
+	char boot_id[BOOT_ID_LEN];
+	double fadj, max_diff;
+	const char *base;
+	int64_t age;
+	char *path;
+
+	path = config_get_string(cfg, NULL, "servo_state_file");
+	if (!path || !path[0] || !servo->drift) {
+		return 0;
+	}
+	/* Every adjusted clock has a file of its own. */
+	base = strrchr(key, '/');
+	base = base ? base + 1 : key;
+	free(servo->state_file);
+	if (asprintf(&servo->state_file, "%s.%s", path, base) < 0) {
+		servo->state_file = NULL;
+		return -1;
+	}
+	path = servo->state_file;
+	servo->state_interval = NSEC_PER_SEC *
+		(int64_t) config_get_int(cfg, NULL, "servo_state_interval");
+	servo->state_last_save = servo_boottime();
+	servo->saved.dirty = 0;
+
+	if (!servo->warm_start || servo_state_load(path, &st) ||
+	    servo_boot_id(boot_id)) {
+		return 0;
+	}
+
+	/* A new servo still runs at the frequency it was created with. */
+	fadj = servo->drift(servo);
+	age = servo->state_last_save - st.boottime;
+	max_diff = config_get_double(cfg, NULL, "servo_state_max_freq_diff");
+
+	if (strcmp(boot_id, st.boot_id)) {
+		pr_info("servo: ignoring %s saved before reboot", path);
+	} else if (age < 0 || age > NSEC_PER_SEC *
+		   (int64_t) config_get_int(cfg, NULL, "servo_state_max_age")) {
+		pr_info("servo: ignoring stale %s", path);
+	} else if (fabs(st.drift - fadj) > max_diff ||
+		   fabs(st.drift) > servo->max_frequency) {
+		pr_info("servo: ignoring %s, drift %.0f inconsistent with "
+			"frequency %.0f", path, st.drift, fadj);
+	} else {
+		pr_info("servo: warm start from %s, drift %.0f ppb",
+			path, st.drift);
+		servo->warm_start(servo, st.drift, st.rate_ratio);
+	}
+	return 0;
+}
+
+void servo_state_flush(struct servo *servo)
+{
+	int64_t now;
+
+	if (!servo->state_file || !servo->saved.dirty) {
+		return;
+	}
+	now = servo_boottime();
+	if (now - servo->state_last_save < servo->state_interval) {
+		return;
+	}
+	servo->state_last_save = now;
+	servo_state_save(servo);
+}
+
+static void servo_configure(struct servo *servo, struct config *cfg)
 {
 	double servo_first_step_threshold;
 	double servo_step_threshold;
 	int servo_max_frequency;
+
+	servo_step_threshold = config_get_double(cfg, NULL, "step_threshold");
+	if (servo_step_threshold > 0.0) {
+		servo->step_threshold = servo_step_threshold * NSEC_PER_SEC;
+	} else {
+		servo->step_threshold = 0.0;
+	}
+
+	servo_first_step_threshold =
+		config_get_double(cfg, NULL, "first_step_threshold");
+
+	if (servo_first_step_threshold > 0.0) {
+		servo->first_step_threshold =
+			servo_first_step_threshold * NSEC_PER_SEC;
+	} else {
+		servo->first_step_threshold = 0.0;
+	}
+
+	servo_max_frequency = config_get_int(cfg, NULL, "max_frequency");
+	servo->max_frequency = servo->max_ppb;
+	if (servo_max_frequency && servo->max_frequency > servo_max_frequency) {
+		servo->max_frequency = servo_max_frequency;
+	}
+
+	servo->offset_threshold = config_get_int(cfg, NULL, "servo_offset_threshold");
+	servo->num_offset_values = config_get_int(cfg, NULL, "servo_num_offset_values");
+}
+
+struct servo *servo_create(struct config *cfg, enum servo_type type,
+			   double fadj, int max_ppb, int sw_ts)
+{
 	struct servo *servo;
 
 	switch (type) {
@@ -66,42 +266,43 @@ struct servo *servo_create(struct config *cfg, enum servo_type type,
 	if (!servo)
 		return NULL;
 
-	servo_step_threshold = config_get_double(cfg, NULL, "step_threshold");
-	if (servo_step_threshold > 0.0) {
-		servo->step_threshold = servo_step_threshold * NSEC_PER_SEC;
-	} else {
-		servo->step_threshold = 0.0;
-	}
-
-	servo_first_step_threshold =
-		config_get_double(cfg, NULL, "first_step_threshold");
-
-	if (servo_first_step_threshold > 0.0) {
-		servo->first_step_threshold =
-			servo_first_step_threshold * NSEC_PER_SEC;
-	} else {
-		servo->first_step_threshold = 0.0;
-	}
-
-	servo_max_frequency = config_get_int(cfg, NULL, "max_frequency");
-	servo->max_frequency = max_ppb;
-	if (servo_max_frequency && servo->max_frequency > servo_max_frequency) {
-		servo->max_frequency = servo_max_frequency;
-	}
-
+	servo->max_ppb = max_ppb;
+	servo_configure(servo, cfg);
 	servo->first_update = 1;
-	servo->offset_threshold = config_get_int(cfg, NULL, "servo_offset_threshold");
-	servo->num_offset_values = config_get_int(cfg, NULL, "servo_num_offset_values");
 	servo->curr_offset_values = servo->num_offset_values;
 
 	return servo;
 }
 
+void servo_reconfigure(struct servo *servo, struct config *cfg)
+{
+	servo_configure(servo, cfg);
+	if (servo->curr_offset_values > servo->num_offset_values)
+		servo->curr_offset_values = servo->num_offset_values;
+	if (servo->reconfigure)
+		servo->reconfigure(servo, cfg);
+}
+
 void servo_destroy(struct servo *servo)
 {
+	if (servo->state_file) {
+		if (servo->saved.dirty) {
+			servo_state_save(servo);
+		}
+		free(servo->state_file);
+	}
 	servo->destroy(servo);
 }
 
+/* Only remembers the state, servo_state_flush() writes it out. */
+static void servo_state_update(struct servo *servo)
+{
+	servo->saved.drift = servo->drift(servo);
+	servo->saved.rate_ratio = servo_rate_ratio(servo);
+	servo->saved.boottime = servo_boottime();
+	servo->saved.dirty = 1;
+}
+
 static int check_offset_threshold(struct servo *s, int64_t offset)
 {
 	long long int abs_offset = llabs(offset);
@@ -141,6 +342,9 @@ double servo_sample(struct servo *servo,
 			*state = SERVO_LOCKED_STABLE;
 		}
 		servo->first_update = 0;
+		if (servo->state_file) {
+			servo_state_update(servo);
+		}
 		break;
 	case SERVO_LOCKED_STABLE:
 		/*
@@ -178,6 +382,14 @@ void servo_leap(struct servo *servo, int leap)
 		servo->leap(servo, leap);
 }
 
+int servo_gains(struct servo *servo, double *kp, double *ki, double *noise)
+{
+	if (servo->gains)
+		return servo->gains(servo, kp, ki, noise);
+
+	return -1;
+}
+
 int servo_offset_threshold(struct servo *servo)
 {
 	return servo->offset_threshold;
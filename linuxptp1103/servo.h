@@ -224,12 +224,39 @@ int slave_servo_stable_shm_read(struct slave_servo_stable_shm *shm, int domain_i
 struct servo *servo_create(struct config *cfg, enum servo_type type,
 			   double fadj, int max_ppb, int sw_ts);
 
+/**
+ * Apply the current configuration to a clock servo without resetting it.
+ * @param servo Pointer to a servo obtained via @ref servo_create().
+ * @param cfg   The configuration the servo was created with.
+ */
+void servo_reconfigure(struct servo *servo, struct config *cfg);
+
 /**
  * Destroy an instance of a clock servo.
  * @param servo Pointer to a servo obtained via @ref servo_create().
  */
 void servo_destroy(struct servo *servo);
 
+/**
+ * Keep the frequency estimate of a clock servo in a state file and load
+ * a previously saved estimate for a warm start. Nothing is done unless
+ * servo_state_file is configured. The file name is servo_state_file
+ * followed by a dot and the last path component of the key.
+ * @param servo Pointer to a servo obtained via @ref servo_create().
+ * @param cfg   The configuration the servo was created with.
+ * @param key   Names the adjusted clock, e.g. its device or interface.
+ * @return      Zero on success, non-zero otherwise.
+ */
+int servo_state_attach(struct servo *servo, struct config *cfg,
+		       const char *key);
+
+/**
+ * Write the state of a locked servo to its state file, at most once per
+ * servo_state_interval. Call this outside of the sample path.
+ * @param servo Pointer to a servo obtained via @ref servo_create().
+ */
+void servo_state_flush(struct servo *servo);
+
 /**
  * Feed a sample into a clock servo.
  * @param servo     Pointer to a servo obtained via @ref servo_create().
@@ -253,6 +280,17 @@ double servo_sample(struct servo *servo,
  */
 void servo_sync_interval(struct servo *servo, double interval);
 
+/**
+ * Obtain the current gains of a clock servo.
+ * @param servo   Pointer to a servo obtained via @ref servo_create().
+ * @param kp      Returns the proportional constant.
+ * @param ki      Returns the integral constant.
+ * @param noise   Returns the estimated offset noise in nanoseconds.
+ * @return 1 if the gains are adapted to the offset noise, zero if they
+ *         are fixed, or -1 if the servo has no such gains.
+ */
+int servo_gains(struct servo *servo, double *kp, double *ki, double *noise);
+
 /**
  * Reset a clock servo.
  * @param servo   Pointer to a servo obtained via @ref servo_create().
@@ -25,6 +25,7 @@
 #include "servo.h"
 
 struct servo {
+	int max_ppb;
 	double max_frequency;
 	double step_threshold;
 	double first_step_threshold;
@@ -33,6 +34,17 @@ struct servo {
 	int num_offset_values;
 	int curr_offset_values;
 
+	/* persisted state for a warm start */
+	char *state_file;
+	int64_t state_interval;
+	int64_t state_last_save;
+	struct {
+		double drift;
+		double rate_ratio;
+		int64_t boottime;
+		int dirty;
+	} saved;
+
 	void (*destroy)(struct servo *servo);
 
 	double (*sample)(struct servo *servo,
@@ -46,6 +58,14 @@ struct servo {
 	double (*rate_ratio)(struct servo *servo);
 
 	void (*leap)(struct servo *servo, int leap);
+
+	double (*drift)(struct servo *servo);
+
+	int (*gains)(struct servo *servo, double *kp, double *ki, double *noise);
+
+	void (*warm_start)(struct servo *servo, double drift, double rate_ratio);
+
+	void (*reconfigure)(struct servo *servo, struct config *cfg);
 };
 
 #endif
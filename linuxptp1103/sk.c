@@ -19,6 +19,7 @@
  */
 #include <errno.h>
 #include <time.h>
+#include <linux/filter.h>
 #include <linux/net_tstamp.h>
 #include <linux/sockios.h>
 #include <linux/ethtool.h>
@@ -32,6 +33,7 @@
 #include <poll.h>
 
 #include "address.h"
+#include "contain.h"
 #include "ether.h"
 #include "missing.h"
 #include "print.h"
@@ -459,7 +461,7 @@ int sk_receive(int fd, void *buf, int buflen,
 	}
 
 	cnt = recvmsg(fd, &msg, flags);
-	if (cnt < 0) {
+	if (cnt < 0 && !(flags & MSG_DONTWAIT && errno == EAGAIN)) {
 		pr_err("recvmsg%sfailed: %m",
 		       flags == MSG_ERRQUEUE ? " tx timestamp " : " ");
 	}
@@ -507,6 +509,18 @@ int sk_receive(int fd, void *buf, int buflen,
 	return cnt < 0 ? -errno : cnt;
 }
 
+void sk_txts_pollfd(int fd, struct pollfd *pfd)
+{
+	pfd->fd = fd;
+	pfd->events = sk_events;
+	pfd->revents = 0;
+}
+
+bool sk_txts_ready(struct pollfd *pfd)
+{
+	return pfd->revents & sk_revents ? true : false;
+}
+
 int sk_get_error(int fd)
 {
 	socklen_t len;
@@ -557,6 +571,46 @@ int sk_set_priority(int fd, int family, uint8_t dscp)
 	return 0;
 }
 
+int sk_set_busy_poll(int fd, int usec)
+{
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec))) {
+		pr_err("setsockopt SO_BUSY_POLL failed: %m");
+		return -1;
+	}
+	return 0;
+}
+
+int sk_set_domain_filter(int fd, int domain, int transport_specific)
+{
+	/* The filter sees the UDP header in front of the PTP message. */
+	struct sock_filter insn[] = {
+		BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, 8 + 4),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, domain, 0, 4),
+		BPF_STMT(BPF_LD  | BPF_B | BPF_ABS, 8),
+		BPF_STMT(BPF_ALU | BPF_AND | BPF_K, 0xf0),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, transport_specific, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, 0x40000),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	struct sock_fprog prg = {
+		.len = ARRAY_SIZE(insn),
+		.filter = insn,
+	};
+
+	if (transport_specific < 0) {
+		/* Skip the transportSpecific check. */
+		insn[1].jf = 1;
+		insn[2] = insn[5];
+		insn[3] = insn[6];
+		prg.len = 4;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prg, sizeof(prg))) {
+		pr_err("setsockopt SO_ATTACH_FILTER failed: %m");
+		return -1;
+	}
+	return 0;
+}
+
 int sk_timestamping_init(int fd, const char *device, enum timestamp_type type,
 			 enum transport_type transport, int vclock)
 {
@@ -20,6 +20,7 @@
 #ifndef HAVE_SK_H
 #define HAVE_SK_H
 
+#include <poll.h>
 #include <stdbool.h>
 #include "address.h"
 #include "transport.h"
@@ -130,6 +131,20 @@ int sk_interface_addr(const char *name, int family, struct address *addr);
 int sk_receive(int fd, void *buf, int buflen,
 	       struct address *addr, struct hw_timestamp *hwts, int flags);
 
+/**
+ * Prepares a poll descriptor that waits for a transmit time stamp.
+ * @param fd      An open socket with time stamping enabled.
+ * @param pfd     The poll descriptor to fill in.
+ */
+void sk_txts_pollfd(int fd, struct pollfd *pfd);
+
+/**
+ * Tests whether poll(2) reported a transmit time stamp.
+ * @param pfd     A descriptor prepared with @ref sk_txts_pollfd().
+ * @return        True if a time stamp is waiting on the error queue.
+ */
+bool sk_txts_ready(struct pollfd *pfd);
+
 /**
  * Get and clear a pending socket error.
  * @param fd      An open socket.
@@ -146,6 +161,25 @@ int sk_get_error(int fd);
  */
 int sk_set_priority(int fd, int family, uint8_t dscp);
 
+/**
+ * Let blocking receive calls busy poll the device queue.
+ * @param fd     An open socket.
+ * @param usec   How long to busy poll, in microseconds, or zero to disable.
+ * @return       Zero on success, negative on failure
+ */
+int sk_set_busy_poll(int fd, int usec);
+
+/**
+ * Attach a socket filter to a UDP socket which drops PTP messages from
+ * other domains before they are queued to the socket.
+ * @param fd                  An open UDP socket.
+ * @param domain              The domainNumber to accept.
+ * @param transport_specific  The transportSpecific value to accept, in
+ *                            the upper nibble, or -1 to accept any.
+ * @return                    Zero on success, negative on failure
+ */
+int sk_set_domain_filter(int fd, int domain, int transport_specific);
+
 /**
  * Enable time stamping on a given network interface.
  * @param fd          An open socket.
@@ -17,11 +17,24 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "stats.h"
 
+/*
+ * The absolute values are also counted in a log-linear histogram in the
+ * style of HdrHistogram. Values below HIST_SUB are counted exactly, above
+ * that each power of two is split into HIST_SUB buckets, which bounds the
+ * relative error of a percentile to 1/HIST_SUB. Values of 2^HIST_MAX_BITS
+ * and above end up in the last bucket.
+ */
+#define HIST_SUB_BITS	4
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS	40
+#define HIST_SIZE	((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB)
+
 struct stats {
 	unsigned int num;
 	double min;
@@ -29,8 +42,38 @@ struct stats {
 	double mean;
 	double sum_sqr;
 	double sum_diff_sqr;
+	unsigned int hist[HIST_SIZE];
 };
 
+static int hist_index(double value)
+{
+	uint64_t v;
+	int e;
+
+	value = fabs(value);
+	if (value >= (double)(1ULL << HIST_MAX_BITS))
+		return HIST_SIZE - 1;
+
+	v = (uint64_t) value;
+	if (v < HIST_SUB)
+		return v;
+
+	e = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+	return e * HIST_SUB + (v >> e);
+}
+
+/* Returns the midpoint of the range of values counted in the bucket. */
+static double hist_value(int index)
+{
+	int e = index / HIST_SUB - 1;
+
+	if (e <= 0)
+		return index;
+
+	return (double)((uint64_t)(index - e * HIST_SUB) << e) +
+		((1ULL << e) - 1) / 2.0;
+}
+
 struct stats *stats_create(void)
 {
 	struct stats *stats;
@@ -57,6 +100,56 @@ void stats_add_value(struct stats *stats, double value)
 	stats->mean = old_mean + (value - old_mean) / stats->num;
 	stats->sum_sqr += value * value;
 	stats->sum_diff_sqr += (value - old_mean) * (value - stats->mean);
+	stats->hist[hist_index(value)]++;
+}
+
+void stats_merge(struct stats *stats, struct stats *other)
+{
+	double delta = other->mean - stats->mean;
+	unsigned int num = stats->num + other->num;
+	int i;
+
+	if (!other->num)
+		return;
+
+	if (!stats->num || stats->max < other->max)
+		stats->max = other->max;
+	if (!stats->num || stats->min > other->min)
+		stats->min = other->min;
+
+	stats->sum_diff_sqr += other->sum_diff_sqr +
+		delta * delta * stats->num * other->num / num;
+	stats->mean += delta * other->num / num;
+	stats->sum_sqr += other->sum_sqr;
+	stats->num = num;
+
+	for (i = 0; i < HIST_SIZE; i++)
+		stats->hist[i] += other->hist[i];
+}
+
+double stats_get_percentile(struct stats *stats, double percentile)
+{
+	double max_abs, rank, value = 0.0;
+	unsigned int count = 0;
+	int i;
+
+	if (!stats->num)
+		return 0.0;
+
+	rank = ceil(stats->num * percentile / 100.0);
+	if (rank < 1.0)
+		rank = 1.0;
+
+	for (i = 0; i < HIST_SIZE; i++) {
+		count += stats->hist[i];
+		if (count >= rank) {
+			value = hist_value(i);
+			break;
+		}
+	}
+
+	max_abs = fmax(fabs(stats->max), fabs(stats->min));
+	return value < max_abs ? value : max_abs;
 }
 
 unsigned int stats_get_num_values(struct stats *stats)
@@ -75,6 +168,8 @@ int stats_get_result(struct stats *stats, struct stats_result *result)
 	result->mean = stats->mean;
 	result->rms = sqrt(stats->sum_sqr / stats->num);
 	result->stddev = sqrt(stats->sum_diff_sqr / stats->num);
+	result->p99 = stats_get_percentile(stats, 99.0);
+	result->p999 = stats_get_percentile(stats, 99.9);
 
 	return 0;
 }
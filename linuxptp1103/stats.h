@@ -49,6 +49,22 @@ void stats_add_value(struct stats *stats, double value);
  */
 unsigned int stats_get_num_values(struct stats *stats);
 
+/**
+ * Merge the values collected in another instance into the stats.
+ * @param stats Pointer to stats obtained via @ref stats_create().
+ * @param other Pointer to the stats to be merged, left unchanged.
+ */
+void stats_merge(struct stats *stats, struct stats *other);
+
+/**
+ * Get a percentile of the absolute values collected so far. The result
+ * is an estimate with a relative error of at most 1/16.
+ * @param stats      Pointer to stats obtained via @ref stats_create().
+ * @param percentile The requested percentile, from 0 to 100.
+ * @return           The estimated value, or zero if no values were added.
+ */
+double stats_get_percentile(struct stats *stats, double percentile);
+
 struct stats_result {
 	double min;
 	double max;
@@ -56,6 +72,8 @@ struct stats_result {
 	double mean;
 	double rms;
 	double stddev;
+	double p99;  /* of the absolute values */
+	double p999; /* of the absolute values */
 };
 
 /**
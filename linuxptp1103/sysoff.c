@@ -18,7 +18,9 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <errno.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <linux/ptp_clock.h>
@@ -54,94 +56,203 @@ static int sysoff_precise(int fd, int64_t *result, uint64_t *ts)
 	return 0;
 }
 
-static int64_t sysoff_estimate(struct ptp_clock_time *pct, int extended,
-			       int n_samples, uint64_t *ts, int64_t *delay)
+struct sysoff_reading {
+	int64_t ts;
+	int64_t offset;
+	int64_t window;
+};
+
+/* Readings wider than this multiple of the first quartile are outliers. */
+#define SYSOFF_REJECT_FACTOR	2
+#define SYSOFF_MIN_WEIGHT	0.01
+/* Time constant of the baseline window in measurements. */
+#define SYSOFF_BASELINE_TC	64
+
+/* Converts a system, PHC, system triplet into a reading. */
+static void sysoff_reading(struct ptp_clock_time *pct, struct sysoff_reading *r)
 {
 	int64_t t1, t2, tp;
-	int64_t interval, timestamp, offset;
-	int64_t shortest_interval, best_timestamp, best_offset;
-	int i = 0;
-
-	if (extended) {
-		t1 = pctns(&pct[3*i]);
-		tp = pctns(&pct[3*i+1]);
-		t2 = pctns(&pct[3*i+2]);
-	} else {
-		t1 = pctns(&pct[2*i]);
-		tp = pctns(&pct[2*i+1]);
-		t2 = pctns(&pct[2*i+2]);
-	}
-	shortest_interval = t2 - t1;
-	best_timestamp = (t2 + t1) / 2;
-	best_offset = best_timestamp - tp;
+
+	t1 = pctns(&pct[0]);
+	tp = pctns(&pct[1]);
+	t2 = pctns(&pct[2]);
+
+	r->window = t2 - t1;
+	r->ts = (t2 + t1) / 2;
+	r->offset = r->ts - tp;
+}
+
+static int64_t sysoff_estimate(struct sysoff_reading *r, int n_samples,
+			       uint64_t *ts, int64_t *delay)
+{
+	int i, best = 0;
 
 	for (i = 1; i < n_samples; i++) {
-		if (extended) {
-			t1 = pctns(&pct[3*i]);
-			tp = pctns(&pct[3*i+1]);
-			t2 = pctns(&pct[3*i+2]);
-		} else {
-			t1 = pctns(&pct[2*i]);
-			tp = pctns(&pct[2*i+1]);
-			t2 = pctns(&pct[2*i+2]);
+		if (r[i].window < r[best].window) {
+			best = i;
 		}
-		interval = t2 - t1;
-		timestamp = (t2 + t1) / 2;
-		offset = timestamp - tp;
-		if (interval < shortest_interval) {
-			shortest_interval = interval;
-			best_timestamp = timestamp;
-			best_offset = offset;
+	}
+	*ts = r[best].ts;
+	*delay = r[best].window;
+	return r[best].offset;
+}
+
+static int cmp_window(const void *a, const void *b)
+{
+	const int64_t *x = a, *y = b;
+
+	return *x < *y ? -1 : *x > *y ? 1 : 0;
+}
+
+/*
+ * Rejects the readings whose window exceeds a multiple of the first
+ * quartile, and fits the rest with weights inversely proportional to the
+ * square of their windows. The fit is evaluated at the weighted centroid
+ * of the readings, where it reduces to the weighted means of the time
+ * stamps and offsets. The weight of the result compares the windows of
+ * the survivors with the shortest window seen recently.
+ */
+static void sysoff_estimate_robust(struct sysoff_reading *r, int n_samples,
+				   int64_t *baseline,
+				   struct sysoff_sample *sample)
+{
+	double w, sum_w = 0.0, sum_ts = 0.0, sum_offset = 0.0, sum_window = 0.0;
+	int64_t windows[PTP_MAX_SAMPLES], threshold;
+	int i, used = 0;
+
+	for (i = 0; i < n_samples; i++) {
+		windows[i] = r[i].window;
+	}
+	qsort(windows, n_samples, sizeof(windows[0]), cmp_window);
+	threshold = SYSOFF_REJECT_FACTOR * windows[n_samples / 4];
+	if (threshold < windows[0]) {
+		/*
+		 * Negative windows, as from a clock stepped during the
+		 * measurement, would reject every reading. Keep at least
+		 * the one with the shortest window.
+		 */
+		threshold = windows[0];
+	}
+
+	for (i = 0; i < n_samples; i++) {
+		if (r[i].window > threshold) {
+			continue;
+		}
+		w = r[i].window > 0 ? 1.0 / ((double) r[i].window * r[i].window) : 1.0;
+		sum_w += w;
+		sum_ts += w * (r[i].ts - r[0].ts);
+		sum_offset += w * (r[i].offset - r[0].offset);
+		sum_window += r[i].window;
+		used++;
+	}
+
+	sample->ts = r[0].ts + llround(sum_ts / sum_w);
+	sample->offset = r[0].offset + llround(sum_offset / sum_w);
+	sample->delay = windows[0];
+	sample->rejected = n_samples - used;
+
+	if (!*baseline || windows[0] < *baseline) {
+		*baseline = windows[0];
+	} else {
+		*baseline += (windows[0] - *baseline) / SYSOFF_BASELINE_TC;
+	}
+
+	sum_window /= used;
+	if (sum_window <= *baseline) {
+		sample->weight = 1.0;
+	} else {
+		sample->weight = *baseline / sum_window;
+		if (sample->weight < SYSOFF_MIN_WEIGHT) {
+			sample->weight = SYSOFF_MIN_WEIGHT;
 		}
 	}
-	*ts = best_timestamp;
-	*delay = shortest_interval;
-	return best_offset;
 }
 
-static int sysoff_extended(int fd, int n_samples,
-			   int64_t *result, uint64_t *ts, int64_t *delay)
+static int sysoff_extended(int fd, int n_samples, struct sysoff_reading *r)
 {
 	struct ptp_sys_offset_extended pso;
+	int i;
+
 	memset(&pso, 0, sizeof(pso));
 	pso.n_samples = n_samples;
 	if (ioctl(fd, PTP_SYS_OFFSET_EXTENDED, &pso)) {
 		print_ioctl_error("PTP_SYS_OFFSET_EXTENDED");
 		return -errno;
 	}
-	*result = sysoff_estimate(&pso.ts[0][0], 1, n_samples, ts, delay);
+	for (i = 0; i < n_samples; i++) {
+		sysoff_reading(pso.ts[i], &r[i]);
+	}
 	return 0;
 }
 
-static int sysoff_basic(int fd, int n_samples,
-			int64_t *result, uint64_t *ts, int64_t *delay)
+static int sysoff_basic(int fd, int n_samples, struct sysoff_reading *r)
 {
 	struct ptp_sys_offset pso;
+	int i;
+
 	memset(&pso, 0, sizeof(pso));
 	pso.n_samples = n_samples;
 	if (ioctl(fd, PTP_SYS_OFFSET, &pso)) {
 		print_ioctl_error("PTP_SYS_OFFSET");
 		return -errno;
 	}
-	*result = sysoff_estimate(pso.ts, 0, n_samples, ts, delay);
+	for (i = 0; i < n_samples; i++) {
+		sysoff_reading(&pso.ts[2 * i], &r[i]);
+	}
 	return 0;
 }
 
-int sysoff_measure(int fd, int method, int n_samples,
-		   int64_t *result, uint64_t *ts, int64_t *delay)
+static int sysoff_read(int fd, int method, int n_samples,
+		       struct sysoff_reading *r)
 {
 	switch (method) {
-	case SYSOFF_PRECISE:
-		*delay = 0;
-		return sysoff_precise(fd, result, ts);
 	case SYSOFF_EXTENDED:
-		return sysoff_extended(fd, n_samples, result, ts, delay);
+		return sysoff_extended(fd, n_samples, r);
 	case SYSOFF_BASIC:
-		return sysoff_basic(fd, n_samples, result, ts, delay);
+		return sysoff_basic(fd, n_samples, r);
 	}
 	return -EOPNOTSUPP;
 }
 
+int sysoff_measure(int fd, int method, int n_samples,
+		   int64_t *result, uint64_t *ts, int64_t *delay)
+{
+	struct sysoff_reading r[PTP_MAX_SAMPLES];
+	int err;
+
+	if (method == SYSOFF_PRECISE) {
+		*delay = 0;
+		return sysoff_precise(fd, result, ts);
+	}
+	err = sysoff_read(fd, method, n_samples, r);
+	if (err) {
+		return err;
+	}
+	*result = sysoff_estimate(r, n_samples, ts, delay);
+	return 0;
+}
+
+int sysoff_measure_robust(int fd, int method, int n_samples,
+			  int64_t *baseline, struct sysoff_sample *sample)
+{
+	struct sysoff_reading r[PTP_MAX_SAMPLES];
+	int err;
+
+	sample->weight = 1.0;
+	sample->rejected = 0;
+
+	if (method == SYSOFF_PRECISE) {
+		sample->delay = 0;
+		return sysoff_precise(fd, &sample->offset, &sample->ts);
+	}
+	err = sysoff_read(fd, method, n_samples, r);
+	if (err) {
+		return err;
+	}
+	sysoff_estimate_robust(r, n_samples, baseline, sample);
+	return 0;
+}
+
 int sysoff_probe(int fd, int n_samples)
 {
 	int64_t junk, delay;
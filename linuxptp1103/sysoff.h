@@ -48,3 +48,26 @@ int sysoff_probe(int fd, int n_samples);
  */
 int sysoff_measure(int fd, int method, int n_samples,
 		   int64_t *result, uint64_t *ts, int64_t *delay);
+
+/** The result of a robust offset measurement. */
+struct sysoff_sample {
+	int64_t offset;   /** The estimated offset in nanoseconds. */
+	uint64_t ts;      /** The system time corresponding to the offset. */
+	int64_t delay;    /** The shortest reading delay in nanoseconds. */
+	double weight;    /** Confidence in the offset, from 0 to 1. */
+	int rejected;     /** The number of readings rejected as outliers. */
+};
+
+/**
+ * Measure the offset between a PHC and the system time, rejecting the
+ * readings disturbed by interrupts or preemption and averaging the rest.
+ * @param fd         An open file descriptor to a PHC device.
+ * @param method     A non-negative SYSOFF_ value returned by sysoff_probe().
+ * @param n_samples  The number of consecutive readings to make.
+ * @param baseline   The shortest recent reading delay, kept by the caller
+ *                   between the measurements. Initialize it to zero.
+ * @param sample     Returns the estimated offset and its weight.
+ * @return  Zero on success, negative error code otherwise.
+ */
+int sysoff_measure_robust(int fd, int method, int n_samples,
+			  int64_t *baseline, struct sysoff_sample *sample);
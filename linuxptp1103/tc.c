@@ -16,11 +16,13 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335 USA.
  */
+#include <errno.h>
 #include <stdlib.h>
 
 #include "port.h"
 #include "print.h"
 #include "sad.h"
+#include "sk.h"
 #include "tc.h"
 #include "tmv.h"
 
@@ -33,6 +35,13 @@ enum tc_match {
 
 static TAILQ_HEAD(tc_pool, tc_txd) tc_pool = TAILQ_HEAD_INITIALIZER(tc_pool);
 
+/* Egress ports still waiting for the transmit time stamp of an event. */
+static struct {
+	struct pollfd *pfd;
+	struct port **port;
+	int max;
+} tc_egress;
+
 static int tc_match_delay(int ingress_port, struct ptp_message *resp,
 			  struct tc_txd *txd);
 static int tc_match_syfup(int ingress_port, struct ptp_message *msg,
@@ -265,15 +274,94 @@ static int tc_current(struct ptp_message *m, struct timespec now)
 	return t2 - t1 < NSEC_PER_SEC;
 }
 
+static int tc_egress_reserve(int n)
+{
+	struct pollfd *pfd;
+	struct port **port;
+
+	if (n <= tc_egress.max) {
+		return 0;
+	}
+	pfd = realloc(tc_egress.pfd, n * sizeof(*pfd));
+	if (!pfd) {
+		return -1;
+	}
+	tc_egress.pfd = pfd;
+	port = realloc(tc_egress.port, n * sizeof(*port));
+	if (!port) {
+		return -1;
+	}
+	tc_egress.port = port;
+	tc_egress.max = n;
+	return 0;
+}
+
+static void tc_egress_txts(struct port *q, struct port *p,
+			   struct ptp_message *msg, tmv_t ingress)
+{
+	tmv_t egress, residence;
+	double rr;
+	int err;
+
+	err = transport_txts_nowait(&p->fda, msg);
+	if (err || !msg_sots_valid(msg)) {
+		pr_err("failed to fetch txts on %s to %s event",
+			q->log_name, p->log_name);
+		port_dispatch(p, EV_FAULT_DETECTED, 0);
+		return;
+	}
+	ts_add(&msg->hwts.ts, p->tx_timestamp_offset);
+	egress = msg->hwts.ts;
+	residence = tmv_sub(egress, ingress);
+	rr = clock_rate_ratio(q->clock);
+	if (rr != 1.0) {
+		residence = dbl_tmv(tmv_dbl(residence) * rr);
+	}
+	tc_complete(q, p, msg, residence);
+}
+
+static int64_t tc_monotonic_ns(struct timespec *ts)
+{
+	return ts->tv_sec * NS_PER_SEC + ts->tv_nsec;
+}
+
+static int tc_egress_timeout(int64_t deadline)
+{
+	struct timespec now;
+	int64_t ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = deadline - tc_monotonic_ns(&now);
+	if (ns <= 0) {
+		return 0;
+	}
+	/* Round up, so as not to give up before the deadline. */
+	return (ns + 999999) / 1000000;
+}
+
 static int tc_fwd_event(struct port *q, struct ptp_message *msg)
 {
-	tmv_t egress, ingress = msg->hwts.ts, residence;
+	tmv_t ingress = msg->hwts.ts;
+	int64_t deadline;
+	int cnt, i, n = 0, res;
 	struct port *p;
-	int cnt, err;
-	double rr;
 
 	clock_gettime(CLOCK_MONOTONIC, &msg->ts.host);
 
+	/*
+	 * Make room for every port up front. Once sent, each event leaves
+	 * a time stamp on the error queue which must be collected.
+	 */
+	for (p = clock_first_port(q->clock); p; p = LIST_NEXT(p, list)) {
+		n++;
+	}
+	if (tc_egress_reserve(n)) {
+		pr_err("low memory, failed to forward event from %s",
+		       q->log_name);
+		return -1;
+	}
+	n = 0;
+
 	/* First send the event message out. */
 	for (p = clock_first_port(q->clock); p; p = LIST_NEXT(p, list)) {
 		if (tc_blocked(q, p, msg)) {
@@ -284,29 +372,62 @@ static int tc_fwd_event(struct port *q, struct ptp_message *msg)
 			pr_err("failed to forward event from %s to %s",
 				q->log_name, p->log_name);
 			port_dispatch(p, EV_FAULT_DETECTED, 0);
+			continue;
 		}
+		sk_txts_pollfd(p->fda.fd[FD_EVENT], &tc_egress.pfd[n]);
+		tc_egress.port[n] = p;
+		n++;
 	}
 
-	/* Go back and gather the transmit time stamps. */
-	for (p = clock_first_port(q->clock); p; p = LIST_NEXT(p, list)) {
-		if (tc_blocked(q, p, msg)) {
+	/*
+	 * Gather the transmit time stamps in the order they arrive, so
+	 * that a slow port does not hold up the others. All of the ports
+	 * share one deadline.
+	 */
+	deadline = tc_monotonic_ns(&msg->ts.host) + sk_tx_timeout * 1000000LL;
+
+	while (n) {
+		res = poll(tc_egress.pfd, n, tc_egress_timeout(deadline));
+		if (res < 0 && errno == EINTR) {
 			continue;
 		}
-		err = transport_txts(&p->fda, msg);
-		if (err || !msg_sots_valid(msg)) {
-			pr_err("failed to fetch txts on %s to %s event",
-				q->log_name, p->log_name);
-			port_dispatch(p, EV_FAULT_DETECTED, 0);
-			continue;
+		if (res < 0) {
+			pr_err("poll for tx timestamp failed: %m");
+			break;
+		}
+		if (!res) {
+			break;
 		}
-		ts_add(&msg->hwts.ts, p->tx_timestamp_offset);
-		egress = msg->hwts.ts;
-		residence = tmv_sub(egress, ingress);
-		rr = clock_rate_ratio(q->clock);
-		if (rr != 1.0) {
-			residence = dbl_tmv(tmv_dbl(residence) * rr);
+		for (i = 0; i < n; i++) {
+			if (!tc_egress.pfd[i].revents) {
+				continue;
+			}
+			p = tc_egress.port[i];
+			if (sk_txts_ready(&tc_egress.pfd[i])) {
+				tc_egress_txts(q, p, msg, ingress);
+			} else {
+				pr_err("poll for tx timestamp on %s woke up on "
+				       "non ERR event", p->log_name);
+				port_dispatch(p, EV_FAULT_DETECTED, 0);
+			}
+			n--;
+			tc_egress.pfd[i] = tc_egress.pfd[n];
+			tc_egress.port[i] = tc_egress.port[n];
+			i--;
 		}
-		tc_complete(q, p, msg, residence);
+	}
+
+	/*
+	 * Drop the event on the ports that missed the deadline. A late
+	 * time stamp would be taken for that of the next event, so fault
+	 * the port, which closes its sockets along with their error queues.
+	 */
+	for (i = 0; i < n; i++) {
+		p = tc_egress.port[i];
+		p->txtsTimeout++;
+		pr_err("timed out while polling for tx timestamp on %s, "
+		       "dropped %s event", p->log_name, q->log_name);
+		port_dispatch(p, EV_FAULT_DETECTED, 0);
 	}
 
 	return 0;
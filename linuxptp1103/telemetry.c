@@ -0,0 +1,369 @@
+/**
+ * @file telemetry.c
+ * @brief Publishes the data sets and counters of ptp4l in shared memory.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The segment holds one record for the clock and one for each port
+ * number. Every record is protected by its own sequence lock, just like
+ * the CMLDS records, so that a port never waits for another one and a
+ * reader never blocks a writer. The payload is copied one 64 bit word
+ * at a time with atomic accesses, which keeps torn reads well defined
+ * and lets the sequence check discard them.
+ *
+ * The header names the process that publishes the records, by its pid and
+ * its start time, so that readers can tell a running ptp4l from records
+ * left behind by one that exited or crashed.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "print.h"
+#include "telemetry.h"
+
+#define TELEMETRY_MAGIC		0x54454c4d /* TELM */
+#define TELEMETRY_VERSION	2
+#define TELEMETRY_RETRIES	16
+
+#define WORDS(type) ((sizeof(type) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+struct telemetry_clock_record {
+	uint32_t seq;
+	uint32_t valid;
+	uint64_t data[WORDS(struct telemetry_clock)];
+} __attribute__((aligned(64)));
+
+struct telemetry_port_record {
+	uint32_t seq;
+	uint32_t valid;
+	uint64_t data[WORDS(struct telemetry_port)];
+} __attribute__((aligned(64)));
+
+struct telemetry_segment {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t clock_size;
+	uint32_t port_size;
+	uint32_t n_ports;
+	int32_t pid;		/* publishing process, or zero */
+	uint32_t writers;	/* ports of that process with the segment open */
+	uint64_t start;		/* start time of that process */
+	struct telemetry_clock_record clock;
+	struct telemetry_port_record port[TELEMETRY_MAX_PORT + 1];
+} __attribute__((aligned(64)));
+
+struct telemetry {
+	struct telemetry_segment *seg;
+	bool publisher;
+};
+
+static void telemetry_write(uint32_t *seq, uint32_t *valid, uint64_t *data,
+			    const void *src, size_t len)
+{
+	const uint8_t *buf = src;
+	uint64_t word;
+	size_t i, n;
+	uint32_t s;
+
+	s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+	if (s & 1) {
+		/* A previous writer died in the middle of an update. */
+		s++;
+	}
+	__atomic_store_n(seq, s + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(valid, src ? 1 : 0, __ATOMIC_RELAXED);
+	for (i = 0; src && i < len; i += sizeof(word)) {
+		n = len - i < sizeof(word) ? len - i : sizeof(word);
+		word = 0;
+		memcpy(&word, buf + i, n);
+		__atomic_store_n(&data[i / sizeof(word)], word, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(seq, s + 2, __ATOMIC_RELEASE);
+}
+
+static int64_t telemetry_copy(uint32_t *seq, uint32_t *valid, uint64_t *data,
+			      void *dst, size_t len)
+{
+	uint32_t s, check, v;
+	uint8_t *buf = dst;
+	uint64_t word;
+	size_t i, n;
+	int retry;
+
+	for (retry = 0; retry < TELEMETRY_RETRIES; retry++) {
+		s = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+		if (s & 1) {
+			continue;
+		}
+		v = __atomic_load_n(valid, __ATOMIC_RELAXED);
+		for (i = 0; i < len; i += sizeof(word)) {
+			n = len - i < sizeof(word) ? len - i : sizeof(word);
+			word = __atomic_load_n(&data[i / sizeof(word)],
+					       __ATOMIC_RELAXED);
+			memcpy(buf + i, &word, n);
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		check = __atomic_load_n(seq, __ATOMIC_RELAXED);
+		if (check != s) {
+			continue;
+		}
+		return v ? s / 2 : 0;
+	}
+	return -1;
+}
+
+static int telemetry_map(struct telemetry *t, const char *path)
+{
+	int fd, flags = t->publisher ? O_RDWR | O_CREAT : O_RDONLY;
+	int prot = t->publisher ? PROT_READ | PROT_WRITE : PROT_READ;
+	struct stat st;
+	void *addr;
+
+	fd = open(path, flags, 0644);
+	if (fd < 0) {
+		pr_err("telemetry: failed to open %s: %m", path);
+		return -1;
+	}
+	if (fstat(fd, &st)) {
+		pr_err("telemetry: fstat failed: %m");
+		goto fail;
+	}
+	if (st.st_size < (off_t) sizeof(*t->seg)) {
+		if (!t->publisher) {
+			pr_err("telemetry: %s is too small", path);
+			goto fail;
+		}
+		if (ftruncate(fd, sizeof(*t->seg))) {
+			pr_err("telemetry: ftruncate failed: %m");
+			goto fail;
+		}
+	}
+	addr = mmap(NULL, sizeof(*t->seg), prot, MAP_SHARED, fd, 0);
+	if (addr == MAP_FAILED) {
+		pr_err("telemetry: mmap failed: %m");
+		goto fail;
+	}
+	close(fd);
+	t->seg = addr;
+	return 0;
+fail:
+	close(fd);
+	return -1;
+}
+
+/*
+ * Returns the start time of a process in clock ticks since boot, as found
+ * in /proc/<pid>/stat, or zero if it cannot be read.
+ */
+static uint64_t telemetry_start_time(pid_t pid)
+{
+	unsigned long long start;
+	char path[32], buf[1024];
+	char *ptr;
+	ssize_t cnt;
+	int fd, i;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	cnt = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (cnt <= 0) {
+		return 0;
+	}
+	buf[cnt] = 0;
+	/* The command name may contain spaces, so skip past its ')'. */
+	ptr = strrchr(buf, ')');
+	/* The start time is the 22nd field, the 20th one after the name. */
+	for (i = 0; ptr && i < 20; i++) {
+		ptr = strchr(ptr + 1, ' ');
+	}
+	if (!ptr || sscanf(ptr, "%llu", &start) != 1) {
+		return 0;
+	}
+	return start;
+}
+
+static bool telemetry_running(struct telemetry_segment *seg)
+{
+	pid_t pid = __atomic_load_n(&seg->pid, __ATOMIC_ACQUIRE);
+	uint64_t start;
+
+	if (pid <= 0) {
+		return false;
+	}
+	if (kill(pid, 0) && errno == ESRCH) {
+		return false;
+	}
+	/* A different start time means the pid was reused. */
+	start = telemetry_start_time(pid);
+	return !start || start == __atomic_load_n(&seg->start, __ATOMIC_RELAXED);
+}
+
+static void telemetry_clear_all(struct telemetry_segment *seg)
+{
+	struct telemetry_port_record *p;
+	struct telemetry_clock_record *c;
+	int i;
+
+	c = &seg->clock;
+	telemetry_write(&c->seq, &c->valid, c->data, NULL, 0);
+	for (i = 0; i <= TELEMETRY_MAX_PORT; i++) {
+		p = &seg->port[i];
+		telemetry_write(&p->seq, &p->valid, p->data, NULL, 0);
+	}
+}
+
+static bool telemetry_layout_ok(struct telemetry_segment *seg)
+{
+	return __atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) == TELEMETRY_MAGIC &&
+		seg->version == TELEMETRY_VERSION &&
+		seg->clock_size == sizeof(struct telemetry_clock) &&
+		seg->port_size == sizeof(struct telemetry_port) &&
+		seg->n_ports == TELEMETRY_MAX_PORT + 1;
+}
+
+static int telemetry_claim(struct telemetry_segment *seg, const char *path)
+{
+	pid_t pid = getpid();
+	uint64_t start;
+
+	start = telemetry_start_time(pid);
+	if (seg->pid == pid && seg->start == start) {
+		/* Another port of this instance. */
+		seg->writers++;
+		return 0;
+	}
+	if (telemetry_running(seg)) {
+		pr_err("telemetry: %s is in use by process %d", path, seg->pid);
+		return -1;
+	}
+	/* Drop whatever an earlier instance left behind. */
+	__atomic_store_n(&seg->pid, 0, __ATOMIC_RELEASE);
+	telemetry_clear_all(seg);
+	seg->start = start;
+	seg->writers = 1;
+	__atomic_store_n(&seg->pid, pid, __ATOMIC_RELEASE);
+	return 0;
+}
+
+struct telemetry *telemetry_open(const char *path, bool publisher)
+{
+	struct telemetry_segment *seg;
+	struct telemetry *t;
+
+	t = calloc(1, sizeof(*t));
+	if (!t) {
+		return NULL;
+	}
+	t->publisher = publisher;
+	if (telemetry_map(t, path)) {
+		free(t);
+		return NULL;
+	}
+	seg = t->seg;
+
+	if (publisher && !telemetry_layout_ok(seg)) {
+		__atomic_store_n(&seg->magic, 0, __ATOMIC_RELEASE);
+		memset(seg, 0, sizeof(*seg));
+		seg->version = TELEMETRY_VERSION;
+		seg->clock_size = sizeof(struct telemetry_clock);
+		seg->port_size = sizeof(struct telemetry_port);
+		seg->n_ports = TELEMETRY_MAX_PORT + 1;
+		__atomic_store_n(&seg->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+	}
+	if (!telemetry_layout_ok(seg)) {
+		pr_err("telemetry: %s has an unknown layout", path);
+		goto fail;
+	}
+	if (publisher && telemetry_claim(seg, path)) {
+		goto fail;
+	}
+	return t;
+fail:
+	t->publisher = false;
+	telemetry_close(t);
+	return NULL;
+}
+
+void telemetry_close(struct telemetry *t)
+{
+	struct telemetry_segment *seg = t->seg;
+
+	if (t->publisher && seg->pid == getpid() && !--seg->writers) {
+		/* The last port of this instance is going away. */
+		__atomic_store_n(&seg->pid, 0, __ATOMIC_RELEASE);
+		telemetry_clear_all(seg);
+	}
+	munmap(seg, sizeof(*seg));
+	free(t);
+}
+
+bool telemetry_alive(struct telemetry *t)
+{
+	return telemetry_running(t->seg);
+}
+
+void telemetry_publish_clock(struct telemetry *t,
+			     const struct telemetry_clock *clk)
+{
+	struct telemetry_clock_record *r = &t->seg->clock;
+
+	if (!t->publisher) {
+		return;
+	}
+	telemetry_write(&r->seq, &r->valid, r->data, clk, sizeof(*clk));
+}
+
+void telemetry_publish_port(struct telemetry *t, int port,
+			    const struct telemetry_port *rec)
+{
+	struct telemetry_port_record *r;
+
+	if (!t->publisher || port < 0 || port > TELEMETRY_MAX_PORT) {
+		return;
+	}
+	r = &t->seg->port[port];
+	telemetry_write(&r->seq, &r->valid, r->data, rec, sizeof(*rec));
+}
+
+void telemetry_clear_port(struct telemetry *t, int port)
+{
+	struct telemetry_port_record *r;
+
+	if (!t->publisher || port < 0 || port > TELEMETRY_MAX_PORT) {
+		return;
+	}
+	r = &t->seg->port[port];
+	telemetry_write(&r->seq, &r->valid, r->data, NULL, 0);
+}
+
+int64_t telemetry_read_clock(struct telemetry *t, struct telemetry_clock *clk)
+{
+	struct telemetry_clock_record *r = &t->seg->clock;
+
+	return telemetry_copy(&r->seq, &r->valid, r->data, clk, sizeof(*clk));
+}
+
+int64_t telemetry_read_port(struct telemetry *t, int port,
+			    struct telemetry_port *rec)
+{
+	struct telemetry_port_record *r;
+
+	if (port < 0 || port > TELEMETRY_MAX_PORT) {
+		return 0;
+	}
+	r = &t->seg->port[port];
+	return telemetry_copy(&r->seq, &r->valid, r->data, rec, sizeof(*rec));
+}
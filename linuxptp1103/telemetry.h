@@ -0,0 +1,137 @@
+/**
+ * @file telemetry.h
+ * @brief Publishes the data sets and counters of ptp4l in shared memory.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_TELEMETRY_H
+#define HAVE_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ddt.h"
+#include "ds.h"
+#include "tlv.h"
+
+/** Largest port number that has a record in the shared memory. */
+#define TELEMETRY_MAX_PORT 255
+
+struct telemetry;
+
+/**
+ * The most recent sample fed to the servo.
+ */
+struct telemetry_servo {
+	/** Ingress time stamp of the Sync message, in nanoseconds. */
+	int64_t ingress_time;
+	/** Offset from the master, in nanoseconds. */
+	int64_t offset;
+	/** Mean path delay, in nanoseconds. */
+	int64_t path_delay;
+	/** Rate ratio estimated by the servo, scaled by 2^41 minus one. */
+	int64_t scaled_rate_offset;
+	/** The state returned by the servo, see enum servo_state. */
+	int32_t state;
+};
+
+/**
+ * The data sets of the clock.
+ */
+struct telemetry_clock {
+	struct ClockIdentity identity;
+	struct currentDS cds;
+	struct parentDS pds;
+	struct time_status_np tsn;
+	struct telemetry_servo servo;
+};
+
+/**
+ * The data set and the counters of one port.
+ */
+struct telemetry_port {
+	struct portDS pds;
+	struct PortStats stats;
+	struct PortServiceStats service_stats;
+};
+
+/**
+ * Opens a telemetry segment.
+ *
+ * The ptp4l ports open the segment for writing, creating the file if
+ * needed, while monitoring tools open it read only. Reading costs no
+ * system calls once the segment is open.
+ *
+ * The first port of a ptp4l instance withdraws all records left behind by
+ * an earlier instance and marks the segment with its process, and the last
+ * port to close it withdraws all records again. Opening fails for writing
+ * while another running process publishes in the segment.
+ *
+ * @param path       Path of the shared memory file.
+ * @param publisher  True to open the segment for writing.
+ * @return           Pointer to the segment on success, NULL otherwise.
+ */
+struct telemetry *telemetry_open(const char *path, bool publisher);
+
+/**
+ * Closes a telemetry segment.
+ * @param t  A pointer obtained via @ref telemetry_open().
+ */
+void telemetry_close(struct telemetry *t);
+
+/**
+ * Checks whether the process publishing in a segment is still running.
+ *
+ * Records of a ptp4l instance that crashed stay valid in the segment, so
+ * readers should call this before trusting them. Unlike the reads, this
+ * costs a few system calls.
+ *
+ * @param t  A pointer obtained via @ref telemetry_open().
+ * @return   True if a running process publishes in the segment.
+ */
+bool telemetry_alive(struct telemetry *t);
+
+/**
+ * Publishes the clock record. This is a no-op for readers.
+ * @param t    A pointer obtained via @ref telemetry_open().
+ * @param clk  The data sets of the clock in host byte order.
+ */
+void telemetry_publish_clock(struct telemetry *t,
+			     const struct telemetry_clock *clk);
+
+/**
+ * Publishes the record of a port. This is a no-op for readers.
+ * @param t     A pointer obtained via @ref telemetry_open().
+ * @param port  The port number, at most @ref TELEMETRY_MAX_PORT.
+ * @param rec   The data of the port in host byte order.
+ */
+void telemetry_publish_port(struct telemetry *t, int port,
+			    const struct telemetry_port *rec);
+
+/**
+ * Withdraws the record of a port. This is a no-op for readers.
+ * @param t     A pointer obtained via @ref telemetry_open().
+ * @param port  The port number, at most @ref TELEMETRY_MAX_PORT.
+ */
+void telemetry_clear_port(struct telemetry *t, int port);
+
+/**
+ * Reads the clock record.
+ * @param t    A pointer obtained via @ref telemetry_open().
+ * @param clk  Returns the data sets of the clock in host byte order.
+ * @return     The generation of the record, which is zero if it was never
+ *             published, or -1 if no consistent record could be read.
+ */
+int64_t telemetry_read_clock(struct telemetry *t, struct telemetry_clock *clk);
+
+/**
+ * Reads the record of a port.
+ * @param t     A pointer obtained via @ref telemetry_open().
+ * @param port  The port number, at most @ref TELEMETRY_MAX_PORT.
+ * @param rec   Returns the data of the port in host byte order.
+ * @return      The generation of the record, which is zero if the port
+ *              has no record, or -1 if no consistent record could be read.
+ */
+int64_t telemetry_read_port(struct telemetry *t, int port,
+			    struct telemetry_port *rec);
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file lstab_edge.c
+ * @brief Measures the cost of one lstab_utc2tai() call per PPS edge.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The UTC time advances by one second per call, as it does for the edges
+ * seen by the ts2phc NMEA source. The table is either the built in one or
+ * read from a leap seconds file, like /usr/share/zoneinfo/leap-seconds.list.
+ * The program only uses the public interface of lstab.h, so it can be
+ * linked against other versions of lstab.c for a comparison.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lstab.h"
+#include "print.h"
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -f [file]  leap seconds file, the built in table by default\n"
+		" -n [num]   number of edges (2000000)\n"
+		" -t [sec]   UTC time of the first edge (1700000000)\n"
+		" -h         prints this message and exits\n"
+		"\n",
+		progname);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long i, n = 2000000, count[LSTAB_AMBIGUOUS + 1];
+	uint64_t start = 1700000000;
+	struct timespec begin, end;
+	char *file = NULL, *progname;
+	enum lstab_result result;
+	struct lstab *lstab;
+	int c, offset;
+	int64_t sum = 0;
+	double elapsed;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "f:n:t:h"))) {
+		switch (c) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			start = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(progname);
+			return 0;
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (!n) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_syslog(0);
+	print_set_level(PRINT_LEVEL_MIN);
+
+	lstab = lstab_create(file);
+	if (!lstab) {
+		fprintf(stderr, "failed to create the leap second table\n");
+		return -1;
+	}
+	memset(count, 0, sizeof(count));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n; i++) {
+		result = lstab_utc2tai(lstab, start + i, &offset);
+		count[result]++;
+		if (result != LSTAB_UNKNOWN) {
+			sum += offset;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec - begin.tv_sec) * 1e9 +
+		end.tv_nsec - begin.tv_nsec;
+
+	printf("%s: %lu edges, %.1f ns per edge\n",
+	       file ? file : "built in table", n, elapsed / n);
+	printf("ok %lu, ambiguous %lu, expired %lu, unknown %lu, "
+	       "sum of offsets %" PRId64 "\n",
+	       count[LSTAB_OK], count[LSTAB_AMBIGUOUS], count[LSTAB_EXPIRED],
+	       count[LSTAB_UNKNOWN], sum);
+
+	lstab_destroy(lstab);
+	return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file nmea_replay.c
+ * @brief Feeds a recorded NMEA stream through the parser in reads of the
+ * size used by the ts2phc NMEA source and reports the throughput.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The stream is replayed until the given amount of data was parsed. The
+ * parser state is carried across the passes, as across the reads of the
+ * serial line. The program only uses the public interface of nmea.h, so
+ * it can be linked against other versions of nmea.c for a comparison.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nmea.h"
+#include "print.h"
+
+#define READ_SIZE 256
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options] file\n\n"
+		" -m [MB]    amount of data to parse (64)\n"
+		" -r [num]   size of the reads in bytes (%d)\n"
+		" -h         prints this message and exits\n"
+		"\n",
+		progname, READ_SIZE);
+}
+
+static char *stream_read(const char *path, long *len)
+{
+	char *buf;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_END) || (*len = ftell(fp)) <= 0 ||
+	    fseek(fp, 0, SEEK_SET)) {
+		fprintf(stderr, "failed to read %s\n", path);
+		fclose(fp);
+		return NULL;
+	}
+	buf = malloc(*len);
+	if (buf && fread(buf, 1, *len, fp) != (size_t) *len) {
+		fprintf(stderr, "failed to read %s\n", path);
+		free(buf);
+		buf = NULL;
+	}
+	fclose(fp);
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long results = 0, valid = 0, seconds = 0;
+	long len, off, total = 0, limit = 64;
+	struct timespec begin, end;
+	int c, chunk, cnt, parsed;
+	struct nmea_parser *np;
+	char *buf, *progname;
+	int read_size = READ_SIZE;
+	struct nmea_rmc rmc, last;
+	const char *ptr;
+	double elapsed;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "m:r:h"))) {
+		switch (c) {
+		case 'm':
+			limit = atol(optarg);
+			break;
+		case 'r':
+			read_size = atoi(optarg);
+			break;
+		case 'h':
+			usage(progname);
+			return 0;
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (optind != argc - 1 || limit <= 0 || read_size <= 0) {
+		usage(progname);
+		return -1;
+	}
+	limit *= 1000000;
+
+	print_set_syslog(0);
+	print_set_level(PRINT_LEVEL_MIN);
+
+	buf = stream_read(argv[optind], &len);
+	if (!buf) {
+		return -1;
+	}
+	np = nmea_parser_create();
+	if (!np) {
+		free(buf);
+		return -1;
+	}
+	memset(&last, 0, sizeof(last));
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	while (total < limit) {
+		for (off = 0; off < len; off += chunk) {
+			chunk = len - off < read_size ? len - off : read_size;
+			ptr = buf + off;
+			cnt = chunk;
+			do {
+				if (!nmea_parse(np, ptr, cnt, &rmc, &parsed)) {
+					results++;
+					valid += rmc.fix_valid;
+					/* As the worker of the NMEA source does. */
+					if (rmc.ts.tv_sec != last.ts.tv_sec) {
+						seconds++;
+					}
+					last = rmc;
+				}
+				cnt -= parsed;
+				ptr += parsed;
+			} while (cnt);
+		}
+		total += len;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = end.tv_sec - begin.tv_sec +
+		(end.tv_nsec - begin.tv_nsec) / 1e9;
+
+	printf("%ld bytes in %d byte reads, %.3f s, %.1f MB/s\n",
+	       total, read_size, elapsed, total / elapsed / 1e6);
+	printf("%lu results, %lu with a valid fix, %lu distinct seconds\n",
+	       results, valid, seconds);
+
+	nmea_parser_destroy(np);
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,268 @@
+/**
+ * @file pollset_latency.c
+ * @brief Checks the poll set and compares its wake up to dispatch latency
+ * with that of poll() over all descriptors, for a growing number of ports.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * Every port has five eventfd descriptors, like the sockets and timers of
+ * a port. In each iteration one random descriptor becomes readable, and
+ * the time from then until the ready (port, index) pair is known is
+ * measured. For poll() this includes the scan of the whole array, as done
+ * by clock_poll().
+ */
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "contain.h"
+#include "pollset.h"
+#include "print.h"
+
+#define FDS_PER_PORT 5
+
+static int64_t now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -c         only check the poll set, skip the benchmark\n"
+		" -n [num]   number of wake ups per measurement (20000)\n"
+		" -h         prints this message and exits\n"
+		"\n",
+		progname);
+}
+
+static void fda_init(struct fdarray *fda)
+{
+	int i;
+
+	for (i = 0; i < N_POLLFD; i++) {
+		fda->fd[i] = -1;
+	}
+}
+
+static int expect(struct pollset *ps, void *owner, int index)
+{
+	struct pollset_event ev[4];
+	int cnt;
+
+	cnt = pollset_wait(ps, ev, 4, 100);
+	if (cnt != 1 || ev[0].owner != owner || ev[0].index != index) {
+		fprintf(stderr, "expected one event of %p/%d, got %d\n",
+			owner, index, cnt);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * A descriptor number freed by one owner and reused by another must stay
+ * registered for the new owner when the old one catches up.
+ */
+static int check_reuse(void)
+{
+	struct fdarray a, b;
+	struct pollset *ps;
+	uint64_t v = 1;
+	int err = -1;
+
+	ps = pollset_create(0);
+	if (!ps) {
+		return -1;
+	}
+	fda_init(&a);
+	fda_init(&b);
+	a.fd[FD_GENERAL] = eventfd(0, EFD_NONBLOCK);
+	if (pollset_update(ps, &a, &a)) {
+		goto out;
+	}
+	close(a.fd[FD_GENERAL]);
+	b.fd[FD_EVENT] = eventfd(0, EFD_NONBLOCK);
+	if (b.fd[FD_EVENT] != a.fd[FD_GENERAL]) {
+		fprintf(stderr, "descriptor number was not reused\n");
+		goto out;
+	}
+	if (pollset_update(ps, &b, &b)) {
+		goto out;
+	}
+	a.fd[FD_GENERAL] = -1;
+	if (pollset_update(ps, &a, &a)) {
+		goto out;
+	}
+	if (write(b.fd[FD_EVENT], &v, sizeof(v)) != sizeof(v) ||
+	    expect(ps, &b, FD_EVENT)) {
+		goto out;
+	}
+	if (read(b.fd[FD_EVENT], &v, sizeof(v)) != sizeof(v)) {
+		goto out;
+	}
+	pollset_remove(ps, &a);
+	if (write(b.fd[FD_EVENT], &v, sizeof(v)) != sizeof(v) ||
+	    expect(ps, &b, FD_EVENT)) {
+		goto out;
+	}
+	err = 0;
+out:
+	pollset_destroy(ps);
+	if (b.fd[FD_EVENT] >= 0) {
+		close(b.fd[FD_EVENT]);
+	}
+	return err;
+}
+
+static int measure(int n_ports, int n, int64_t *lat)
+{
+	int i, j, m, n_fds = n_ports * FDS_PER_PORT, err = -1;
+	struct pollset_event ev[16];
+	struct pollset *ps;
+	struct fdarray *fda;
+	struct pollfd *pfd;
+	uint64_t v = 1;
+	int64_t t0;
+
+	fda = calloc(n_ports, sizeof(*fda));
+	pfd = calloc(n_fds, sizeof(*pfd));
+	ps = pollset_create(0);
+	if (!fda || !pfd || !ps) {
+		goto out;
+	}
+	for (i = 0; i < n_ports; i++) {
+		fda_init(&fda[i]);
+		for (j = 0; j < FDS_PER_PORT; j++) {
+			fda[i].fd[j] = eventfd(0, EFD_NONBLOCK);
+			pfd[i * FDS_PER_PORT + j].fd = fda[i].fd[j];
+			pfd[i * FDS_PER_PORT + j].events = POLLIN | POLLPRI;
+		}
+		if (pollset_update(ps, &fda[i], &fda[i])) {
+			goto out;
+		}
+	}
+	srand(1);
+	for (m = 0; m < 2; m++) {
+		for (i = 0; i < n; i++) {
+			int p = rand() % n_ports, x = rand() % FDS_PER_PORT;
+			int fd = fda[p].fd[x], port = -1, index = -1;
+
+			if (write(fd, &v, sizeof(v)) != sizeof(v)) {
+				goto out;
+			}
+			t0 = now();
+			if (!m) {
+				poll(pfd, n_fds, -1);
+				for (j = 0; j < n_fds; j++) {
+					if (pfd[j].revents & (POLLIN | POLLPRI)) {
+						port = j / FDS_PER_PORT;
+						index = j % FDS_PER_PORT;
+						break;
+					}
+				}
+			} else if (pollset_wait(ps, ev, 16, -1) == 1) {
+				port = (struct fdarray *) ev[0].owner - fda;
+				index = ev[0].index;
+			}
+			lat[i] = now() - t0;
+			if (port != p || index != x) {
+				fprintf(stderr, "dispatched %d/%d instead of %d/%d\n",
+					port, index, p, x);
+				goto out;
+			}
+			if (read(fd, &v, sizeof(v)) != sizeof(v)) {
+				goto out;
+			}
+		}
+		qsort(lat, n, sizeof(*lat), cmp);
+		printf("%5d %6d  %-7s %8" PRId64 " %8" PRId64 "\n",
+		       n_ports, n_fds, m ? "pollset" : "poll",
+		       lat[n / 2], lat[n * 99 / 100]);
+	}
+	err = 0;
+out:
+	if (ps) {
+		pollset_destroy(ps);
+	}
+	for (i = 0; fda && pfd && i < n_fds; i++) {
+		if (pfd[i].fd > 0) {
+			close(pfd[i].fd);
+		}
+	}
+	free(fda);
+	free(pfd);
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	int c, check_only = 0, i, n = 20000;
+	int ports[] = { 1, 8, 32, 128, 512 };
+	char *progname;
+	int64_t *lat;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "cn:h"))) {
+		switch (c) {
+		case 'c':
+			check_only = 1;
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'h':
+			usage(progname);
+			return 0;
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (n <= 0) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_syslog(0);
+	print_set_level(PRINT_LEVEL_MIN);
+
+	if (check_reuse()) {
+		fprintf(stderr, "descriptor reuse check failed\n");
+		return -1;
+	}
+	if (check_only) {
+		return 0;
+	}
+	lat = calloc(n, sizeof(*lat));
+	if (!lat) {
+		return -1;
+	}
+	printf("wake up to dispatch latency in ns\n");
+	printf("%5s %6s  %-7s %8s %8s\n",
+	       "ports", "fds", "backend", "median", "p99");
+	for (i = 0; i < ARRAY_SIZE(ports); i++) {
+		if (measure(ports[i], n, lat)) {
+			free(lat);
+			return -1;
+		}
+	}
+	free(lat);
+	return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * @file rx_path.c
+ * @brief Measures the cost of the message layer of the receive path for
+ * the Sync, Follow_Up and Delay_Resp messages of a slave port.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * Every iteration takes a message from the pool, copies a wire frame into
+ * it, decodes it and returns it to the pool, as bc_event() does. The frame
+ * is decoded once with msg_post_recv() and once with msg_post_recv_lazy(),
+ * which the port uses since the TLV decoding is deferred. The checks done
+ * by the port itself depend on the clock and are measured in a running
+ * ptp4l with the rx_path_stats option.
+ */
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define COUNTER_UNIT "cycles"
+#else
+#define COUNTER_UNIT "ns"
+#endif
+
+#include "contain.h"
+#include "msg.h"
+#include "print.h"
+#include "tlv.h"
+
+#define N_ROUNDS 16
+
+struct frame {
+	const char *name;
+	uint8_t data[128] __attribute__((aligned(8)));
+	int len;
+};
+
+static uint64_t counter(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -n [num]   number of messages per round (100000)\n"
+		" -h         prints this message and exits\n"
+		"\n",
+		progname);
+}
+
+static int frame_build(struct frame *f, const char *name, int type,
+		       int follow_up_info)
+{
+	struct follow_up_info_tlv *fui;
+	struct tlv_extra *extra;
+	struct ptp_message *m;
+
+	m = msg_allocate();
+	if (!m) {
+		return -1;
+	}
+	switch (type) {
+	case SYNC:
+		m->header.messageLength = sizeof(struct sync_msg);
+		break;
+	case FOLLOW_UP:
+		m->header.messageLength = sizeof(struct follow_up_msg);
+		break;
+	case DELAY_RESP:
+		m->header.messageLength = sizeof(struct delay_resp_msg);
+		m->delay_resp.requestingPortIdentity.portNumber = 1;
+		break;
+	default:
+		msg_put(m);
+		return -1;
+	}
+	m->header.tsmt = type;
+	m->header.ver = PTP_VERSION;
+	m->header.sequenceId = 1;
+	m->header.sourcePortIdentity.portNumber = 1;
+	if (follow_up_info) {
+		extra = msg_tlv_append(m, sizeof(*fui));
+		if (!extra) {
+			msg_put(m);
+			return -1;
+		}
+		fui = (struct follow_up_info_tlv *) extra->tlv;
+		fui->type = TLV_ORGANIZATION_EXTENSION;
+		fui->length = sizeof(*fui) - sizeof(fui->type) -
+			sizeof(fui->length);
+		memcpy(fui->id, ieee8021_id, sizeof(ieee8021_id));
+		fui->subtype[2] = 1;
+	}
+	f->name = name;
+	f->len = m->header.messageLength;
+	if (msg_pre_send(m)) {
+		msg_put(m);
+		return -1;
+	}
+	memcpy(f->data, &m->header, f->len);
+	msg_put(m);
+	return 0;
+}
+
+static double replay(struct frame *f, unsigned int n,
+		     int (*post_recv)(struct ptp_message *m, int cnt))
+{
+	uint64_t begin, best = UINT64_MAX, end;
+	struct ptp_message *m;
+	unsigned int i, r;
+
+	for (r = 0; r < N_ROUNDS; r++) {
+		begin = counter();
+		for (i = 0; i < n; i++) {
+			m = msg_allocate();
+			memcpy(&m->header, f->data, f->len);
+			if (post_recv(m, f->len)) {
+				fprintf(stderr, "%s: bad message\n", f->name);
+				exit(-1);
+			}
+			msg_put(m);
+		}
+		end = counter();
+		if (end - begin < best) {
+			best = end - begin;
+		}
+	}
+	return (double) best / n;
+}
+
+int main(int argc, char *argv[])
+{
+	struct frame frames[4];
+	unsigned int i, n = 100000;
+	char *progname;
+	int c;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "n:h"))) {
+		switch (c) {
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 'h':
+			usage(progname);
+			return 0;
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (!n) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_syslog(0);
+	print_set_level(PRINT_LEVEL_MIN);
+
+	if (frame_build(&frames[0], "Sync", SYNC, 0) ||
+	    frame_build(&frames[1], "Follow_Up", FOLLOW_UP, 0) ||
+	    frame_build(&frames[2], "Follow_Up+TLV", FOLLOW_UP, 1) ||
+	    frame_build(&frames[3], "Delay_Resp", DELAY_RESP, 0)) {
+		fprintf(stderr, "failed to build the messages\n");
+		return -1;
+	}
+
+	printf("%u messages per round, best of %d rounds, " COUNTER_UNIT
+	       " per message\n", n, N_ROUNDS);
+	printf("%-14s %10s %10s\n", "message", "decoded", "deferred");
+	for (i = 0; i < ARRAY_SIZE(frames); i++) {
+		printf("%-14s %10.1f %10.1f\n", frames[i].name,
+		       replay(&frames[i], n, msg_post_recv),
+		       replay(&frames[i], n, msg_post_recv_lazy));
+	}
+	return 0;
+}
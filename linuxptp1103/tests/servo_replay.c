@@ -0,0 +1,239 @@
+/**
+ * @file servo_replay.c
+ * @brief Replays a measurement noise sequence through the PI servo with
+ * fixed and with adaptive gains and compares the resulting time error.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The simulated clock has a constant frequency error. In every interval
+ * the servo sees the true offset of the clock plus one value of the noise
+ * sequence, and its frequency adjustment is applied to the clock for the
+ * next interval. The noise is read from a file with one value in
+ * nanoseconds per line, for example the path delay variation captured on
+ * a link, or generated as white Gaussian noise with a fixed seed.
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "print.h"
+#include "servo.h"
+
+struct result {
+	double rms;
+	double max_abs;
+	double kp;
+	double ki;
+	unsigned int locked;
+};
+
+static void usage(char *progname)
+{
+	fprintf(stderr,
+		"\n"
+		"usage: %s [options]\n\n"
+		" -d [ppb]   frequency error of the clock (10000)\n"
+		" -f [file]  noise sequence, one value in ns per line\n"
+		" -i [sec]   sync interval (1.0)\n"
+		" -n [num]   number of generated noise values (4096)\n"
+		" -s [ns]    standard deviation of the generated noise (2000)\n"
+		" -h         prints this message and exits\n"
+		"\n",
+		progname);
+}
+
+static double gauss(void)
+{
+	double u1, u2;
+
+	do {
+		u1 = drand48();
+	} while (u1 <= 0.0);
+	u2 = drand48();
+	return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static double *noise_generate(unsigned int n, double sigma)
+{
+	double *noise;
+	unsigned int i;
+
+	noise = calloc(n, sizeof(*noise));
+	if (!noise) {
+		return NULL;
+	}
+	srand48(1);
+	for (i = 0; i < n; i++) {
+		noise[i] = sigma * gauss();
+	}
+	return noise;
+}
+
+static double *noise_read(const char *path, unsigned int *n)
+{
+	unsigned int size = 1024;
+	double *noise, *tmp;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "failed to open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+	noise = malloc(size * sizeof(*noise));
+	*n = 0;
+	while (noise && fscanf(fp, "%lf", &noise[*n]) == 1) {
+		if (++*n < size) {
+			continue;
+		}
+		size *= 2;
+		tmp = realloc(noise, size * sizeof(*noise));
+		if (!tmp) {
+			free(noise);
+		}
+		noise = tmp;
+	}
+	fclose(fp);
+	if (noise && !*n) {
+		fprintf(stderr, "no values in %s\n", path);
+		free(noise);
+		return NULL;
+	}
+	return noise;
+}
+
+static int replay(struct config *cfg, const double *noise, unsigned int n,
+		  double interval, double drift, struct result *res)
+{
+	double adj = 0.0, noise_sd, sum_sqr = 0.0, x = 0.0;
+	enum servo_state state;
+	uint64_t local_ts = 0;
+	struct servo *servo;
+	unsigned int i;
+	int64_t offset;
+
+	servo = servo_create(cfg, CLOCK_SERVO_PI, 0.0, 500000, 0);
+	if (!servo) {
+		return -1;
+	}
+	servo_sync_interval(servo, interval);
+	memset(res, 0, sizeof(*res));
+
+	for (i = 0; i < n; i++) {
+		/* The adjustment slows the clock down. */
+		x += (drift - adj) * interval;
+		local_ts += interval * 1e9;
+		offset = llround(x + noise[i]);
+
+		adj = servo_sample(servo, offset, local_ts, 1.0, &state);
+		switch (state) {
+		case SERVO_UNLOCKED:
+			adj = 0.0;
+			break;
+		case SERVO_JUMP:
+			x -= offset;
+			break;
+		case SERVO_LOCKED:
+		case SERVO_LOCKED_STABLE:
+			/* Leave out the time the loop needs to settle. */
+			if (i < n / 4) {
+				break;
+			}
+			sum_sqr += x * x;
+			res->max_abs = fmax(res->max_abs, fabs(x));
+			res->locked++;
+			break;
+		}
+	}
+	if (res->locked) {
+		res->rms = sqrt(sum_sqr / res->locked);
+	}
+	servo_gains(servo, &res->kp, &res->ki, &noise_sd);
+	servo_destroy(servo);
+	return 0;
+}
+
+static void show(const char *name, struct result *res)
+{
+	printf("%-9s %10.1f %10.1f %9.4f %11.7f %7u\n", name,
+	       res->rms, res->max_abs, res->kp, res->ki, res->locked);
+}
+
+int main(int argc, char *argv[])
+{
+	double drift = 10000.0, interval = 1.0, sigma = 2000.0;
+	struct result fixed, adaptive;
+	char *file = NULL, *progname;
+	struct config *cfg;
+	unsigned int n = 4096;
+	int c, err = -1;
+	double *noise;
+
+	progname = strrchr(argv[0], '/');
+	progname = progname ? 1 + progname : argv[0];
+	while (EOF != (c = getopt(argc, argv, "d:f:i:n:s:h"))) {
+		switch (c) {
+		case 'd':
+			drift = atof(optarg);
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 'i':
+			interval = atof(optarg);
+			break;
+		case 'n':
+			n = atoi(optarg);
+			break;
+		case 's':
+			sigma = atof(optarg);
+			break;
+		case 'h':
+			usage(progname);
+			return 0;
+		default:
+			usage(progname);
+			return -1;
+		}
+	}
+	if (interval <= 0.0 || !n) {
+		usage(progname);
+		return -1;
+	}
+
+	print_set_syslog(0);
+	print_set_level(PRINT_LEVEL_MIN);
+
+	noise = file ? noise_read(file, &n) : noise_generate(n, sigma);
+	if (!noise) {
+		return -1;
+	}
+	cfg = config_create();
+	if (!cfg) {
+		goto out;
+	}
+	if (replay(cfg, noise, n, interval, drift, &fixed)) {
+		goto out;
+	}
+	config_set_int(cfg, "pi_adaptive", 1);
+	if (replay(cfg, noise, n, interval, drift, &adaptive)) {
+		goto out;
+	}
+
+	printf("%u samples, interval %.3f s, frequency error %.0f ppb\n",
+	       n, interval, drift);
+	printf("%-9s %10s %10s %9s %11s %7s\n",
+	       "gains", "rms [ns]", "max [ns]", "kp", "ki", "samples");
+	show("fixed", &fixed);
+	show("adaptive", &adaptive);
+	err = 0;
+out:
+	if (cfg) {
+		config_destroy(cfg);
+	}
+	free(noise);
+	return err;
+}
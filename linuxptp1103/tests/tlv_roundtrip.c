@@ -0,0 +1,356 @@
+/**
+ * @file tlv_roundtrip.c
+ * @brief Converts TLVs carrying record arrays to the wire format and
+ * back. The wire image is compared against one built field by field
+ * from the message definitions, and the receive path must restore the
+ * original host image.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tlv.h"
+
+#define BUF_SIZE 1500
+
+static uint8_t buf[BUF_SIZE] __attribute__((aligned(8)));
+static uint8_t host[BUF_SIZE];
+static uint8_t wire[BUF_SIZE];
+
+static void fill(void *p, size_t len, unsigned int seed)
+{
+	uint8_t *b = p;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		b[i] = (uint8_t) (seed + i * 37);
+	}
+}
+
+static uint64_t host_value(size_t offset, size_t len)
+{
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v64;
+
+	switch (len) {
+	case sizeof(v16):
+		memcpy(&v16, host + offset, len);
+		return v16;
+	case sizeof(v32):
+		memcpy(&v32, host + offset, len);
+		return v32;
+	default:
+		memcpy(&v64, host + offset, len);
+		return v64;
+	}
+}
+
+/* Writes the expected wire image of one field, most significant first. */
+static void be(size_t offset, size_t len)
+{
+	uint64_t v = host_value(offset, len);
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		wire[offset + i] = v >> (8 * (len - 1 - i));
+	}
+}
+
+/* Writes the expected wire image of one field, least significant first. */
+static void le(size_t offset, size_t len)
+{
+	uint64_t v = host_value(offset, len);
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		wire[offset + i] = v >> (8 * i);
+	}
+}
+
+#define BE(base, type, member) \
+	be((base) + offsetof(type, member), sizeof(((type *) 0)->member))
+
+#define LE(base, type, member) \
+	le((base) + offsetof(type, member), sizeof(((type *) 0)->member))
+
+#define BE_TIMESTAMP(base, type, member) \
+	BE(base, type, member.seconds_msb); \
+	BE(base, type, member.seconds_lsb); \
+	BE(base, type, member.nanoseconds)
+
+static struct management_tlv *mgt_tlv(int id)
+{
+	struct management_tlv *mgt = (struct management_tlv *) buf;
+
+	memset(buf, 0, sizeof(buf));
+	mgt->type = TLV_MANAGEMENT;
+	mgt->length = sizeof(mgt->id);
+	mgt->id = id;
+	return mgt;
+}
+
+/* Takes a copy of the host image as the starting point of the wire image. */
+static void snapshot(size_t size)
+{
+	memcpy(host, buf, size);
+	memcpy(wire, buf, size);
+	if (((struct TLV *) buf)->type == TLV_MANAGEMENT) {
+		BE(0, struct management_tlv, id);
+	}
+}
+
+static int roundtrip(const char *name, size_t size)
+{
+	struct TLV *tlv = (struct TLV *) buf;
+	struct tlv_extra extra;
+	size_t i;
+	int err;
+
+	memset(&extra, 0, sizeof(extra));
+	extra.tlv = tlv;
+
+	tlv_pre_send(tlv, &extra);
+	for (i = 0; i < size; i++) {
+		if (buf[i] != wire[i]) {
+			printf("%s: wrong wire image at offset %zu\n", name, i);
+			return -1;
+		}
+	}
+	err = tlv_post_recv(&extra);
+	if (err) {
+		printf("%s: receive failed: %s\n", name, strerror(-err));
+		return -1;
+	}
+	if (memcmp(buf, host, size)) {
+		printf("%s: fields differ after the round trip\n", name);
+		return -1;
+	}
+	printf("%s: ok\n", name);
+	return 0;
+}
+
+static int test_rx_sync_timing(void)
+{
+	struct slave_rx_sync_timing_data_tlv *tlv = (void *) buf;
+	const size_t n = 20;
+	size_t base, i, size;
+
+	size = sizeof(*tlv) + n * sizeof(tlv->record[0]);
+	memset(buf, 0, sizeof(buf));
+	fill(tlv, size, 1);
+	tlv->type = TLV_SLAVE_RX_SYNC_TIMING_DATA;
+	tlv->length = size - sizeof(struct TLV);
+
+	snapshot(size);
+	BE(0, struct slave_rx_sync_timing_data_tlv,
+	   sourcePortIdentity.portNumber);
+	for (i = 0; i < n; i++) {
+		base = offsetof(struct slave_rx_sync_timing_data_tlv, record) +
+			i * sizeof(tlv->record[0]);
+		BE(base, struct slave_rx_sync_timing_record, sequenceId);
+		BE_TIMESTAMP(base, struct slave_rx_sync_timing_record,
+			     syncOriginTimestamp);
+		BE(base, struct slave_rx_sync_timing_record,
+		   totalCorrectionField);
+		BE(base, struct slave_rx_sync_timing_record,
+		   scaledCumulativeRateOffset);
+		BE_TIMESTAMP(base, struct slave_rx_sync_timing_record,
+			     syncEventIngressTimestamp);
+	}
+	return roundtrip("SLAVE_RX_SYNC_TIMING_DATA", size);
+}
+
+static int test_delay_timing(void)
+{
+	struct slave_delay_timing_data_tlv *tlv = (void *) buf;
+	const size_t n = 16;
+	size_t base, i, size;
+
+	size = sizeof(*tlv) + n * sizeof(tlv->record[0]);
+	memset(buf, 0, sizeof(buf));
+	fill(tlv, size, 2);
+	tlv->type = TLV_SLAVE_DELAY_TIMING_DATA_NP;
+	tlv->length = size - sizeof(struct TLV);
+
+	snapshot(size);
+	BE(0, struct slave_delay_timing_data_tlv,
+	   sourcePortIdentity.portNumber);
+	for (i = 0; i < n; i++) {
+		base = offsetof(struct slave_delay_timing_data_tlv, record) +
+			i * sizeof(tlv->record[0]);
+		BE(base, struct slave_delay_timing_record, sequenceId);
+		BE_TIMESTAMP(base, struct slave_delay_timing_record,
+			     delayOriginTimestamp);
+		BE(base, struct slave_delay_timing_record,
+		   totalCorrectionField);
+		BE_TIMESTAMP(base, struct slave_delay_timing_record,
+			     delayResponseTimestamp);
+	}
+	return roundtrip("SLAVE_DELAY_TIMING_DATA_NP", size);
+}
+
+static int test_port_stats(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_PORT_STATS_NP);
+	struct port_stats_np *psn = (void *) mgt->data;
+	int i;
+
+	fill(psn, sizeof(*psn), 3);
+	mgt->length += sizeof(*psn);
+
+	snapshot(data + sizeof(*psn));
+	BE(data, struct port_stats_np, portIdentity.portNumber);
+	for (i = 0; i < MAX_MESSAGE_TYPES; i++) {
+		LE(data, struct port_stats_np, stats.rxMsgType[i]);
+		LE(data, struct port_stats_np, stats.txMsgType[i]);
+	}
+	return roundtrip("PORT_STATS_NP", data + sizeof(*psn));
+}
+
+static int test_port_service_stats(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_PORT_SERVICE_STATS_NP);
+	struct port_service_stats_np *pssn = (void *) mgt->data;
+	size_t i, n = sizeof(pssn->stats) / sizeof(uint64_t);
+
+	fill(pssn, sizeof(*pssn), 4);
+	mgt->length += sizeof(*pssn);
+
+	snapshot(data + sizeof(*pssn));
+	BE(data, struct port_service_stats_np, portIdentity.portNumber);
+	/* All of the service counters are 64 bit wide. */
+	for (i = 0; i < n; i++) {
+		le(data + offsetof(struct port_service_stats_np, stats) +
+		   i * sizeof(uint64_t), sizeof(uint64_t));
+	}
+	return roundtrip("PORT_SERVICE_STATS_NP", data + sizeof(*pssn));
+}
+
+static int test_port_tlv_stats(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_PORT_TLV_STATS_NP);
+	struct port_tlv_stats_np *ptsn = (void *) mgt->data;
+
+	fill(ptsn, sizeof(*ptsn), 12);
+	mgt->length += sizeof(*ptsn);
+
+	snapshot(data + sizeof(*ptsn));
+	BE(data, struct port_tlv_stats_np, portIdentity.portNumber);
+	BE(data, struct port_tlv_stats_np, rxTlvDecoded);
+	BE(data, struct port_tlv_stats_np, rxTlvSkipped);
+	return roundtrip("PORT_TLV_STATS_NP", data + sizeof(*ptsn));
+}
+
+static int test_port_tc_stats(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_PORT_TC_STATS_NP);
+	struct port_tc_stats_np *ptcn = (void *) mgt->data;
+
+	fill(ptcn, sizeof(*ptcn), 13);
+	mgt->length += sizeof(*ptcn);
+
+	snapshot(data + sizeof(*ptcn));
+	BE(data, struct port_tc_stats_np, portIdentity.portNumber);
+	BE(data, struct port_tc_stats_np, txtsTimeout);
+	return roundtrip("PORT_TC_STATS_NP", data + sizeof(*ptcn));
+}
+
+static int test_port_stats_bulk(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_PORT_STATS_BULK_NP);
+	struct port_stats_bulk_np *psb = (void *) mgt->data;
+	const int n_values[] = { 3, 64 };
+	struct port_stats_bulk_record *rec;
+	size_t base, len;
+	uint8_t *p;
+	int i, j;
+
+	psb->generation = 7;
+	psb->first_port = 1;
+	psb->num_records = 2;
+	p = psb->data;
+	for (i = 0; i < 2; i++) {
+		rec = (void *) p;
+		rec->portNumber = i + 1;
+		rec->mask = n_values[i] == 64 ? ~0ULL : (1ULL << n_values[i]) - 1;
+		fill(rec->value, n_values[i] * sizeof(uint64_t), 5 + i);
+		p += sizeof(*rec) + n_values[i] * sizeof(uint64_t);
+	}
+	len = p - (uint8_t *) psb;
+	mgt->length += len;
+
+	snapshot(data + len);
+	BE(data, struct port_stats_bulk_np, generation);
+	BE(data, struct port_stats_bulk_np, first_port);
+	BE(data, struct port_stats_bulk_np, num_records);
+	base = data + sizeof(*psb);
+	for (i = 0; i < 2; i++) {
+		BE(base, struct port_stats_bulk_record, portNumber);
+		LE(base, struct port_stats_bulk_record, mask);
+		for (j = 0; j < n_values[i]; j++) {
+			LE(base, struct port_stats_bulk_record, value[j]);
+		}
+		base += sizeof(*rec) + n_values[i] * sizeof(uint64_t);
+	}
+	return roundtrip("PORT_STATS_BULK_NP", data + len);
+}
+
+static int test_unicast_master_table(void)
+{
+	const size_t data = offsetof(struct management_tlv, data);
+	struct management_tlv *mgt = mgt_tlv(MID_UNICAST_MASTER_TABLE_NP);
+	struct unicast_master_table_np *umtn = (void *) mgt->data;
+	const uint16_t addr_len[] = { 4, 16, 6 };
+	struct unicast_master_entry *ume;
+	size_t base, len;
+	uint8_t *p;
+	int i;
+
+	umtn->actual_table_size = 3;
+	p = (uint8_t *) umtn->unicast_masters;
+	for (i = 0; i < 3; i++) {
+		ume = (void *) p;
+		fill(ume, sizeof(*ume) + addr_len[i], 8 + i);
+		ume->address.addressLength = addr_len[i];
+		p += sizeof(*ume) + addr_len[i];
+	}
+	len = p - (uint8_t *) umtn;
+	mgt->length += len;
+
+	snapshot(data + len);
+	BE(data, struct unicast_master_table_np, actual_table_size);
+	base = data + sizeof(*umtn);
+	for (i = 0; i < 3; i++) {
+		BE(base, struct unicast_master_entry, port_identity.portNumber);
+		BE(base, struct unicast_master_entry,
+		   clock_quality.offsetScaledLogVariance);
+		BE(base, struct unicast_master_entry, address.networkProtocol);
+		BE(base, struct unicast_master_entry, address.addressLength);
+		base += sizeof(*ume) + addr_len[i];
+	}
+	return roundtrip("UNICAST_MASTER_TABLE_NP", data + len);
+}
+
+int main(int argc, char *argv[])
+{
+	int err = 0;
+
+	err |= test_rx_sync_timing();
+	err |= test_delay_timing();
+	err |= test_port_stats();
+	err |= test_port_service_stats();
+	err |= test_port_tlv_stats();
+	err |= test_port_tc_stats();
+	err |= test_port_stats_bulk();
+	err |= test_unicast_master_table();
+
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file timerq.c
+ * @brief Multiplexes a set of one shot timers onto a single timerfd.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ *
+ * The armed timers are kept in a binary heap ordered by deadline, and
+ * the timerfd is programmed for the earliest one. Re-programming is
+ * lazy. Pushing a deadline further out, as happens with every received
+ * Sync or Announce message, leaves the timerfd alone, and the resulting
+ * early wake up simply re-programs it. Only a deadline that moves ahead
+ * of the programmed one by more than the slack costs a system call.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "missing.h"
+#include "print.h"
+#include "timerq.h"
+
+struct timerq {
+	int fd;
+	int n;
+	uint64_t slack;
+	/* Deadline programmed into the timerfd, zero when disarmed. */
+	uint64_t armed;
+	/* Expired timers not yet handed out, one bit per timer. */
+	uint64_t pending;
+	uint64_t deadline[TIMERQ_MAX];
+	int pos[TIMERQ_MAX];
+	int heap[TIMERQ_MAX];
+	int len;
+	uint64_t n_armed;
+	uint64_t n_settime;
+};
+
+static uint64_t timerq_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+/* Ties are broken by identifier, to keep the expiration order stable. */
+static int timerq_before(struct timerq *q, int a, int b)
+{
+	if (q->deadline[a] != q->deadline[b]) {
+		return q->deadline[a] < q->deadline[b];
+	}
+	return a < b;
+}
+
+static void timerq_place(struct timerq *q, int i, int id)
+{
+	q->heap[i] = id;
+	q->pos[id] = i;
+}
+
+static void timerq_sift_up(struct timerq *q, int i)
+{
+	int id = q->heap[i], parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!timerq_before(q, id, q->heap[parent])) {
+			break;
+		}
+		timerq_place(q, i, q->heap[parent]);
+		i = parent;
+	}
+	timerq_place(q, i, id);
+}
+
+static void timerq_sift_down(struct timerq *q, int i)
+{
+	int id = q->heap[i], child;
+
+	while ((child = 2 * i + 1) < q->len) {
+		if (child + 1 < q->len &&
+		    timerq_before(q, q->heap[child + 1], q->heap[child])) {
+			child++;
+		}
+		if (!timerq_before(q, q->heap[child], id)) {
+			break;
+		}
+		timerq_place(q, i, q->heap[child]);
+		i = child;
+	}
+	timerq_place(q, i, id);
+}
+
+static void timerq_remove(struct timerq *q, int id)
+{
+	int i = q->pos[id], last;
+
+	if (i < 0) {
+		return;
+	}
+	q->pos[id] = -1;
+	q->len--;
+	if (i == q->len) {
+		return;
+	}
+	last = q->heap[q->len];
+	timerq_place(q, i, last);
+	timerq_sift_up(q, i);
+	timerq_sift_down(q, q->pos[last]);
+}
+
+static int timerq_settime(struct timerq *q, uint64_t deadline)
+{
+	struct itimerspec tmo = {
+		{0, 0}, {0, 0}
+	};
+
+	tmo.it_value.tv_sec = deadline / NS_PER_SEC;
+	tmo.it_value.tv_nsec = deadline % NS_PER_SEC;
+	q->armed = deadline;
+	q->n_settime++;
+
+	if (timerfd_settime(q->fd, TFD_TIMER_ABSTIME, &tmo, NULL)) {
+		pr_err("timerq: timerfd_settime failed: %m");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Makes sure that the timerfd fires no later than the earliest deadline
+ * plus the slack. When 'fired' is set, the timerfd has expired and must
+ * be re-programmed or disarmed in order to clear its readable state.
+ */
+static int timerq_program(struct timerq *q, int fired)
+{
+	uint64_t next;
+
+	if (!q->len) {
+		return fired ? timerq_settime(q, 0) : 0;
+	}
+	next = q->deadline[q->heap[0]];
+	if (q->armed && q->armed <= next + q->slack) {
+		return 0;
+	}
+	return timerq_settime(q, next);
+}
+
+struct timerq *timerq_create(int n, uint64_t slack_ns)
+{
+	struct timerq *q;
+	int i;
+
+	if (n < 1 || n > TIMERQ_MAX) {
+		return NULL;
+	}
+	q = calloc(1, sizeof(*q));
+	if (!q) {
+		return NULL;
+	}
+	q->fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (q->fd < 0) {
+		pr_err("timerfd_create: %s", strerror(errno));
+		free(q);
+		return NULL;
+	}
+	q->n = n;
+	q->slack = slack_ns;
+	for (i = 0; i < n; i++) {
+		q->pos[i] = -1;
+	}
+	return q;
+}
+
+void timerq_destroy(struct timerq *q)
+{
+	close(q->fd);
+	free(q);
+}
+
+int timerq_fd(struct timerq *q)
+{
+	return q->fd;
+}
+
+int timerq_arm(struct timerq *q, int id, uint64_t ns)
+{
+	return timerq_arm_abs(q, id, timerq_now() + ns);
+}
+
+int timerq_arm_abs(struct timerq *q, int id, uint64_t deadline)
+{
+	if (id < 0 || id >= q->n) {
+		return -1;
+	}
+	q->pending &= ~(1ULL << id);
+	q->n_armed++;
+
+	/* A zero it_value would disarm the timerfd. */
+	q->deadline[id] = deadline ? deadline : 1;
+	if (q->pos[id] < 0) {
+		q->len++;
+		timerq_place(q, q->len - 1, id);
+		timerq_sift_up(q, q->len - 1);
+	} else {
+		timerq_sift_up(q, q->pos[id]);
+		timerq_sift_down(q, q->pos[id]);
+	}
+	return timerq_program(q, 0);
+}
+
+void timerq_disarm(struct timerq *q, int id)
+{
+	if (id < 0 || id >= q->n) {
+		return;
+	}
+	q->pending &= ~(1ULL << id);
+	/*
+	 * Leave the timerfd as it is. Should it fire for nothing, then
+	 * timerq_expired() will sort it out.
+	 */
+	timerq_remove(q, id);
+}
+
+int timerq_expired(struct timerq *q)
+{
+	uint64_t due = timerq_now() + q->slack;
+	int id;
+
+	while (q->len && q->deadline[q->heap[0]] <= due) {
+		id = q->heap[0];
+		timerq_remove(q, id);
+		q->pending |= 1ULL << id;
+	}
+	if (!q->pending) {
+		id = -1;
+	} else {
+		id = __builtin_ctzll(q->pending);
+		q->pending &= ~(1ULL << id);
+	}
+	if (q->pending) {
+		/* The timerfd remains readable until it is re-programmed. */
+		return id;
+	}
+	q->armed = 0;
+	timerq_program(q, 1);
+	return id;
+}
+
+void timerq_stats(struct timerq *q, uint64_t *armed, uint64_t *settime)
+{
+	*armed = q->n_armed;
+	*settime = q->n_settime;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file timerq.h
+ * @brief Multiplexes a set of one shot timers onto a single timerfd.
+ * @note SPDX-License-Identifier: GPL-2.0+
+ */
+#ifndef HAVE_TIMERQ_H
+#define HAVE_TIMERQ_H
+
+#include <stdint.h>
+
+/** Largest number of timers in a single queue. */
+#define TIMERQ_MAX 64
+
+struct timerq;
+
+/**
+ * Creates a timer queue.
+ *
+ * Timers whose deadlines lie within the slack of each other are allowed
+ * to expire together, saving both wake ups and re-programming of the
+ * underlying timerfd.
+ *
+ * @param n         Number of timers, identified by 0 to n - 1.
+ * @param slack_ns  Coalescing slack in nanoseconds.
+ * @return          Pointer to a new queue on success, NULL otherwise.
+ */
+struct timerq *timerq_create(int n, uint64_t slack_ns);
+
+/**
+ * Destroys a timer queue and closes its timerfd.
+ * @param q  A pointer obtained via @ref timerq_create().
+ */
+void timerq_destroy(struct timerq *q);
+
+/**
+ * Obtains the file descriptor to poll for timer expirations.
+ * @param q  A pointer obtained via @ref timerq_create().
+ * @return   A timerfd descriptor.
+ */
+int timerq_fd(struct timerq *q);
+
+/**
+ * Arms or re-arms a timer relative to the current CLOCK_MONOTONIC time.
+ * @param q       A pointer obtained via @ref timerq_create().
+ * @param id      The timer to arm.
+ * @param ns      Time until expiration in nanoseconds.
+ * @return        Zero on success, non-zero otherwise.
+ */
+int timerq_arm(struct timerq *q, int id, uint64_t ns);
+
+/**
+ * Arms or re-arms a timer at an absolute CLOCK_MONOTONIC time.
+ * @param q         A pointer obtained via @ref timerq_create().
+ * @param id        The timer to arm.
+ * @param deadline  Time of expiration in nanoseconds.
+ * @return          Zero on success, non-zero otherwise.
+ */
+int timerq_arm_abs(struct timerq *q, int id, uint64_t deadline);
+
+/**
+ * Disarms a timer. A timer expiration that was not yet handed out by
+ * @ref timerq_expired() is discarded as well.
+ * @param q   A pointer obtained via @ref timerq_create().
+ * @param id  The timer to disarm.
+ */
+void timerq_disarm(struct timerq *q, int id);
+
+/**
+ * Hands out one expired timer. Call this when the queue's descriptor
+ * becomes readable. When more than one timer has expired, the one with
+ * the lowest identifier comes first, and the descriptor stays readable
+ * until all of them have been handed out.
+ *
+ * @param q  A pointer obtained via @ref timerq_create().
+ * @return   The identifier of an expired timer, or -1 if none expired.
+ */
+int timerq_expired(struct timerq *q);
+
+/**
+ * Reports how many times the timers were armed and how many of those
+ * required re-programming the timerfd.
+ * @param q        A pointer obtained via @ref timerq_create().
+ * @param armed    Returns the number of times a timer was armed.
+ * @param settime  Returns the number of timerfd_settime() calls.
+ */
+void timerq_stats(struct timerq *q, uint64_t *armed, uint64_t *settime);
+
+#endif
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "contain.h"
 #include "port.h"
 #include "tlv.h"
 #include "msg.h"
@@ -55,20 +56,6 @@ static void scaled_ns_h2n(ScaledNs *sns)
 	sns->fractional_nanoseconds = htons(sns->fractional_nanoseconds);
 }
 
-static void timestamp_host2net(struct Timestamp *t)
-{
-	HTONL(t->seconds_lsb);
-	HTONS(t->seconds_msb);
-	HTONL(t->nanoseconds);
-}
-
-static void timestamp_net2host(struct Timestamp *t)
-{
-	NTOHL(t->seconds_lsb);
-	NTOHS(t->seconds_msb);
-	NTOHL(t->nanoseconds);
-}
-
 static uint16_t flip16(void *p)
 {
 	uint16_t v;
@@ -128,6 +115,152 @@ static bool tlv_array_invalid(struct TLV *tlv, size_t base_size, size_t item_siz
 	return (tlv->length == expected_length) ? false : true;
 }
 
+/*
+ * Fixed layout records are converted field by field rather than record
+ * by record. Each pass swaps one field of one width at a constant stride
+ * through the whole array, a loop which the compiler is free to unroll
+ * and vectorize. Since swapping the bytes is its own inverse, the same
+ * layout serves for both receive and transmit. The statistics of the
+ * linuxptp specific management IDs are sent in little endian order.
+ */
+struct tlv_field {
+	uint16_t offset;
+	uint16_t size;
+	uint16_t count;
+};
+
+struct tlv_layout {
+	const struct tlv_field *field;
+	size_t n_fields;
+	bool little_endian;
+};
+
+#define TLV_FIELD(type, member) \
+	{ offsetof(type, member), sizeof(((type *) 0)->member), 1 }
+
+#define TLV_ARRAY(type, member) \
+	{ offsetof(type, member), sizeof(((type *) 0)->member[0]), \
+	  ARRAY_SIZE(((type *) 0)->member) }
+
+#define TLV_TIMESTAMP(type, member) \
+	TLV_FIELD(type, member.seconds_msb), \
+	TLV_FIELD(type, member.seconds_lsb), \
+	TLV_FIELD(type, member.nanoseconds)
+
+#define TLV_LAYOUT(fields, le) { fields, ARRAY_SIZE(fields), le }
+
+static const struct tlv_field slave_delay_timing_fields[] = {
+	TLV_FIELD(struct slave_delay_timing_record, sequenceId),
+	TLV_TIMESTAMP(struct slave_delay_timing_record, delayOriginTimestamp),
+	TLV_FIELD(struct slave_delay_timing_record, totalCorrectionField),
+	TLV_TIMESTAMP(struct slave_delay_timing_record, delayResponseTimestamp),
+};
+
+static const struct tlv_field slave_rx_sync_timing_fields[] = {
+	TLV_FIELD(struct slave_rx_sync_timing_record, sequenceId),
+	TLV_TIMESTAMP(struct slave_rx_sync_timing_record, syncOriginTimestamp),
+	TLV_FIELD(struct slave_rx_sync_timing_record, totalCorrectionField),
+	TLV_FIELD(struct slave_rx_sync_timing_record, scaledCumulativeRateOffset),
+	TLV_TIMESTAMP(struct slave_rx_sync_timing_record, syncEventIngressTimestamp),
+};
+
+static const struct tlv_field unicast_master_entry_fields[] = {
+	TLV_FIELD(struct unicast_master_entry, port_identity.portNumber),
+	TLV_FIELD(struct unicast_master_entry,
+		  clock_quality.offsetScaledLogVariance),
+	TLV_FIELD(struct unicast_master_entry, address.networkProtocol),
+	TLV_FIELD(struct unicast_master_entry, address.addressLength),
+};
+
+static const struct tlv_field port_stats_fields[] = {
+	TLV_ARRAY(struct PortStats, rxMsgType),
+	TLV_ARRAY(struct PortStats, txMsgType),
+};
+
+static const struct tlv_field port_service_stats_fields[] = {
+	TLV_FIELD(struct PortServiceStats, announce_timeout),
+	TLV_FIELD(struct PortServiceStats, sync_timeout),
+	TLV_FIELD(struct PortServiceStats, delay_timeout),
+	TLV_FIELD(struct PortServiceStats, unicast_service_timeout),
+	TLV_FIELD(struct PortServiceStats, unicast_request_timeout),
+	TLV_FIELD(struct PortServiceStats, master_announce_timeout),
+	TLV_FIELD(struct PortServiceStats, master_sync_timeout),
+	TLV_FIELD(struct PortServiceStats, qualification_timeout),
+	TLV_FIELD(struct PortServiceStats, sync_mismatch),
+	TLV_FIELD(struct PortServiceStats, followup_mismatch),
+};
+
+static const struct tlv_field counter_fields[] = {
+	{ 0, sizeof(uint64_t), 1 },
+};
+
+static const struct tlv_layout slave_delay_timing_layout =
+	TLV_LAYOUT(slave_delay_timing_fields, false);
+static const struct tlv_layout slave_rx_sync_timing_layout =
+	TLV_LAYOUT(slave_rx_sync_timing_fields, false);
+static const struct tlv_layout unicast_master_entry_layout =
+	TLV_LAYOUT(unicast_master_entry_fields, false);
+static const struct tlv_layout port_stats_layout =
+	TLV_LAYOUT(port_stats_fields, true);
+static const struct tlv_layout port_service_stats_layout =
+	TLV_LAYOUT(port_service_stats_fields, true);
+static const struct tlv_layout counter_layout =
+	TLV_LAYOUT(counter_fields, true);
+
+static void tlv_swap_stride(uint8_t *p, size_t n_items, size_t stride,
+			    size_t size)
+{
+	uint16_t v16;
+	uint32_t v32;
+	uint64_t v64;
+	size_t i;
+
+	switch (size) {
+	case sizeof(v16):
+		for (i = 0; i < n_items; i++, p += stride) {
+			memcpy(&v16, p, sizeof(v16));
+			v16 = __builtin_bswap16(v16);
+			memcpy(p, &v16, sizeof(v16));
+		}
+		break;
+	case sizeof(v32):
+		for (i = 0; i < n_items; i++, p += stride) {
+			memcpy(&v32, p, sizeof(v32));
+			v32 = __builtin_bswap32(v32);
+			memcpy(p, &v32, sizeof(v32));
+		}
+		break;
+	case sizeof(v64):
+		for (i = 0; i < n_items; i++, p += stride) {
+			memcpy(&v64, p, sizeof(v64));
+			v64 = __builtin_bswap64(v64);
+			memcpy(p, &v64, sizeof(v64));
+		}
+		break;
+	}
+}
+
+static void tlv_records_flip(void *records, size_t n_items, size_t item_size,
+			     const struct tlv_layout *layout)
+{
+	bool host_le = htons(1) != 1;
+	const struct tlv_field *f;
+	size_t j, k;
+
+	if (layout->little_endian == host_le) {
+		/* The wire order is the host order. */
+		return;
+	}
+	for (j = 0; j < layout->n_fields; j++) {
+		f = &layout->field[j];
+		for (k = 0; k < f->count; k++) {
+			tlv_swap_stride((uint8_t *) records + f->offset +
+					k * f->size, n_items, item_size,
+					f->size);
+		}
+	}
+}
+
 static int alttime_offset_post_recv(struct tlv_extra *extra)
 {
 	struct TLV *tlv = extra->tlv;
@@ -170,7 +303,14 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 	struct unicast_master_table_np *umtn;
 	struct grandmaster_settings_np *gsn;
 	struct port_service_stats_np *pssn;
+	struct port_stats_bulk_record *rec;
+	struct port_rate_stats_np *prsn;
+	struct port_tlv_stats_np *ptsn;
+	struct port_tc_stats_np *ptcn;
 	struct mgmt_clock_description *cd;
+	struct port_stats_bulk_np *psb;
+	struct clock_stats_np *csn;
+	struct servo_gains_np *sgn;
 	struct unicast_master_entry *ume;
 	struct subscribe_events_np *sen;
 	struct port_properties_np *ppn;
@@ -368,6 +508,27 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 		scaled_ns_n2h(&tsn->lastGmPhaseChange);
 		tsn->gmPresent = ntohl(tsn->gmPresent);
 		break;
+	case MID_CLOCK_STATS_NP:
+		if (data_len != sizeof(struct clock_stats_np))
+			goto bad_length;
+		csn = (struct clock_stats_np *) m->data;
+		csn->num_values = ntohl(csn->num_values);
+		csn->offset_rms = net2host64(csn->offset_rms);
+		csn->offset_max_abs = net2host64(csn->offset_max_abs);
+		csn->offset_p99 = net2host64(csn->offset_p99);
+		csn->offset_p999 = net2host64(csn->offset_p999);
+		csn->delay_mean = net2host64(csn->delay_mean);
+		csn->delay_p99 = net2host64(csn->delay_p99);
+		csn->delay_p999 = net2host64(csn->delay_p999);
+		break;
+	case MID_SERVO_GAINS_NP:
+		if (data_len != sizeof(struct servo_gains_np))
+			goto bad_length;
+		sgn = (struct servo_gains_np *) m->data;
+		sgn->scaled_kp = net2host64(sgn->scaled_kp);
+		sgn->scaled_ki = net2host64(sgn->scaled_ki);
+		sgn->offset_noise = net2host64(sgn->offset_noise);
+		break;
 	case MID_GRANDMASTER_SETTINGS_NP:
 		if (data_len != sizeof(struct grandmaster_settings_np))
 			goto bad_length;
@@ -403,38 +564,41 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 		psn = (struct port_stats_np *)m->data;
 		psn->portIdentity.portNumber =
 			ntohs(psn->portIdentity.portNumber);
-		for (i = 0 ; i < MAX_MESSAGE_TYPES; i++) {
-			psn->stats.rxMsgType[i] = __le64_to_cpu(psn->stats.rxMsgType[i]);
-			psn->stats.txMsgType[i] = __le64_to_cpu(psn->stats.txMsgType[i]);
-		}
+		tlv_records_flip(&psn->stats, 1, sizeof(psn->stats),
+				 &port_stats_layout);
 		extra_len = sizeof(struct port_stats_np);
 		break;
+	case MID_PORT_STATS_BULK_NP:
+		if (data_len < sizeof(struct port_stats_bulk_np))
+			goto bad_length;
+		psb = (struct port_stats_bulk_np *)m->data;
+		psb->generation = ntohl(psb->generation);
+		psb->first_port = ntohs(psb->first_port);
+		psb->num_records = ntohs(psb->num_records);
+		extra_len = sizeof(struct port_stats_bulk_np);
+		for (i = 0; i < psb->num_records; i++) {
+			if (data_len < extra_len + sizeof(*rec))
+				goto bad_length;
+			rec = (struct port_stats_bulk_record *)
+				(m->data + extra_len);
+			rec->portNumber = ntohs(rec->portNumber);
+			rec->mask = __le64_to_cpu(rec->mask);
+			len = __builtin_popcountll(rec->mask);
+			extra_len += sizeof(*rec) + len * sizeof(uint64_t);
+			if (data_len < extra_len)
+				goto bad_length;
+			tlv_records_flip(rec->value, len, sizeof(uint64_t),
+					 &counter_layout);
+		}
+		break;
 	case MID_PORT_SERVICE_STATS_NP:
 		if (data_len < sizeof(struct port_service_stats_np))
 			goto bad_length;
 		pssn = (struct port_service_stats_np *)m->data;
 		pssn->portIdentity.portNumber =
 			htons(pssn->portIdentity.portNumber);
-		pssn->stats.announce_timeout =
-			__le64_to_cpu(pssn->stats.announce_timeout);
-		pssn->stats.sync_timeout =
-			__le64_to_cpu(pssn->stats.sync_timeout);
-		pssn->stats.delay_timeout =
-			__le64_to_cpu(pssn->stats.delay_timeout);
-		pssn->stats.unicast_service_timeout =
-			__le64_to_cpu(pssn->stats.unicast_service_timeout);
-		pssn->stats.unicast_request_timeout =
-			__le64_to_cpu(pssn->stats.unicast_request_timeout);
-		pssn->stats.master_announce_timeout =
-			__le64_to_cpu(pssn->stats.master_announce_timeout);
-		pssn->stats.master_sync_timeout =
-			__le64_to_cpu(pssn->stats.master_sync_timeout);
-		pssn->stats.qualification_timeout =
-			__le64_to_cpu(pssn->stats.qualification_timeout);
-		pssn->stats.sync_mismatch =
-			__le64_to_cpu(pssn->stats.sync_mismatch);
-		pssn->stats.followup_mismatch =
-			__le64_to_cpu(pssn->stats.followup_mismatch);
+		tlv_records_flip(&pssn->stats, 1, sizeof(pssn->stats),
+				 &port_service_stats_layout);
 		extra_len = sizeof(struct port_service_stats_np);
 		break;
 	case MID_UNICAST_MASTER_TABLE_NP:
@@ -450,14 +614,8 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 			if (data_len < len)
 				goto bad_length;
 			ume = (struct unicast_master_entry *) buf;
-			ume->port_identity.portNumber =
-				ntohs(ume->port_identity.portNumber);
-			ume->clock_quality.offsetScaledLogVariance =
-				ntohs(ume->clock_quality.offsetScaledLogVariance);
-			ume->address.networkProtocol =
-				ntohs(ume->address.networkProtocol);
-			ume->address.addressLength =
-				ntohs(ume->address.addressLength);
+			tlv_records_flip(ume, 1, sizeof(*ume),
+					 &unicast_master_entry_layout);
 			len += ume->address.addressLength;
 			if (data_len < len)
 				goto bad_length;
@@ -490,6 +648,35 @@ static int mgt_post_recv(struct management_tlv *m, uint16_t data_len,
 		NTOHL(cmlds->scaledNeighborRateRatio);
 		NTOHL(cmlds->as_capable);
 		break;
+	case MID_PORT_RATE_STATS_NP:
+		if (data_len < sizeof(struct port_rate_stats_np))
+			goto bad_length;
+		prsn = (struct port_rate_stats_np *)m->data;
+		NTOHS(prsn->portIdentity.portNumber);
+		NTOHL(prsn->allanDeviation);
+		net2host64_unaligned(&prsn->pathDelayVariation);
+		NTOHL(prsn->rateChanges);
+		net2host64_unaligned(&prsn->syncSaved);
+		net2host64_unaligned(&prsn->pdelaySaved);
+		extra_len = sizeof(struct port_rate_stats_np);
+		break;
+	case MID_PORT_TLV_STATS_NP:
+		if (data_len < sizeof(struct port_tlv_stats_np))
+			goto bad_length;
+		ptsn = (struct port_tlv_stats_np *)m->data;
+		NTOHS(ptsn->portIdentity.portNumber);
+		net2host64_unaligned(&ptsn->rxTlvDecoded);
+		net2host64_unaligned(&ptsn->rxTlvSkipped);
+		extra_len = sizeof(struct port_tlv_stats_np);
+		break;
+	case MID_PORT_TC_STATS_NP:
+		if (data_len < sizeof(struct port_tc_stats_np))
+			goto bad_length;
+		ptcn = (struct port_tc_stats_np *)m->data;
+		NTOHS(ptcn->portIdentity.portNumber);
+		net2host64_unaligned(&ptcn->txtsTimeout);
+		extra_len = sizeof(struct port_tc_stats_np);
+		break;
 	case MID_SAVE_IN_NON_VOLATILE_STORAGE:
 	case MID_RESET_NON_VOLATILE_STORAGE:
 	case MID_INITIALIZE:
@@ -518,7 +705,14 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 	struct unicast_master_table_np *umtn;
 	struct grandmaster_settings_np *gsn;
 	struct port_service_stats_np *pssn;
+	struct port_stats_bulk_record *rec;
+	struct port_rate_stats_np *prsn;
+	struct port_tlv_stats_np *ptsn;
+	struct port_tc_stats_np *ptcn;
 	struct mgmt_clock_description *cd;
+	struct port_stats_bulk_np *psb;
+	struct clock_stats_np *csn;
+	struct servo_gains_np *sgn;
 	struct unicast_master_entry *ume;
 	struct subscribe_events_np *sen;
 	struct port_properties_np *ppn;
@@ -532,8 +726,8 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 	struct currentDS *cds;
 	struct parentDS *pds;
 	struct portDS *p;
+	int i, len;
 	uint8_t *buf;
-	int i;
 
 	switch (m->id) {
 	case MID_CLOCK_DESCRIPTION:
@@ -597,6 +791,23 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 		scaled_ns_h2n(&tsn->lastGmPhaseChange);
 		tsn->gmPresent = htonl(tsn->gmPresent);
 		break;
+	case MID_CLOCK_STATS_NP:
+		csn = (struct clock_stats_np *) m->data;
+		csn->num_values = htonl(csn->num_values);
+		csn->offset_rms = host2net64(csn->offset_rms);
+		csn->offset_max_abs = host2net64(csn->offset_max_abs);
+		csn->offset_p99 = host2net64(csn->offset_p99);
+		csn->offset_p999 = host2net64(csn->offset_p999);
+		csn->delay_mean = host2net64(csn->delay_mean);
+		csn->delay_p99 = host2net64(csn->delay_p99);
+		csn->delay_p999 = host2net64(csn->delay_p999);
+		break;
+	case MID_SERVO_GAINS_NP:
+		sgn = (struct servo_gains_np *) m->data;
+		sgn->scaled_kp = host2net64(sgn->scaled_kp);
+		sgn->scaled_ki = host2net64(sgn->scaled_ki);
+		sgn->offset_noise = host2net64(sgn->offset_noise);
+		break;
 	case MID_GRANDMASTER_SETTINGS_NP:
 		gsn = (struct grandmaster_settings_np *) m->data;
 		gsn->clockQuality.offsetScaledLogVariance =
@@ -620,35 +831,31 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 		psn = (struct port_stats_np *)m->data;
 		psn->portIdentity.portNumber =
 			htons(psn->portIdentity.portNumber);
-		for (i = 0 ; i < MAX_MESSAGE_TYPES; i++) {
-			psn->stats.rxMsgType[i] = __cpu_to_le64(psn->stats.rxMsgType[i]);
-			psn->stats.txMsgType[i] = __cpu_to_le64(psn->stats.txMsgType[i]);
+		tlv_records_flip(&psn->stats, 1, sizeof(psn->stats),
+				 &port_stats_layout);
+		break;
+	case MID_PORT_STATS_BULK_NP:
+		psb = (struct port_stats_bulk_np *)m->data;
+		buf = psb->data;
+		for (i = 0; i < psb->num_records; i++) {
+			rec = (struct port_stats_bulk_record *)buf;
+			len = __builtin_popcountll(rec->mask);
+			tlv_records_flip(rec->value, len, sizeof(uint64_t),
+					 &counter_layout);
+			rec->portNumber = htons(rec->portNumber);
+			rec->mask = __cpu_to_le64(rec->mask);
+			buf += sizeof(*rec) + len * sizeof(uint64_t);
 		}
+		psb->generation = htonl(psb->generation);
+		psb->first_port = htons(psb->first_port);
+		psb->num_records = htons(psb->num_records);
 		break;
 	case MID_PORT_SERVICE_STATS_NP:
 		pssn = (struct port_service_stats_np *)m->data;
 		pssn->portIdentity.portNumber =
 			htons(pssn->portIdentity.portNumber);
-		pssn->stats.announce_timeout =
-			__cpu_to_le64(pssn->stats.announce_timeout);
-		pssn->stats.sync_timeout =
-			__cpu_to_le64(pssn->stats.sync_timeout);
-		pssn->stats.delay_timeout =
-			__cpu_to_le64(pssn->stats.delay_timeout);
-		pssn->stats.unicast_service_timeout =
-			__cpu_to_le64(pssn->stats.unicast_service_timeout);
-		pssn->stats.unicast_request_timeout =
-			__cpu_to_le64(pssn->stats.unicast_request_timeout);
-		pssn->stats.master_announce_timeout =
-			__cpu_to_le64(pssn->stats.master_announce_timeout);
-		pssn->stats.master_sync_timeout =
-			__cpu_to_le64(pssn->stats.master_sync_timeout);
-		pssn->stats.qualification_timeout =
-			__cpu_to_le64(pssn->stats.qualification_timeout);
-		pssn->stats.sync_mismatch =
-			__cpu_to_le64(pssn->stats.sync_mismatch);
-		pssn->stats.followup_mismatch =
-			__cpu_to_le64(pssn->stats.followup_mismatch);
+		tlv_records_flip(&pssn->stats, 1, sizeof(pssn->stats),
+				 &port_service_stats_layout);
 		break;
 	case MID_UNICAST_MASTER_TABLE_NP:
 		umtn = (struct unicast_master_table_np *)m->data;
@@ -657,14 +864,8 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 			ume = (struct unicast_master_entry *) buf;
 			// update pointer before the conversion
 			buf += sizeof(*ume) + ume->address.addressLength;
-			ume->port_identity.portNumber =
-				htons(ume->port_identity.portNumber);
-			ume->clock_quality.offsetScaledLogVariance =
-				htons(ume->clock_quality.offsetScaledLogVariance);
-			ume->address.networkProtocol =
-				htons(ume->address.networkProtocol);
-			ume->address.addressLength =
-				htons(ume->address.addressLength);
+			tlv_records_flip(ume, 1, sizeof(*ume),
+					 &unicast_master_entry_layout);
 		}
 		umtn->actual_table_size =
 			htons(umtn->actual_table_size);
@@ -688,6 +889,26 @@ static void mgt_pre_send(struct management_tlv *m, struct tlv_extra *extra)
 		HTONL(cmlds->scaledNeighborRateRatio);
 		HTONL(cmlds->as_capable);
 		break;
+	case MID_PORT_RATE_STATS_NP:
+		prsn = (struct port_rate_stats_np *)m->data;
+		HTONS(prsn->portIdentity.portNumber);
+		HTONL(prsn->allanDeviation);
+		host2net64_unaligned(&prsn->pathDelayVariation);
+		HTONL(prsn->rateChanges);
+		host2net64_unaligned(&prsn->syncSaved);
+		host2net64_unaligned(&prsn->pdelaySaved);
+		break;
+	case MID_PORT_TLV_STATS_NP:
+		ptsn = (struct port_tlv_stats_np *)m->data;
+		HTONS(ptsn->portIdentity.portNumber);
+		host2net64_unaligned(&ptsn->rxTlvDecoded);
+		host2net64_unaligned(&ptsn->rxTlvSkipped);
+		break;
+	case MID_PORT_TC_STATS_NP:
+		ptcn = (struct port_tc_stats_np *)m->data;
+		HTONS(ptcn->portIdentity.portNumber);
+		host2net64_unaligned(&ptcn->txtsTimeout);
+		break;
 	}
 }
 
@@ -924,15 +1145,8 @@ static int slave_delay_timing_data_post_revc(struct tlv_extra *extra)
 
 	NTOHS(slave_delay->sourcePortIdentity.portNumber);
 
-	while (n_items) {
-		NTOHS(record->sequenceId);
-		timestamp_net2host(&record->delayOriginTimestamp);
-		net2host64_unaligned(&record->totalCorrectionField);
-		timestamp_net2host(&record->delayResponseTimestamp);
-		n_items--;
-		record++;
-	}
-
+	tlv_records_flip(record, n_items, sizeof(*record),
+			 &slave_delay_timing_layout);
 	return 0;
 }
 
@@ -948,14 +1162,8 @@ static void slave_delay_timing_data_pre_send(struct tlv_extra *extra)
 
 	HTONS(slave_delay->sourcePortIdentity.portNumber);
 
-	while (n_items) {
-		HTONS(record->sequenceId);
-		timestamp_host2net(&record->delayOriginTimestamp);
-		host2net64_unaligned(&record->totalCorrectionField);
-		timestamp_host2net(&record->delayResponseTimestamp);
-		n_items--;
-		record++;
-	}
+	tlv_records_flip(record, n_items, sizeof(*record),
+			 &slave_delay_timing_layout);
 }
 
 static int slave_rx_sync_timing_data_post_revc(struct tlv_extra *extra)
@@ -973,16 +1181,8 @@ static int slave_rx_sync_timing_data_post_revc(struct tlv_extra *extra)
 
 	NTOHS(slave_data->sourcePortIdentity.portNumber);
 
-	while (n_items) {
-		NTOHS(record->sequenceId);
-		timestamp_net2host(&record->syncOriginTimestamp);
-		net2host64_unaligned(&record->totalCorrectionField);
-		NTOHL(record->scaledCumulativeRateOffset);
-		timestamp_net2host(&record->syncEventIngressTimestamp);
-		n_items--;
-		record++;
-	}
-
+	tlv_records_flip(record, n_items, sizeof(*record),
+			 &slave_rx_sync_timing_layout);
 	return 0;
 }
 
@@ -998,15 +1198,8 @@ static void slave_rx_sync_timing_data_pre_send(struct tlv_extra *extra)
 
 	HTONS(slave_data->sourcePortIdentity.portNumber);
 
-	while (n_items) {
-		HTONS(record->sequenceId);
-		timestamp_host2net(&record->syncOriginTimestamp);
-		host2net64_unaligned(&record->totalCorrectionField);
-		HTONL(record->scaledCumulativeRateOffset);
-		timestamp_host2net(&record->syncEventIngressTimestamp);
-		n_items--;
-		record++;
-	}
+	tlv_records_flip(record, n_items, sizeof(*record),
+			 &slave_rx_sync_timing_layout);
 }
 
 static int auth_post_recv(struct tlv_extra *extra)
@@ -100,6 +100,8 @@ enum management_action {
 #define MID_GRANDMASTER_SETTINGS_NP			0xC001
 #define MID_SUBSCRIBE_EVENTS_NP				0xC003
 #define MID_SYNCHRONIZATION_UNCERTAIN_NP		0xC006
+#define MID_CLOCK_STATS_NP				0xC00C
+#define MID_SERVO_GAINS_NP				0xC00D
 
 /* Port management ID values */
 #define MID_NULL_MANAGEMENT				0x0000
@@ -130,6 +132,11 @@ enum management_action {
 #define MID_PORT_HWCLOCK_NP				0xC009
 #define MID_POWER_PROFILE_SETTINGS_NP			0xC00A
 #define MID_CMLDS_INFO_NP				0xC00B
+#define MID_PORT_STATS_BULK_NP				0xC00E
+#define MID_PORT_RATE_STATS_NP				0xC00F
+#define MID_RELOAD_CONFIG_NP				0xC010
+#define MID_PORT_TLV_STATS_NP				0xC011
+#define MID_PORT_TC_STATS_NP				0xC012
 
 /* Management error ID values */
 #define MID_RESPONSE_TOO_BIG				0x0001
@@ -403,6 +410,30 @@ struct time_status_np {
 	struct ClockIdentity gmIdentity;
 } PACKED;
 
+/*
+ * Summary statistics of the last complete summary_interval. The offset
+ * and delay percentiles are taken over the absolute values.
+ */
+struct clock_stats_np {
+	UInteger32    num_values;
+	int64_t       offset_rms;      /*nanoseconds*/
+	int64_t       offset_max_abs;  /*nanoseconds*/
+	int64_t       offset_p99;      /*nanoseconds*/
+	int64_t       offset_p999;     /*nanoseconds*/
+	int64_t       delay_mean;      /*nanoseconds*/
+	int64_t       delay_p99;       /*nanoseconds*/
+	int64_t       delay_p999;      /*nanoseconds*/
+} PACKED;
+
+/* The gains are scaled by 2^32. */
+struct servo_gains_np {
+	int64_t       scaled_kp;
+	int64_t       scaled_ki;
+	int64_t       offset_noise;    /*nanoseconds*/
+	UInteger8     adaptive;
+	UInteger8     reserved;
+} PACKED;
+
 struct grandmaster_settings_np {
 	struct ClockQuality clockQuality;
 	Integer16 utc_offset;
@@ -447,6 +478,78 @@ struct port_service_stats_np {
 	struct PortServiceStats stats;
 } PACKED;
 
+/*
+ * The counters of a port as they appear in a bulk statistics record,
+ * namely the fields of struct PortStats followed by those of struct
+ * PortServiceStats. There may be at most 64 of them.
+ */
+#define PORT_STATS_BULK_COUNTERS \
+	((sizeof(struct PortStats) + sizeof(struct PortServiceStats)) / \
+	 sizeof(uint64_t))
+
+/*
+ * In a GET request, 'generation' asks for the counters that changed
+ * after that generation, or for all of them when zero, and 'first_port'
+ * is the port number to start from. A response carries the current
+ * generation and 'first_port' tells where the next part of the
+ * response starts, or zero if this is the last part.
+ */
+struct port_stats_bulk_np {
+	UInteger32 generation;
+	UInteger16 first_port;
+	UInteger16 num_records;
+	uint8_t data[0];
+} PACKED;
+
+/*
+ * Bit 'n' of the mask is set when counter 'n' is present. The values
+ * follow in the order of their bits.
+ */
+struct port_stats_bulk_record {
+	UInteger16 portNumber;
+	UInteger16 reserved;
+	uint64_t mask;
+	uint64_t value[0];
+} PACKED;
+
+/*
+ * The message rates chosen by the adaptive rate controller of a port.
+ * The Allan deviation is given in parts per 10^12, and the savings count
+ * the Sync messages and peer delay exchanges that the fastest rates
+ * would have needed on top of the ones that actually took place.
+ */
+struct port_rate_stats_np {
+	struct PortIdentity portIdentity;
+	UInteger8 enabled;
+	Integer8 logSyncInterval;
+	Integer8 logPdelayReqInterval;
+	UInteger8 reserved;
+	UInteger32 allanDeviation;
+	TimeInterval pathDelayVariation;
+	UInteger32 rateChanges;
+	UInteger64 syncSaved;
+	UInteger64 pdelaySaved;
+} PACKED;
+
+/*
+ * The received messages whose TLVs were decoded, and the ones that were
+ * dropped while their TLVs were still in wire format.
+ */
+struct port_tlv_stats_np {
+	struct PortIdentity portIdentity;
+	UInteger64 rxTlvDecoded;
+	UInteger64 rxTlvSkipped;
+} PACKED;
+
+/*
+ * The events which a transparent clock port dropped because their
+ * transmit time stamp did not arrive within tx_timestamp_timeout.
+ */
+struct port_tc_stats_np {
+	struct PortIdentity portIdentity;
+	UInteger64 txtsTimeout;
+} PACKED;
+
 struct unicast_master_table_np {
 	uint16_t actual_table_size;
 	struct unicast_master_entry unicast_masters[0];
@@ -19,6 +19,7 @@
 
 #include <arpa/inet.h>
 
+#include "config.h"
 #include "transport.h"
 #include "transport_private.h"
 #include "raw.h"
@@ -37,6 +38,18 @@ int transport_open(struct transport *t, struct interface *iface,
 	return t->open(t, iface, fda, tt);
 }
 
+int transport_domain_filter(struct transport *t, const char *name, int *ts)
+{
+	*ts = -1;
+	if (!config_get_int(t->cfg, name, "socket_domain_filter")) {
+		return -1;
+	}
+	if (!config_get_int(t->cfg, name, "ignore_transport_specific")) {
+		*ts = config_get_int(t->cfg, name, "transportSpecific") << 4;
+	}
+	return config_get_int(t->cfg, NULL, "domainNumber");
+}
+
 int transport_recv(struct transport *t, int fd, struct ptp_message *msg)
 {
 	return t->recv(t, fd, msg, sizeof(msg->data), &msg->address, &msg->hwts);
@@ -77,6 +90,17 @@ int transport_txts(struct fdarray *fda,
 	return cnt > 0 ? 0 : cnt;
 }
 
+int transport_txts_nowait(struct fdarray *fda, struct ptp_message *msg)
+{
+	int cnt, len = ntohs(msg->header.messageLength);
+	struct hw_timestamp *hwts = &msg->hwts;
+	unsigned char pkt[1600];
+
+	cnt = sk_receive(fda->fd[FD_EVENT], pkt, len, NULL, hwts,
+			 MSG_ERRQUEUE | MSG_DONTWAIT);
+	return cnt > 0 ? 0 : cnt;
+}
+
 int transport_physical_addr(struct transport *t, uint8_t *addr)
 {
 	if (t->physical_addr) {
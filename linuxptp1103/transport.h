@@ -51,6 +51,7 @@ enum transport_event {
 	TRANS_ONESTEP,
 	TRANS_P2P1STEP,
 	TRANS_DEFER_EVENT,
+	TRANS_GENERAL_NOWAIT, /* general message, fail instead of blocking */
 };
 
 struct transport;
@@ -113,6 +114,18 @@ int transport_sendto(struct transport *t, struct fdarray *fda,
 int transport_txts(struct fdarray *fda,
 		   struct ptp_message *msg);
 
+/**
+ * Fetches the transmit time stamp for a PTP message that was sent
+ * with the TRANS_DEFER_EVENT flag, without waiting for it. The caller
+ * polls the event socket beforehand, see @ref sk_txts_pollfd().
+ *
+ * @param fda	The array of descriptors filled in by transport_open.
+ * @param msg	The message previously sent using transport_send(),
+ *              transport_peer(), or transport_sendto().
+ * @return	Zero on success, or negative value in case of an error.
+ */
+int transport_txts_nowait(struct fdarray *fda, struct ptp_message *msg);
+
 /**
  * Returns the transport's type.
  */
@@ -49,4 +49,15 @@ struct transport {
 	int (*protocol_addr)(struct transport *t, uint8_t *addr);
 };
 
+/**
+ * Obtain the messages which the sockets of an interface are restricted
+ * to by the socket_domain_filter option.
+ * @param t     The transport.
+ * @param name  The name of the interface, as used in the configuration.
+ * @param ts    Returns the transportSpecific value to accept, in the
+ *              upper nibble, or -1 to accept any.
+ * @return      The domainNumber to accept, or -1 if no filter is wanted.
+ */
+int transport_domain_filter(struct transport *t, const char *name, int *ts);
+
 #endif
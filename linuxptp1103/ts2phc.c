@@ -8,6 +8,8 @@
  */
 #include <errno.h>
 #include <net/if.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -29,6 +31,28 @@ struct interface {
 	STAILQ_ENTRY(interface) list;
 };
 
+struct ts2phc_worker {
+	pthread_t thread;
+	/* Protects the fields below from concurrent access. */
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool pending;
+	bool stop;
+	tmv_t ts;
+	tmv_t source_tmv;
+	int holdover;
+	int64_t rx;
+	unsigned int overruns;
+};
+
+static int64_t ts2phc_monotonic(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * NS_PER_SEC + now.tv_nsec;
+}
+
 static void ts2phc_cleanup(struct ts2phc_private *priv)
 {
 	struct ts2phc_port *p, *tmp;
@@ -142,6 +166,11 @@ static struct servo *ts2phc_servo_create(struct ts2phc_private *priv,
 
 	servo_sync_interval(servo, SERVO_SYNC_INTERVAL);
 
+	if (servo_state_attach(servo, priv->cfg, clock->name)) {
+		servo_destroy(servo);
+		return NULL;
+	}
+
 	return servo;
 }
 
@@ -152,6 +181,7 @@ void ts2phc_clock_add_tstamp(struct ts2phc_clock *clock, tmv_t t)
 	pr_debug("adding tstamp %ld.%09ld to clock %s",
 		 ts.tv_sec, ts.tv_nsec, clock->name);
 	clock->last_ts = t;
+	clock->last_rx = ts2phc_monotonic();
 	clock->is_ts_available = true;
 }
 
@@ -198,7 +228,6 @@ struct ts2phc_clock *ts2phc_clock_add(struct ts2phc_private *priv,
 	c->fd = CLOCKID_TO_FD(clkid);
 	c->phc_index = phc_index;
 	c->servo_state = SERVO_UNLOCKED;
-	c->servo = ts2phc_servo_create(priv, c);
 	c->no_adj = config_get_int(priv->cfg, NULL, "free_running");
 	err = asprintf(&c->name, "/dev/ptp%d", phc_index);
 	if (err < 0) {
@@ -206,13 +235,18 @@ struct ts2phc_clock *ts2phc_clock_add(struct ts2phc_private *priv,
 		posix_clock_close(clkid);
 		return NULL;
 	}
+	c->servo = ts2phc_servo_create(priv, c);
 
 	LIST_INSERT_HEAD(&priv->clocks, c, list);
 	return c;
 }
 
+static void ts2phc_worker_stop(struct ts2phc_clock *c);
+
 void ts2phc_clock_destroy(struct ts2phc_clock *c)
 {
+	if (c->worker)
+		ts2phc_worker_stop(c);
 	servo_destroy(c->servo);
 	posix_clock_close(c->clkid);
 	free(c->name);
@@ -440,109 +474,285 @@ static int ts2phc_pps_source_implicit_tstamp(struct ts2phc_private *priv,
 	return 0;
 }
 
-static void ts2phc_synchronize_clocks(struct ts2phc_private *priv, int autocfg)
+/*
+ * Determines the source time stamp of the current edge, once for all the
+ * clocks. With an automatic configuration, the edge waits for the time
+ * stamp of the reference clock, and it is given up on when the caller
+ * sets 'last' and the reference still did not report.
+ */
+static bool ts2phc_edge_ready(struct ts2phc_private *priv, bool last)
 {
-	struct timespec source_ts, now;
-	tmv_t source_tmv;
-	struct ts2phc_clock *c;
-	int holdover, valid;
+	struct timespec now;
+	int valid;
 
-	if (autocfg) {
+	if (priv->edge_state != TS2PHC_EDGE_PENDING)
+		return priv->edge_state == TS2PHC_EDGE_READY;
+
+	if (priv->autocfg) {
 		if (!priv->ref_clock) {
 			pr_debug("no reference clock, skipping");
-			return;
+			priv->edge_state = TS2PHC_EDGE_SKIP;
+			return false;
 		}
-		valid = ts2phc_clock_get_tstamp(priv->ref_clock, &source_tmv);
+		valid = ts2phc_clock_get_tstamp(priv->ref_clock,
+						&priv->edge_source);
 		if (!valid) {
+			if (!last)
+				return false;
 			pr_err("reference clock (%s) timestamp not valid, skipping",
 				priv->ref_clock->name);
-			return;
+			priv->edge_state = TS2PHC_EDGE_SKIP;
+			return false;
 		}
 	} else {
-		valid = !ts2phc_pps_source_implicit_tstamp(priv, &source_tmv);
+		valid = !ts2phc_pps_source_implicit_tstamp(priv,
+							   &priv->edge_source);
 	}
 
 	if (valid) {
 		priv->holdover_start = 0;
-		holdover = 0;
+		priv->edge_holdover = 0;
 	} else {
 		clock_gettime(CLOCK_MONOTONIC, &now);
 
 		if (!priv->holdover_start)
 			priv->holdover_start = now.tv_sec;
-		if (now.tv_sec >= priv->holdover_start + priv->holdover_length)
+		if (now.tv_sec >= priv->holdover_start + priv->holdover_length) {
+			priv->edge_state = TS2PHC_EDGE_SKIP;
+			return false;
+		}
+		priv->edge_holdover = 1;
+	}
+	priv->edge_state = TS2PHC_EDGE_READY;
+	return true;
+}
+
+static void ts2phc_clock_sync(struct ts2phc_clock *c, tmv_t ts,
+			      tmv_t source_tmv, int holdover, int64_t rx)
+{
+	struct timespec source_ts;
+	int64_t offset, latency;
+	double adj;
+	int err = 0;
+
+	if (holdover) {
+		if (c->servo_state != SERVO_LOCKED_STABLE)
 			return;
-		holdover = 1;
+		source_ts = tmv_to_timespec(ts);
+		if (source_ts.tv_nsec > NS_PER_SEC / 2)
+			source_ts.tv_sec++;
+		source_ts.tv_nsec = 0;
+		source_tmv = timespec_to_tmv(source_ts);
 	}
 
-	LIST_FOREACH(c, &priv->clocks, list) {
-		int64_t offset;
-		double adj;
-		tmv_t ts;
+	offset = tmv_to_nanoseconds(tmv_sub(ts, source_tmv));
 
-		if (!c->is_target)
-			continue;
+	if (c->no_adj) {
+		pr_info("%s offset %10" PRId64, c->name,
+			offset);
+		return;
+	}
 
-		valid = ts2phc_clock_get_tstamp(c, &ts);
-		if (!valid) {
-			pr_debug("%s timestamp not valid, skipping", c->name);
-			continue;
-		}
+	adj = servo_sample(c->servo, offset, tmv_to_nanoseconds(ts),
+			   SAMPLE_WEIGHT, &c->servo_state);
 
-		if (holdover) {
-			if (c->servo_state != SERVO_LOCKED_STABLE)
-				continue;
-			source_ts = tmv_to_timespec(ts);
-			if (source_ts.tv_nsec > NS_PER_SEC / 2)
-				source_ts.tv_sec++;
-			source_ts.tv_nsec = 0;
-			source_tmv = timespec_to_tmv(source_ts);
-		}
+	if (holdover && c->servo_state != SERVO_LOCKED_STABLE) {
+		pr_info("%s lost holdover lock (offset %10" PRId64 ")",
+			c->name, offset);
+		return;
+	}
 
-		offset = tmv_to_nanoseconds(tmv_sub(ts, source_tmv));
+	switch (c->servo_state) {
+	case SERVO_UNLOCKED:
+		break;
+	case SERVO_JUMP:
+		err = clockadj_set_freq(c->clkid, -adj);
+		if (!err)
+			err = clockadj_step(c->clkid, -offset);
+		break;
+	case SERVO_LOCKED:
+	case SERVO_LOCKED_STABLE:
+		err = clockadj_set_freq(c->clkid, -adj);
+		break;
+	}
 
-		if (c->no_adj) {
-			pr_info("%s offset %10" PRId64, c->name,
-				offset);
-			continue;
-		}
+	/* Time from reading the event to the completed adjustment. */
+	latency = ts2phc_monotonic() - rx;
 
-		adj = servo_sample(c->servo, offset, tmv_to_nanoseconds(ts),
-				   SAMPLE_WEIGHT, &c->servo_state);
+	pr_info("%s offset %10" PRId64 " s%d freq %+7.0f latency %6" PRId64 "%s",
+		c->name, offset, c->servo_state, adj, latency,
+		holdover ? " holdover" : "");
 
-		if (holdover && c->servo_state != SERVO_LOCKED_STABLE) {
-			pr_info("%s lost holdover lock (offset %10" PRId64 ")",
-				c->name, offset);
-			continue;
-		}
+	if (err) {
+		servo_reset(c->servo);
+		c->servo_state = SERVO_UNLOCKED;
+	}
+}
 
-		pr_info("%s offset %10" PRId64 " s%d freq %+7.0f%s",
-			c->name, offset, c->servo_state, adj,
-			holdover ? " holdover" : "");
+static void *ts2phc_worker_run(void *arg)
+{
+	struct ts2phc_clock *c = arg;
+	struct ts2phc_worker *w = c->worker;
+	tmv_t ts, source_tmv;
+	int holdover;
+	int64_t rx;
 
-		switch (c->servo_state) {
-		case SERVO_UNLOCKED:
-			break;
-		case SERVO_JUMP:
-			if (clockadj_set_freq(c->clkid, -adj)) {
-				goto servo_unlock;
-			}
-			if (clockadj_step(c->clkid, -offset)) {
-				goto servo_unlock;
-			}
-			break;
-		case SERVO_LOCKED:
-		case SERVO_LOCKED_STABLE:
-			if (clockadj_set_freq(c->clkid, -adj)) {
-				goto servo_unlock;
-			}
+	pthread_mutex_lock(&w->mutex);
+	while (1) {
+		while (!w->pending && !w->stop)
+			pthread_cond_wait(&w->cond, &w->mutex);
+		if (w->stop)
 			break;
+		ts = w->ts;
+		source_tmv = w->source_tmv;
+		holdover = w->holdover;
+		rx = w->rx;
+		w->pending = false;
+		pthread_mutex_unlock(&w->mutex);
+
+		ts2phc_clock_sync(c, ts, source_tmv, holdover, rx);
+		servo_state_flush(c->servo);
+
+		pthread_mutex_lock(&w->mutex);
+	}
+	pthread_mutex_unlock(&w->mutex);
+	return NULL;
+}
+
+static int ts2phc_worker_start(struct ts2phc_clock *c)
+{
+	struct ts2phc_worker *w;
+	sigset_t all, old;
+	int err;
+
+	w = calloc(1, sizeof(*w));
+	if (!w) {
+		pr_err("failed to allocate memory for a worker");
+		return -1;
+	}
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	c->worker = w;
+
+	/* Leave the termination signals to the main thread. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&w->thread, NULL, ts2phc_worker_run, c);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err) {
+		pr_err("failed to create worker thread: %s", strerror(err));
+		pthread_cond_destroy(&w->cond);
+		pthread_mutex_destroy(&w->mutex);
+		free(w);
+		c->worker = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+static void ts2phc_worker_stop(struct ts2phc_clock *c)
+{
+	struct ts2phc_worker *w = c->worker;
+
+	pthread_mutex_lock(&w->mutex);
+	w->stop = true;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->mutex);
+	pthread_join(w->thread, NULL);
+
+	if (w->overruns)
+		pr_warning("%s: worker skipped %u edges", c->name, w->overruns);
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->mutex);
+	free(w);
+	c->worker = NULL;
+}
+
+static void ts2phc_worker_post(struct ts2phc_clock *c, tmv_t ts,
+			       tmv_t source_tmv, int holdover)
+{
+	struct ts2phc_worker *w = c->worker;
+
+	pthread_mutex_lock(&w->mutex);
+	if (w->pending)
+		w->overruns++;
+	w->ts = ts;
+	w->source_tmv = source_tmv;
+	w->holdover = holdover;
+	w->rx = c->last_rx;
+	w->pending = true;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->mutex);
+}
+
+static int ts2phc_workers_start(struct ts2phc_private *priv)
+{
+	struct ts2phc_clock *c;
+
+	LIST_FOREACH(c, &priv->clocks, list) {
+		if (ts2phc_worker_start(c))
+			return -1;
+	}
+	return 0;
+}
+
+/* Hands the time stamp of a target clock over to its servo. */
+static void ts2phc_clock_dispatch(struct ts2phc_private *priv,
+				  struct ts2phc_clock *c)
+{
+	tmv_t ts;
+
+	if (!ts2phc_clock_get_tstamp(c, &ts))
+		return;
+
+	if (c->worker)
+		ts2phc_worker_post(c, ts, priv->edge_source,
+				   priv->edge_holdover);
+	else
+		ts2phc_clock_sync(c, ts, priv->edge_source,
+				  priv->edge_holdover, c->last_rx);
+}
+
+void ts2phc_clock_event(struct ts2phc_private *priv, struct ts2phc_clock *clock)
+{
+	struct ts2phc_clock *c;
+
+	if (!priv->workers || !ts2phc_edge_ready(priv, false))
+		return;
+
+	/*
+	 * The event of the reference clock releases the targets which
+	 * reported earlier, any other event only the clock itself.
+	 */
+	if (clock == priv->ref_clock) {
+		LIST_FOREACH(c, &priv->clocks, list) {
+			if (c->is_target)
+				ts2phc_clock_dispatch(priv, c);
 		}
-		continue;
+	} else if (clock->is_target) {
+		ts2phc_clock_dispatch(priv, clock);
+	}
+}
 
-servo_unlock:
-		servo_reset(c->servo);
-		c->servo_state = SERVO_UNLOCKED;
+static void ts2phc_synchronize_clocks(struct ts2phc_private *priv)
+{
+	struct ts2phc_clock *c;
+
+	if (!ts2phc_edge_ready(priv, true))
+		return;
+
+	LIST_FOREACH(c, &priv->clocks, list) {
+		if (!c->is_target)
+			continue;
+
+		if (!c->is_ts_available) {
+			/* The workers have already taken the others. */
+			if (!priv->workers)
+				pr_debug("%s timestamp not valid, skipping",
+					 c->name);
+			continue;
+		}
+		ts2phc_clock_dispatch(priv, c);
 	}
 }
 
@@ -789,6 +999,15 @@ int main(int argc, char *argv[])
 
 	priv.holdover_length = config_get_int(cfg, NULL, "ts2phc.holdover");
 	priv.holdover_start = 0;
+	priv.autocfg = autocfg;
+
+	if (config_get_int(cfg, NULL, "ts2phc.workers")) {
+		if (ts2phc_workers_start(&priv)) {
+			ts2phc_cleanup(&priv);
+			return -1;
+		}
+		priv.workers = true;
+	}
 
 	while (is_running()) {
 		struct ts2phc_clock *clk;
@@ -807,6 +1026,7 @@ int main(int argc, char *argv[])
 
 		LIST_FOREACH(clk, &priv.clocks, list)
 			ts2phc_clock_flush_tstamp(clk);
+		priv.edge_state = TS2PHC_EDGE_PENDING;
 
 		err = ts2phc_pps_sink_poll(&priv);
 		if (err < 0) {
@@ -820,8 +1040,12 @@ int main(int argc, char *argv[])
 				break;
 			}
 
-			ts2phc_synchronize_clocks(&priv, autocfg);
+			ts2phc_synchronize_clocks(&priv);
 		}
+		if (priv.workers)
+			continue;
+		LIST_FOREACH(clk, &priv.clocks, list)
+			servo_state_flush(clk->servo);
 	}
 
 	ts2phc_cleanup(&priv);
@@ -17,6 +17,7 @@
 #include "ts2phc_pps_sink.h"
 
 struct ts2phc_sink_array;
+struct ts2phc_worker;
 
 #define SERVO_SYNC_INTERVAL    1.0
 
@@ -34,6 +35,8 @@ struct ts2phc_clock {
 	bool is_target;
 	bool is_ts_available;
 	tmv_t last_ts;
+	int64_t last_rx;
+	struct ts2phc_worker *worker;
 };
 
 struct ts2phc_port {
@@ -57,11 +60,22 @@ struct ts2phc_private {
 	LIST_HEAD(clock_head, ts2phc_clock) clocks;
 	int holdover_length;
 	time_t holdover_start;
+	bool autocfg;
+	bool workers;
+	/* Source time stamp of the current edge, shared by all clocks. */
+	enum {
+		TS2PHC_EDGE_PENDING,
+		TS2PHC_EDGE_READY,
+		TS2PHC_EDGE_SKIP,
+	} edge_state;
+	tmv_t edge_source;
+	int edge_holdover;
 };
 
 struct ts2phc_clock *ts2phc_clock_add(struct ts2phc_private *priv,
 				      const char *device);
 void ts2phc_clock_destroy(struct ts2phc_clock *clock);
 void ts2phc_clock_add_tstamp(struct ts2phc_clock *clock, tmv_t ts);
+void ts2phc_clock_event(struct ts2phc_private *priv, struct ts2phc_clock *clock);
 
 #endif
@@ -25,19 +25,24 @@
 
 #define MAX_RMC_AGE	5000000000ULL
 #define NMEA_TMO	2000 /*milliseconds*/
+#define NMEA_SEQ_RETRIES	16
 
 struct ts2phc_nmea_pps_source {
 	struct ts2phc_pps_source pps_source;
 	struct config *config;
 	struct lstab *lstab;
 	pthread_t worker;
-	/* Protects anonymous struct fields, below, from concurrent access. */
-	pthread_mutex_t mutex;
 	tmv_t delay_correction;
+	/*
+	 * Sequence lock protecting the anonymous struct fields, below. The
+	 * worker makes the sequence odd while it updates them, and readers
+	 * retry whenever they observe an odd or changed sequence.
+	 */
+	uint32_t seq;
 	struct {
-		struct timespec local_monotime;
-		struct timespec local_utctime;
-		struct timespec rmc_utctime;
+		int64_t local_monotime;
+		int64_t local_utctime;
+		int64_t rmc_utctime;
 		bool rmc_fix_valid;
 	};
 };
@@ -61,6 +66,30 @@ static int open_nmea_connection(const char *host, const char *port,
 	return fd;
 }
 
+static void publish_nmea_status(struct ts2phc_nmea_pps_source *s,
+				struct timespec *rxtime,
+				struct timespec *rxtime_rt,
+				struct nmea_rmc *rmc)
+{
+	uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&s->local_monotime,
+			 tmv_to_nanoseconds(timespec_to_tmv(*rxtime)),
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&s->local_utctime,
+			 tmv_to_nanoseconds(timespec_to_tmv(*rxtime_rt)),
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&s->rmc_utctime,
+			 tmv_to_nanoseconds(timespec_to_tmv(rmc->ts)),
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&s->rmc_fix_valid, rmc->fix_valid, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
 static void *monitor_nmea_status(void *arg)
 {
 	struct timespec rxtime, rxtime_rt, tmo = { 2, 0 };
@@ -69,7 +98,7 @@ static void *monitor_nmea_status(void *arg)
 	char *host, input[256], *port, *ptr, *uart;
 	struct ts2phc_nmea_pps_source *s = arg;
 	int cnt, num, parsed, baud;
-	struct nmea_rmc rmc;
+	struct nmea_rmc rmc, last = {0};
 
 	if (!np) {
 		pr_err("failed to create NMEA parser");
@@ -119,13 +148,16 @@ static void *monitor_nmea_status(void *arg)
 		}
 		ptr = input;
 		do {
-			if (!nmea_parse(np, ptr, cnt, &rmc, &parsed)) {
-				pthread_mutex_lock(&s->mutex);
-				s->local_monotime = rxtime;
-				s->local_utctime = rxtime_rt;
-				s->rmc_utctime = rmc.ts;
-				s->rmc_fix_valid = rmc.fix_valid;
-				pthread_mutex_unlock(&s->mutex);
+			/*
+			 * Receivers send several sentences for each second.
+			 * Only the first one arrives close to the pulse.
+			 */
+			if (!nmea_parse(np, ptr, cnt, &rmc, &parsed) &&
+			    (rmc.ts.tv_sec != last.ts.tv_sec ||
+			     rmc.ts.tv_nsec != last.ts.tv_nsec ||
+			     rmc.fix_valid != last.fix_valid)) {
+				publish_nmea_status(s, &rxtime, &rxtime_rt, &rmc);
+				last = rmc;
 			}
 			cnt -= parsed;
 			ptr += parsed;
@@ -144,7 +176,6 @@ static void ts2phc_nmea_pps_source_destroy(struct ts2phc_pps_source *src)
 	struct ts2phc_nmea_pps_source *s =
 		container_of(src, struct ts2phc_nmea_pps_source, pps_source);
 	pthread_join(s->worker, NULL);
-	pthread_mutex_destroy(&s->mutex);
 	lstab_destroy(s->lstab);
 	free(s);
 }
@@ -157,21 +188,37 @@ static int ts2phc_nmea_pps_source_getppstime(struct ts2phc_pps_source *src,
 	tmv_t delay_t1, delay_t2, duration_since_rmc, local_t1, local_t2, rmc;
 	int lstab_error = -1, tai_offset = 0;
 	enum lstab_result result;
+	bool fix_valid = false;
+	uint32_t seq, check;
 	struct timespec now;
 	int64_t utc_time;
-	bool fix_valid;
+	int i;
 
 	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
 	local_t2 = timespec_to_tmv(now);
 
-	pthread_mutex_lock(&m->mutex);
-
-	local_t1 = timespec_to_tmv(m->local_monotime);
-	delay_t2 = timespec_to_tmv(m->local_utctime);
-	rmc = timespec_to_tmv(m->rmc_utctime);
-	fix_valid = m->rmc_fix_valid;
-
-	pthread_mutex_unlock(&m->mutex);
+	for (i = 0; i < NMEA_SEQ_RETRIES; i++) {
+		seq = __atomic_load_n(&m->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			continue;
+		}
+		local_t1 = nanoseconds_to_tmv(
+			__atomic_load_n(&m->local_monotime, __ATOMIC_RELAXED));
+		delay_t2 = nanoseconds_to_tmv(
+			__atomic_load_n(&m->local_utctime, __ATOMIC_RELAXED));
+		rmc = nanoseconds_to_tmv(
+			__atomic_load_n(&m->rmc_utctime, __ATOMIC_RELAXED));
+		fix_valid = __atomic_load_n(&m->rmc_fix_valid, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		check = __atomic_load_n(&m->seq, __ATOMIC_RELAXED);
+		if (check == seq) {
+			break;
+		}
+	}
+	if (i == NMEA_SEQ_RETRIES) {
+		pr_debug("nmea: no consistent rmc");
+		return -1;
+	}
 
 	if (!fix_valid) {
 		pr_debug("nmea: no valid rmc fix");
@@ -238,7 +285,6 @@ struct ts2phc_pps_source *ts2phc_nmea_pps_source_create(struct ts2phc_private *p
 	s->config = priv->cfg;
 	s->delay_correction = nanoseconds_to_tmv(
 			 config_get_int(priv->cfg, NULL, "ts2phc.nmea_delay"));
-	pthread_mutex_init(&s->mutex, NULL);
 	err = pthread_create(&s->worker, NULL, monitor_nmea_status, s);
 	if (err) {
 		pr_err("failed to create worker thread: %s", strerror(err));
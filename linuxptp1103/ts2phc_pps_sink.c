@@ -61,7 +61,8 @@ static int ts2phc_pps_sink_array_create(struct ts2phc_private *priv)
 	if (!polling_array->sink)
 		goto err_alloc_sinks;
 
-	polling_array->pfd = malloc(priv->n_sinks *
+	/* One more entry for the connection to ptp4l. */
+	polling_array->pfd = malloc((priv->n_sinks + 1) *
 				    sizeof(*polling_array->pfd));
 	if (!polling_array->pfd)
 		goto err_alloc_pfd;
@@ -81,6 +82,8 @@ static int ts2phc_pps_sink_array_create(struct ts2phc_private *priv)
 		polling_array->pfd[i].events = POLLIN | POLLPRI;
 		polling_array->pfd[i].fd = sink->clock->fd;
 	}
+	polling_array->pfd[i].events = POLLIN | POLLPRI;
+	polling_array->pfd[i].fd = -1;
 
 	priv->polling_array = polling_array;
 
@@ -307,6 +310,7 @@ out:
 	ts = pct_to_tmv(event.t);
 	ts = tmv_add(ts, sink->correction);
 	ts2phc_clock_add_tstamp(sink->clock, ts);
+	ts2phc_clock_event(priv, sink->clock);
 
 	return EXTTS_OK;
 }
@@ -389,13 +393,16 @@ int ts2phc_pps_sink_poll(struct ts2phc_private *priv)
 	for (i = 0; i < priv->n_sinks; i++)
 		polling_array->collected_events[i] = 0;
 
+	polling_array->pfd[priv->n_sinks].fd = priv->agent ?
+		pmc_agent_get_fd(priv->agent) : -1;
+
 	while (!all_sinks_have_events) {
 		struct ts2phc_pps_sink *sink;
 
 		if (!is_running())
 			return 0;
 
-		cnt = poll(polling_array->pfd, priv->n_sinks, 2000);
+		cnt = poll(polling_array->pfd, priv->n_sinks + 1, 2000);
 		if (cnt < 0) {
 			if (errno == EINTR) {
 				return 0;
@@ -408,6 +415,15 @@ int ts2phc_pps_sink_poll(struct ts2phc_private *priv)
 			return 0;
 		}
 
+		if (polling_array->pfd[priv->n_sinks].revents &
+		    (POLLIN | POLLPRI)) {
+			if (pmc_agent_process(priv->agent) < 0)
+				return -EIO;
+			/* Let the caller reconfigure right away. */
+			if (priv->state_changed)
+				return 0;
+		}
+
 		for (i = 0; i < priv->n_sinks; i++) {
 			if (polling_array->pfd[i].revents & POLLERR) {
 				sink = polling_array->sink[i];
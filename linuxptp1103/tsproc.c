@@ -145,6 +145,15 @@ tmv_t get_raw_delay(struct tsproc *tsp)
 	return delay;
 }
 
+int tsproc_raw_delay(struct tsproc *tsp, tmv_t *delay)
+{
+	if (tmv_is_zero(tsp->t2) || tmv_is_zero(tsp->t3))
+		return -1;
+
+	*delay = get_raw_delay(tsp);
+	return 0;
+}
+
 int tsproc_update_delay(struct tsproc *tsp, tmv_t *delay)
 {
 	tmv_t raw_delay;
@@ -82,6 +82,14 @@ void tsproc_set_clock_rate_ratio(struct tsproc *tsp, double clock_rate_ratio);
  */
 void tsproc_set_delay(struct tsproc *tsp, tmv_t delay);
 
+/**
+ * Calculate the raw delay from the latest measurements, without filtering.
+ * @param tsp    Pointer obtained via @ref tsproc_create().
+ * @param delay  A pointer to store the raw delay.
+ * @return       0 on success, -1 when the measurements are incomplete.
+ */
+int tsproc_raw_delay(struct tsproc *tsp, tmv_t *delay);
+
 /**
  * Update delay in a time stamp processor using new measurements.
  * @param tsp    Pointer obtained via @ref tsproc_create().
@@ -154,7 +154,7 @@ static int udp_open(struct transport *t, struct interface *iface,
 	struct udp *udp = container_of(t, struct udp, t);
 	const char *name = interface_name(iface);
 	uint8_t event_dscp, general_dscp;
-	int efd, gfd, ttl;
+	int domain, efd, gfd, ts, ttl;
 	char *str;
 
 	ttl = config_get_int(t->cfg, name, "udp_ttl");
@@ -191,6 +191,11 @@ static int udp_open(struct transport *t, struct interface *iface,
 	if (sk_general_init(gfd))
 		goto no_timestamping;
 
+	domain = transport_domain_filter(t, name, &ts);
+	if (domain >= 0 && (sk_set_domain_filter(efd, domain, ts) ||
+			    sk_set_domain_filter(gfd, domain, ts)))
+		goto no_timestamping;
+
 	event_dscp = config_get_int(t->cfg, NULL, "dscp_event");
 	general_dscp = config_get_int(t->cfg, NULL, "dscp_general");
 
@@ -226,9 +231,13 @@ static int udp_send(struct transport *t, struct fdarray *fda,
 	struct address addr_buf;
 	unsigned char junk[1600];
 	ssize_t cnt;
-	int fd = -1;
+	int fd = -1, flags = 0;
 
 	switch (event) {
+	case TRANS_GENERAL_NOWAIT:
+		flags = MSG_DONTWAIT;
+		event = TRANS_GENERAL;
+		/* fall through */
 	case TRANS_GENERAL:
 		fd = fda->fd[FD_GENERAL];
 		break;
@@ -259,7 +268,7 @@ static int udp_send(struct transport *t, struct fdarray *fda,
 	if (event == TRANS_ONESTEP)
 		len += 2;
 
-	cnt = sendto(fd, buf, len, 0, &addr->sa, sizeof(addr->sin));
+	cnt = sendto(fd, buf, len, flags, &addr->sa, sizeof(addr->sin));
 	if (cnt < 1) {
 		pr_err("sendto failed: %m");
 		return -errno;
@@ -162,7 +162,7 @@ static int udp6_open(struct transport *t, struct interface *iface,
 	struct udp6 *udp6 = container_of(t, struct udp6, t);
 	const char *name = interface_name(iface);
 	uint8_t event_dscp, general_dscp;
-	int efd, gfd, hop_limit;
+	int domain, efd, gfd, hop_limit, ts;
 	char *str;
 
 	hop_limit = config_get_int(t->cfg, name, "udp_ttl");
@@ -204,6 +204,11 @@ static int udp6_open(struct transport *t, struct interface *iface,
 	if (sk_general_init(gfd))
 		goto no_timestamping;
 
+	domain = transport_domain_filter(t, name, &ts);
+	if (domain >= 0 && (sk_set_domain_filter(efd, domain, ts) ||
+			    sk_set_domain_filter(gfd, domain, ts)))
+		goto no_timestamping;
+
 	event_dscp = config_get_int(t->cfg, NULL, "dscp_event");
 	general_dscp = config_get_int(t->cfg, NULL, "dscp_general");
 
@@ -240,9 +245,13 @@ static int udp6_send(struct transport *t, struct fdarray *fda,
 	struct address addr_buf;
 	unsigned char junk[1600];
 	ssize_t cnt;
-	int fd = -1;
+	int fd = -1, flags = 0;
 
 	switch (event) {
+	case TRANS_GENERAL_NOWAIT:
+		flags = MSG_DONTWAIT;
+		event = TRANS_GENERAL;
+		/* fall through */
 	case TRANS_GENERAL:
 		fd = fda->fd[FD_GENERAL];
 		break;
@@ -270,7 +279,7 @@ static int udp6_send(struct transport *t, struct fdarray *fda,
 
 	len += 2; /* Extend the payload by two, for UDP checksum corrections. */
 
-	cnt = sendto(fd, buf, len, 0, &addr->sa, sizeof(addr->sin6));
+	cnt = sendto(fd, buf, len, flags, &addr->sa, sizeof(addr->sin6));
 	if (cnt < 1) {
 		pr_err("sendto failed: %m");
 		return -errno;
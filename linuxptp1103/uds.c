@@ -124,11 +124,12 @@ static int uds_send(struct transport *t, struct fdarray *fda,
 {
 	int cnt, fd = fda->fd[FD_GENERAL];
 	struct uds *uds = container_of(t, struct uds, t);
+	int flags = event == TRANS_GENERAL_NOWAIT ? MSG_DONTWAIT : 0;
 
 	if (!addr)
 		addr = &uds->address;
 
-	cnt = sendto(fd, buf, buflen, 0, &addr->sa, addr->len);
+	cnt = sendto(fd, buf, buflen, flags, &addr->sa, addr->len);
 	if (cnt < 1) {
 		return -errno;
 	}
@@ -419,6 +419,22 @@ int unicast_client_initialize(struct port *p)
 	return 0;
 }
 
+int unicast_client_reload(struct port *p)
+{
+	struct unicast_master_table *table = p->unicast_master_table;
+
+	if (!table) {
+		return 0;
+	}
+	if (unicast_client_initialize(p)) {
+		return -1;
+	}
+	if (p->unicast_master_table != table) {
+		free_master_table(table);
+	}
+	return 0;
+}
+
 void unicast_client_cleanup(struct port *p)
 {
 	if (p->unicast_master_table)
@@ -526,8 +542,8 @@ void unicast_client_grant(struct port *p, struct ptp_message *m,
 
 int unicast_client_set_tmo(struct port *p)
 {
-	return set_tmo_log(p->fda.fd[FD_UNICAST_REQ_TIMER], 1,
-			   p->unicast_master_table->logQueryInterval);
+	return port_set_tmo_log(p, FD_UNICAST_REQ_TIMER, 1,
+				p->unicast_master_table->logQueryInterval);
 }
 
 void unicast_client_state_changed(struct port *p)
@@ -42,6 +42,14 @@ int unicast_client_cancel(struct port *p, struct ptp_message *m,
  */
 int unicast_client_initialize(struct port *port);
 
+/**
+ * Replaces the copy of the unicast master table of a port with a fresh
+ * one from the configuration. Ports without a table are left alone.
+ * @param p      The port in question.
+ * @return       Zero on success, non-zero otherwise, keeping the old table.
+ */
+int unicast_client_reload(struct port *p);
+
 /**
  * Frees all of the resources associated with a port's unicast client.
  * @param p      The port in question.
@@ -248,20 +248,15 @@ static void unicast_service_extend(struct unicast_client_address *client,
 static int unicast_service_rearm_timer(struct port *p)
 {
 	struct unicast_service_interval *interval;
-	struct itimerspec tmo;
-	int fd;
 
-	fd = p->fda.fd[FD_UNICAST_SRV_TIMER];
-	memset(&tmo, 0, sizeof(tmo));
 	interval = pqueue_peek(p->unicast_service->queue);
-	if (interval) {
-		tmo.it_value = interval->tmo;
-		pr_debug("arming timer tmo={%lld,%ld}",
-			 (long long)interval->tmo.tv_sec, interval->tmo.tv_nsec);
-	} else {
+	if (!interval) {
 		pr_debug("stopping unicast service timer");
+		return port_clr_tmo(p, FD_UNICAST_SRV_TIMER);
 	}
-	return timerfd_settime(fd, TFD_TIMER_ABSTIME, &tmo, NULL);
+	pr_debug("arming timer tmo={%lld,%ld}",
+		 (long long)interval->tmo.tv_sec, interval->tmo.tv_nsec);
+	return port_set_tmo_abs(p, FD_UNICAST_SRV_TIMER, &interval->tmo);
 }
 
 static int unicast_service_reply(struct port *p, struct ptp_message *dst,
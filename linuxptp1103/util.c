@@ -36,6 +36,7 @@
 #define NS_PER_DAY (24 * NS_PER_HOUR)
 
 static int running = 1;
+static volatile sig_atomic_t reload;
 
 const char *ps_str[] = {
 	"NONE",
@@ -633,6 +634,34 @@ int is_running(void)
 	return running;
 }
 
+static void handle_hup(int s)
+{
+	reload = 1;
+}
+
+int handle_reload_signal(void)
+{
+	if (SIG_ERR == signal(SIGHUP, handle_hup)) {
+		fprintf(stderr, "cannot handle SIGHUP\n");
+		return -1;
+	}
+	return 0;
+}
+
+void request_reload(void)
+{
+	reload = 1;
+}
+
+int reload_requested(void)
+{
+	if (!reload) {
+		return 0;
+	}
+	reload = 0;
+	return 1;
+}
+
 void *xmalloc(size_t size)
 {
 	void *r;
@@ -367,6 +367,26 @@ int handle_term_signals(void);
  */
 int is_running(void);
 
+/**
+ * Setup a handler for SIGHUP which requests a reload of the configuration
+ * instead of terminating the program. Call after handle_term_signals().
+ *
+ * @return       0 on success, -1 on error.
+ */
+int handle_reload_signal(void);
+
+/**
+ * Request a reload of the configuration, as if SIGHUP was received.
+ */
+void request_reload(void);
+
+/**
+ * Check and clear a pending request to reload the configuration.
+ *
+ * @return       1 if a reload was requested since the last call, 0 otherwise.
+ */
+int reload_requested(void);
+
 /**
  * Allocate memory. This is a malloc() wrapper that terminates the process when
  * the allocation fails.